@@ -1,4 +1,8 @@
 #include "QGraphicsCircleObject.h"
+#include "QGraphicsRenderQuality.h"
+#include "QGraphicsOverlayTiles.h"
+#include "QGraphicsROIClusters.h"
+#include "QGraphicsDragIndex.h"
 #include <QGraphicsScene>
 #include <QGraphicsView>
 #include <QPainter>
@@ -7,8 +11,9 @@
 #include <cassert>
 
 QGraphicsCircleObject::QGraphicsCircleObject(const QPointF& center, qreal radius, QGraphicsItem* parent)
-    : QGraphicsObject(parent)
+    : QGraphicsROIObject(parent)
     , _handle_size(DEFAULT_HANDLE_SIZE)
+    , _roi_id(-1)
     , _shape_pen(QBrush(Qt::red), 1, Qt::SolidLine) 
     , _handle_pen(QBrush(Qt::green), 1, Qt::SolidLine) 
 {
@@ -22,6 +27,7 @@ QGraphicsCircleObject::QGraphicsCircleObject(const QPointF& center, qreal radius
 
     _center = mapFromScene(center);
     _radius = radius; 
+    _shape_bound = _circle_rect(); 
     _update_handles(); 
     _clear_mode(); 
 }
@@ -52,6 +58,52 @@ void QGraphicsCircleObject::setHandleColor(const QColor& color)
     _handle_pen.setColor(color); 
 }
 
+QPen QGraphicsCircleObject::shapePen() const
+{
+    return _shape_pen; 
+}
+
+QGraphicsROIShape QGraphicsCircleObject::roiShape() const
+{
+    return QGraphicsROIShape::fromCircle(mapToScene(_center), _radius); 
+}
+
+QGraphicsROIMetrics QGraphicsCircleObject::metrics() const
+{
+    return QGraphicsROIMetrics::fromShape(roiShape()); 
+}
+
+// circle in scene coords, without notifying 
+void QGraphicsCircleObject::setCircle(const QPointF& center, qreal radius)
+{
+    _center = mapFromScene(center);
+    _radius = radius; 
+    _fit_bound(_circle_rect()); 
+    _update_handles(); 
+    update(); 
+}
+
+void QGraphicsCircleObject::setRoiId(qint64 id)
+{
+    _roi_id = id; 
+}
+
+qint64 QGraphicsCircleObject::roiId() const
+{
+    return _roi_id; 
+}
+
+// transform circle in scene coords in place, without notifying, 
+// for group edits of many items 
+void QGraphicsCircleObject::transformShape(const QTransform& transform)
+{
+    _center = mapFromScene(transform.map(mapToScene(_center))); 
+    _radius *= sqrt(fabs(transform.determinant())); 
+    _fit_bound(_circle_rect()); 
+    _update_handles(); 
+    update(); 
+}
+
 // return the actual bounding area of the item
 // include the circle bounding box and handles 
 QRectF QGraphicsCircleObject::boundingRect() const
@@ -59,10 +111,8 @@ QRectF QGraphicsCircleObject::boundingRect() const
     auto t = this->scene()->views().at(0)->transform(); //get current sace factors
     qreal x_off = (_handle_size / t.m11()) / 2.0 + 1; 
     qreal y_off = (_handle_size / t.m22()) / 2.0 + 1; 
-    // extend the area of polygon to include the handle rects
-    QPointF off(_radius, _radius); 
-    QRectF rect(_center - off, _center + off); 
-    return rect.adjusted(-x_off, -y_off, x_off, y_off);
+    // extend the area of circle to include the handle rects
+    return _shape_bound.adjusted(-x_off, -y_off, x_off, y_off);
 }
 
 void QGraphicsCircleObject::_update_handles()
@@ -85,12 +135,25 @@ void QGraphicsCircleObject::_update_handles()
 // customized painting
 void QGraphicsCircleObject::paint(QPainter* painter, const QStyleOptionGraphicsItem*, QWidget*)
 {
+    // static items are rendered in overlay tiles
+    if (!isSelected() && QGraphicsOverlayTiles::isActive(scene())) {
+        return; 
+    }
+    // small items are drawn as clusters 
+    qreal lod_cell = QGraphicsROIClusters::lodCellSize(scene()); 
+    if (lod_cell > 0 && !isSelected() && qMax(_shape_bound.width(), _shape_bound.height()) <= lod_cell) {
+        return; 
+    }
+    int fast_path = QGraphicsRenderQuality::activeFastPath(scene());
     painter->setPen(_shape_pen);
     painter->drawEllipse(_center, _radius, _radius); 
-    painter->drawLine(_center - QPointF(_radius, 0), _center + QPointF(_radius, 0)); 
-    painter->drawLine(_center - QPointF(0, _radius), _center + QPointF(0, _radius)); 
+    // skip crossing lines on simplified outline 
+    if (!(fast_path & QGraphicsRenderQuality::SIMPLIFIED_OUTLINES)) {
+        painter->drawLine(_center - QPointF(_radius, 0), _center + QPointF(_radius, 0)); 
+        painter->drawLine(_center - QPointF(0, _radius), _center + QPointF(0, _radius)); 
+    }
     // draw resize handles if the item is currectly selected
-    if (isSelected()) {
+    if (isSelected() && !(fast_path & QGraphicsRenderQuality::NO_HANDLES)) {
         _update_handles();
         painter->setPen(_handle_pen);
         painter->drawRects(_handles);
@@ -158,6 +221,55 @@ void QGraphicsCircleObject::_resize_circle(const QPointF& pos)
     _radius = sqrt(pow(pos.x() - _center.x(), 2) + pow(pos.y() - _center.y(), 2)); 
 }
 
+QRectF QGraphicsCircleObject::_circle_rect() const
+{
+    QPointF off(_radius, _radius); 
+    return QRectF(_center - off, _center + off); 
+}
+
+// damage of the circle changing radius, the annulus in between 
+// covered by sectors, including crossing lines and handles 
+void QGraphicsCircleObject::_annulus_damage(qreal before, qreal after, QVector<QRectF>& damage) const
+{
+    const int sectors = 16; 
+    qreal margin = _damage_margin(_handle_size, _shape_pen); 
+    qreal inner = qMax(qreal(0), qMin(before, after) - margin); 
+    qreal outer = qMax(before, after) + margin; 
+    for (int i = 0; i < sectors; i++) {
+        // sector boundaries include the axis, so the corners bound the sector 
+        qreal a0 = 2 * M_PI * i / sectors; 
+        qreal a1 = 2 * M_PI * (i + 1) / sectors; 
+        QPolygonF corners; 
+        corners << _center + QPointF(cos(a0), sin(a0)) * inner 
+                << _center + QPointF(cos(a1), sin(a1)) * inner 
+                << _center + QPointF(cos(a0), sin(a0)) * outer 
+                << _center + QPointF(cos(a1), sin(a1)) * outer; 
+        damage.append(corners.boundingRect()); 
+    }
+}
+
+// move the resizing handle and repaint only the damaged area, 
+// the annulus between old and new radius, before and after the move. 
+// return damaged rects in local coords 
+QVector<QRectF> QGraphicsCircleObject::_move_handle(const QPointF& pos)
+{
+    qreal before = _radius; 
+    _resize_circle(pos); 
+    QVector<QRectF> damage; 
+    _annulus_damage(before, _radius, damage); 
+    if (_grow_bound(_circle_rect())) {
+        // full repaint by geometry change 
+        damage.clear(); 
+        damage.append(boundingRect()); 
+    }
+    else {
+        for (int i = 0; i < damage.size(); i++) {
+            scene()->update(mapRectToScene(damage[i])); 
+        }
+    }
+    return damage; 
+}
+
 void QGraphicsCircleObject::hoverEnterEvent(QGraphicsSceneHoverEvent* event)
 {
     _clear_mode(); 
@@ -184,26 +296,32 @@ void QGraphicsCircleObject::mousePressEvent(QGraphicsSceneMouseEvent* event)
         _set_dragging_mode(); 
     }
     QGraphicsObject::mousePressEvent(event);
+    // selection is settled by the press 
+    if (!_resizing && event->button() == Qt::LeftButton) {
+        Q_EMIT dragStarted(); 
+    }
 }
 
 void QGraphicsCircleObject::mouseMoveEvent(QGraphicsSceneMouseEvent* event)
 {
     if (_resizing) {
         if (scene()->sceneRect().contains(event->scenePos())) {
-            _resize_circle(event->pos());
-            prepareGeometryChange();
-            update();
+            _move_handle(event->pos());
         }
+        // notify changing
+        Q_EMIT circleChanged(mapToScene(_center), _radius);
     }
     else {
+        // moving of all selected items is notified by itemChange() 
         QGraphicsObject::mouseMoveEvent(event);
     }
-    // notify changing
-    Q_EMIT circleChanged(mapToScene(_center), _radius);
 }
 
 void QGraphicsCircleObject::mouseReleaseEvent(QGraphicsSceneMouseEvent* event)
 {
+    if (_resizing) {
+        _fit_bound(_circle_rect()); 
+    }
     _clear_mode(); 
     QGraphicsObject::mouseReleaseEvent(event);
 }
@@ -217,10 +335,16 @@ QVariant QGraphicsCircleObject::itemChange(GraphicsItemChange change, const QVar
     //     QPointF pt = value.toPointF(); // new pos
     // }
 
+    // moving of a large selection is notified once when dragging ends 
+    if (change == QGraphicsItem::ItemPositionHasChanged && !QGraphicsDragIndex::isDragging(scene())) {
+        Q_EMIT circleChanged(mapToScene(_center), _radius);
+    }
+
     if (change == QGraphicsItem::ItemSelectedHasChanged) {
         // move to front when selected 
         bool selected = value.toBool();
         setZValue(selected ? 1 : 0);
+        Q_EMIT selectedChanged(selected); 
     }
     return QGraphicsItem::itemChange(change, value);
 }
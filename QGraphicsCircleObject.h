@@ -1,13 +1,15 @@
 #pragma once 
 
-#include <QGraphicsObject>
+#include "QGraphicsROIObject.h"
 #include <QGraphicsSceneHoverEvent>
 #include <QGraphicsSceneMouseEvent>
 #include <QPen>
+#include "QGraphicsROIShape.h"
+#include "QGraphicsROIMetrics.h"
 
 #define DEFAULT_HANDLE_SIZE 10
 
-class QGraphicsCircleObject : public QGraphicsObject
+class QGraphicsCircleObject : public QGraphicsROIObject
 {
     Q_OBJECT
 public:
@@ -34,9 +36,31 @@ public:
     void setHandleSize(int size); 
     void setHandleColor(const QColor& color); 
 
+    QPen shapePen() const; 
+
+    // circle in scene coords 
+    QGraphicsROIShape roiShape() const; 
+    // area, perimeter, centroid and bound in scene coords 
+    QGraphicsROIMetrics metrics() const; 
+    // circle in scene coords, without notifying 
+    void setCircle(const QPointF& center, qreal radius); 
+
+    // identifier of the ROI, -1 by default 
+    void setRoiId(qint64 id); 
+    qint64 roiId() const; 
+
+    // transform circle in scene coords in place, without notifying 
+    void transformShape(const QTransform& transform); 
+
 signals:
     void circleChanged(const QPointF& center, qreal radius);
 
+    // dragging with all selected items starts 
+    void dragStarted();
+
+    // item is selected or deselected 
+    void selectedChanged(bool);
+
 protected:
     QRectF boundingRect() const;
     void paint(QPainter*, const QStyleOptionGraphicsItem*, QWidget*);
@@ -54,7 +78,10 @@ protected:
     QVariant itemChange(GraphicsItemChange change, const QVariant &value); 
 
     void _update_handles(); 
+    QRectF _circle_rect() const; 
     void _resize_circle(const QPointF& pos); 
+    QVector<QRectF> _move_handle(const QPointF& pos); 
+    void _annulus_damage(qreal before, qreal after, QVector<QRectF>& damage) const; 
     int _check_pos_in_handle(const QPointF& pos); 
     bool _set_resizing_mode(const QPointF& pos); 
     void _set_dragging_mode(); 
@@ -63,6 +90,7 @@ protected:
 protected:
     // circle and handles 
     int _handle_size; 
+    qint64 _roi_id; 
     QPointF _center;
     qreal _radius; 
     QVector<QRectF> _handles;
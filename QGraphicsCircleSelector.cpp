@@ -1,5 +1,6 @@
 #include "QGraphicsCircleSelector.h"
 #include "QGraphicsViewZoom.h"
+#include "QGraphicsRenderQuality.h"
 #include "QGraphicsCircleObject.h"
 #include <QKeyEvent>
 #include <QDebug>
@@ -8,6 +9,9 @@
 
 QGraphicsCircleSelector::QGraphicsCircleSelector(QWidget* parent)
     : QGraphicsView(parent)
+    , _overlay(NULL)
+    , _clusters(NULL)
+    , _selecting_mode(false)
     , _drawing_mode(false)
     , _drawing_radius(0)
     , _drawing_circle(NULL)
@@ -21,25 +25,57 @@ QGraphicsCircleSelector::QGraphicsCircleSelector(QWidget* parent)
     QGraphicsViewZoom* zoom = new QGraphicsViewZoom(this);
     zoom->set_modifiers(Qt::NoModifier);
 
+    // fast rendering while panning and zooming 
+    QGraphicsRenderQuality* quality = new QGraphicsRenderQuality(this);
+    connect(zoom, &QGraphicsViewZoom::zoomStarted, 
+            quality, &QGraphicsRenderQuality::beginInteraction);
+    connect(zoom, &QGraphicsViewZoom::zoomFinished, 
+            quality, &QGraphicsRenderQuality::endInteraction);
+    connect(quality, &QGraphicsRenderQuality::qualityChanged, 
+            this, &QGraphicsCircleSelector::onQualityChanged);
+
     setScene(&_scene);
-    connect(&_scene, &QGraphicsScene::selectionChanged, 
-            this, &QGraphicsCircleSelector::onSelectionChanged);
+
+    // selection tracked by changes 
+    _selection = new QGraphicsROISelection(this);
+
+    // move large selections unindexed 
+    _drag_index = new QGraphicsDragIndex(this);
+    connect(_drag_index, &QGraphicsDragIndex::itemsMoved, 
+            this, &QGraphicsCircleSelector::onItemsMoved);
+
+    // ROIs from worker threads 
+    _queue = new QGraphicsROIQueue(this);
+    connect(_queue, &QGraphicsROIQueue::recordsReady, 
+            this, &QGraphicsCircleSelector::onRecordsReady);
 
     // default scene 
-    scene()->addPixmap(QPixmap::fromImage(QImage(1920, 1080, QImage::Format_RGB888)));
+    _background = scene()->addPixmap(QPixmap::fromImage(QImage(1920, 1080, QImage::Format_RGB888)));
+    _background->setTransformationMode(Qt::SmoothTransformation);
     scene()->setSceneRect(QRectF(0, 0, 1920, 1080));
 }
 
 QGraphicsCircleSelector::~QGraphicsCircleSelector()
 {
-
+    delete _overlay; 
+    delete _clusters; 
 }
 // add a polygon item
-void QGraphicsCircleSelector::addCircleItem(const QPointF& center, qreal radius)
+QGraphicsCircleObject* QGraphicsCircleSelector::addCircleItem(const QPointF& center, qreal radius)
 {
     QGraphicsCircleObject* item = new QGraphicsCircleObject(center, radius);
     connect(item, SIGNAL(circleChanged(const QPointF&, qreal)), this, SLOT(onCircleChanged(const QPointF&, qreal)));
+    connect(item, SIGNAL(dragStarted()), this, SLOT(onDragStarted()));
+    _selection->addItem(item); 
     scene()->addItem(item); 
+    if (_overlay) {
+        _overlay->setShape(item, item->roiShape(), item->shapePen()); 
+    }
+    if (_clusters) {
+        _clusters->setItem(item, item->roiShape().boundingRect()); 
+    }
+    _publish(item); 
+    return item; 
 }
 
 // enable drawing polygon with mouse
@@ -56,10 +92,235 @@ void QGraphicsCircleSelector::setDrawingMode(bool drawing)
     }
 }
 
+// select items intersecting the rubber band, by the index of the scene 
+void QGraphicsCircleSelector::setSelectingMode(bool selecting)
+{
+    _selecting_mode = selecting;
+    if (_selecting_mode) {
+        setRubberBandSelectionMode(Qt::IntersectsItemBoundingRect);
+        setDragMode(QGraphicsView::RubberBandDrag);
+        viewport()->setCursor(Qt::ArrowCursor);
+    }
+    else {
+        setDragMode(QGraphicsView::ScrollHandDrag);
+    }
+}
+
+void QGraphicsCircleSelector::moveSelected(const QPointF& offset)
+{
+    transformSelected(QTransform::fromTranslate(offset.x(), offset.y()));
+}
+
+// scale about the center of selected items 
+void QGraphicsCircleSelector::scaleSelected(qreal factor)
+{
+    QRectF bound;
+    foreach (QGraphicsItem* item, _selection->items()) {
+        bound |= item->sceneBoundingRect();
+    }
+    QPointF center = bound.center();
+    QTransform transform;
+    transform.translate(center.x(), center.y());
+    transform.scale(factor, factor);
+    transform.translate(-center.x(), -center.y());
+    transformSelected(transform);
+}
+
+// geometry of items is transformed in place, without position changes and 
+// their notifications, and a large selection is transformed unindexed, 
+// the index is rebuilt once after a burst of key presses 
+void QGraphicsCircleSelector::transformSelected(const QTransform& transform)
+{
+    if (_selection->count() == 0) {
+        return; 
+    }
+    QList<QGraphicsItem*> items = _selection->items().toList();
+    if (items.size() >= _drag_index->threshold()) {
+        _drag_index->suspend(); 
+    }
+    foreach (QGraphicsItem* item, items) {
+        QGraphicsCircleObject* roi = qobject_cast<QGraphicsCircleObject*>(item->toGraphicsObject()); 
+        if (roi) {
+            roi->transformShape(transform); 
+        }
+    }
+    onItemsMoved(items);
+}
+
+// deleted items are dropped from selection without notification 
+void QGraphicsCircleSelector::deleteSelected()
+{
+    QList<QGraphicsItem*> items = _selection->items().toList();
+    foreach (QGraphicsItem* item, items) {
+        _remove_item(item); 
+    }
+}
+
+void QGraphicsCircleSelector::_remove_item(QGraphicsItem* item)
+{
+    _drag_index->removeItem(item); 
+    if (_overlay) {
+        _overlay->removeShape(item); 
+    }
+    if (_clusters) {
+        _clusters->removeItem(item); 
+    }
+    if (_publisher) {
+        _publisher->publishRemove(item); 
+    }
+    delete item; 
+}
+
+void QGraphicsCircleSelector::_publish(QGraphicsCircleObject* item)
+{
+    if (_publisher) {
+        _publisher->publishShape(item, item->roiShape()); 
+    }
+}
+
+QGraphicsROIQueue* QGraphicsCircleSelector::roiQueue() const
+{
+    return _queue; 
+}
+
+// visible ROIs of the scene 
+QList<QGraphicsItem*> QGraphicsCircleSelector::_roi_list() const
+{
+    QList<QGraphicsItem*> items; 
+    foreach (QGraphicsItem* item, _scene.items()) {
+        if (item->isVisible() && qobject_cast<QGraphicsCircleObject*>(item->toGraphicsObject())) {
+            items.append(item); 
+        }
+    }
+    return items; 
+}
+
+QVector<QGraphicsROIOverlap::Pair> QGraphicsCircleSelector::findOverlaps(QList<QGraphicsItem*>& items, qreal tolerance)
+{
+    items = _roi_list(); 
+    QVector<QGraphicsROIShape> shapes; 
+    shapes.reserve(items.size()); 
+    foreach (QGraphicsItem* item, items) {
+        shapes.append(static_cast<QGraphicsCircleObject*>(item->toGraphicsObject())->roiShape()); 
+    }
+    QGraphicsROIOverlap overlap(shapes, tolerance); 
+    return overlap.pairs(); 
+}
+
+void QGraphicsCircleSelector::selectOverlapping(qreal iou_threshold)
+{
+    QList<QGraphicsItem*> items; 
+    QVector<QGraphicsROIOverlap::Pair> pairs = findOverlaps(items); 
+    _scene.clearSelection(); 
+    foreach (const QGraphicsROIOverlap::Pair& pair, pairs) {
+        if (pair.iou > iou_threshold) {
+            items[pair.first]->setSelected(true); 
+            items[pair.second]->setSelected(true); 
+        }
+    }
+}
+
+int QGraphicsCircleSelector::removeDuplicates(qreal iou_threshold)
+{
+    QList<QGraphicsItem*> items = _roi_list(); 
+    QVector<QGraphicsROIShape> shapes; 
+    shapes.reserve(items.size()); 
+    foreach (QGraphicsItem* item, items) {
+        shapes.append(static_cast<QGraphicsCircleObject*>(item->toGraphicsObject())->roiShape()); 
+    }
+    QGraphicsROIOverlap overlap(shapes); 
+    int removed = 0; 
+    foreach (const QVector<int>& group, overlap.duplicates(iou_threshold)) {
+        int largest = group.first(); 
+        foreach (int i, group) {
+            if (overlap.area(i) > overlap.area(largest)) {
+                largest = i; 
+            }
+        }
+        foreach (int i, group) {
+            if (i != largest) {
+                _remove_item(items[i]); 
+                removed++; 
+            }
+        }
+    }
+    return removed; 
+}
+
+// render static ROIs into cached tiles on worker threads 
+void QGraphicsCircleSelector::setOverlayTiles(bool enabled)
+{
+    if (enabled == (_overlay != NULL)) {
+        return; 
+    }
+    if (enabled) {
+        _overlay = new QGraphicsOverlayTiles(this); 
+        _overlay->setSelection(_selection); 
+        foreach (QGraphicsItem* item, _scene.items()) {
+            QGraphicsCircleObject* roi = qobject_cast<QGraphicsCircleObject*>(item->toGraphicsObject()); 
+            if (roi) {
+                _overlay->setShape(roi, roi->roiShape(), roi->shapePen()); 
+            }
+        }
+    }
+    else {
+        delete _overlay; 
+        _overlay = NULL; 
+    }
+    viewport()->update(); 
+}
+
+// draw small ROIs as clusters below full detail zoom 
+void QGraphicsCircleSelector::setLevelOfDetail(bool enabled)
+{
+    if (enabled == (_clusters != NULL)) {
+        return; 
+    }
+    if (enabled) {
+        _clusters = new QGraphicsROIClusters(this); 
+        foreach (QGraphicsItem* item, _scene.items()) {
+            QGraphicsCircleObject* roi = qobject_cast<QGraphicsCircleObject*>(item->toGraphicsObject()); 
+            if (roi) {
+                _clusters->setItem(roi, roi->roiShape().boundingRect()); 
+            }
+        }
+    }
+    else {
+        delete _clusters; 
+        _clusters = NULL; 
+    }
+    viewport()->update(); 
+}
+
+// visible circles in the scene published as added 
+void QGraphicsCircleSelector::setPublisher(QGraphicsROIPublisher* publisher)
+{
+    _publisher = publisher; 
+    foreach (QGraphicsItem* item, _roi_list()) {
+        QGraphicsCircleObject* roi = qobject_cast<QGraphicsCircleObject*>(item->toGraphicsObject()); 
+        if (roi) {
+            _publish(roi); 
+        }
+    }
+    if (_publisher) {
+        _publisher->publishCommit(); 
+    }
+}
+
+void QGraphicsCircleSelector::drawForeground(QPainter* painter, const QRectF& rect)
+{
+    if (_clusters) {
+        _clusters->paint(painter, rect); 
+    }
+}
+
 void QGraphicsCircleSelector::_clear_drawing()
 {
     _drawing_radius = 0; 
     if (_drawing_circle) {
+        _drag_index->removeItem(_drawing_circle); 
+        _drag_index->removeItem(_h_line); 
+        _drag_index->removeItem(_v_line); 
         scene()->removeItem(_drawing_circle);
         delete _drawing_circle;
         _drawing_circle = NULL;
@@ -84,11 +345,44 @@ void QGraphicsCircleSelector::_prepare_drawing(const QPointF& pos)
 
 void QGraphicsCircleSelector::keyPressEvent(QKeyEvent *event)
 {
-    if (event->key() == Qt::Key_Shift) {
+    // plus is shifted on most layouts, and its Shift, pressed first, has 
+    // entered drawing mode, so leave it. equal is the same key unshifted 
+    if (event->key() == Qt::Key_Plus || event->key() == Qt::Key_Equal) {
+        if (event->modifiers() & Qt::ShiftModifier) {
+            setDrawingMode(false);
+        }
+        scaleSelected(1.1);
+    }
+    else if (event->key() == Qt::Key_Shift) {
         setDrawingMode(true);
     }
+    else if (event->key() == Qt::Key_Control) {
+        setSelectingMode(true);
+    }
     else if (event->key() == Qt::Key_Escape) {
         setDrawingMode(false);
+        setSelectingMode(false);
+    }
+    else if (event->key() == Qt::Key_Delete) {
+        deleteSelected();
+    }
+    else if (event->key() == Qt::Key_Left) {
+        moveSelected(QPointF(-1, 0));
+    }
+    else if (event->key() == Qt::Key_Right) {
+        moveSelected(QPointF(1, 0));
+    }
+    else if (event->key() == Qt::Key_Up) {
+        moveSelected(QPointF(0, -1));
+    }
+    else if (event->key() == Qt::Key_Down) {
+        moveSelected(QPointF(0, 1));
+    }
+    else if (event->key() == Qt::Key_Minus) {
+        scaleSelected(1 / 1.1);
+    }
+    if (_publisher) {
+        _publisher->publishCommit(); 
     }
     // forward key press anyway
     QWidget::keyPressEvent(event);
@@ -141,26 +435,116 @@ void QGraphicsCircleSelector::mouseReleaseEvent(QMouseEvent* event)
         }
     }
     QGraphicsView::mouseReleaseEvent(event);
+    // items are selected by the view 
+    if (_selecting_mode && event->button() == Qt::LeftButton) {
+        setSelectingMode(false);
+    }
+    if (_publisher) {
+        _publisher->publishCommit(); 
+    }
 }
 
 // on circle moving and resizing 
 void QGraphicsCircleSelector::onCircleChanged(const QPointF& center, qreal radius)
 {
+    QGraphicsCircleObject* item = qobject_cast<QGraphicsCircleObject*>(sender()); 
+    if (_overlay && item) {
+        _overlay->setShape(item, item->roiShape(), item->shapePen()); 
+    }
+    if (_clusters && item) {
+        _clusters->setItem(item, item->roiShape().boundingRect()); 
+    }
+    if (item) {
+        _publish(item); 
+        Q_EMIT metricsChanged(item, item->metrics()); 
+    }
     setDrawingMode(false);
 }
 
-// on selection of circle items 
-void QGraphicsCircleSelector::onSelectionChanged()
+// dragging with all selected items 
+void QGraphicsCircleSelector::onDragStarted()
 {
-    QList<QGraphicsItem*> selections = _scene.selectedItems();
-    if (selections.empty()) {
-        //qDebug() << "No selected item";
+    _drag_index->begin(qobject_cast<QGraphicsCircleObject*>(sender())); 
+}
+
+// moving of a large selection, or group edit, notified once 
+void QGraphicsCircleSelector::onItemsMoved(const QList<QGraphicsItem*>& items)
+{
+    _update_shapes(items);
+    setDrawingMode(false);
+}
+
+void QGraphicsCircleSelector::_update_shapes(const QList<QGraphicsItem*>& items)
+{
+    foreach (QGraphicsItem* it, items) {
+        QGraphicsCircleObject* item = qobject_cast<QGraphicsCircleObject*>(it->toGraphicsObject()); 
+        if (_overlay && item) {
+            _overlay->setShape(item, item->roiShape(), item->shapePen()); 
+        }
+        if (_clusters && item) {
+            _clusters->setItem(item, item->roiShape().boundingRect()); 
+        }
+        if (item) {
+            _publish(item); 
+            Q_EMIT metricsChanged(item, item->metrics()); 
+        }
     }
-    else if (selections.size() == 1) {
-        // one item is selected
-        QGraphicsItem* item = selections[0];
+}
+
+// circle of a shape, the circle around the bounding box of other shapes 
+static QPointF _circle_center(const QGraphicsROIShape& shape)
+{
+    return shape.type == QGraphicsROIShape::CIRCLE_SHAPE ? shape.center : shape.boundingRect().center(); 
+}
+
+static qreal _circle_radius(const QGraphicsROIShape& shape)
+{
+    QRectF bound = shape.boundingRect(); 
+    return shape.type == QGraphicsROIShape::CIRCLE_SHAPE ? shape.radius : qMax(bound.width(), bound.height()) / 2; 
+}
+
+// ROIs from worker threads, applied as one batch within the budget of the 
+// frame of the queue, the rest in next frames, without interrupting drawing. 
+// added and changed items are indexed by the scene in one pass at next query 
+void QGraphicsCircleSelector::onRecordsReady()
+{
+    QSet<QGraphicsItem*> changed;
+    QGraphicsROIQueue::Record record;
+    while (_queue->take(record)) {
+        QGraphicsCircleObject* item = _roi_items.value(record.id);
+        switch (record.type) {
+        case QGraphicsROIQueue::ADD_ROI:
+        case QGraphicsROIQueue::UPDATE_ROI:
+            if (item) {
+                item->setCircle(_circle_center(record.shape), _circle_radius(record.shape));
+                changed.insert(item);
+            }
+            else {
+                item = addCircleItem(_circle_center(record.shape), _circle_radius(record.shape));
+                item->setRoiId(record.id);
+                _roi_items.insert(record.id, item);
+            }
+            break;
+        case QGraphicsROIQueue::REMOVE_ROI:
+            if (item) {
+                changed.remove(item);
+                _remove_item(item);
+            }
+            _roi_items.remove(record.id);
+            break;
+        default:
+            break;
+        }
     }
-    else {
-        //qDebug() << "Number of selected items is greater than 1";
+    _update_shapes(changed.toList());
+    if (_publisher) {
+        _publisher->publishCommit(); 
     }
 }
+
+// nearest neighbour background on fast path 
+void QGraphicsCircleSelector::onQualityChanged(int fast_path)
+{
+    bool nearest = fast_path & QGraphicsRenderQuality::NEAREST_BACKGROUND;
+    _background->setTransformationMode(nearest ? Qt::FastTransformation : Qt::SmoothTransformation);
+}
@@ -2,6 +2,16 @@
 
 #include <QGraphicsView>
 #include <QGraphicsScene>
+#include <QGraphicsPixmapItem>
+#include <QPointer>
+#include "QGraphicsOverlayTiles.h"
+#include "QGraphicsROIClusters.h"
+#include "QGraphicsDragIndex.h"
+#include "QGraphicsROISelection.h"
+#include "QGraphicsROIQueue.h"
+#include "QGraphicsROIOverlap.h"
+#include "QGraphicsCircleObject.h"
+#include "QGraphicsROIPublisher.h"
 #include <QGraphicsEllipseItem>
 #include <QGraphicsLineItem>
 #include <QPen>
@@ -11,6 +21,9 @@
  * When the "shift" key is pressed, user may draw circle by press the left 
  * mouse key and move in the view. Press "esc" key to cancel the drawing. 
  * User may click on a circle to move and resize the ROI.   
+ * When the "ctrl" key is pressed, user may select ROIs in an area with rubber 
+ * band. Selected ROIs are moved with arrow keys, scaled with "+" and "-" keys 
+ * and deleted with "delete" key, as a group. 
  * The view needs to get focus, by setFocus(), to capture the key press. 
  */
 class QGraphicsCircleSelector : public QGraphicsView
@@ -20,13 +33,52 @@ public:
     QGraphicsCircleSelector(QWidget *parent = 0);
     virtual ~QGraphicsCircleSelector();
 
+    // queue of ROIs from worker threads, drained on GUI thread once per frame 
+    QGraphicsROIQueue* roiQueue() const;
+
+    // overlapping pairs of visible ROIs, indices into the list of ROIs given 
+    QVector<QGraphicsROIOverlap::Pair> findOverlaps(QList<QGraphicsItem*>& items, qreal tolerance = 0.5);
+
+    // keep the largest ROI of each group of duplicates, return number of ROIs removed 
+    int removeDuplicates(qreal iou_threshold);
+
 public slots: 
     // add a circle  
-    void addCircleItem(const QPointF& center, qreal radius);
+    QGraphicsCircleObject* addCircleItem(const QPointF& center, qreal radius);
 
     // enable circle drawing with mouse
     virtual void setDrawingMode(bool drawing);
 
+    // enable area selection with rubber band 
+    void setSelectingMode(bool selecting);
+
+    // edit all selected items as a group, with one repaint and notification 
+    void moveSelected(const QPointF& offset);
+    void scaleSelected(qreal factor);
+    void transformSelected(const QTransform& transform);
+    void deleteSelected();
+
+    // select ROIs overlapping another one with IoU over threshold 
+    void selectOverlapping(qreal iou_threshold);
+
+    // render static ROIs into cached tiles on worker threads 
+    void setOverlayTiles(bool enabled);
+
+    // draw small ROIs as clusters below full detail zoom 
+    void setLevelOfDetail(bool enabled);
+
+    // stream changes of circle ROIs to other processes, committed on mouse 
+    // release, key press and ROIs from worker threads, current ROIs published first 
+    void setPublisher(QGraphicsROIPublisher* publisher);
+
+signals:
+    // measurements of a ROI changed by an edit, or moved with a group 
+    void metricsChanged(QGraphicsItem* item, const QGraphicsROIMetrics& metrics);
+
+protected:
+    // composite clusters, overlay tiles are an item of the scene 
+    void drawForeground(QPainter* painter, const QRectF& rect);
+
 private slots:
     // press "shift" key to draw circle 
     void keyPressEvent(QKeyEvent *event);
@@ -39,11 +91,27 @@ private slots:
     // on circle moving and resizing 
     void onCircleChanged(const QPointF&, qreal);
 
-    // on selection of circles 
-    void onSelectionChanged();
+    // render background with lower fidelity on fast path
+    void onQualityChanged(int fast_path);
+
+    // on dragging of a large selection, and group edits 
+    void onDragStarted();
+    void onItemsMoved(const QList<QGraphicsItem*>& items);
+
+    // on ROIs from worker threads 
+    void onRecordsReady();
 
 private:
     QGraphicsScene _scene;
+    QGraphicsPixmapItem* _background;
+    QGraphicsOverlayTiles* _overlay;
+    QGraphicsROIClusters* _clusters;
+    QPointer<QGraphicsROIPublisher> _publisher;
+    QGraphicsDragIndex* _drag_index;
+    QGraphicsROISelection* _selection;
+    bool _selecting_mode;
+    QGraphicsROIQueue* _queue;
+    QHash<qint64, QPointer<QGraphicsCircleObject> > _roi_items;
 
     bool _drawing_mode;
     QPointF _drawing_center; 
@@ -53,6 +121,10 @@ private:
     QGraphicsLineItem* _h_line;
     QPen _drawing_pen; 
 
+    void _update_shapes(const QList<QGraphicsItem*>& items);
+    void _remove_item(QGraphicsItem* item);
+    void _publish(QGraphicsCircleObject* item);
+    QList<QGraphicsItem*> _roi_list() const;
     void _clear_drawing(); 
     void _prepare_drawing(const QPointF& pos); 
 };
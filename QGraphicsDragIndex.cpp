@@ -0,0 +1,272 @@
+#include "QGraphicsDragIndex.h"
+#include <QMouseEvent>
+#include <qmath.h>
+#include <algorithm>
+#include <climits>
+#include <cassert>
+
+#define DRAGGING_PROPERTY "drag_index"
+#define DEFAULT_THRESHOLD 100
+#define DEFAULT_REINDEX_DELAY 300
+#define MAX_ITEM_CELLS 64
+
+static quint64 _cell_key(int cx, int cy)
+{
+    return (quint64(quint32(cx)) << 32) | quint32(cy);
+}
+
+// topmost first, as items of the scene
+static bool _above(const QGraphicsItem* a, const QGraphicsItem* b)
+{
+    return a->zValue() > b->zValue();
+}
+
+QGraphicsDragIndex::QGraphicsDragIndex(QGraphicsView* view)
+    : QObject(view)
+    , _view(view)
+    , _scene(view->scene())
+    , _threshold(DEFAULT_THRESHOLD)
+    , _active(false)
+    , _suspended(false)
+    , _index_method(QGraphicsScene::BspTreeIndex)
+    , _anchor(NULL)
+    , _cell_size(1)
+{
+    assert(_scene);
+    _view->viewport()->installEventFilter(this);
+    _reindex_timer.setSingleShot(true);
+    _reindex_timer.setInterval(DEFAULT_REINDEX_DELAY);
+    connect(&_reindex_timer, &QTimer::timeout, this, &QGraphicsDragIndex::_on_reindex_timeout);
+}
+
+QGraphicsDragIndex::~QGraphicsDragIndex()
+{
+    end();
+    _reindex_timer.stop();
+    _suspended = false;
+    _reindex();
+}
+
+void QGraphicsDragIndex::setThreshold(int count)
+{
+    _threshold = count;
+}
+
+int QGraphicsDragIndex::threshold() const
+{
+    return _threshold;
+}
+
+void QGraphicsDragIndex::setReindexDelay(int msec)
+{
+    _reindex_timer.setInterval(msec);
+}
+
+int QGraphicsDragIndex::reindexDelay() const
+{
+    return _reindex_timer.interval();
+}
+
+bool QGraphicsDragIndex::isActive() const
+{
+    return _active;
+}
+
+bool QGraphicsDragIndex::isDragging(const QGraphicsScene* scene)
+{
+    return scene && scene->property(DRAGGING_PROPERTY).toBool();
+}
+
+void QGraphicsDragIndex::begin(QGraphicsItem* item)
+{
+    if (_active || !_scene || !item || !item->isSelected()) {
+        return;
+    }
+    QList<QGraphicsItem*> selected = _scene->selectedItems();
+    if (selected.size() < _threshold) {
+        return;
+    }
+    _anchor = item;
+    _anchor_pos = item->pos();
+
+    // cells about the mean item size
+    QList<QGraphicsItem*> items = _scene->items();
+    qreal size = 0;
+    foreach (QGraphicsItem* it, items) {
+        QRectF rect = it->sceneBoundingRect();
+        size += qMax(rect.width(), rect.height());
+    }
+    _cell_size = qMax(qreal(1), size / qMax(1, items.size()));
+
+    foreach (QGraphicsItem* it, selected) {
+        _moving.insert(it, it->pos());
+        _insert(_moving_grid, it, it->sceneBoundingRect());
+    }
+    foreach (QGraphicsItem* it, items) {
+        if (!_moving.contains(it)) {
+            _insert(_static_grid, it, it->sceneBoundingRect());
+        }
+    }
+
+    // items are moved unindexed
+    _unindex();
+    _active = true;
+    _scene->setProperty(DRAGGING_PROPERTY, true);
+}
+
+void QGraphicsDragIndex::end()
+{
+    if (!_active) {
+        return;
+    }
+    _active = false;
+    QList<QGraphicsItem*> moved;
+    if (_scene) {
+        // index is rebuilt once
+        _reindex();
+        _scene->setProperty(DRAGGING_PROPERTY, false);
+        QHash<QGraphicsItem*, QPointF>::const_iterator it;
+        for (it = _moving.constBegin(); it != _moving.constEnd(); ++it) {
+            if (it.key()->pos() != it.value()) {
+                moved.append(it.key());
+            }
+        }
+    }
+    _anchor = NULL;
+    _moving.clear();
+    _static_grid.clear();
+    _moving_grid.clear();
+    if (!moved.isEmpty()) {
+        Q_EMIT itemsMoved(moved);
+    }
+}
+
+void QGraphicsDragIndex::removeItem(QGraphicsItem* item)
+{
+    if (!_active || !item) {
+        return;
+    }
+    _moving.remove(item);
+    _remove(_static_grid, item);
+    _remove(_moving_grid, item);
+    if (item == _anchor) {
+        end();
+    }
+}
+
+void QGraphicsDragIndex::suspend()
+{
+    if (!_scene) {
+        return;
+    }
+    _unindex();
+    _suspended = true;
+    _reindex_timer.start();
+}
+
+// index method of the scene is saved when neither a drag nor a burst of
+// edits has it unindexed yet
+void QGraphicsDragIndex::_unindex()
+{
+    if (!_active && !_suspended) {
+        _index_method = _scene->itemIndexMethod();
+        _scene->setItemIndexMethod(QGraphicsScene::NoIndex);
+    }
+}
+
+// and restored when both are over
+void QGraphicsDragIndex::_reindex()
+{
+    if (!_active && !_suspended && _scene) {
+        _scene->setItemIndexMethod(_index_method);
+    }
+}
+
+void QGraphicsDragIndex::_on_reindex_timeout()
+{
+    _suspended = false;
+    _reindex();
+}
+
+// drag ends with the release of mouse, before the grabber item gets it
+bool QGraphicsDragIndex::eventFilter(QObject* object, QEvent* event)
+{
+    if (_active && event->type() == QEvent::MouseButtonRelease) {
+        QMouseEvent* mouse_event = static_cast<QMouseEvent*>(event);
+        if (mouse_event->buttons() == Qt::NoButton) {
+            end();
+        }
+    }
+    return QObject::eventFilter(object, event);
+}
+
+QList<QGraphicsItem*> QGraphicsDragIndex::itemsAt(const QPointF& pos) const
+{
+    if (!_active) {
+        return _scene ? _scene->items(pos) : QList<QGraphicsItem*>();
+    }
+    QList<QGraphicsItem*> candidates;
+    _query(_static_grid, pos, candidates);
+    // selected items are found at their start position
+    _query(_moving_grid, pos - (_anchor->pos() - _anchor_pos), candidates);
+    QList<QGraphicsItem*> items;
+    foreach (QGraphicsItem* item, candidates) {
+        if (item->contains(item->mapFromScene(pos))) {
+            items.append(item);
+        }
+    }
+    std::stable_sort(items.begin(), items.end(), _above);
+    return items;
+}
+
+// large items are kept in the cell of key (INT_MIN, INT_MIN) and always tested
+void QGraphicsDragIndex::_insert(Grid& grid, QGraphicsItem* item, const QRectF& rect)
+{
+    int x0 = int(qFloor(rect.left() / _cell_size));
+    int x1 = int(qFloor(rect.right() / _cell_size));
+    int y0 = int(qFloor(rect.top() / _cell_size));
+    int y1 = int(qFloor(rect.bottom() / _cell_size));
+    if (qint64(x1 - x0 + 1) * (y1 - y0 + 1) > MAX_ITEM_CELLS) {
+        grid[_cell_key(INT_MIN, INT_MIN)].append(item);
+        return;
+    }
+    for (int cy = y0; cy <= y1; cy++) {
+        for (int cx = x0; cx <= x1; cx++) {
+            grid[_cell_key(cx, cy)].append(item);
+        }
+    }
+}
+
+// all cells, as items may have changed since they were inserted, deleting
+// during a drag is rare
+void QGraphicsDragIndex::_remove(Grid& grid, QGraphicsItem* item)
+{
+    Grid::iterator it = grid.begin();
+    while (it != grid.end()) {
+        it->removeAll(item);
+        if (it->isEmpty()) {
+            it = grid.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
+
+void QGraphicsDragIndex::_query(const Grid& grid, const QPointF& pos, QList<QGraphicsItem*>& items) const
+{
+    int cx = int(qFloor(pos.x() / _cell_size));
+    int cy = int(qFloor(pos.y() / _cell_size));
+    Grid::const_iterator it = grid.constFind(_cell_key(cx, cy));
+    if (it != grid.constEnd()) {
+        foreach (QGraphicsItem* item, *it) {
+            items.append(item);
+        }
+    }
+    it = grid.constFind(_cell_key(INT_MIN, INT_MIN));
+    if (it != grid.constEnd()) {
+        foreach (QGraphicsItem* item, *it) {
+            items.append(item);
+        }
+    }
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <QObject>
+#include <QGraphicsView>
+#include <QGraphicsScene>
+#include <QGraphicsItem>
+#include <QHash>
+#include <QVector>
+#include <QPointer>
+#include <QTimer>
+
+/*!
+ * This class keeps dragging of a large selection interactive.
+ *
+ * The built-in dragging moves every selected item with setPos(), and the BSP tree
+ * index of the scene re-indexes each of them at every step. When a drag starts
+ * with at least setThreshold() selected items, the scene is switched to NoIndex
+ * and items stop notifying their position changes. When the drag ends, the index
+ * is rebuilt once and itemsMoved() is emitted once with all moved items.
+ *
+ * During the drag, itemsAt() answers hit tests from a temporary grid, built at
+ * drag start from the static items and the start position of the moving ones.
+ * All selected items move by the same offset, so they need no update. It is
+ * for callers of hit tests of their own; the hit tests of the view, for
+ * hover and press, go to the scene.
+ *
+ * Items check isDragging(scene()) before notifying position changes. Items
+ * deleted during a drag are given to removeItem() first, so the drag does
+ * not keep them.
+ *
+ * Group edits from keys, as moves and scales of the selection, call
+ * suspend() before each step. The scene stays unindexed over a burst of
+ * steps, and the index is rebuilt once after setReindexDelay() msec without
+ * a step, rather than at every key press.
+ *
+ * Usage:
+ *
+ *   QGraphicsDragIndex* drag_index = new QGraphicsDragIndex(view);
+ *   // when an item starts and finishes dragging
+ *   drag_index->begin(item);
+ *   drag_index->end();
+ */
+class QGraphicsDragIndex : public QObject
+{
+    Q_OBJECT
+public:
+    QGraphicsDragIndex(QGraphicsView* view);
+    ~QGraphicsDragIndex();
+
+    // minimal number of selected items for the unindexed dragging
+    void setThreshold(int count);
+    int threshold() const;
+
+    // unindexed dragging is active
+    bool isActive() const;
+    static bool isDragging(const QGraphicsScene* scene);
+
+    // msec without suspend() before the index is rebuilt
+    void setReindexDelay(int msec);
+    int reindexDelay() const;
+
+    // items at given position in scene coords, answered from the temporary
+    // grid while dragging and by the scene otherwise
+    QList<QGraphicsItem*> itemsAt(const QPointF& pos) const;
+
+public slots:
+    // dragging of given item, with all selected items
+    void begin(QGraphicsItem* item);
+    void end();
+
+    // item about to be deleted, dropped from the drag, which ends with it
+    // when it is the dragged item
+    void removeItem(QGraphicsItem* item);
+
+    // keep the scene unindexed for a burst of group edits
+    void suspend();
+
+signals:
+    void itemsMoved(const QList<QGraphicsItem*>& items);
+
+private:
+    typedef QHash<quint64, QVector<QGraphicsItem*> > Grid;
+
+    QGraphicsView* _view;
+    QPointer<QGraphicsScene> _scene;
+    int _threshold;
+    bool _active;
+    bool _suspended;
+    QTimer _reindex_timer;
+    QGraphicsScene::ItemIndexMethod _index_method;
+    QGraphicsItem* _anchor;
+    QPointF _anchor_pos;
+    QHash<QGraphicsItem*, QPointF> _moving; // start positions
+    qreal _cell_size;
+    Grid _static_grid;
+    Grid _moving_grid;
+
+    bool eventFilter(QObject* object, QEvent* event);
+    void _unindex();
+    void _reindex();
+    void _on_reindex_timeout();
+    void _insert(Grid& grid, QGraphicsItem* item, const QRectF& rect);
+    void _remove(Grid& grid, QGraphicsItem* item);
+    void _query(const Grid& grid, const QPointF& pos, QList<QGraphicsItem*>& items) const;
+};
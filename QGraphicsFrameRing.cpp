@@ -0,0 +1,267 @@
+#include "QGraphicsFrameRing.h"
+#include <QThread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <climits>
+#include <ctime>
+#ifdef Q_OS_LINUX
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+#define FRAME_MAX_SLOTS 256
+
+// shared, not private, futex as the word is in memory of two processes
+static void _futex_wait(std::atomic<quint32>* word, quint32 value, int msec)
+{
+#ifdef Q_OS_LINUX
+    struct timespec timeout;
+    timeout.tv_sec = msec / 1000;
+    timeout.tv_nsec = (msec % 1000) * 1000000L;
+    syscall(SYS_futex, reinterpret_cast<quint32*>(word), FUTEX_WAIT, value, &timeout, NULL, 0);
+#else
+    // polled elsewhere
+    for (int i = 0; i < msec && word->load() == value; i++) {
+        QThread::msleep(1);
+    }
+#endif
+}
+
+static void _futex_wake(std::atomic<quint32>* word)
+{
+#ifdef Q_OS_LINUX
+    syscall(SYS_futex, reinterpret_cast<quint32*>(word), FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+#else
+    Q_UNUSED(word);
+#endif
+}
+
+QGraphicsFrameRing::QGraphicsFrameRing()
+    : _memory(NULL)
+    , _size(0)
+    , _created(false)
+    , _published(0)
+    , _last_slot(-1)
+{
+}
+
+QGraphicsFrameRing::~QGraphicsFrameRing()
+{
+    close();
+}
+
+bool QGraphicsFrameRing::create(const QString& name, int slot_count, int frame_size)
+{
+    close();
+    if (slot_count < 3 || slot_count > FRAME_MAX_SLOTS || frame_size <= 0) {
+        return false; // a slot latest, one read and one written
+    }
+    long page = sysconf(_SC_PAGESIZE);
+    qint64 slot_size = (FRAME_SLOT_HEADER_SIZE + qint64(frame_size) + page - 1) / page * page;
+    if (slot_size > 0xffffffffLL) {
+        return false;
+    }
+    QByteArray path = name.toLocal8Bit();
+    shm_unlink(path.constData());
+    int fd = shm_open(path.constData(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        return false;
+    }
+    qint64 size = FRAME_HEADER_SIZE + slot_size * slot_count;
+    if (ftruncate(fd, size) != 0 || !_map(fd, size)) {
+        ::close(fd);
+        shm_unlink(path.constData());
+        return false;
+    }
+    ::close(fd);
+    _name = name;
+    _created = true;
+    Header* header = _header();
+    header->version = FRAME_RING_VERSION;
+    header->slot_count = quint32(slot_count);
+    header->slot_size = quint32(slot_size);
+    header->latest.store(0);
+    for (int i = 0; i < slot_count; i++) {
+        _slot(i)->sequence.store(0);
+        _slot(i)->readers.store(0);
+    }
+    // magic last, a reader opening early finds no ring
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    header->magic = FRAME_RING_MAGIC;
+    return true;
+}
+
+bool QGraphicsFrameRing::open(const QString& name)
+{
+    close();
+    int fd = shm_open(name.toLocal8Bit().constData(), O_RDWR, 0);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    bool mapped = fstat(fd, &info) == 0 && info.st_size >= FRAME_HEADER_SIZE && _map(fd, info.st_size);
+    ::close(fd);
+    if (!mapped) {
+        return false;
+    }
+    Header* header = _header();
+    if (header->magic != FRAME_RING_MAGIC || header->version != FRAME_RING_VERSION || header->slot_count < 3 ||
+        header->slot_count > FRAME_MAX_SLOTS || header->slot_size <= FRAME_SLOT_HEADER_SIZE ||
+        FRAME_HEADER_SIZE + qint64(header->slot_size) * header->slot_count > _size) {
+        close();
+        return false;
+    }
+    _name = name;
+    for (int i = 0; i < slotCount(); i++) {
+        _slot(i)->readers.store(0);
+    }
+    return true;
+}
+
+void QGraphicsFrameRing::close()
+{
+    if (_memory) {
+        munmap(_memory, size_t(_size));
+    }
+    if (_created) {
+        shm_unlink(_name.toLocal8Bit().constData());
+    }
+    _memory = NULL;
+    _size = 0;
+    _created = false;
+    _name.clear();
+}
+
+bool QGraphicsFrameRing::isOpen() const
+{
+    return _memory != NULL;
+}
+
+int QGraphicsFrameRing::slotCount() const
+{
+    return _memory ? int(_header()->slot_count) : 0;
+}
+
+int QGraphicsFrameRing::slotCapacity() const
+{
+    return _memory ? int(_header()->slot_size) - FRAME_SLOT_HEADER_SIZE : 0;
+}
+
+// readers checked after the sequence is marked, see the class comment
+int QGraphicsFrameRing::beginFrame()
+{
+    if (!_memory) {
+        return -1;
+    }
+    int count = slotCount();
+    int latest = _published > 0 ? int(_header()->latest.load() & 0xff) : -1;
+    for (int k = 1; k <= count; k++) {
+        int index = (_last_slot + k + count) % count;
+        Slot* slot = _slot(index);
+        if (index == latest || slot->readers.load() > 0) {
+            continue;
+        }
+        quint64 sequence = slot->sequence.load();
+        slot->sequence.store(sequence | 1);
+        if (slot->readers.load() == 0) {
+            _last_slot = index;
+            return index;
+        }
+        slot->sequence.store(sequence);
+    }
+    return -1;
+}
+
+uchar* QGraphicsFrameRing::slotBits(int slot)
+{
+    return reinterpret_cast<uchar*>(_slot(slot)) + FRAME_SLOT_HEADER_SIZE;
+}
+
+void QGraphicsFrameRing::publish(int slot, int format, int width, int height, int bytesPerLine, quint64 timestamp)
+{
+    Slot* target = _slot(slot);
+    target->format = quint32(format);
+    target->width = quint32(width);
+    target->height = quint32(height);
+    target->bytes_per_line = quint32(bytesPerLine);
+    target->timestamp = timestamp;
+    _published++;
+    target->sequence.store(2 * _published);
+    _header()->latest.store(quint32(_published << 8) | quint32(slot));
+    _futex_wake(&_header()->latest);
+}
+
+bool QGraphicsFrameRing::acquire(Frame& frame, quint64 after)
+{
+    if (!_memory) {
+        return false;
+    }
+    quint32 latest = _header()->latest.load();
+    if ((latest >> 8) == 0) {
+        return false;
+    }
+    int index = int(latest & 0xff);
+    if (index >= slotCount()) {
+        return false;
+    }
+    Slot* slot = _slot(index);
+    slot->readers.fetch_add(1);
+    quint64 sequence = slot->sequence.load();
+    if ((sequence & 1) || sequence / 2 <= after) {
+        slot->readers.fetch_sub(1);
+        return false;
+    }
+    frame.slot = index;
+    frame.number = sequence / 2;
+    frame.format = int(slot->format);
+    frame.width = int(slot->width);
+    frame.height = int(slot->height);
+    frame.bytes_per_line = int(slot->bytes_per_line);
+    frame.timestamp = slot->timestamp;
+    frame.bits = reinterpret_cast<const uchar*>(slot) + FRAME_SLOT_HEADER_SIZE;
+    return true;
+}
+
+void QGraphicsFrameRing::release(int slot)
+{
+    if (_memory && slot >= 0 && slot < slotCount()) {
+        _slot(slot)->readers.fetch_sub(1);
+    }
+}
+
+quint32 QGraphicsFrameRing::latest() const
+{
+    return _memory ? _header()->latest.load() : 0;
+}
+
+void QGraphicsFrameRing::wait(quint32 seen, int msec)
+{
+    if (!_memory) {
+        QThread::msleep(quint32(msec));
+        return;
+    }
+    _futex_wait(&_header()->latest, seen, msec);
+}
+
+QGraphicsFrameRing::Header* QGraphicsFrameRing::_header() const
+{
+    return reinterpret_cast<Header*>(_memory);
+}
+
+QGraphicsFrameRing::Slot* QGraphicsFrameRing::_slot(int slot) const
+{
+    return reinterpret_cast<Slot*>(_memory + FRAME_HEADER_SIZE + qint64(slot) * _header()->slot_size);
+}
+
+bool QGraphicsFrameRing::_map(int fd, qint64 size)
+{
+    void* memory = mmap(NULL, size_t(size), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (memory == MAP_FAILED) {
+        return false;
+    }
+    _memory = reinterpret_cast<uchar*>(memory);
+    _size = size;
+    return true;
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <QString>
+#include <QtGlobal>
+#include <atomic>
+
+#define FRAME_RING_MAGIC 0x51524f49 // "QROI"
+#define FRAME_RING_VERSION 1
+#define FRAME_HEADER_SIZE 4096
+#define FRAME_SLOT_HEADER_SIZE 4096
+
+/*!
+ * This class is a ring of frame slots in POSIX shared memory, written by a
+ * capture process and read in place by the annotation UI.
+ *
+ * The memory starts with a header of FRAME_HEADER_SIZE bytes, then
+ * slot_count slots of slot_size bytes. Each slot starts with a slot header,
+ * of sequence, format, size and stride of its frame, and pixels follow at
+ * FRAME_SLOT_HEADER_SIZE. Formats are those of QGraphicsImageData.
+ *
+ * The sequence of a slot is twice the number of its frame, odd while the
+ * frame is written. Readers count themselves in a slot before they check
+ * its sequence, and writers mark the sequence odd before they check the
+ * readers, so either the reader sees the frame being written and leaves, or
+ * the writer sees the reader and takes another slot. A frame held by the UI
+ * is thus never overwritten, and one written is never shown.
+ *
+ * Published frames are counted in the latest word of the header, the slot in
+ * its low 8 bits, on which readers wait with a futex, so a frame wakes the
+ * UI with no polling. Atomics in the memory are lock-free, and so work
+ * between processes.
+ *
+ * Usage:
+ *
+ *   // capture process
+ *   QGraphicsFrameRing ring;
+ *   ring.create("/camera", 4, 3840 * 2160 * 2);
+ *   int slot = ring.beginFrame();
+ *   memcpy(ring.slotBits(slot), frame, size);
+ *   ring.publish(slot, QGraphicsImageData::NV12, 3840, 2160, 3840);
+ *
+ *   // UI, see QGraphicsFrameSource
+ *   ring.open("/camera");
+ *   QGraphicsFrameRing::Frame frame;
+ *   if (ring.acquire(frame, last_number)) { ...; ring.release(frame.slot); }
+ *
+ * There is a single writer and a single reader.
+ */
+class QGraphicsFrameRing
+{
+public:
+    struct Header
+    {
+        quint32 magic;
+        quint32 version;
+        quint32 slot_count;
+        quint32 slot_size; // bytes of a slot, slot header included
+        std::atomic<quint32> latest; // frames published << 8 | slot, futex word
+    };
+
+    struct Slot
+    {
+        std::atomic<quint64> sequence; // 2 x frame number, odd while written
+        std::atomic<quint32> readers;
+        quint32 format;
+        quint32 width;
+        quint32 height;
+        quint32 bytes_per_line;
+        quint64 timestamp; // usec, of the capture clock
+    };
+
+    // a frame held by a reader
+    struct Frame
+    {
+        Frame() : slot(-1), number(0), format(0), width(0), height(0), bytes_per_line(0), timestamp(0), bits(NULL) {}
+        int slot;
+        quint64 number;
+        int format;
+        int width;
+        int height;
+        int bytes_per_line;
+        quint64 timestamp;
+        const uchar* bits;
+    };
+
+    QGraphicsFrameRing();
+    // unmapped, and unlinked if created
+    ~QGraphicsFrameRing();
+
+    // by the writer, slots of frame_size bytes of pixels
+    bool create(const QString& name, int slot_count, int frame_size);
+    // by the reader, readers left by a previous reader cleared
+    bool open(const QString& name);
+    void close();
+    bool isOpen() const;
+
+    int slotCount() const;
+    // bytes of pixels a slot holds
+    int slotCapacity() const;
+
+    // writer: a slot neither latest nor read, marked written, -1 when none
+    int beginFrame();
+    uchar* slotBits(int slot);
+    void publish(int slot, int format, int width, int height, int bytesPerLine, quint64 timestamp = 0);
+
+    // reader: latest frame if newer than number after, kept until released
+    bool acquire(Frame& frame, quint64 after);
+    void release(int slot);
+
+    // latest word, and a wait until it is no longer seen, or msec passed
+    quint32 latest() const;
+    void wait(quint32 seen, int msec);
+
+private:
+    QString _name;
+    uchar* _memory;
+    qint64 _size;
+    bool _created;
+    quint64 _published;
+    int _last_slot;
+
+    Header* _header() const;
+    Slot* _slot(int slot) const;
+    bool _map(int fd, qint64 size);
+};
@@ -0,0 +1,135 @@
+#include "QGraphicsFrameSource.h"
+#include <QMetaObject>
+
+#define FRAME_WAIT_TIMEOUT 100
+
+QGraphicsFrameSource::QGraphicsFrameSource(QObject* parent)
+    : QObject(parent)
+    , _stopping(0)
+    , _scheduled(0)
+    , _taken_number(0)
+    , _shown_number(0)
+    , _skipped(0)
+{
+    _reader.source = this;
+}
+
+QGraphicsFrameSource::~QGraphicsFrameSource()
+{
+    close();
+}
+
+bool QGraphicsFrameSource::open(const QString& name)
+{
+    close();
+    QSharedPointer<QGraphicsFrameRing> ring(new QGraphicsFrameRing());
+    if (!ring->open(name)) {
+        return false;
+    }
+    _ring = ring;
+    _taken_number = 0;
+    _shown_number = 0;
+    _skipped = 0;
+    _stopping.store(0);
+    _reader.start();
+    return true;
+}
+
+// the ring is unmapped once frames over it are gone
+void QGraphicsFrameSource::close()
+{
+    _stopping.store(1);
+    _reader.wait();
+    QMutexLocker locker(&_mutex);
+    _taken = QGraphicsImageData();
+    _ring.reset();
+}
+
+bool QGraphicsFrameSource::isOpen() const
+{
+    return !_ring.isNull();
+}
+
+quint64 QGraphicsFrameSource::frameNumber() const
+{
+    QMutexLocker locker(&_mutex);
+    return _shown_number;
+}
+
+quint64 QGraphicsFrameSource::skippedFrames() const
+{
+    QMutexLocker locker(&_mutex);
+    return _skipped;
+}
+
+void QGraphicsFrameSource::Reader::run()
+{
+    source->_read();
+}
+
+// the latest word is read before the frame, so one published in between
+// ends the wait at once
+void QGraphicsFrameSource::_read()
+{
+    quint64 number = 0;
+    while (!_stopping.load()) {
+        quint32 seen = _ring->latest();
+        QGraphicsFrameRing::Frame frame;
+        if (_ring->acquire(frame, number)) {
+            number = frame.number;
+            _take(frame);
+        }
+        _ring->wait(seen, FRAME_WAIT_TIMEOUT);
+    }
+}
+
+// a frame not yet shown is replaced, and its slot given back
+void QGraphicsFrameSource::_take(const QGraphicsFrameRing::Frame& frame)
+{
+    SlotRelease release;
+    release.ring = _ring;
+    release.slot = frame.slot;
+    QSharedPointer<const uchar> bits(frame.bits, release);
+    QGraphicsImageData data = QGraphicsImageData::fromExternal(bits, frame.width, frame.height, frame.bytes_per_line,
+                                                               QGraphicsImageData::FORMAT(frame.format));
+    if (data.isNull() || data.byteCount() > _ring->slotCapacity()) {
+        return;
+    }
+    QGraphicsImageData replaced;
+    {
+        QMutexLocker locker(&_mutex);
+        replaced = _taken;
+        if (!_taken.isNull()) {
+            _skipped++;
+        }
+        if (_taken_number > 0) {
+            _skipped += frame.number - _taken_number - 1;
+        }
+        _taken = data;
+        _taken_number = frame.number;
+    }
+    if (_scheduled.testAndSetOrdered(0, 1)) {
+        QMetaObject::invokeMethod(this, "onFrame", Qt::QueuedConnection);
+    }
+}
+
+void QGraphicsFrameSource::SlotRelease::operator()(const uchar* bits) const
+{
+    Q_UNUSED(bits);
+    ring->release(slot);
+}
+
+void QGraphicsFrameSource::onFrame()
+{
+    QGraphicsImageData frame;
+    {
+        QMutexLocker locker(&_mutex);
+        frame = _taken;
+        _taken = QGraphicsImageData();
+        _shown_number = _taken_number;
+        _scheduled.store(0);
+    }
+    if (!frame.isNull()) {
+        Q_EMIT frameReady(frame);
+    }
+}
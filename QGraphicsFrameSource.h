@@ -0,0 +1,80 @@
+#pragma once
+
+#include <QObject>
+#include <QThread>
+#include <QMutex>
+#include <QAtomicInt>
+#include <QSharedPointer>
+#include "QGraphicsFrameRing.h"
+#include "QGraphicsImageData.h"
+
+/*!
+ * This class shows frames of an external capture process, written to a
+ * QGraphicsFrameRing in shared memory, as the background of a selector.
+ *
+ * A reader thread waits on the futex of the ring and takes each new frame in
+ * place, as QGraphicsImageData over the memory of its slot, with no copy. The
+ * slot is held, so not written again, until the last copy of the data is
+ * gone. Frames go to the GUI thread latest wins: a frame taken while one is
+ * waiting for the GUI replaces it, and a frame older than one shown is never
+ * taken, so a stale frame is never shown.
+ *
+ * Usage:
+ *
+ *   QGraphicsFrameSource* source = new QGraphicsFrameSource(view);
+ *   connect(source, &QGraphicsFrameSource::frameReady, selector, &QGraphicsPolygonSelector::setBackgroundFrame);
+ *   source->open("/camera");
+ */
+class QGraphicsFrameSource : public QObject
+{
+    Q_OBJECT
+public:
+    QGraphicsFrameSource(QObject* parent = NULL);
+    ~QGraphicsFrameSource();
+
+    // shared memory of the name, written by the capture process
+    bool open(const QString& name);
+    void close();
+    bool isOpen() const;
+
+    // number of the last frame shown, and frames never shown as the GUI or
+    // the reader was busy
+    quint64 frameNumber() const;
+    quint64 skippedFrames() const;
+
+signals:
+    void frameReady(const QGraphicsImageData& frame);
+
+private slots:
+    void onFrame();
+
+private:
+    class Reader : public QThread
+    {
+    public:
+        QGraphicsFrameSource* source;
+        void run();
+    };
+
+    // gives the slot back when the last data over it is gone
+    struct SlotRelease
+    {
+        QSharedPointer<QGraphicsFrameRing> ring;
+        int slot;
+        void operator()(const uchar* bits) const;
+    };
+
+    QSharedPointer<QGraphicsFrameRing> _ring;
+    Reader _reader;
+    QAtomicInt _stopping;
+    QAtomicInt _scheduled;
+
+    mutable QMutex _mutex; // for the frame taken and numbers
+    QGraphicsImageData _taken;
+    quint64 _taken_number;
+    quint64 _shown_number;
+    quint64 _skipped;
+
+    void _read();
+    void _take(const QGraphicsFrameRing::Frame& frame);
+};
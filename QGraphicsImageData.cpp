@@ -0,0 +1,587 @@
+#include "QGraphicsImageData.h"
+#include <QtConcurrent>
+#include <qmath.h>
+#include <cstring>
+
+#define MAP_PARALLEL_PIXELS (1 << 20)
+#define MAP_BAND_ROWS 64
+
+// native values of a row, every step pixels, as float
+template <typename T>
+static void _load_row(const T* pixels, int count, int step, float* values)
+{
+    if (step == 1) {
+        for (int i = 0; i < count; i++) {
+            values[i] = float(pixels[i]);
+        }
+    }
+    else {
+        for (int i = 0; i < count; i++) {
+            values[i] = float(pixels[i * step]);
+        }
+    }
+}
+
+// values windowed to indices 0 to 255, branch free
+static void _window_row(const float* values, int count, float offset, float scale, uchar* indices)
+{
+    for (int i = 0; i < count; i++) {
+        float index = (values[i] - offset) * scale;
+        index = index < 0.0f ? 0.0f : index;
+        index = index > 255.0f ? 255.0f : index;
+        indices[i] = uchar(index + 0.5f);
+    }
+}
+
+// BT.601 video range YUV of pixel x to blue, green and red, V chroma_size / 2
+// bytes after U
+static inline void _yuv_pixel(const uchar* luma, int luma_size, const uchar* chroma, int chroma_size, int x,
+                              float& b, float& g, float& r)
+{
+    const uchar* uv = chroma + (x >> 1) * chroma_size;
+    float c = 1.164f * (luma[x * luma_size] - 16);
+    float d = float(uv[0] - 128);
+    float e = float(uv[chroma_size / 2] - 128);
+    r = c + 1.596f * e;
+    g = c - 0.392f * d - 0.813f * e;
+    b = c + 2.017f * d;
+}
+
+// YUV of pixels, every step pixels, chroma shared by 2 pixels. At full
+// resolution the two pixels of a chroma pair are converted together, without
+// branches, the chroma terms computed once
+template <int LUMA_SIZE, int CHROMA_SIZE>
+static void _yuv_row(const uchar* luma, const uchar* chroma, int left, int count, int step, float* b, float* g,
+                     float* r)
+{
+    int i = 0;
+    if (step == 1) {
+        if (left & 1) {
+            _yuv_pixel(luma, LUMA_SIZE, chroma, CHROMA_SIZE, left, b[0], g[0], r[0]);
+            i = 1;
+        }
+        const uchar* y = luma + (left + i) * LUMA_SIZE;
+        const uchar* uv = chroma + ((left + i) >> 1) * CHROMA_SIZE;
+        for (; i + 1 < count; i += 2, y += 2 * LUMA_SIZE, uv += CHROMA_SIZE) {
+            float d = float(uv[0] - 128);
+            float e = float(uv[CHROMA_SIZE / 2] - 128);
+            float cr = 1.596f * e;
+            float cg = -0.392f * d - 0.813f * e;
+            float cb = 2.017f * d;
+            float c0 = 1.164f * (y[0] - 16);
+            float c1 = 1.164f * (y[LUMA_SIZE] - 16);
+            r[i] = c0 + cr;
+            g[i] = c0 + cg;
+            b[i] = c0 + cb;
+            r[i + 1] = c1 + cr;
+            g[i + 1] = c1 + cg;
+            b[i + 1] = c1 + cb;
+        }
+    }
+    for (; i < count; i++) {
+        _yuv_pixel(luma, LUMA_SIZE, chroma, CHROMA_SIZE, left + i * step, b[i], g[i], r[i]);
+    }
+}
+
+// bilinear demosaic of pixel x of a row of RGGB, neighbours mirrored at
+// borders so they keep the color of the pixel they stand for
+static inline void _bayer_pixel(const uchar* above, const uchar* row, const uchar* below, bool odd_row, int width,
+                                int x, float& b, float& g, float& r)
+{
+    int xl = x > 0 ? x - 1 : qMin(x + 1, width - 1);
+    int xr = x < width - 1 ? x + 1 : qMax(x - 1, 0);
+    float c = row[x];
+    float horizontal = (row[xl] + row[xr]) * 0.5f;
+    float vertical = (above[x] + below[x]) * 0.5f;
+    float cross = (horizontal + vertical) * 0.5f;
+    float diagonal = (above[xl] + above[xr] + below[xl] + below[xr]) * 0.25f;
+    int site = (odd_row ? 2 : 0) | (x & 1); // red, green of red rows, green of blue rows, blue
+    r = site == 0 ? c : (site == 1 ? horizontal : (site == 2 ? vertical : diagonal));
+    g = site == 0 || site == 3 ? cross : c;
+    b = site == 3 ? c : (site == 2 ? horizontal : (site == 1 ? vertical : diagonal));
+}
+
+// demosaic of a row, every step pixels. At full resolution, inner pixels go
+// by pairs from an even x, red and green on even rows, green and blue on odd
+// rows, so the sites are known and nothing is mirrored; border pixels and
+// zoomed out rows go one by one
+static void _bayer_row(const uchar* above, const uchar* row, const uchar* below, bool odd_row, int width, int left,
+                       int count, int step, float* b, float* g, float* r)
+{
+    int i = 0;
+    if (step == 1) {
+        for (; i < count && (left + i < 2 || ((left + i) & 1)); i++) {
+            _bayer_pixel(above, row, below, odd_row, width, left + i, b[i], g[i], r[i]);
+        }
+        if (!odd_row) {
+            for (; i + 1 < count && left + i + 2 < width; i += 2) {
+                int x = left + i;
+                float cross = ((row[x - 1] + row[x + 1]) * 0.5f + (above[x] + below[x]) * 0.5f) * 0.5f;
+                r[i] = row[x];
+                g[i] = cross;
+                b[i] = (above[x - 1] + above[x + 1] + below[x - 1] + below[x + 1]) * 0.25f;
+                r[i + 1] = (row[x] + row[x + 2]) * 0.5f;
+                g[i + 1] = row[x + 1];
+                b[i + 1] = (above[x + 1] + below[x + 1]) * 0.5f;
+            }
+        }
+        else {
+            for (; i + 1 < count && left + i + 2 < width; i += 2) {
+                int x = left + i;
+                float cross = ((row[x] + row[x + 2]) * 0.5f + (above[x + 1] + below[x + 1]) * 0.5f) * 0.5f;
+                r[i] = (above[x] + below[x]) * 0.5f;
+                g[i] = row[x];
+                b[i] = (row[x - 1] + row[x + 1]) * 0.5f;
+                r[i + 1] = (above[x] + above[x + 2] + below[x] + below[x + 2]) * 0.25f;
+                g[i + 1] = cross;
+                b[i + 1] = row[x + 1];
+            }
+        }
+    }
+    for (; i < count; i++) {
+        _bayer_pixel(above, row, below, odd_row, width, left + i * step, b[i], g[i], r[i]);
+    }
+}
+
+// min, max, sum and sum of squares of a run of values
+template <typename T>
+static void _accumulate(const T* values, int count, double& min, double& max, double& sum, double& squares)
+{
+    for (int i = 0; i < count; i++) {
+        double v = values[i];
+        min = v < min ? v : min;
+        max = v > max ? v : max;
+        sum += v;
+        squares += v * v;
+    }
+}
+
+static void _color_row(const uchar* indices, int count, const QRgb* colormap, QRgb* colors)
+{
+    for (int i = 0; i < count; i++) {
+        colors[i] = colormap[indices[i]];
+    }
+}
+
+QGraphicsImageData::QGraphicsImageData()
+    : _width(0)
+    , _height(0)
+    , _format(INVALID)
+    , _stride(0)
+{
+}
+
+QGraphicsImageData::QGraphicsImageData(int width, int height, FORMAT format)
+    : _width(qMax(0, width))
+    , _height(qMax(0, height))
+    , _format(format)
+{
+    _stride = (_line_size(_width, format) + 3) & ~3;
+    _bytes.fill(0, _stride * _rows());
+}
+
+QGraphicsImageData QGraphicsImageData::fromImage(const QImage& image)
+{
+    QGraphicsImageData data;
+    QImage source;
+    if (image.format() == QImage::Format_Grayscale8) {
+        data = QGraphicsImageData(image.width(), image.height(), GRAY8);
+        source = image;
+    }
+#if QT_VERSION >= QT_VERSION_CHECK(5, 13, 0)
+    else if (image.format() == QImage::Format_Grayscale16) {
+        data = QGraphicsImageData(image.width(), image.height(), GRAY16);
+        source = image;
+    }
+#endif
+    else if (!image.isNull()) {
+        data = QGraphicsImageData(image.width(), image.height(), RGB32);
+        source = image.convertToFormat(QImage::Format_RGB32);
+    }
+    int length = _line_size(data.width(), data.format());
+    for (int y = 0; y < data.height(); y++) {
+        memcpy(data.scanLine(y), source.constScanLine(y), length);
+    }
+    return data;
+}
+
+QGraphicsImageData QGraphicsImageData::fromFrame(const uchar* bits, int width, int height, int bytesPerLine,
+                                                 FORMAT format)
+{
+    QGraphicsImageData data(width, height, format);
+    int length = _line_size(data.width(), format);
+    if (bits && bytesPerLine < length) {
+        return QGraphicsImageData();
+    }
+    for (int y = 0; y < data._rows() && bits; y++) {
+        memcpy(data.bits() + qint64(y) * data.bytesPerLine(), bits + qint64(y) * bytesPerLine, length);
+    }
+    return data;
+}
+
+QGraphicsImageData QGraphicsImageData::fromExternal(const QSharedPointer<const uchar>& bits, int width, int height,
+                                                    int bytesPerLine, FORMAT format)
+{
+    QGraphicsImageData data;
+    if (!bits || width <= 0 || height <= 0 || bytesPerLine < _line_size(width, format) ||
+        _pixel_size(format) == 0) {
+        return data;
+    }
+    data._width = width;
+    data._height = height;
+    data._format = format;
+    data._stride = bytesPerLine;
+    data._external = bits;
+    return data;
+}
+
+bool QGraphicsImageData::isNull() const
+{
+    return _format == INVALID || _width == 0 || _height == 0;
+}
+
+int QGraphicsImageData::width() const
+{
+    return _width;
+}
+
+int QGraphicsImageData::height() const
+{
+    return _height;
+}
+
+QRect QGraphicsImageData::rect() const
+{
+    return QRect(0, 0, _width, _height);
+}
+
+QGraphicsImageData::FORMAT QGraphicsImageData::format() const
+{
+    return _format;
+}
+
+bool QGraphicsImageData::isColor() const
+{
+    return _format == RGB32 || _format == NV12 || _format == YUYV || _format == BAYER_RGGB;
+}
+
+int QGraphicsImageData::bytesPerLine() const
+{
+    return _stride;
+}
+
+qint64 QGraphicsImageData::byteCount() const
+{
+    return qint64(_stride) * _rows();
+}
+
+// external pixels detached into bytes of our own, as QImage does
+uchar* QGraphicsImageData::bits()
+{
+    if (_external) {
+        _bytes = QByteArray(reinterpret_cast<const char*>(_external.data()), int(byteCount()));
+        _external.reset();
+    }
+    return reinterpret_cast<uchar*>(_bytes.data());
+}
+
+const uchar* QGraphicsImageData::constBits() const
+{
+    if (_external) {
+        return _external.data();
+    }
+    return reinterpret_cast<const uchar*>(_bytes.constData());
+}
+
+uchar* QGraphicsImageData::scanLine(int y)
+{
+    return bits() + qint64(y) * _stride;
+}
+
+const uchar* QGraphicsImageData::constScanLine(int y) const
+{
+    return constBits() + qint64(y) * _stride;
+}
+
+double QGraphicsImageData::value(int x, int y) const
+{
+    const uchar* row = constScanLine(y);
+    switch (_format) {
+    case GRAY8:
+    case NV12:
+    case BAYER_RGGB:
+        return row[x];
+    case YUYV:
+        return row[2 * x];
+    case GRAY16:
+        return reinterpret_cast<const quint16*>(row)[x];
+    case FLOAT32:
+        return reinterpret_cast<const float*>(row)[x];
+    case RGB32:
+        return qGray(reinterpret_cast<const QRgb*>(row)[x]);
+    default:
+        return 0;
+    }
+}
+
+void QGraphicsImageData::range(double& low, double& high) const
+{
+    QGraphicsRLEMask all = QGraphicsRLEMask::fromShape(QGraphicsROIShape::fromRect(QRectF(rect())));
+    Statistics statistics = this->statistics(all);
+    low = statistics.min;
+    high = statistics.max;
+}
+
+// over the runs of each row, in double as float sums of 16 bit values lose
+// precision
+QGraphicsImageData::Statistics QGraphicsImageData::statistics(const QGraphicsRLEMask& mask) const
+{
+    Statistics statistics;
+    if (isNull()) {
+        return statistics;
+    }
+    double sum = 0;
+    double squares = 0;
+    double min = 0;
+    double max = 0;
+    QVector<uchar> grays;
+    int top = qMax(mask.top(), 0);
+    int bottom = qMin(mask.top() + mask.rowCount(), _height);
+    for (int y = top; y < bottom; y++) {
+        const uchar* row = constScanLine(y);
+        int count;
+        const int* runs = mask.row(y, count);
+        for (int k = 0; k < count; k++) {
+            int begin = qMax(runs[2 * k], 0);
+            int end = qMin(runs[2 * k + 1], _width);
+            if (begin >= end) {
+                continue;
+            }
+            if (statistics.count == 0) {
+                min = max = value(begin, y);
+            }
+            statistics.count += end - begin;
+            switch (_format) {
+            case GRAY8:
+            case NV12:
+            case BAYER_RGGB:
+                _accumulate(row + begin, end - begin, min, max, sum, squares);
+                break;
+            case GRAY16:
+                _accumulate(reinterpret_cast<const quint16*>(row) + begin, end - begin, min, max, sum, squares);
+                break;
+            case FLOAT32:
+                _accumulate(reinterpret_cast<const float*>(row) + begin, end - begin, min, max, sum, squares);
+                break;
+            case RGB32:
+                grays.resize(end - begin);
+                for (int x = begin; x < end; x++) {
+                    grays[x - begin] = uchar(qGray(reinterpret_cast<const QRgb*>(row)[x]));
+                }
+                _accumulate(grays.constData(), end - begin, min, max, sum, squares);
+                break;
+            case YUYV:
+                grays.resize(end - begin);
+                for (int x = begin; x < end; x++) {
+                    grays[x - begin] = row[2 * x];
+                }
+                _accumulate(grays.constData(), end - begin, min, max, sum, squares);
+                break;
+            default:
+                break;
+            }
+        }
+    }
+    statistics.min = min;
+    statistics.max = max;
+    if (statistics.count > 0) {
+        statistics.mean = sum / statistics.count;
+        statistics.deviation = qSqrt(qMax(0.0, squares / statistics.count - statistics.mean * statistics.mean));
+    }
+    return statistics;
+}
+
+// rows of large rects in bands on the thread pool, each writing rows of its
+// own in the image
+QImage QGraphicsImageData::map(const QRect& rect, int step, double low, double high,
+                               const QVector<QRgb>& colormap) const
+{
+    QRect source = rect & this->rect();
+    step = qMax(1, step);
+    int width = (source.width() + step - 1) / step;
+    int height = (source.height() + step - 1) / step;
+    if (source.isEmpty() || colormap.size() < 256) {
+        return QImage();
+    }
+    QImage image(width, height, QImage::Format_RGB32);
+    float offset = float(low);
+    float scale = high > low ? float(255 / (high - low)) : 0.0f;
+    uchar* bits = image.bits();
+    if (qint64(width) * height < MAP_PARALLEL_PIXELS) {
+        _map_rows(source, step, 0, height, offset, scale, colormap.constData(), bits, image.bytesPerLine());
+        return image;
+    }
+    QVector<Band> bands;
+    for (int top = 0; top < height; top += MAP_BAND_ROWS) {
+        Band band;
+        band.top = top;
+        band.bottom = qMin(top + MAP_BAND_ROWS, height);
+        bands.append(band);
+    }
+    BandMapping mapping;
+    mapping.data = this;
+    mapping.source = source;
+    mapping.step = step;
+    mapping.offset = offset;
+    mapping.scale = scale;
+    mapping.colormap = colormap.constData();
+    mapping.bits = bits;
+    mapping.bytes_per_line = image.bytesPerLine();
+    QtConcurrent::blockingMap(bands, mapping);
+    return image;
+}
+
+void QGraphicsImageData::BandMapping::operator()(const Band& band) const
+{
+    data->_map_rows(source, step, band.top, band.bottom, offset, scale, colormap, bits, bytes_per_line);
+}
+
+// mapped rows top to bottom of source, every step pixels
+void QGraphicsImageData::_map_rows(const QRect& source, int step, int top, int bottom, float offset, float scale,
+                                   const QRgb* colormap, uchar* bits, int bytes_per_line) const
+{
+    int width = (source.width() + step - 1) / step;
+    int channels = isColor() ? 3 : 1;
+    QVector<float> values(width * channels);
+    QVector<uchar> indices(width * channels);
+    float* b = values.data();
+    float* g = b + width;
+    float* r = g + width;
+    for (int i = top; i < bottom; i++) {
+        int y = source.top() + i * step;
+        const uchar* row = constScanLine(y);
+        QRgb* colors = reinterpret_cast<QRgb*>(bits + qint64(i) * bytes_per_line);
+        switch (_format) {
+        case GRAY8:
+            _load_row(row + source.left(), width, step, values.data());
+            break;
+        case GRAY16:
+            _load_row(reinterpret_cast<const quint16*>(row) + source.left(), width, step, values.data());
+            break;
+        case FLOAT32:
+            _load_row(reinterpret_cast<const float*>(row) + source.left(), width, step, values.data());
+            break;
+        case RGB32:
+            // blue, green and red bytes in place, every step pixels
+            for (int c = 0; c < 3; c++) {
+                _load_row(row + 4 * source.left() + c, width, 4 * step, values.data() + c * width);
+            }
+            break;
+        case NV12:
+            _yuv_row<1, 2>(row, _chroma_line(y), source.left(), width, step, b, g, r);
+            break;
+        case YUYV:
+            _yuv_row<2, 4>(row, row + 1, source.left(), width, step, b, g, r);
+            break;
+        case BAYER_RGGB:
+            _bayer_row(constScanLine(y > 0 ? y - 1 : qMin(1, _height - 1)), row,
+                       constScanLine(y < _height - 1 ? y + 1 : qMax(y - 1, 0)), y & 1, _width, source.left(), width,
+                       step, b, g, r);
+            break;
+        default:
+            break;
+        }
+        _window_row(values.constData(), width * channels, offset, scale, indices.data());
+        if (channels == 3) {
+            const uchar* bi = indices.constData();
+            const uchar* gi = bi + width;
+            const uchar* ri = gi + width;
+            for (int x = 0; x < width; x++) {
+                colors[x] = qRgb(ri[x], gi[x], bi[x]);
+            }
+        }
+        else {
+            _color_row(indices.constData(), width, colormap, colors);
+        }
+    }
+}
+
+QImage QGraphicsImageData::toImage(double low, double high) const
+{
+    QImage image = map(rect(), 1, low, high, colormap(GRAY));
+    if (isColor()) {
+        return image;
+    }
+    return image.convertToFormat(QImage::Format_Grayscale8);
+}
+
+// piecewise linear between a few colors
+QVector<QRgb> QGraphicsImageData::colormap(COLORMAP colormap)
+{
+    static const QRgb hot[] = { qRgb(0, 0, 0), qRgb(230, 0, 0), qRgb(255, 210, 0), qRgb(255, 255, 255) };
+    static const QRgb jet[] = { qRgb(0, 0, 128), qRgb(0, 0, 255), qRgb(0, 255, 255), qRgb(255, 255, 0),
+                                qRgb(255, 0, 0), qRgb(128, 0, 0) };
+    static const QRgb gray[] = { qRgb(0, 0, 0), qRgb(255, 255, 255) };
+    const QRgb* stops = gray;
+    int count = 2;
+    if (colormap == HOT) {
+        stops = hot;
+        count = 4;
+    }
+    else if (colormap == JET) {
+        stops = jet;
+        count = 6;
+    }
+    QVector<QRgb> colors(256);
+    for (int i = 0; i < 256; i++) {
+        qreal t = qreal(i) * (count - 1) / 255;
+        int k = qMin(int(t), count - 2);
+        qreal f = t - k;
+        QRgb a = stops[k];
+        QRgb b = stops[k + 1];
+        colors[i] = qRgb(qRound(qRed(a) + f * (qRed(b) - qRed(a))), qRound(qGreen(a) + f * (qGreen(b) - qGreen(a))),
+                         qRound(qBlue(a) + f * (qBlue(b) - qBlue(a))));
+    }
+    return colors;
+}
+
+// with the chroma plane of NV12
+int QGraphicsImageData::_rows() const
+{
+    return _format == NV12 ? _height + (_height + 1) / 2 : _height;
+}
+
+// U and V of rows y and y + 1 of NV12
+const uchar* QGraphicsImageData::_chroma_line(int y) const
+{
+    return constBits() + qint64(_height + y / 2) * _stride;
+}
+
+// bytes of a row, up to the whole chroma pair of the last pixel of an odd
+// width for NV12 and YUYV
+int QGraphicsImageData::_line_size(int width, FORMAT format)
+{
+    if (format == NV12 || format == YUYV) {
+        width = (width + 1) / 2 * 2;
+    }
+    return width * _pixel_size(format);
+}
+
+// of the rows of luma for NV12
+int QGraphicsImageData::_pixel_size(FORMAT format)
+{
+    switch (format) {
+    case GRAY8:
+    case NV12:
+    case BAYER_RGGB:
+        return 1;
+    case GRAY16:
+    case YUYV:
+        return 2;
+    case FLOAT32:
+    case RGB32:
+        return 4;
+    default:
+        return 0;
+    }
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <QByteArray>
+#include <QImage>
+#include <QRect>
+#include <QRgb>
+#include <QSharedPointer>
+#include <QVector>
+#include "QGraphicsRLEMask.h"
+
+/*!
+ * Pixels of an image at their native depth, 8 or 16 bit gray, float gray or
+ * 32 bit RGB, for display through a window and a colormap and for statistics
+ * of the original values. It is a value type, shared implicitly, and may be
+ * copied to worker threads.
+ *
+ * Raw camera frames, NV12, YUYV and 8 bit Bayer RGGB, are kept as captured
+ * and converted to RGB only for the pixels mapped, so a frame is never
+ * converted as a whole before it is shown.
+ *
+ * map() is the kernel of display. Values of a rect, every step pixels, are
+ * windowed to 8 bit indices with float arithmetic over whole rows, with no
+ * branch so the compiler vectorizes it, then looked up in a colormap of 256
+ * colors. Color formats are converted row by row to blue, green and red,
+ * then windowed channel by channel, without colormap. Large rects are mapped
+ * in bands of rows on the thread pool.
+ *
+ * Pixels may also live in memory of others, a frame in shared memory, kept
+ * by a shared pointer whose deleter gives the memory back. They are read in
+ * place, and copied only when written through bits() or scanLine().
+ *
+ * Usage:
+ *
+ *   QGraphicsImageData data(width, height, QGraphicsImageData::GRAY16);
+ *   memcpy(data.bits(), frame, data.byteCount());
+ *   QImage tile = data.map(rect, 1, 100, 4000, QGraphicsImageData::colormap(QGraphicsImageData::HOT));
+ *   QGraphicsImageData::Statistics statistics = data.statistics(mask);
+ *
+ *   QGraphicsImageData frame = QGraphicsImageData::fromFrame(buffer, 3840, 2160, 3840, QGraphicsImageData::NV12);
+ */
+class QGraphicsImageData
+{
+public:
+    enum FORMAT
+    {
+        INVALID = 0,
+        GRAY8 = 1,
+        GRAY16 = 2,
+        FLOAT32 = 3,
+        RGB32 = 4,
+        NV12 = 5, // 8 bit Y plane, then a plane of interleaved U and V for 2 x 2 pixels
+        YUYV = 6, // Y, U, Y, V for 2 pixels
+        BAYER_RGGB = 7 // 8 bit, red at even rows and columns
+    };
+
+    enum COLORMAP
+    {
+        GRAY = 0,
+        HOT = 1,
+        JET = 2
+    };
+
+    struct Statistics
+    {
+        Statistics() : count(0), min(0), max(0), mean(0), deviation(0) {}
+        qint64 count;
+        double min;
+        double max;
+        double mean;
+        double deviation;
+    };
+
+    QGraphicsImageData();
+    // zero filled, rows aligned to 4 bytes
+    QGraphicsImageData(int width, int height, FORMAT format);
+
+    // gray 8 and 16 bit images as gray, others as RGB
+    static QGraphicsImageData fromImage(const QImage& image);
+
+    // rows of a captured frame copied, NV12 chroma plane right after the
+    // rows of luma, null when rows are too short for the format. rows of
+    // NV12 and YUYV hold whole chroma pairs, odd widths are rounded up
+    static QGraphicsImageData fromFrame(const uchar* bits, int width, int height, int bytesPerLine, FORMAT format);
+
+    // pixels not copied, bits kept while the data or a copy of it lives,
+    // null when rows are too short for the format
+    static QGraphicsImageData fromExternal(const QSharedPointer<const uchar>& bits, int width, int height,
+                                           int bytesPerLine, FORMAT format);
+
+    bool isNull() const;
+    int width() const;
+    int height() const;
+    QRect rect() const;
+    FORMAT format() const;
+    // converted to RGB for display
+    bool isColor() const;
+    int bytesPerLine() const;
+    qint64 byteCount() const;
+    // external pixels copied first
+    uchar* bits();
+    const uchar* constBits() const;
+    uchar* scanLine(int y);
+    // rows of luma for NV12
+    const uchar* constScanLine(int y) const;
+
+    // native value at pixel, gray of RGB, luma of YUV, raw value of Bayer
+    double value(int x, int y) const;
+
+    // smallest and largest values, for a first window
+    void range(double& low, double& high) const;
+
+    // count, min, max, mean and deviation of native values of pixels in
+    // mask, in image coords
+    Statistics statistics(const QGraphicsRLEMask& mask) const;
+
+    // pixels of rect, every step pixels, windowed from low to high and
+    // colored by a colormap of 256 colors
+    QImage map(const QRect& rect, int step, double low, double high, const QVector<QRgb>& colormap) const;
+
+    // full image windowed to 8 bit gray, or RGB for color formats, for tools
+    // working on 8 bit images
+    QImage toImage(double low, double high) const;
+
+    static QVector<QRgb> colormap(COLORMAP colormap);
+
+private:
+    // a band of rows of a mapped image, on a worker thread
+    struct Band
+    {
+        int top;
+        int bottom;
+    };
+
+    struct BandMapping
+    {
+        typedef void result_type;
+        const QGraphicsImageData* data;
+        QRect source;
+        int step;
+        float offset;
+        float scale;
+        const QRgb* colormap;
+        uchar* bits;
+        int bytes_per_line;
+        void operator()(const Band& band) const;
+    };
+
+    int _width;
+    int _height;
+    FORMAT _format;
+    int _stride;
+    QByteArray _bytes;
+    QSharedPointer<const uchar> _external;
+
+    int _rows() const;
+    const uchar* _chroma_line(int y) const;
+    void _map_rows(const QRect& source, int step, int top, int bottom, float offset, float scale,
+                   const QRgb* colormap, uchar* bits, int bytes_per_line) const;
+    static int _pixel_size(FORMAT format);
+    static int _line_size(int width, FORMAT format);
+};
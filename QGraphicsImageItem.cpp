@@ -0,0 +1,203 @@
+#include "QGraphicsImageItem.h"
+#include <QStyleOptionGraphicsItem>
+#include <QPainter>
+#include <QtConcurrent>
+#include <qmath.h>
+
+#define IMAGE_TILE_SIZE 256
+#define IMAGE_MAX_LEVEL 8
+#define MAX_CACHED_TILES 512
+
+// level in the top byte, then tile coords
+static quint64 _tile_key(int level, int tx, int ty)
+{
+    return (quint64(level) << 56) | (quint64(quint32(tx) & 0xfffffff) << 28) | (quint32(ty) & 0xfffffff);
+}
+
+QGraphicsImageItem::QGraphicsImageItem(QGraphicsItem* parent)
+    : QGraphicsItem(parent)
+    , _low(0)
+    , _high(255)
+    , _colormap(QGraphicsImageData::colormap(QGraphicsImageData::GRAY))
+    , _smooth(true)
+    , _generation(0)
+{
+    setFlags(QGraphicsItem::ItemUsesExtendedStyleOption);
+}
+
+void QGraphicsImageItem::setImageData(const QGraphicsImageData& data)
+{
+    prepareGeometryChange();
+    _data = data;
+    if (data.format() == QGraphicsImageData::GRAY16 || data.format() == QGraphicsImageData::FLOAT32) {
+        data.range(_low, _high);
+    }
+    else {
+        _low = 0;
+        _high = 255;
+    }
+    _tiles.clear();
+    _generation++;
+    update();
+}
+
+const QGraphicsImageData& QGraphicsImageItem::imageData() const
+{
+    return _data;
+}
+
+void QGraphicsImageItem::setFrame(const QGraphicsImageData& frame)
+{
+    if (frame.rect() != _data.rect() || frame.format() != _data.format()) {
+        setImageData(frame);
+        return;
+    }
+    _data = frame;
+    _generation++;
+    update();
+}
+
+// stale tiles are kept until painted, so a drag maps only visible ones
+void QGraphicsImageItem::setWindow(double low, double high)
+{
+    _low = low;
+    _high = high;
+    _generation++;
+    update();
+}
+
+double QGraphicsImageItem::windowLow() const
+{
+    return _low;
+}
+
+double QGraphicsImageItem::windowHigh() const
+{
+    return _high;
+}
+
+void QGraphicsImageItem::setColormap(const QVector<QRgb>& colormap)
+{
+    if (colormap.size() < 256) {
+        return;
+    }
+    _colormap = colormap;
+    _generation++;
+    update();
+}
+
+void QGraphicsImageItem::setSmooth(bool smooth)
+{
+    _smooth = smooth;
+    update();
+}
+
+void QGraphicsImageItem::invalidate(const QRect& rect)
+{
+    if (rect.isNull()) {
+        _tiles.clear();
+        update();
+        return;
+    }
+    QHash<quint64, Tile>::iterator it = _tiles.begin();
+    while (it != _tiles.end()) {
+        int level = int(it.key() >> 56);
+        int span = IMAGE_TILE_SIZE << level;
+        int tx = int((it.key() >> 28) & 0xfffffff);
+        int ty = int(it.key() & 0xfffffff);
+        if (QRect(tx * span, ty * span, span, span).intersects(rect)) {
+            it = _tiles.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+    update(rect);
+}
+
+QRectF QGraphicsImageItem::boundingRect() const
+{
+    return QRectF(_data.rect());
+}
+
+// tiles of the level where a mapped pixel is about a device pixel, those
+// missing or stale mapped in parallel first
+void QGraphicsImageItem::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget)
+{
+    Q_UNUSED(widget);
+    QRectF exposed = option->exposedRect & boundingRect();
+    if (exposed.isEmpty()) {
+        return;
+    }
+    qreal lod = option->levelOfDetailFromTransform(painter->worldTransform());
+    int level = 0;
+    while (level < IMAGE_MAX_LEVEL && lod * (2 << level) <= 1) {
+        level++;
+    }
+    int step = 1 << level;
+    int span = IMAGE_TILE_SIZE * step;
+    QRect tiles(QPoint(qFloor(exposed.left() / span), qFloor(exposed.top() / span)),
+                QPoint(qFloor((exposed.right() - 1e-6) / span), qFloor((exposed.bottom() - 1e-6) / span)));
+
+    QVector<TileJob> jobs;
+    for (int ty = tiles.top(); ty <= tiles.bottom(); ty++) {
+        for (int tx = tiles.left(); tx <= tiles.right(); tx++) {
+            quint64 key = _tile_key(level, tx, ty);
+            QHash<quint64, Tile>::const_iterator it = _tiles.constFind(key);
+            if (it == _tiles.constEnd() || it->generation != _generation) {
+                TileJob job;
+                job.key = key;
+                job.rect = QRect(tx * span, ty * span, span, span) & _data.rect();
+                jobs.append(job);
+            }
+        }
+    }
+    if (!jobs.isEmpty()) {
+        TileMapping mapping;
+        mapping.data = &_data;
+        mapping.step = step;
+        mapping.low = _low;
+        mapping.high = _high;
+        mapping.colormap = &_colormap;
+        QtConcurrent::blockingMap(jobs, mapping);
+        foreach (const TileJob& job, jobs) {
+            Tile& tile = _tiles[job.key];
+            tile.image = job.image;
+            tile.generation = _generation;
+        }
+    }
+
+    painter->setRenderHint(QPainter::SmoothPixmapTransform, _smooth);
+    for (int ty = tiles.top(); ty <= tiles.bottom(); ty++) {
+        for (int tx = tiles.left(); tx <= tiles.right(); tx++) {
+            const Tile& tile = _tiles[_tile_key(level, tx, ty)];
+            QRectF target(QRect(tx * span, ty * span, span, span) & _data.rect());
+            painter->drawImage(target, tile.image);
+        }
+    }
+    _evict_tiles(level, tiles);
+}
+
+void QGraphicsImageItem::TileMapping::operator()(TileJob& job) const
+{
+    job.image = data->map(job.rect, step, low, high, *colormap);
+}
+
+// tiles of other levels and out of view go first
+void QGraphicsImageItem::_evict_tiles(int level, const QRect& visible)
+{
+    if (_tiles.size() <= MAX_CACHED_TILES) {
+        return;
+    }
+    QHash<quint64, Tile>::iterator it = _tiles.begin();
+    while (it != _tiles.end()) {
+        int tx = int((it.key() >> 28) & 0xfffffff);
+        int ty = int(it.key() & 0xfffffff);
+        if (int(it.key() >> 56) != level || !visible.contains(tx, ty)) {
+            it = _tiles.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <QGraphicsItem>
+#include <QHash>
+#include <QImage>
+#include <QVector>
+#include "QGraphicsImageData.h"
+
+/*!
+ * This item shows an image kept at native depth, 16 bit or float, through a
+ * window of values and a colormap, pixel (x, y) at item (x, y).
+ *
+ * Native pixels are mapped for display into a cache of tiles, only the tiles
+ * painted, that is those visible, on paint. Zoomed out, tiles are mapped every
+ * 2, 4, ... pixels so work follows the pixels of the viewport rather than
+ * those of the image. Changing the window or colormap marks all tiles stale,
+ * and only the visible ones are mapped again, in parallel, when painted.
+ *
+ * Usage:
+ *
+ *   QGraphicsImageItem* item = new QGraphicsImageItem();
+ *   scene->addItem(item);
+ *   item->setImageData(data);
+ *   // on contrast slider
+ *   item->setWindow(low, high);
+ *   // on a captured frame
+ *   item->setFrame(QGraphicsImageData::fromFrame(bits, width, height, stride, QGraphicsImageData::NV12));
+ */
+class QGraphicsImageItem : public QGraphicsItem
+{
+public:
+    QGraphicsImageItem(QGraphicsItem* parent = NULL);
+
+    // window is reset to the range of 16 bit and float data, 0 to 255 others
+    void setImageData(const QGraphicsImageData& data);
+    const QGraphicsImageData& imageData() const;
+
+    // next frame of a live source, window and colormap kept when of the same
+    // size and format, only visible tiles mapped again
+    void setFrame(const QGraphicsImageData& frame);
+
+    // native values shown from first to last color of colormap
+    void setWindow(double low, double high);
+    double windowLow() const;
+    double windowHigh() const;
+
+    // 256 colors, for gray data
+    void setColormap(const QVector<QRgb>& colormap);
+
+    // smooth or nearest neighbour scaling of tiles
+    void setSmooth(bool smooth);
+
+    // native pixels changed in rect, all when null
+    void invalidate(const QRect& rect = QRect());
+
+    QRectF boundingRect() const;
+    void paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget = NULL);
+
+private:
+    struct Tile
+    {
+        Tile() : generation(-1) {}
+        QImage image;
+        int generation;
+    };
+
+    // a stale tile mapped on a worker thread
+    struct TileJob
+    {
+        quint64 key;
+        QRect rect; // in image coords
+        QImage image;
+    };
+
+    struct TileMapping
+    {
+        typedef void result_type;
+        const QGraphicsImageData* data;
+        int step;
+        double low;
+        double high;
+        const QVector<QRgb>* colormap;
+        void operator()(TileJob& job) const;
+    };
+
+    QGraphicsImageData _data;
+    double _low;
+    double _high;
+    QVector<QRgb> _colormap;
+    bool _smooth;
+    QHash<quint64, Tile> _tiles;
+    int _generation; // of window and colormap
+
+    void _evict_tiles(int level, const QRect& visible);
+};
@@ -0,0 +1,235 @@
+#include "QGraphicsLassoItem.h"
+#include <QPainter>
+#include <qmath.h>
+
+// angle in (-pi, pi]
+static qreal _wrap(qreal angle)
+{
+    while (angle > M_PI) {
+        angle -= 2 * M_PI;
+    }
+    while (angle <= -M_PI) {
+        angle += 2 * M_PI;
+    }
+    return angle;
+}
+
+QGraphicsLassoItem::QGraphicsLassoItem(const QPen& pen, QGraphicsItem* parent)
+    : QGraphicsItem(parent)
+    , _pen(pen)
+    , _tolerance(1)
+    , _has_floating(false)
+    , _has_sample(false)
+    , _has_sleeve(false)
+    , _sleeve_base(0)
+    , _sleeve_low(0)
+    , _sleeve_high(0)
+{
+    _pen.setCosmetic(true);
+    setAcceptedMouseButtons(Qt::NoButton);
+}
+
+void QGraphicsLassoItem::setTolerance(qreal tolerance)
+{
+    _tolerance = qMax(qreal(0), tolerance);
+}
+
+qreal QGraphicsLassoItem::tolerance() const
+{
+    return _tolerance;
+}
+
+void QGraphicsLassoItem::addPoint(const QPointF& pos)
+{
+    _update_floating();
+    _has_floating = false;
+    _has_sample = false;
+    _reset_sleeve();
+    _append(pos);
+}
+
+void QGraphicsLassoItem::setFloatingPoint(const QPointF& pos)
+{
+    if (_points.isEmpty()) {
+        return;
+    }
+    _update_floating();
+    _floating = pos;
+    _floating_path.clear();
+    _has_floating = true;
+    _grow(pos);
+    _update_segment(_points.last(), _floating);
+}
+
+void QGraphicsLassoItem::setFloatingPath(const QPolygonF& path)
+{
+    if (_points.isEmpty() || path.isEmpty()) {
+        return;
+    }
+    _update_floating();
+    _floating = path.last();
+    _floating_path = path;
+    _has_floating = true;
+    foreach (const QPointF& pos, path) {
+        _grow(pos);
+    }
+    _update_floating();
+}
+
+// the sleeve holds the directions from the last vertex along which a line
+// passes within tolerance of all samples since; the previous sample becomes a
+// vertex when a sample falls out of it
+void QGraphicsLassoItem::addSample(const QPointF& pos)
+{
+    if (_points.isEmpty()) {
+        _append(pos);
+        return;
+    }
+    QPointF d = pos - _points.last();
+    qreal distance = qSqrt(d.x() * d.x() + d.y() * d.y());
+    if (distance > _tolerance) {
+        qreal angle = qAtan2(d.y(), d.x());
+        qreal half = qAsin(_tolerance / distance);
+        if (!_has_sleeve) {
+            _has_sleeve = true;
+            _sleeve_base = angle;
+            _sleeve_low = -half;
+            _sleeve_high = half;
+        }
+        else {
+            qreal relative = _wrap(angle - _sleeve_base);
+            if (relative < _sleeve_low || relative > _sleeve_high) {
+                // out of the sleeve, start again from the previous sample
+                _has_floating = false;
+                _append(_last_sample);
+                _reset_sleeve();
+                d = pos - _points.last();
+                distance = qSqrt(d.x() * d.x() + d.y() * d.y());
+                if (distance > _tolerance) {
+                    _has_sleeve = true;
+                    _sleeve_base = qAtan2(d.y(), d.x());
+                    _sleeve_high = qAsin(_tolerance / distance);
+                    _sleeve_low = -_sleeve_high;
+                }
+            }
+            else {
+                _sleeve_low = qMax(_sleeve_low, relative - half);
+                _sleeve_high = qMin(_sleeve_high, relative + half);
+            }
+        }
+    }
+    _last_sample = pos;
+    _has_sample = true;
+    setFloatingPoint(pos);
+}
+
+void QGraphicsLassoItem::clear()
+{
+    prepareGeometryChange();
+    _points.clear();
+    _has_floating = false;
+    _has_sample = false;
+    _reset_sleeve();
+    _bound = QRectF();
+}
+
+QPolygonF QGraphicsLassoItem::polygon() const
+{
+    QPolygonF polygon = _points;
+    if (_has_sample && !_points.isEmpty() && _last_sample != _points.last()) {
+        polygon.append(_last_sample);
+    }
+    return polygon;
+}
+
+const QPolygonF& QGraphicsLassoItem::points() const
+{
+    return _points;
+}
+
+bool QGraphicsLassoItem::isEmpty() const
+{
+    return _points.isEmpty();
+}
+
+QRectF QGraphicsLassoItem::boundingRect() const
+{
+    return _bound;
+}
+
+void QGraphicsLassoItem::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget)
+{
+    Q_UNUSED(option);
+    Q_UNUSED(widget);
+    if (_points.isEmpty()) {
+        return;
+    }
+    painter->setPen(_pen);
+    painter->setBrush(Qt::NoBrush);
+    painter->drawPolyline(_points.constData(), _points.size());
+    if (_has_floating && _floating_path.isEmpty()) {
+        painter->drawLine(_points.last(), _floating);
+    }
+    else if (_has_floating) {
+        painter->drawLine(_points.last(), _floating_path.first());
+        painter->drawPolyline(_floating_path.constData(), _floating_path.size());
+    }
+}
+
+void QGraphicsLassoItem::_append(const QPointF& pos)
+{
+    if (!_points.isEmpty() && _points.last() == pos) {
+        return;
+    }
+    _grow(pos);
+    _points.append(pos);
+    if (_points.size() > 1) {
+        _update_segment(_points[_points.size() - 2], pos);
+    }
+}
+
+// the bound only grows while drawing, so most points need no geometry change
+void QGraphicsLassoItem::_grow(const QPointF& pos)
+{
+    // pen is cosmetic, a few scene units are enough at usual zoom
+    qreal margin = qMax(qreal(2), 2 * _tolerance);
+    QRectF rect(pos.x() - margin, pos.y() - margin, 2 * margin, 2 * margin);
+    if (_bound.isNull()) {
+        prepareGeometryChange();
+        _bound = rect;
+    }
+    else if (!_bound.contains(rect)) {
+        prepareGeometryChange();
+        _bound = _bound.united(rect);
+    }
+}
+
+void QGraphicsLassoItem::_update_segment(const QPointF& p0, const QPointF& p1)
+{
+    qreal margin = qMax(qreal(2), 2 * _tolerance);
+    QRectF rect(QPointF(qMin(p0.x(), p1.x()), qMin(p0.y(), p1.y())),
+                QPointF(qMax(p0.x(), p1.x()), qMax(p0.y(), p1.y())));
+    update(rect.adjusted(-margin, -margin, margin, margin));
+}
+
+void QGraphicsLassoItem::_update_floating()
+{
+    if (!_has_floating || _points.isEmpty()) {
+        return;
+    }
+    if (_floating_path.isEmpty()) {
+        _update_segment(_points.last(), _floating);
+        return;
+    }
+    QRectF rect = _floating_path.boundingRect();
+    _update_segment(rect.topLeft(), rect.bottomRight());
+    _update_segment(_points.last(), _floating_path.first());
+}
+
+void QGraphicsLassoItem::_reset_sleeve()
+{
+    _has_sleeve = false;
+    _sleeve_base = 0;
+    _sleeve_low = 0;
+    _sleeve_high = 0;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <QGraphicsItem>
+#include <QPolygonF>
+#include <QPen>
+
+/*!
+ * This item draws a polygon being drawn, as one polyline appended point by point,
+ * instead of one line item per segment.
+ *
+ * Vertices are added with addPoint(), and the end of the polyline follows the
+ * mouse with setFloatingPoint(), or along a path snapped to edges with
+ * setFloatingPath(). Pointer samples of a freehand stroke are added
+ * with addSample(), which decimates them as they arrive: a sample is kept only
+ * when the stroke cannot be drawn as one line from the last kept vertex within
+ * setTolerance(). The directions from the last vertex to all samples since are
+ * kept as an angular sleeve, so each sample costs O(1).
+ *
+ * Appending grows the bound and repaints only the changed segments.
+ *
+ * Usage:
+ *
+ *   QGraphicsLassoItem* lasso = new QGraphicsLassoItem(pen);
+ *   scene->addItem(lasso);
+ *   lasso->setTolerance(1 / qSqrt(qAbs(view->transform().determinant())));
+ *   // on mouse move with left button down
+ *   lasso->addSample(pos);
+ *   QPolygonF polygon = lasso->polygon();
+ */
+class QGraphicsLassoItem : public QGraphicsItem
+{
+public:
+    QGraphicsLassoItem(const QPen& pen, QGraphicsItem* parent = NULL);
+
+    // largest distance of dropped samples from the polygon, in scene units
+    void setTolerance(qreal tolerance);
+    qreal tolerance() const;
+
+    // vertex added as it is
+    void addPoint(const QPointF& pos);
+
+    // end of the polyline, not a vertex yet
+    void setFloatingPoint(const QPointF& pos);
+
+    // end of the polyline through the points of path, not vertices yet
+    void setFloatingPath(const QPolygonF& path);
+
+    // pointer sample of a freehand stroke, decimated
+    void addSample(const QPointF& pos);
+
+    void clear();
+
+    // vertices, and the floating point at the end of a freehand stroke
+    QPolygonF polygon() const;
+    const QPolygonF& points() const;
+    bool isEmpty() const;
+
+    QRectF boundingRect() const;
+    void paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget = NULL);
+
+private:
+    QPen _pen;
+    qreal _tolerance;
+    QPolygonF _points;
+    QPointF _floating;
+    QPolygonF _floating_path; // ending at floating point, or empty for one line
+    bool _has_floating;
+    QRectF _bound;
+
+    // samples since the last vertex
+    QPointF _last_sample;
+    bool _has_sample;
+    bool _has_sleeve;
+    qreal _sleeve_base; // direction of the first sample out of tolerance
+    qreal _sleeve_low; // relative to the base
+    qreal _sleeve_high;
+
+    void _append(const QPointF& pos);
+    void _grow(const QPointF& pos);
+    void _update_segment(const QPointF& p0, const QPointF& p1);
+    void _update_floating();
+    void _reset_sleeve();
+};
@@ -0,0 +1,282 @@
+#include "QGraphicsLiveWire.h"
+#include <QtConcurrent>
+#include <algorithm>
+
+// steps to the 8 neighbours, and their length in tenths
+static const int _step_x[8] = { 1, -1, 0, 0, 1, 1, -1, -1 };
+static const int _step_y[8] = { 0, 0, 1, -1, 1, -1, 1, -1 };
+static const int _step_length[8] = { 10, 10, 10, 10, 14, 14, 14, 14 };
+
+// longest step, 256 times 14, and one for the bucket being popped
+#define STEP_BUCKETS 3585
+// side of the window at most, about 12 MB of search state
+#define MAX_WINDOW_SIZE 1024
+
+static QPoint _clamp(const QPoint& pos, const QRect& rect)
+{
+    return QPoint(qBound(rect.left(), pos.x(), rect.right()), qBound(rect.top(), pos.y(), rect.bottom()));
+}
+
+// span of at most size, keeping margin around seed, centered between seed
+// and target as far as it can
+static void _cap(int& first, int& last, int seed, int target, int margin, int size)
+{
+    if (last - first + 1 <= size) {
+        return;
+    }
+    first = qBound(seed + margin - size + 1, (seed + target) / 2 - size / 2, seed - margin);
+    last = first + size - 1;
+}
+
+QGraphicsLiveWire::QGraphicsLiveWire(QObject* parent)
+    : QObject(parent)
+    , _margin(64)
+    , _pending(false)
+{
+    _search.image_key = 0;
+    _watcher = new QFutureWatcher<QPolygonF>(this);
+    connect(_watcher, SIGNAL(finished()), this, SLOT(onFinished()));
+}
+
+QGraphicsLiveWire::~QGraphicsLiveWire()
+{
+    // the running job extends the search
+    _watcher->waitForFinished();
+}
+
+void QGraphicsLiveWire::setImage(const QImage& image)
+{
+    _image = image.format() == QImage::Format_Grayscale8 ? image : image.convertToFormat(QImage::Format_Grayscale8);
+}
+
+void QGraphicsLiveWire::setMargin(int margin)
+{
+    _margin = qMax(1, margin);
+}
+
+bool QGraphicsLiveWire::isBusy() const
+{
+    return _watcher->isRunning() || _pending;
+}
+
+QPolygonF QGraphicsLiveWire::shortestPath(const QImage& image, const QPoint& seed, const QPoint& target, int margin)
+{
+    QImage gray = image.format() == QImage::Format_Grayscale8 ? image : image.convertToFormat(QImage::Format_Grayscale8);
+    if (gray.isNull()) {
+        return QPolygonF();
+    }
+    Search search;
+    search.image_key = 0;
+    return _run(&search, gray, _clamp(seed, gray.rect()), _clamp(target, gray.rect()), margin);
+}
+
+void QGraphicsLiveWire::setSeed(const QPoint& seed)
+{
+    _seed = _clamp(seed, _image.rect());
+    if (_watcher->isRunning()) {
+        _pending = true;
+    }
+}
+
+// paths over settled pixels are traced back at once
+void QGraphicsLiveWire::setTarget(const QPoint& target)
+{
+    if (_image.isNull()) {
+        return;
+    }
+    _target = _clamp(target, _image.rect());
+    if (_watcher->isRunning()) {
+        _pending = true;
+    }
+    else if (_ready(_target)) {
+        Q_EMIT pathReady(_search.path(_target));
+    }
+    else {
+        _start();
+    }
+}
+
+bool QGraphicsLiveWire::_ready(const QPoint& target) const
+{
+    return _search.image_key == _image.cacheKey() && _search.seed == _seed && _search.isSettled(target);
+}
+
+void QGraphicsLiveWire::_start()
+{
+    _pending = false;
+    _watcher->setFuture(QtConcurrent::run(&QGraphicsLiveWire::_run, &_search, _image, _seed, _target, _margin));
+}
+
+// the path of a replaced target is dropped, the search it extended is kept
+void QGraphicsLiveWire::onFinished()
+{
+    if (_pending) {
+        _pending = false;
+        setTarget(_target);
+        return;
+    }
+    Q_EMIT pathReady(_watcher->result());
+}
+
+// a target out of the largest window ends the path on its border, the
+// search starts again only when the window moves
+QPolygonF QGraphicsLiveWire::_run(Search* search, const QImage& image, const QPoint& seed, const QPoint& target,
+                                  int margin)
+{
+    bool same = search->image_key == image.cacheKey() && search->seed == seed;
+    if (!same || !search->contains(target)) {
+        QRect window = _window(image, *search, seed, target, margin);
+        if (!same || window != search->window) {
+            search->reset(image, seed, window);
+        }
+    }
+    QPoint end = _clamp(target, search->window);
+    search->extend(end);
+    return search->path(end);
+}
+
+// around seed and target, and half again the old window on each side when
+// the target left it, at most MAX_WINDOW_SIZE on a side with the seed kept
+// in and moved towards the target
+QRect QGraphicsLiveWire::_window(const QImage& image, const Search& search, const QPoint& seed,
+                                 const QPoint& target, int margin)
+{
+    QRect window = QRect(seed, seed).united(QRect(target, target)).adjusted(-margin, -margin, margin, margin);
+    if (search.image_key == image.cacheKey() && search.seed == seed && !search.window.isEmpty()) {
+        int dx = search.window.width() / 2;
+        int dy = search.window.height() / 2;
+        window = window.united(search.window.adjusted(-dx, -dy, dx, dy));
+    }
+    window &= image.rect();
+    int left = window.left();
+    int right = window.right();
+    int top = window.top();
+    int bottom = window.bottom();
+    margin = qMin(margin, MAX_WINDOW_SIZE / 4);
+    _cap(left, right, seed.x(), target.x(), margin, MAX_WINDOW_SIZE);
+    _cap(top, bottom, seed.y(), target.y(), margin, MAX_WINDOW_SIZE);
+    return QRect(QPoint(left, top), QPoint(right, bottom)) & image.rect();
+}
+
+// cost from 1 on the strongest edge of the window to 256 on flat areas, by
+// Sobel gradient
+void QGraphicsLiveWire::Search::reset(const QImage& image, const QPoint& seed, const QRect& window)
+{
+    this->image_key = image.cacheKey();
+    this->seed = seed;
+    this->window = window;
+    int width = window.width();
+    int height = window.height();
+    cost.resize(width * height);
+    int strongest = 1;
+    for (int y = 0; y < height; y++) {
+        int iy = window.top() + y;
+        const uchar* above = image.constScanLine(qMax(iy - 1, 0));
+        const uchar* row = image.constScanLine(iy);
+        const uchar* below = image.constScanLine(qMin(iy + 1, image.height() - 1));
+        ushort* costs = cost.data() + y * width;
+        for (int x = 0; x < width; x++) {
+            int ix = window.left() + x;
+            int left = qMax(ix - 1, 0);
+            int right = qMin(ix + 1, image.width() - 1);
+            int gx = (above[right] + 2 * row[right] + below[right]) - (above[left] + 2 * row[left] + below[left]);
+            int gy = (below[left] + 2 * below[ix] + below[right]) - (above[left] + 2 * above[ix] + above[right]);
+            costs[x] = ushort(qAbs(gx) + qAbs(gy));
+            strongest = qMax(strongest, int(costs[x]));
+        }
+    }
+    for (int i = 0; i < cost.size(); i++) {
+        cost[i] = ushort(1 + 255 * (strongest - cost[i]) / strongest);
+    }
+    distance.fill(-1, width * height);
+    parent.fill(-1, width * height);
+    settled.fill(0, width * height);
+    buckets.resize(STEP_BUCKETS);
+    for (int i = 0; i < buckets.size(); i++) {
+        buckets[i].clear();
+    }
+    int index = (seed.y() - window.top()) * width + (seed.x() - window.left());
+    distance[index] = 0;
+    buckets[0].append(index);
+    current = 0;
+    queued = 1;
+}
+
+bool QGraphicsLiveWire::Search::contains(const QPoint& pos) const
+{
+    return window.contains(pos);
+}
+
+bool QGraphicsLiveWire::Search::isSettled(const QPoint& pos) const
+{
+    if (!window.contains(pos)) {
+        return false;
+    }
+    return settled[(pos.y() - window.top()) * window.width() + (pos.x() - window.left())];
+}
+
+// nearest pixels are settled first, until the target is. a pixel reached
+// again with a shorter distance is queued again and the stale entry skipped
+void QGraphicsLiveWire::Search::extend(const QPoint& target)
+{
+    int width = window.width();
+    int height = window.height();
+    int goal = (target.y() - window.top()) * width + (target.x() - window.left());
+    while (!settled[goal] && queued > 0) {
+        QVector<int>& bucket = buckets[current % STEP_BUCKETS];
+        if (bucket.isEmpty()) {
+            current++;
+            continue;
+        }
+        int index = bucket.last();
+        bucket.removeLast();
+        queued--;
+        if (settled[index]) {
+            continue;
+        }
+        settled[index] = 1;
+        int x = index % width;
+        int y = index / width;
+        for (int k = 0; k < 8; k++) {
+            int nx = x + _step_x[k];
+            int ny = y + _step_y[k];
+            if (nx < 0 || ny < 0 || nx >= width || ny >= height) {
+                continue;
+            }
+            int next = ny * width + nx;
+            if (settled[next]) {
+                continue;
+            }
+            int d = distance[index] + cost[next] * _step_length[k];
+            if (distance[next] < 0 || d < distance[next]) {
+                distance[next] = d;
+                parent[next] = index;
+                buckets[d % STEP_BUCKETS].append(next);
+                queued++;
+            }
+        }
+    }
+}
+
+// back from target by parents, keeping the pixels where the step turns
+QPolygonF QGraphicsLiveWire::Search::path(const QPoint& target) const
+{
+    QPolygonF path;
+    if (!isSettled(target)) {
+        return path;
+    }
+    int width = window.width();
+    int index = (target.y() - window.top()) * width + (target.x() - window.left());
+    int last_step = 0;
+    while (index >= 0) {
+        int next = parent[index];
+        int step = next < 0 ? 0 : index - next;
+        if (path.isEmpty() || step != last_step) {
+            path.append(QPointF(window.left() + index % width + 0.5, window.top() + index / width + 0.5));
+        }
+        last_step = step;
+        index = next;
+    }
+    std::reverse(path.begin(), path.end());
+    return path;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <QObject>
+#include <QFutureWatcher>
+#include <QImage>
+#include <QPoint>
+#include <QRect>
+#include <QPolygonF>
+#include <QVector>
+
+/*!
+ * This class snaps the segment from a seed point to the cursor to edges of an
+ * image, as intelligent scissors, with the shortest path search on a worker
+ * thread.
+ *
+ * Stepping onto a pixel costs more where the gradient of the image is weaker,
+ * diagonal steps by sqrt(2), so the cheapest path from the seed follows edges.
+ * The search is Dijkstra from the seed, with reached pixels sorted in buckets
+ * of distance as steps cost small integers, limited to a window around the
+ * seed and the cursor, with costs computed for that window only. It is kept between
+ * cursor moves and only extended until the pixel under the cursor is settled,
+ * so a move over pixels already settled traces the path back at once without
+ * a search. The window grows by half on each side when the cursor leaves it,
+ * and the search starts again, so regrowing is rare. It is at most 1024
+ * pixels on a side, whatever the size of the image: past that it keeps the
+ * seed and moves towards the cursor, and a cursor out of it ends the path on
+ * its border.
+ *
+ * Only the latest cursor position is searched for, those given while a search
+ * is running are replaced.
+ *
+ * Usage:
+ *
+ *   QGraphicsLiveWire* wire = new QGraphicsLiveWire(view);
+ *   wire->setImage(image);
+ *   connect(wire, &QGraphicsLiveWire::pathReady, ...);
+ *   wire->setSeed(last_point);
+ *   // on mouse move
+ *   wire->setTarget(pos);
+ */
+class QGraphicsLiveWire : public QObject
+{
+    Q_OBJECT
+public:
+    QGraphicsLiveWire(QObject* parent = 0);
+    ~QGraphicsLiveWire();
+
+    void setImage(const QImage& image);
+
+    // pixels around seed and target searched at least, 64 by default
+    void setMargin(int margin);
+
+    // a search is running or waiting
+    bool isBusy() const;
+
+    // path from seed to target in image coords through pixel centers, on
+    // calling thread, to the border of the window for a farther target
+    static QPolygonF shortestPath(const QImage& image, const QPoint& seed, const QPoint& target, int margin = 64);
+
+public slots:
+    // start of paths in image coords, search starts again
+    void setSeed(const QPoint& seed);
+
+    // end of path in image coords, searched for on a worker thread unless
+    // already settled
+    void setTarget(const QPoint& target);
+
+signals:
+    // path from seed to target, turning points only
+    void pathReady(const QPolygonF& path);
+
+private slots:
+    void onFinished();
+
+private:
+    // state of a search, extended by one job at a time
+    struct Search
+    {
+        qint64 image_key;
+        QPoint seed;
+        QRect window; // in image coords
+        QVector<ushort> cost; // of stepping onto pixels of window
+        QVector<int> distance; // from seed, -1 until reached
+        QVector<int> parent; // index into window, -1 for seed
+        QVector<uchar> settled;
+        QVector<QVector<int> > buckets; // reached pixels by distance, circular
+        int current; // distance of the bucket popped from
+        int queued;
+
+        void reset(const QImage& image, const QPoint& seed, const QRect& window);
+        bool contains(const QPoint& pos) const;
+        bool isSettled(const QPoint& pos) const;
+        void extend(const QPoint& target);
+        QPolygonF path(const QPoint& target) const;
+    };
+
+    QImage _image; // gray
+    int _margin;
+    QPoint _seed;
+    QPoint _target;
+    Search _search;
+    QFutureWatcher<QPolygonF>* _watcher;
+    bool _pending;
+
+    void _start();
+    bool _ready(const QPoint& target) const;
+    static QPolygonF _run(Search* search, const QImage& image, const QPoint& seed, const QPoint& target, int margin);
+    static QRect _window(const QImage& image, const Search& search, const QPoint& seed, const QPoint& target,
+                         int margin);
+};
@@ -0,0 +1,280 @@
+#include "QGraphicsMagicWand.h"
+#include <QtConcurrent>
+#include <string.h>
+
+#define PARALLEL_FILL_PIXELS (256 * 1024)
+#define FILL_BAND_ROWS 128
+#define CANCEL_CHECK_SPANS 1024
+
+// rows of a fill on one thread, spans leaving them are passed up or down
+struct FillBand
+{
+    FillBand() : first(0), last(0), filled(0) {}
+    int first;
+    int last; // past the band
+    QVector<int> spans; // to scan, as y, left and right
+    QVector<int> up;
+    QVector<int> down;
+    QVector<int> runs; // filled, as y, begin and end
+    qint64 filled;
+};
+
+// scanline fill of the spans of a band, until none is left or limit pixels
+// are filled, -1 for no limit; stopped early once cancelled
+struct FillSpans
+{
+    typedef void result_type;
+    const uchar* image;
+    int stride;
+    int width;
+    int height;
+    QRgb color;
+    int tolerance;
+    uchar* filled;
+    const QAtomicInt* generation;
+    int current;
+    qint64 limit;
+
+    bool similar(const QRgb* row, int x) const
+    {
+        return qAbs(qRed(row[x]) - qRed(color)) <= tolerance &&
+               qAbs(qGreen(row[x]) - qGreen(color)) <= tolerance &&
+               qAbs(qBlue(row[x]) - qBlue(color)) <= tolerance;
+    }
+
+    void push(FillBand& band, int y, int left, int right) const
+    {
+        if (y < 0 || y >= height) {
+            return;
+        }
+        QVector<int>& spans = y < band.first ? band.up : (y >= band.last ? band.down : band.spans);
+        spans << y << left << right;
+    }
+
+    void operator()(FillBand& band) const
+    {
+        int count = 0;
+        while (!band.spans.isEmpty()) {
+            if (++count % CANCEL_CHECK_SPANS == 0 && generation && generation->load() != current) {
+                return;
+            }
+            if (limit >= 0 && band.filled >= limit) {
+                return;
+            }
+            int right = band.spans.takeLast();
+            int left = band.spans.takeLast();
+            int y = band.spans.takeLast();
+            const QRgb* row = reinterpret_cast<const QRgb*>(image + qint64(y) * stride);
+            uchar* marks = filled + qint64(y) * width;
+            int x = left;
+            while (x <= right) {
+                if (marks[x] || !similar(row, x)) {
+                    x++;
+                    continue;
+                }
+                int begin = x;
+                while (begin > 0 && !marks[begin - 1] && similar(row, begin - 1)) {
+                    begin--;
+                }
+                int end = x + 1;
+                while (end < width && !marks[end] && similar(row, end)) {
+                    end++;
+                }
+                memset(marks + begin, 1, end - begin);
+                band.runs << y << begin << end;
+                band.filled += end - begin;
+                push(band, y - 1, begin, end - 1);
+                push(band, y + 1, begin, end - 1);
+                x = end + 1;
+            }
+        }
+    }
+};
+
+QGraphicsMagicWand::QGraphicsMagicWand(QObject* parent)
+    : QObject(parent)
+    , _seed(-1, -1)
+    , _tolerance(0)
+    , _generation(0)
+    , _pending(false)
+{
+    _watcher = new QFutureWatcher<Result>(this);
+    connect(_watcher, SIGNAL(finished()), this, SLOT(onFinished()));
+}
+
+QGraphicsMagicWand::~QGraphicsMagicWand()
+{
+    // the running job reads the generation
+    _generation.ref();
+    _watcher->waitForFinished();
+}
+
+// marks of a running job are kept by it
+void QGraphicsMagicWand::setImage(const QImage& image)
+{
+    cancel();
+    if (image.format() == QImage::Format_RGB32 || image.format() == QImage::Format_ARGB32) {
+        _image = image;
+    }
+    else {
+        _image = image.convertToFormat(QImage::Format_RGB32);
+    }
+    _filled.clear();
+    _seed = QPoint(-1, -1);
+}
+
+bool QGraphicsMagicWand::isBusy() const
+{
+    return _watcher->isRunning() || _pending;
+}
+
+QGraphicsRLEMask QGraphicsMagicWand::fill(const QImage& image, const QPoint& seed, int tolerance)
+{
+    Job job;
+    job.image = image.format() == QImage::Format_RGB32 ? image : image.convertToFormat(QImage::Format_RGB32);
+    if (!job.image.rect().contains(seed)) {
+        return QGraphicsRLEMask();
+    }
+    job.filled.reset(new QVector<uchar>(job.image.width() * job.image.height(), 0));
+    job.color = job.image.pixel(seed);
+    job.seed = seed;
+    job.tolerance = tolerance;
+    job.generation = NULL;
+    job.current = 0;
+    return _run(job).region;
+}
+
+// a running request is cancelled and replaced when it returns
+void QGraphicsMagicWand::select(const QPoint& seed, int tolerance)
+{
+    if (!_image.rect().contains(seed)) {
+        cancel();
+        _seed = QPoint(-1, -1);
+        return;
+    }
+    _seed = seed;
+    _tolerance = qBound(0, tolerance, 255);
+    _generation.ref();
+    if (_watcher->isRunning()) {
+        _pending = true;
+    }
+    else {
+        _start();
+    }
+}
+
+void QGraphicsMagicWand::setTolerance(int tolerance)
+{
+    select(_seed, tolerance);
+}
+
+void QGraphicsMagicWand::cancel()
+{
+    _generation.ref();
+    _pending = false;
+}
+
+// one job at a time uses the marks
+void QGraphicsMagicWand::_start()
+{
+    _pending = false;
+    if (!_filled) {
+        _filled.reset(new QVector<uchar>(_image.width() * _image.height(), 0));
+    }
+    Job job;
+    job.image = _image;
+    job.filled = _filled;
+    job.color = _image.pixel(_seed);
+    job.seed = _seed;
+    job.tolerance = _tolerance;
+    job.generation = &_generation;
+    job.current = _generation.load();
+    _watcher->setFuture(QtConcurrent::run(&QGraphicsMagicWand::_run, job));
+}
+
+void QGraphicsMagicWand::onFinished()
+{
+    Result result = _watcher->result();
+    if (_pending) {
+        _start();
+        return;
+    }
+    if (!result.cancelled && result.generation == _generation.load()) {
+        Q_EMIT regionReady(_seed, _tolerance, result.region);
+    }
+}
+
+// on one thread while the region is small, then in bands of rows in rounds;
+// marks are cleared over filled runs, cancelled or not
+QGraphicsMagicWand::Result QGraphicsMagicWand::_run(const Job& job)
+{
+    Result result;
+    result.cancelled = false;
+    result.generation = job.current;
+
+    FillSpans fill;
+    fill.image = job.image.constBits();
+    fill.stride = job.image.bytesPerLine();
+    fill.width = job.image.width();
+    fill.height = job.image.height();
+    fill.color = job.color;
+    fill.tolerance = job.tolerance;
+    fill.filled = job.filled->data();
+    fill.generation = job.generation;
+    fill.current = job.current;
+    fill.limit = PARALLEL_FILL_PIXELS;
+
+    FillBand start;
+    start.last = fill.height;
+    start.spans << job.seed.y() << job.seed.x() << job.seed.x();
+    fill(start);
+
+    QVector<FillBand> bands;
+    bool cancelled = job.generation && job.generation->load() != job.current;
+    if (!start.spans.isEmpty() && !cancelled) {
+        fill.limit = -1;
+        bands.resize((fill.height + FILL_BAND_ROWS - 1) / FILL_BAND_ROWS);
+        for (int b = 0; b < bands.size(); b++) {
+            bands[b].first = b * FILL_BAND_ROWS;
+            bands[b].last = qMin(bands[b].first + FILL_BAND_ROWS, fill.height);
+        }
+        for (int k = 0; k < start.spans.size(); k += 3) {
+            bands[start.spans[k] / FILL_BAND_ROWS].spans << start.spans[k] << start.spans[k + 1]
+                                                         << start.spans[k + 2];
+        }
+        bool pending = true;
+        while (pending && !cancelled) {
+            QtConcurrent::blockingMap(bands, fill);
+            cancelled = job.generation && job.generation->load() != job.current;
+            pending = false;
+            for (int b = 0; b < bands.size(); b++) {
+                if (b > 0) {
+                    bands[b - 1].spans += bands[b].up;
+                }
+                if (b + 1 < bands.size()) {
+                    bands[b + 1].spans += bands[b].down;
+                }
+                bands[b].up.clear();
+                bands[b].down.clear();
+            }
+            for (int b = 0; b < bands.size(); b++) {
+                pending = pending || !bands[b].spans.isEmpty();
+            }
+        }
+    }
+
+    QVector<int> runs = start.runs;
+    for (int b = 0; b < bands.size(); b++) {
+        runs += bands[b].runs;
+    }
+    uchar* marks = job.filled->data();
+    for (int k = 0; k < runs.size(); k += 3) {
+        memset(marks + qint64(runs[k]) * fill.width + runs[k + 1], 0, runs[k + 2] - runs[k + 1]);
+    }
+    if (cancelled) {
+        result.cancelled = true;
+        return result;
+    }
+    result.region = QGraphicsRLEMask::fromRuns(runs);
+    return result;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <QObject>
+#include <QFutureWatcher>
+#include <QAtomicInt>
+#include <QImage>
+#include <QPoint>
+#include <QRgb>
+#include <QVector>
+#include <QSharedPointer>
+#include "QGraphicsRLEMask.h"
+
+/*!
+ * This class selects the region of similar pixels around a seed point of an
+ * image, on a worker thread.
+ *
+ * A pixel is similar when none of its channels differs from the seed color by
+ * more than the tolerance. The region is flood filled from the seed by scanline
+ * spans: a span of similar pixels is extended left and right, filled, and the
+ * rows above and below it are scanned for further spans. Only the pixels of the
+ * region and their neighbours are visited, whatever the size of the image.
+ * Filled pixels are marked in a byte buffer kept with the image, cleared again
+ * over the region after each fill.
+ *
+ * A fill starts on one thread. When its region grows over a number of pixels,
+ * the rest is filled in bands of rows in parallel, in rounds, spans leaving a
+ * band being passed to its neighbour for the next round.
+ *
+ * Requests are latest-wins. A new request cancels the running one between
+ * spans, and only the region of the latest request is emitted.
+ *
+ * Usage:
+ *
+ *   QGraphicsMagicWand* wand = new QGraphicsMagicWand(view);
+ *   wand->setImage(image);
+ *   connect(wand, &QGraphicsMagicWand::regionReady, ...);
+ *   wand->select(seed, 32);
+ *   // while dragging
+ *   wand->setTolerance(48);
+ */
+class QGraphicsMagicWand : public QObject
+{
+    Q_OBJECT
+public:
+    QGraphicsMagicWand(QObject* parent = 0);
+    ~QGraphicsMagicWand();
+
+    void setImage(const QImage& image);
+
+    // a request is running or waiting
+    bool isBusy() const;
+
+    // region of similar pixels around seed, on calling thread
+    static QGraphicsRLEMask fill(const QImage& image, const QPoint& seed, int tolerance);
+
+public slots:
+    // select around seed in image coords, with tolerance 0 to 255
+    void select(const QPoint& seed, int tolerance);
+
+    // select again around last seed
+    void setTolerance(int tolerance);
+
+    void cancel();
+
+signals:
+    void regionReady(const QPoint& seed, int tolerance, const QGraphicsRLEMask& region);
+
+private slots:
+    void onFinished();
+
+private:
+    struct Job
+    {
+        QImage image;
+        QSharedPointer<QVector<uchar> > filled; // marks, zero out of fills
+        QRgb color;
+        QPoint seed;
+        int tolerance;
+        const QAtomicInt* generation;
+        int current; // generation of the job
+    };
+
+    struct Result
+    {
+        bool cancelled;
+        int generation;
+        QGraphicsRLEMask region;
+    };
+
+    QImage _image;
+    QSharedPointer<QVector<uchar> > _filled;
+    QPoint _seed;
+    int _tolerance;
+    QAtomicInt _generation;
+    QFutureWatcher<Result>* _watcher;
+    bool _pending;
+
+    void _start();
+    static Result _run(const Job& job);
+};
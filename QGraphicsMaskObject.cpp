@@ -0,0 +1,225 @@
+#include "QGraphicsMaskObject.h"
+#include <QGraphicsScene>
+#include <QStyleOptionGraphicsItem>
+#include <QPainter>
+#include <QImage>
+#include <qmath.h>
+
+static quint64 _tile_key(const QPoint& tile)
+{
+    return (quint64(quint32(tile.x())) << 32) | quint32(tile.y());
+}
+
+QGraphicsMaskObject::QGraphicsMaskObject(QGraphicsItem* parent)
+    : QGraphicsObject(parent)
+    , _roi_id(-1)
+    , _color(255, 0, 0, 96)
+    , _bound_pen(QBrush(Qt::green), 1, Qt::DashLine)
+    , _quiet(false)
+{
+    setFlags(QGraphicsItem::ItemSendsGeometryChanges |
+             QGraphicsItem::ItemIsMovable |
+             QGraphicsItem::ItemIsSelectable |
+             QGraphicsItem::ItemUsesExtendedStyleOption);
+    _bound_pen.setCosmetic(true);
+}
+
+QGraphicsMaskObject::~QGraphicsMaskObject()
+{
+
+}
+
+void QGraphicsMaskObject::setShapeColor(const QColor& color)
+{
+    _color = color;
+    _pixmaps.clear();
+    update();
+}
+
+QColor QGraphicsMaskObject::shapeColor() const
+{
+    return _color;
+}
+
+// the tiles touched by the stroke are converted again and repainted, the
+// bound grows with new tiles and is fitted again when tiles are freed
+void QGraphicsMaskObject::paintStroke(const QPointF& from, const QPointF& to, qreal radius, bool erase)
+{
+    QVector<QPoint> touched;
+    _mask.stampSegment(mapFromScene(from), mapFromScene(to), radius, !erase, touched);
+    if (touched.isEmpty()) {
+        return;
+    }
+    QRectF changed;
+    bool freed = false;
+    foreach (const QPoint& tile, touched) {
+        QRectF rect = QGraphicsMaskTiles::tileRect(tile);
+        _pixmaps.remove(_tile_key(tile));
+        if (!_mask.tile(tile)) {
+            freed = true;
+        }
+        else if (!_bound.contains(rect)) {
+            prepareGeometryChange();
+            _bound |= rect;
+        }
+        changed |= rect;
+        update(rect);
+    }
+    if (freed) {
+        _fit_bound();
+    }
+    Q_EMIT maskChanged(mapRectToScene(changed));
+}
+
+const QGraphicsMaskTiles& QGraphicsMaskObject::mask() const
+{
+    return _mask;
+}
+
+void QGraphicsMaskObject::clear()
+{
+    _mask.clear();
+    _pixmaps.clear();
+    _fit_bound();
+    update();
+}
+
+QGraphicsRLEMask QGraphicsMaskObject::rleMask() const
+{
+    return QGraphicsRLEMask::fromTiles(_mask, pos().toPoint());
+}
+
+void QGraphicsMaskObject::setRleMask(const QGraphicsRLEMask& mask)
+{
+    _mask.clear();
+    mask.toTiles(_mask, -pos().toPoint());
+    _pixmaps.clear();
+    _fit_bound();
+    update();
+    Q_EMIT maskChanged(mapRectToScene(_bound));
+}
+
+// pixels are unit squares, the perimeter counts their sides between set and
+// unset pixels, all kept by the mask as spans are filled
+QGraphicsROIMetrics QGraphicsMaskObject::metrics() const
+{
+    QGraphicsROIMetrics metrics;
+    qint64 area = _mask.area();
+    metrics.area = area;
+    metrics.perimeter = _mask.perimeter();
+    metrics.bound = mapRectToScene(QRectF(_mask.boundingRect()));
+    metrics.centroid = area > 0 ? mapToScene(_mask.moment() / area + QPointF(0.5, 0.5)) : metrics.bound.center();
+    return metrics;
+}
+
+void QGraphicsMaskObject::setRoiId(qint64 id)
+{
+    _roi_id = id;
+}
+
+qint64 QGraphicsMaskObject::roiId() const
+{
+    return _roi_id;
+}
+
+// translations move the item, scales resample the pixels of the mask in
+// scene coords, both quietly for group edits of many items
+void QGraphicsMaskObject::transformShape(const QTransform& transform)
+{
+    if (transform.type() > QTransform::TxScale) {
+        return;
+    }
+    if (transform.type() <= QTransform::TxTranslate) {
+        _quiet = true;
+        setPos(pos() + QPointF(transform.dx(), transform.dy()));
+        _quiet = false;
+        return;
+    }
+    QGraphicsRLEMask mask = rleMask().scaled(transform);
+    _mask.clear();
+    mask.toTiles(_mask, -pos().toPoint());
+    _pixmaps.clear();
+    _fit_bound();
+    update();
+}
+
+QRectF QGraphicsMaskObject::boundingRect() const
+{
+    return _bound;
+}
+
+// only tiles in the exposed area are drawn
+void QGraphicsMaskObject::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget*)
+{
+    QRectF exposed = option->exposedRect;
+    int tx0 = qFloor(exposed.left() / MASK_TILE_SIZE);
+    int tx1 = qFloor(exposed.right() / MASK_TILE_SIZE);
+    int ty0 = qFloor(exposed.top() / MASK_TILE_SIZE);
+    int ty1 = qFloor(exposed.bottom() / MASK_TILE_SIZE);
+    if (qint64(tx1 - tx0 + 1) * (ty1 - ty0 + 1) > _mask.tileCount()) {
+        // fewer tiles than cells exposed
+        foreach (const QPoint& tile, _mask.tiles()) {
+            QRect rect = QGraphicsMaskTiles::tileRect(tile);
+            if (exposed.intersects(rect)) {
+                painter->drawPixmap(rect.topLeft(), _tile_pixmap(tile));
+            }
+        }
+    }
+    else {
+        for (int ty = ty0; ty <= ty1; ty++) {
+            for (int tx = tx0; tx <= tx1; tx++) {
+                QPoint tile(tx, ty);
+                if (_mask.tile(tile)) {
+                    painter->drawPixmap(QGraphicsMaskTiles::tileRect(tile).topLeft(), _tile_pixmap(tile));
+                }
+            }
+        }
+    }
+    if (isSelected()) {
+        painter->setPen(_bound_pen);
+        painter->setBrush(Qt::NoBrush);
+        painter->drawRect(_bound);
+    }
+}
+
+// tile pixels index a color table of transparent and the shape color
+QPixmap QGraphicsMaskObject::_tile_pixmap(const QPoint& tile)
+{
+    quint64 key = _tile_key(tile);
+    QHash<quint64, QPixmap>::const_iterator it = _pixmaps.constFind(key);
+    if (it != _pixmaps.constEnd()) {
+        return it.value();
+    }
+    QImage image(_mask.tile(tile), MASK_TILE_SIZE, MASK_TILE_SIZE, MASK_TILE_SIZE, QImage::Format_Indexed8);
+    QVector<QRgb> colors;
+    colors << qRgba(0, 0, 0, 0) << _color.rgba();
+    image.setColorTable(colors);
+    QPixmap pixmap = QPixmap::fromImage(image);
+    _pixmaps.insert(key, pixmap);
+    return pixmap;
+}
+
+void QGraphicsMaskObject::_fit_bound()
+{
+    prepareGeometryChange();
+    _bound = QRectF();
+    foreach (const QPoint& tile, _mask.tiles()) {
+        _bound |= QGraphicsMaskTiles::tileRect(tile);
+    }
+}
+
+// hook item changing
+QVariant QGraphicsMaskObject::itemChange(GraphicsItemChange change, const QVariant &value)
+{
+    if (change == QGraphicsItem::ItemPositionHasChanged && !_quiet) {
+        Q_EMIT maskChanged(mapRectToScene(_bound));
+    }
+
+    if (change == QGraphicsItem::ItemSelectedHasChanged) {
+        // move to front when selected
+        bool selected = value.toBool();
+        setZValue(selected ? 1 : 0);
+        Q_EMIT selectedChanged(selected);
+    }
+    return QGraphicsItem::itemChange(change, value);
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <QGraphicsObject>
+#include <QHash>
+#include <QPixmap>
+#include <QPen>
+#include <QColor>
+#include "QGraphicsMaskTiles.h"
+#include "QGraphicsRLEMask.h"
+#include "QGraphicsROIMetrics.h"
+
+/*!
+ * This class is a ROI painted with a brush, kept as a mask of pixels in sparse
+ * tiles of QGraphicsMaskTiles, in item coords.
+ *
+ * A stroke is stamped with paintStroke() from the previous mouse position to
+ * the current one, and only the tiles it touched are converted for display
+ * again and repainted. Tiles are drawn as cached pixmaps, only those in the
+ * exposed area.
+ *
+ * Usage:
+ *
+ *   QGraphicsMaskObject* item = new QGraphicsMaskObject();
+ *   scene->addItem(item);
+ *   // on mouse move with button down, in scene coords
+ *   item->paintStroke(last_pos, pos, radius);
+ */
+class QGraphicsMaskObject : public QGraphicsObject
+{
+    Q_OBJECT
+public:
+    QGraphicsMaskObject(QGraphicsItem* parent = 0);
+    ~QGraphicsMaskObject();
+
+    // set color of painted pixels, drawn with its alpha
+    void setShapeColor(const QColor& color);
+    QColor shapeColor() const;
+
+    // stamp a brush of given radius along segment in scene coords, erase
+    // clears pixels instead of setting them
+    void paintStroke(const QPointF& from, const QPointF& to, qreal radius, bool erase = false);
+
+    // mask in item coords, pixel (x, y) at scene (x, y) + pos()
+    const QGraphicsMaskTiles& mask() const;
+    void clear();
+
+    // mask as runs in scene coords, for storage and export, pos() rounded
+    QGraphicsRLEMask rleMask() const;
+    void setRleMask(const QGraphicsRLEMask& mask);
+
+    // area, perimeter, centroid and bound in scene coords, kept by the mask
+    // as strokes are stamped
+    QGraphicsROIMetrics metrics() const;
+
+    // identifier of the ROI, -1 by default
+    void setRoiId(qint64 id);
+    qint64 roiId() const;
+
+    // translate or scale mask in scene coords in place, without notifying,
+    // pixels are resampled to nearest when scaled, rotation and shear are
+    // ignored
+    void transformShape(const QTransform& transform);
+
+signals:
+    // pixels changed in given rect in scene coords
+    void maskChanged(const QRectF& rect);
+
+    // item is selected or deselected
+    void selectedChanged(bool);
+
+protected:
+    QRectF boundingRect() const;
+    void paint(QPainter*, const QStyleOptionGraphicsItem*, QWidget*);
+
+    // hook item changing, move to front when selected
+    QVariant itemChange(GraphicsItemChange change, const QVariant &value);
+
+    void _fit_bound();
+    QPixmap _tile_pixmap(const QPoint& tile);
+
+protected:
+    qint64 _roi_id;
+    QGraphicsMaskTiles _mask;
+    QHash<quint64, QPixmap> _pixmaps; // display of tiles
+    QRectF _bound; // union of tiles
+    QColor _color;
+    QPen _bound_pen;
+    bool _quiet; // no notification of position changes
+};
@@ -0,0 +1,319 @@
+#include "QGraphicsMaskTiles.h"
+#include <qmath.h>
+#include <algorithm>
+#include <string.h>
+
+#define TILE_PIXELS (MASK_TILE_SIZE * MASK_TILE_SIZE)
+
+static const uchar _zero_row[MASK_TILE_SIZE] = { 0 };
+
+static quint64 _tile_key(int tx, int ty)
+{
+    return (quint64(quint32(tx)) << 32) | quint32(ty);
+}
+
+static QPoint _key_tile(quint64 key)
+{
+    return QPoint(int(quint32(key >> 32)), int(quint32(key)));
+}
+
+static bool _tile_less(const QPoint& a, const QPoint& b)
+{
+    return _tile_key(a.x(), a.y()) < _tile_key(b.x(), b.y());
+}
+
+// tile of a pixel coord, rounding down for negative coords too
+static int _tile_of(int v)
+{
+    return v >= 0 ? v / MASK_TILE_SIZE : -((-v - 1) / MASK_TILE_SIZE) - 1;
+}
+
+// values of x where a * x + b is in [lo, hi], false if none
+static bool _solve(qreal a, qreal b, qreal lo, qreal hi, qreal& x0, qreal& x1)
+{
+    if (a == 0) {
+        x0 = -1e300;
+        x1 = 1e300;
+        return lo <= b && b <= hi;
+    }
+    x0 = (lo - b) / a;
+    x1 = (hi - b) / a;
+    if (x0 > x1) {
+        std::swap(x0, x1);
+    }
+    return true;
+}
+
+QGraphicsMaskTiles::QGraphicsMaskTiles()
+    : _area(0)
+    , _sum_x(0)
+    , _sum_y(0)
+    , _edges(0)
+    , _bound_valid(true)
+{
+
+}
+
+// the capsule is convex, so its span on a row is the hull of the spans of
+// the two end discs and of the band between them
+void QGraphicsMaskTiles::stampSegment(const QPointF& p0, const QPointF& p1, qreal radius, bool value,
+                                      QVector<QPoint>& touched)
+{
+    if (radius <= 0) {
+        return;
+    }
+    QVector<QPoint> changed;
+    QPointF d = p1 - p0;
+    qreal length2 = d.x() * d.x() + d.y() * d.y();
+    qreal length = qSqrt(length2);
+    int y0 = qCeil(qMin(p0.y(), p1.y()) - radius - 0.5);
+    int y1 = qFloor(qMax(p0.y(), p1.y()) + radius - 0.5);
+    for (int y = y0; y <= y1; y++) {
+        // pixels are hit at their center
+        qreal yc = y + 0.5;
+        qreal lo = 1e300;
+        qreal hi = -1e300;
+        const QPointF* ends[2] = { &p0, &p1 };
+        for (int k = 0; k < 2; k++) {
+            qreal dy = yc - ends[k]->y();
+            if (qAbs(dy) <= radius) {
+                qreal w = qSqrt(radius * radius - dy * dy);
+                lo = qMin(lo, ends[k]->x() - w);
+                hi = qMax(hi, ends[k]->x() + w);
+            }
+        }
+        if (length2 > 0) {
+            // 0 <= (q - p0) . d <= |d|^2 and |(q - p0) x d| <= r |d|
+            qreal a0, a1, b0, b1;
+            qreal ry = yc - p0.y();
+            if (_solve(d.x(), ry * d.y() - p0.x() * d.x(), 0, length2, a0, a1) &&
+                _solve(d.y(), -ry * d.x() - p0.x() * d.y(), -radius * length, radius * length, b0, b1)) {
+                qreal l = qMax(a0, b0);
+                qreal h = qMin(a1, b1);
+                if (l <= h) {
+                    lo = qMin(lo, l);
+                    hi = qMax(hi, h);
+                }
+            }
+        }
+        if (lo > hi) {
+            continue;
+        }
+        int x0 = qCeil(lo - 0.5);
+        int x1 = qFloor(hi - 0.5);
+        if (x0 <= x1) {
+            fillSpan(y, x0, x1, value, changed);
+        }
+    }
+
+    std::sort(changed.begin(), changed.end(), _tile_less);
+    changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+    if (!value) {
+        _drop_empty(changed);
+    }
+    touched += changed;
+}
+
+// one memset per tile crossed by the span, tiles are only allocated to set
+// pixels; touched may repeat tiles of earlier spans. Sides of the span, to its
+// ends and to the rows above and below, are counted before and after the fill,
+// pixels around it are left as they are
+void QGraphicsMaskTiles::fillSpan(int y, int x0, int x1, bool value, QVector<QPoint>& touched)
+{
+    int v = value ? 1 : 0;
+    int ty = _tile_of(y);
+    int row = (y - ty * MASK_TILE_SIZE) * MASK_TILE_SIZE;
+    int tx0 = _tile_of(x0);
+    int tx1 = _tile_of(x1);
+    int prev = pixel(x0 - 1, y);
+    int next = pixel(x1 + 1, y);
+    qint64 edges_before = 0;
+    qint64 edges_after = (prev != v) + (next != v);
+    qint64 changed = 0;
+    qint64 changed_x = 0;
+    for (int tx = tx0; tx <= tx1; tx++) {
+        uchar* pixels = _tile(tx, ty, value);
+        int left = qMax(x0, tx * MASK_TILE_SIZE) - tx * MASK_TILE_SIZE;
+        int right = qMin(x1, tx * MASK_TILE_SIZE + MASK_TILE_SIZE - 1) - tx * MASK_TILE_SIZE;
+        const uchar* old = pixels ? pixels + row : _zero_row;
+        const uchar* up = _row(tx, y - 1);
+        const uchar* down = _row(tx, y + 1);
+        for (int i = left; i <= right; i++) {
+            int o = old[i];
+            edges_before += (prev != o) + (up[i] != o) + (down[i] != o);
+            edges_after += (up[i] != v) + (down[i] != v);
+            if (o != v) {
+                changed++;
+                changed_x += tx * MASK_TILE_SIZE + i;
+            }
+            prev = o;
+        }
+        if (!pixels) {
+            continue;
+        }
+        memset(pixels + row + left, v, right - left + 1);
+        if (touched.isEmpty() || touched.last() != QPoint(tx, ty)) {
+            touched.append(QPoint(tx, ty));
+        }
+    }
+    edges_before += (prev != next);
+    if (!changed) {
+        return;
+    }
+    qint64 sign = value ? 1 : -1;
+    _area += sign * changed;
+    _sum_x += sign * changed_x;
+    _sum_y += sign * changed * y;
+    _edges += edges_after - edges_before;
+    if (!_bound_valid) {
+        return;
+    }
+    if (value) {
+        _bound |= QRect(x0, y, x1 - x0 + 1, 1);
+    }
+    else if (x0 <= _bound.left() || x1 >= _bound.right() || y == _bound.top() || y == _bound.bottom()) {
+        _bound_valid = false;
+    }
+}
+
+bool QGraphicsMaskTiles::pixel(int x, int y) const
+{
+    int tx = _tile_of(x);
+    int ty = _tile_of(y);
+    Tiles::const_iterator it = _tiles.constFind(_tile_key(tx, ty));
+    if (it == _tiles.constEnd()) {
+        return false;
+    }
+    return it.value()[(y - ty * MASK_TILE_SIZE) * MASK_TILE_SIZE + x - tx * MASK_TILE_SIZE];
+}
+
+const uchar* QGraphicsMaskTiles::tile(const QPoint& tile) const
+{
+    Tiles::const_iterator it = _tiles.constFind(_tile_key(tile.x(), tile.y()));
+    return it == _tiles.constEnd() ? NULL : it.value().constData();
+}
+
+QList<QPoint> QGraphicsMaskTiles::tiles() const
+{
+    QList<QPoint> tiles;
+    Tiles::const_iterator it;
+    for (it = _tiles.constBegin(); it != _tiles.constEnd(); ++it) {
+        tiles.append(_key_tile(it.key()));
+    }
+    return tiles;
+}
+
+int QGraphicsMaskTiles::tileCount() const
+{
+    return _tiles.size();
+}
+
+QRect QGraphicsMaskTiles::tileRect(const QPoint& tile)
+{
+    return QRect(tile.x() * MASK_TILE_SIZE, tile.y() * MASK_TILE_SIZE, MASK_TILE_SIZE, MASK_TILE_SIZE);
+}
+
+bool QGraphicsMaskTiles::isEmpty() const
+{
+    return _tiles.isEmpty();
+}
+
+void QGraphicsMaskTiles::clear()
+{
+    _tiles.clear();
+    _area = 0;
+    _sum_x = 0;
+    _sum_y = 0;
+    _edges = 0;
+    _bound = QRect();
+    _bound_valid = true;
+}
+
+QRect QGraphicsMaskTiles::boundingRect() const
+{
+    if (!_bound_valid) {
+        _bound = _fit_bound();
+        _bound_valid = true;
+    }
+    return _bound;
+}
+
+qint64 QGraphicsMaskTiles::area() const
+{
+    return _area;
+}
+
+QPointF QGraphicsMaskTiles::moment() const
+{
+    return QPointF(_sum_x, _sum_y);
+}
+
+qint64 QGraphicsMaskTiles::perimeter() const
+{
+    return _edges;
+}
+
+uchar* QGraphicsMaskTiles::_tile(int tx, int ty, bool allocate)
+{
+    quint64 key = _tile_key(tx, ty);
+    Tiles::iterator it = _tiles.find(key);
+    if (it == _tiles.end()) {
+        if (!allocate) {
+            return NULL;
+        }
+        it = _tiles.insert(key, QVector<uchar>(TILE_PIXELS, 0));
+    }
+    return it.value().data();
+}
+
+void QGraphicsMaskTiles::_drop_empty(const QVector<QPoint>& tiles)
+{
+    foreach (const QPoint& tile, tiles) {
+        Tiles::iterator it = _tiles.find(_tile_key(tile.x(), tile.y()));
+        if (it != _tiles.end() && !memchr(it.value().constData(), 1, TILE_PIXELS)) {
+            _tiles.erase(it);
+        }
+    }
+}
+
+// row y of tile column tx, zeros when the tile is not allocated
+const uchar* QGraphicsMaskTiles::_row(int tx, int y) const
+{
+    int ty = _tile_of(y);
+    Tiles::const_iterator it = _tiles.constFind(_tile_key(tx, ty));
+    if (it == _tiles.constEnd()) {
+        return _zero_row;
+    }
+    return it.value().constData() + (y - ty * MASK_TILE_SIZE) * MASK_TILE_SIZE;
+}
+
+// exact bound, scanned from the tiles
+QRect QGraphicsMaskTiles::_fit_bound() const
+{
+    QRect bound;
+    Tiles::const_iterator it;
+    for (it = _tiles.constBegin(); it != _tiles.constEnd(); ++it) {
+        QRect rect = tileRect(_key_tile(it.key()));
+        const uchar* pixels = it.value().constData();
+        int left = MASK_TILE_SIZE, right = -1, top = MASK_TILE_SIZE, bottom = -1;
+        for (int y = 0; y < MASK_TILE_SIZE; y++) {
+            const uchar* row = pixels + y * MASK_TILE_SIZE;
+            const uchar* first = (const uchar*)memchr(row, 1, MASK_TILE_SIZE);
+            if (!first) {
+                continue;
+            }
+            int last = MASK_TILE_SIZE - 1;
+            while (!row[last]) {
+                last--;
+            }
+            left = qMin(left, int(first - row));
+            right = qMax(right, last);
+            top = qMin(top, y);
+            bottom = y;
+        }
+        if (right >= 0) {
+            bound |= QRect(rect.left() + left, rect.top() + top, right - left + 1, bottom - top + 1);
+        }
+    }
+    return bound;
+}
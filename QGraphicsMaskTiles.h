@@ -0,0 +1,83 @@
+#pragma once
+
+#include <QHash>
+#include <QVector>
+#include <QPoint>
+#include <QPointF>
+#include <QRect>
+
+#define MASK_TILE_SIZE 64
+
+/*!
+ * Binary mask of pixels, kept as sparse square tiles of MASK_TILE_SIZE pixels.
+ *
+ * A tile is allocated when a pixel in it is set, and freed when its last pixel
+ * is cleared, so the memory follows the painted area and not the image size.
+ * Pixels are bytes, 0 or 1, row by row in each tile. Tile (tx, ty) covers the
+ * pixels from (tx, ty) * MASK_TILE_SIZE, negative coords included.
+ *
+ * Brush strokes are stamped as capsules, discs swept along a segment. The span
+ * of the capsule on each pixel row is solved directly and filled with one
+ * memset per tile, so a stroke costs its rows and not its pixels, and
+ * overlapping stamps of a dense stroke are never filled twice.
+ *
+ * Area, first moments and perimeter are updated by each span, from its pixels
+ * before the fill and their neighbours in the rows above and below, so they
+ * cost the stroke and not the mask. The bound grows with filled spans, and is
+ * only found again from the tiles after a span on it is cleared.
+ *
+ * Usage:
+ *
+ *   QGraphicsMaskTiles mask;
+ *   QVector<QPoint> touched;
+ *   mask.stampSegment(from, to, radius, true, touched);
+ *   foreach (const QPoint& tile, touched) { ... mask.tile(tile) ... }
+ */
+class QGraphicsMaskTiles
+{
+public:
+    QGraphicsMaskTiles();
+
+    // set, or clear, pixels whose center is within radius of the segment,
+    // coords of tiles changed are appended to touched
+    void stampSegment(const QPointF& p0, const QPointF& p1, qreal radius, bool value,
+                      QVector<QPoint>& touched);
+
+    // set or clear one row span of pixels [x0, x1]
+    void fillSpan(int y, int x0, int x1, bool value, QVector<QPoint>& touched);
+
+    bool pixel(int x, int y) const;
+
+    // pixels of a tile, NULL when nothing is set in it
+    const uchar* tile(const QPoint& tile) const;
+    QList<QPoint> tiles() const;
+    int tileCount() const;
+    static QRect tileRect(const QPoint& tile);
+
+    bool isEmpty() const;
+    void clear();
+
+    // exact bound and number of set pixels, kept as spans are filled
+    QRect boundingRect() const;
+    qint64 area() const;
+    // sums of x and of y of set pixels, and number of sides between set and
+    // unset pixels, kept as spans are filled
+    QPointF moment() const;
+    qint64 perimeter() const;
+
+private:
+    typedef QHash<quint64, QVector<uchar> > Tiles;
+
+    Tiles _tiles;
+    qint64 _area;
+    qint64 _sum_x;
+    qint64 _sum_y;
+    qint64 _edges;
+    mutable QRect _bound;
+    mutable bool _bound_valid;
+
+    uchar* _tile(int tx, int ty, bool allocate);
+    const uchar* _row(int tx, int y) const;
+    QRect _fit_bound() const;
+    void _drop_empty(const QVector<QPoint>& tiles);
+};
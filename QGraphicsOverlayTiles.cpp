@@ -0,0 +1,461 @@
+#include "QGraphicsOverlayTiles.h"
+#include <QtConcurrent>
+#include <QPainter>
+#include <QStyleOptionGraphicsItem>
+#include <qmath.h>
+#include <cassert>
+
+#define OVERLAY_PROPERTY "overlay_tiles"
+#define DEFAULT_TILE_SIZE 256
+#define MAX_CACHED_TILES 512
+#define SCALE_SETTLE_DELAY 120
+// over the background and unselected items, below selected ones
+#define LAYER_Z_VALUE 0.5
+
+static quint64 _tile_key(int tx, int ty)
+{
+    return (quint64(quint32(tx)) << 32) | quint32(ty);
+}
+
+// of the view, also when rotated, as m11 is the scale times the cosine
+static qreal _view_zoom(const QGraphicsView* view)
+{
+    return qSqrt(qAbs(view->transform().determinant()));
+}
+
+QGraphicsOverlayTiles::Layer::Layer(QGraphicsOverlayTiles* overlay)
+    : _overlay(overlay)
+{
+    setFlags(QGraphicsItem::ItemUsesExtendedStyleOption);
+    setAcceptedMouseButtons(Qt::NoButton);
+    setZValue(LAYER_Z_VALUE);
+}
+
+void QGraphicsOverlayTiles::Layer::setRect(const QRectF& rect)
+{
+    prepareGeometryChange();
+    _rect = rect;
+}
+
+QRectF QGraphicsOverlayTiles::Layer::boundingRect() const
+{
+    return _rect;
+}
+
+// empty, so hit tests and rubber bands pass through
+QPainterPath QGraphicsOverlayTiles::Layer::shape() const
+{
+    return QPainterPath();
+}
+
+void QGraphicsOverlayTiles::Layer::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget*)
+{
+    _overlay->paint(painter, option->exposedRect);
+}
+
+QGraphicsOverlayTiles::QGraphicsOverlayTiles(QGraphicsView* view)
+    : QObject(view)
+    , _view(view)
+    , _scene(view->scene())
+    , _layer(new Layer(this))
+    , _tile_size(DEFAULT_TILE_SIZE)
+    , _scale(_view_zoom(view))
+    , _view_scale(_scale)
+    , _old_scale(_scale)
+    , _level(new QAtomicInt(0))
+{
+    assert(_scene);
+    _settle_timer.setSingleShot(true);
+    _settle_timer.setInterval(SCALE_SETTLE_DELAY);
+    connect(&_settle_timer, SIGNAL(timeout()), this, SLOT(onScaleSettled()));
+    _scene->setProperty(OVERLAY_PROPERTY, true);
+    connect(_scene, SIGNAL(selectionChanged()), this, SLOT(onSelectionChanged()));
+    connect(_scene, SIGNAL(sceneRectChanged(const QRectF&)), this, SLOT(onSceneRectChanged(const QRectF&)));
+    _layer->setRect(_scene->sceneRect());
+    _scene->addItem(_layer);
+    onSelectionChanged();
+}
+
+QGraphicsOverlayTiles::~QGraphicsOverlayTiles()
+{
+    // pending renderings hold copies of their input, and are skipped
+    _level->ref();
+    if (_scene) {
+        _scene->setProperty(OVERLAY_PROPERTY, false);
+        delete _layer;
+    }
+}
+
+void QGraphicsOverlayTiles::setTileSize(int size)
+{
+    _tile_size = size;
+    _reset_tiles();
+}
+
+bool QGraphicsOverlayTiles::isActive(const QGraphicsScene* scene)
+{
+    return scene && scene->property(OVERLAY_PROPERTY).toBool();
+}
+
+void QGraphicsOverlayTiles::setShape(QGraphicsItem* item, const QGraphicsROIShape& shape, const QPen& pen)
+{
+    Entry& entry = _entries[item];
+    QRectF dirty = entry.shape.translated(item->pos() - entry.pos).boundingRect();
+    entry.shape = shape;
+    entry.pen = pen;
+    entry.pos = item->pos();
+    if (!_live.contains(item)) {
+        invalidate(dirty | shape.boundingRect());
+    }
+}
+
+void QGraphicsOverlayTiles::removeShape(QGraphicsItem* item)
+{
+    if (_entries.remove(item) && !_live.remove(item)) {
+        invalidate(item->sceneBoundingRect());
+    }
+}
+
+void QGraphicsOverlayTiles::clear()
+{
+    _entries.clear();
+    _live.clear();
+    _reset_tiles();
+}
+
+// selected items are painted by themselves
+void QGraphicsOverlayTiles::onSelectionChanged()
+{
+    QSet<QGraphicsItem*> live;
+    foreach (QGraphicsItem* item, _scene->selectedItems()) {
+        if (_entries.contains(item)) {
+            live.insert(item);
+        }
+    }
+    foreach (QGraphicsItem* item, live) {
+        if (!_live.contains(item)) {
+            invalidate(item->sceneBoundingRect());
+        }
+    }
+    foreach (QGraphicsItem* item, _live) {
+        if (!live.contains(item) && _entries.contains(item)) {
+            invalidate(item->sceneBoundingRect());
+        }
+    }
+    _live = live;
+}
+
+void QGraphicsOverlayTiles::setSelection(QGraphicsROISelection* selection)
+{
+    disconnect(_scene, SIGNAL(selectionChanged()), this, SLOT(onSelectionChanged()));
+    connect(selection, &QGraphicsROISelection::selectionChanged,
+            this, &QGraphicsOverlayTiles::onSelectionDelta);
+}
+
+// changes of selection, linear in the number of changed items
+void QGraphicsOverlayTiles::onSelectionDelta(const QList<QGraphicsItem*>& added, const QList<QGraphicsItem*>& removed)
+{
+    foreach (QGraphicsItem* item, added) {
+        if (_entries.contains(item) && !_live.contains(item)) {
+            _live.insert(item);
+            invalidate(item->sceneBoundingRect());
+        }
+    }
+    foreach (QGraphicsItem* item, removed) {
+        if (_live.remove(item)) {
+            invalidate(item->sceneBoundingRect());
+        }
+    }
+}
+
+QRectF QGraphicsOverlayTiles::_tile_rect(int tx, int ty) const
+{
+    qreal size = _tile_size / _scale;
+    return QRectF(tx * size, ty * size, size, size);
+}
+
+QRectF QGraphicsOverlayTiles::_tile_rect(quint64 key, qreal scale) const
+{
+    qreal size = _tile_size / scale;
+    return QRectF(int(qint32(key >> 32)) * size, int(qint32(key & 0xffffffff)) * size, size, size);
+}
+
+void QGraphicsOverlayTiles::invalidate(const QRectF& rect)
+{
+    if (rect.isNull()) {
+        return;
+    }
+    // one device pixel of margin for the pen
+    qreal margin = 2 / _scale;
+    QRectF dirty = rect.adjusted(-margin, -margin, margin, margin);
+    QHash<quint64, Tile>::iterator it;
+    for (it = _tiles.begin(); it != _tiles.end(); ++it) {
+        int tx = int(qint32(it.key() >> 32));
+        int ty = int(qint32(it.key() & 0xffffffff));
+        if (_tile_rect(tx, ty).intersects(dirty)) {
+            it->valid = false;
+            it->generation++;
+        }
+    }
+    // former level is not rendered again, its stale tiles are dropped
+    QHash<quint64, Tile>::iterator old = _old_tiles.begin();
+    while (old != _old_tiles.end()) {
+        if (_tile_rect(old.key(), _old_scale).intersects(dirty)) {
+            old = _old_tiles.erase(old);
+        }
+        else {
+            ++old;
+        }
+    }
+    _view->viewport()->update(_view->mapFromScene(dirty).boundingRect());
+}
+
+void QGraphicsOverlayTiles::paint(QPainter* painter, const QRectF& rect)
+{
+    qreal scale = _view_zoom(_view);
+    if (scale != _view_scale) {
+        _view_scale = scale;
+        if (scale == _scale) {
+            _settle_timer.stop();
+        }
+        else {
+            _settle_timer.start();
+        }
+    }
+    // zooming, cached tiles drawn scaled and none rendered
+    if (_settle_timer.isActive()) {
+        for (QHash<quint64, Tile>::const_iterator it = _tiles.constBegin(); it != _tiles.constEnd(); ++it) {
+            QRectF tile_rect = _tile_rect(it.key(), _scale);
+            if (!it->image.isNull() && tile_rect.intersects(rect)) {
+                painter->drawImage(tile_rect, it->image);
+            }
+        }
+        return;
+    }
+    int x0 = int(qFloor(rect.left() * _scale / _tile_size));
+    int x1 = int(qFloor(rect.right() * _scale / _tile_size));
+    int y0 = int(qFloor(rect.top() * _scale / _tile_size));
+    int y1 = int(qFloor(rect.bottom() * _scale / _tile_size));
+    for (int ty = y0; ty <= y1; ty++) {
+        for (int tx = x0; tx <= x1; tx++) {
+            quint64 key = _tile_key(tx, ty);
+            QHash<quint64, Tile>::iterator it = _tiles.find(key);
+            if (it == _tiles.end() || !it->valid) {
+                _request_tile(key, tx, ty);
+                it = _tiles.find(key);
+            }
+            // stale image is drawn until the new one is ready, or the
+            // former level when there is none
+            if (!it->image.isNull()) {
+                painter->drawImage(_tile_rect(tx, ty), it->image);
+            }
+            else if (!_old_tiles.isEmpty()) {
+                _draw_old_tiles(painter, _tile_rect(tx, ty) & rect);
+            }
+        }
+    }
+    _evict_tiles();
+}
+
+// parts of tiles of the former level in rect, scaled to this level
+void QGraphicsOverlayTiles::_draw_old_tiles(QPainter* painter, const QRectF& rect)
+{
+    qreal size = _tile_size / _old_scale;
+    int x0 = int(qFloor(rect.left() / size));
+    int x1 = int(qFloor(rect.right() / size));
+    int y0 = int(qFloor(rect.top() / size));
+    int y1 = int(qFloor(rect.bottom() / size));
+    for (int ty = y0; ty <= y1; ty++) {
+        for (int tx = x0; tx <= x1; tx++) {
+            QHash<quint64, Tile>::const_iterator it = _old_tiles.constFind(_tile_key(tx, ty));
+            if (it == _old_tiles.constEnd() || it->image.isNull()) {
+                continue;
+            }
+            QRectF tile_rect(tx * size, ty * size, size, size);
+            QRectF target = tile_rect & rect;
+            QRectF source((target.topLeft() - tile_rect.topLeft()) * _old_scale, target.size() * _old_scale);
+            painter->drawImage(target, it->image, source);
+        }
+    }
+}
+
+void QGraphicsOverlayTiles::onSceneRectChanged(const QRectF& rect)
+{
+    _layer->setRect(rect);
+}
+
+// zoom has settled, tiles of this level become the former level
+void QGraphicsOverlayTiles::onScaleSettled()
+{
+    _cancel(_tiles);
+    _old_tiles.clear();
+    for (QHash<quint64, Tile>::const_iterator it = _tiles.constBegin(); it != _tiles.constEnd(); ++it) {
+        if (!it->image.isNull()) {
+            Tile tile;
+            tile.image = it->image;
+            _old_tiles.insert(it.key(), tile);
+        }
+    }
+    _old_scale = _scale;
+    _tiles.clear();
+    _scale = _view_scale;
+    _view->viewport()->update();
+}
+
+// all tiles of the viewport rendered at this level
+bool QGraphicsOverlayTiles::_visible_ready() const
+{
+    QRectF visible = _view->mapToScene(_view->viewport()->rect()).boundingRect();
+    int x0 = int(qFloor(visible.left() * _scale / _tile_size));
+    int x1 = int(qFloor(visible.right() * _scale / _tile_size));
+    int y0 = int(qFloor(visible.top() * _scale / _tile_size));
+    int y1 = int(qFloor(visible.bottom() * _scale / _tile_size));
+    for (int ty = y0; ty <= y1; ty++) {
+        for (int tx = x0; tx <= x1; tx++) {
+            QHash<quint64, Tile>::const_iterator it = _tiles.constFind(_tile_key(tx, ty));
+            if (it == _tiles.constEnd() || it->image.isNull()) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void QGraphicsOverlayTiles::_request_tile(quint64 key, int tx, int ty)
+{
+    Tile& tile = _tiles[key];
+    if (tile.watcher) {
+        return; // rendering
+    }
+    // snapshot shapes on GUI thread, from bottom to top
+    TileJob job;
+    job.rect = _tile_rect(tx, ty);
+    QList<QGraphicsItem*> items = _scene->items(job.rect, Qt::IntersectsItemBoundingRect, Qt::AscendingOrder);
+    foreach (QGraphicsItem* item, items) {
+        QHash<QGraphicsItem*, Entry>::const_iterator it = _entries.constFind(item);
+        if (it != _entries.constEnd() && !_live.contains(item)) {
+            Entry entry = *it;
+            entry.shape = entry.shape.translated(item->pos() - entry.pos);
+            job.entries.append(entry);
+        }
+    }
+    job.scale = _scale;
+    job.size = _tile_size;
+    job.antialiasing = _view->renderHints() & QPainter::Antialiasing;
+    job.level = _level;
+    job.tile_level = _level->load();
+    QFutureWatcher<QImage>* watcher = new QFutureWatcher<QImage>(this);
+    watcher->setProperty("tile_key", key);
+    watcher->setProperty("generation", tile.generation);
+    connect(watcher, SIGNAL(finished()), this, SLOT(onTileRendered()));
+    tile.watcher = watcher;
+    watcher->setFuture(QtConcurrent::run(&QGraphicsOverlayTiles::_render_tile, job));
+}
+
+void QGraphicsOverlayTiles::onTileRendered()
+{
+    QFutureWatcher<QImage>* watcher = static_cast<QFutureWatcher<QImage>*>(sender());
+    quint64 key = watcher->property("tile_key").toULongLong();
+    int generation = watcher->property("generation").toInt();
+    watcher->deleteLater();
+    QHash<quint64, Tile>::iterator it = _tiles.find(key);
+    if (it == _tiles.end() || it->watcher != watcher) {
+        return; // evicted or reset while rendering
+    }
+    it->watcher = NULL;
+    if (it->generation == generation) {
+        it->image = watcher->result();
+        it->valid = true;
+    }
+    if (!_old_tiles.isEmpty() && _visible_ready()) {
+        _old_tiles.clear();
+    }
+    // show new tile, or render an invalidated one again
+    QRectF rect = _tile_rect(int(qint32(key >> 32)), int(qint32(key & 0xffffffff)));
+    _view->viewport()->update(_view->mapFromScene(rect).boundingRect());
+}
+
+void QGraphicsOverlayTiles::_reset_tiles()
+{
+    _cancel(_tiles);
+    _tiles.clear();
+    _old_tiles.clear();
+    _view->viewport()->update();
+}
+
+// renderings of tiles skipped by workers, and their watchers dropped
+void QGraphicsOverlayTiles::_cancel(QHash<quint64, Tile>& tiles)
+{
+    bool pending = false;
+    for (QHash<quint64, Tile>::iterator it = tiles.begin(); it != tiles.end(); ++it) {
+        if (it->watcher) {
+            it->watcher->disconnect(this);
+            it->watcher->deleteLater();
+            it->watcher = NULL;
+            pending = true;
+        }
+    }
+    if (pending) {
+        _level->ref();
+    }
+}
+
+// drop tiles out of the viewport when cache is full
+void QGraphicsOverlayTiles::_evict_tiles()
+{
+    if (_tiles.size() <= MAX_CACHED_TILES) {
+        return;
+    }
+    QRectF visible = _view->mapToScene(_view->viewport()->rect()).boundingRect();
+    QHash<quint64, Tile>::iterator it = _tiles.begin();
+    while (it != _tiles.end()) {
+        int tx = int(qint32(it.key() >> 32));
+        int ty = int(qint32(it.key() & 0xffffffff));
+        if (!_tile_rect(tx, ty).intersects(visible)) {
+            it = _tiles.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
+
+// runs on worker thread, QPainter on QImage is thread-safe
+QImage QGraphicsOverlayTiles::_render_tile(const TileJob& job)
+{
+    if (job.level->load() != job.tile_level) {
+        return QImage(); // of a former level, not shown anymore
+    }
+    const QVector<Entry>& entries = job.entries;
+    int size = job.size;
+    QImage image(size, size, QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::transparent);
+    QPainter painter(&image);
+    painter.setRenderHint(QPainter::Antialiasing, job.antialiasing);
+    painter.scale(job.scale, job.scale);
+    painter.translate(-job.rect.topLeft());
+    painter.setBrush(Qt::NoBrush);
+    for (int i = 0; i < entries.size(); i++) {
+        const QGraphicsROIShape& shape = entries[i].shape;
+        painter.setPen(entries[i].pen);
+        switch (shape.type) {
+        case QGraphicsROIShape::RECT_SHAPE:
+            painter.drawRect(shape.rect);
+            break;
+        case QGraphicsROIShape::POLYGON_SHAPE:
+            painter.drawPolygon(shape.polygon);
+            foreach (const QPolygonF& hole, shape.holes) {
+                painter.drawPolygon(hole);
+            }
+            break;
+        case QGraphicsROIShape::CIRCLE_SHAPE:
+            painter.drawEllipse(shape.center, shape.radius, shape.radius);
+            painter.drawLine(shape.center - QPointF(shape.radius, 0), shape.center + QPointF(shape.radius, 0));
+            painter.drawLine(shape.center - QPointF(0, shape.radius), shape.center + QPointF(0, shape.radius));
+            break;
+        default:
+            break;
+        }
+    }
+    return image;
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <QObject>
+#include <QGraphicsView>
+#include <QGraphicsScene>
+#include <QGraphicsItem>
+#include <QFutureWatcher>
+#include <QImage>
+#include <QHash>
+#include <QSet>
+#include <QPointer>
+#include <QSharedPointer>
+#include <QAtomicInt>
+#include <QTimer>
+#include <QPen>
+#include "QGraphicsROIShape.h"
+#include "QGraphicsROISelection.h"
+
+/*!
+ * This class renders static ROIs of a view into cached image tiles on worker
+ * threads, and composites the tiles from an item of its own, over the
+ * background and below selected items, so live and dragged items are drawn
+ * over the cached ones.
+ *
+ * Tiles are aligned to device pixels at current zoom level, so a pan reuses
+ * cached tiles and a zoom re-renders them. While the zoom level changes, the
+ * cached tiles are drawn scaled and nothing is rendered. Once it has settled
+ * for a moment, tiles of the new level are rendered, and tiles of the former
+ * level are drawn scaled where new ones are not ready yet. Renderings of a
+ * former level are skipped by workers still holding them. The ROIs are
+ * registered as plain
+ * shapes with setShape(), which invalidates only the tiles intersecting the old
+ * and new shape. Stale tiles are still drawn until the new ones are ready.
+ *
+ * Selected items are live, painted by items themselves and excluded from tiles.
+ * Shapes follow item position at rendering time, so moving a selection needs no
+ * update. While the object exists, isActive(scene) is true and items should skip
+ * painting unless they are selected.
+ *
+ * Selected items are polled from the scene, or tracked by changes once a
+ * selection model is given by setSelection().
+ *
+ * Usage:
+ *
+ *   QGraphicsOverlayTiles* overlay = new QGraphicsOverlayTiles(view);
+ *   overlay->setShape(item, item->roiShape(), pen);
+ */
+class QGraphicsOverlayTiles : public QObject
+{
+    Q_OBJECT
+public:
+    QGraphicsOverlayTiles(QGraphicsView* view);
+    ~QGraphicsOverlayTiles();
+
+    // size of tiles in device pixels
+    void setTileSize(int size);
+
+    // ROIs rendered into tiles
+    void setShape(QGraphicsItem* item, const QGraphicsROIShape& shape, const QPen& pen);
+    void removeShape(QGraphicsItem* item);
+    void clear();
+
+    // track live items by changes of selection model
+    void setSelection(QGraphicsROISelection* selection);
+
+    // drop cached tiles intersecting given area in scene coords
+    void invalidate(const QRectF& rect);
+
+    // composite tiles intersecting given area in scene coords, done by the
+    // item of the overlay
+    void paint(QPainter* painter, const QRectF& rect);
+
+    // overlay is active on the scene
+    static bool isActive(const QGraphicsScene* scene);
+
+private slots:
+    void onSelectionChanged();
+    void onSelectionDelta(const QList<QGraphicsItem*>& added, const QList<QGraphicsItem*>& removed);
+    void onTileRendered();
+    void onScaleSettled();
+    void onSceneRectChanged(const QRectF& rect);
+
+private:
+    // item painting tiles, over all of the scene and never hit
+    class Layer : public QGraphicsItem
+    {
+    public:
+        Layer(QGraphicsOverlayTiles* overlay);
+        void setRect(const QRectF& rect);
+        QRectF boundingRect() const;
+        QPainterPath shape() const;
+        void paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget);
+
+    private:
+        QGraphicsOverlayTiles* _overlay;
+        QRectF _rect;
+    };
+
+    struct Entry
+    {
+        QGraphicsROIShape shape;
+        QPen pen;
+        QPointF pos; // item position of the shape
+    };
+
+    struct Tile
+    {
+        Tile() : valid(false), generation(0), watcher(NULL) {}
+        QImage image;
+        bool valid;
+        int generation;
+        QFutureWatcher<QImage>* watcher;
+    };
+
+    QGraphicsView* _view;
+    QPointer<QGraphicsScene> _scene;
+    Layer* _layer; // owned by the scene
+    int _tile_size;
+    qreal _scale; // of tiles
+    qreal _view_scale; // of the view, waiting to settle when not the scale of tiles
+    QTimer _settle_timer;
+    QHash<QGraphicsItem*, Entry> _entries;
+    QSet<QGraphicsItem*> _live;
+    QHash<quint64, Tile> _tiles;
+    // tiles of the former level, drawn until the tiles of this level are ready
+    QHash<quint64, Tile> _old_tiles;
+    qreal _old_scale;
+    // level of tiles, renderings of former levels are skipped
+    QSharedPointer<QAtomicInt> _level;
+
+    // input of a rendering, copied to the worker thread
+    struct TileJob
+    {
+        QVector<Entry> entries;
+        QRectF rect;
+        qreal scale;
+        int size;
+        bool antialiasing;
+        QSharedPointer<QAtomicInt> level;
+        int tile_level; // level when requested
+    };
+
+    static QImage _render_tile(const TileJob& job);
+
+    QRectF _tile_rect(int tx, int ty) const;
+    QRectF _tile_rect(quint64 key, qreal scale) const;
+    void _request_tile(quint64 key, int tx, int ty);
+    void _draw_old_tiles(QPainter* painter, const QRectF& rect);
+    bool _visible_ready() const;
+    void _reset_tiles();
+    void _cancel(QHash<quint64, Tile>& tiles);
+    void _evict_tiles();
+};
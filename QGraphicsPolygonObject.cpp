@@ -1,15 +1,33 @@
 #include "QGraphicsPolygonObject.h"
+#include "QGraphicsRenderQuality.h"
+#include "QGraphicsOverlayTiles.h"
+#include "QGraphicsROIClusters.h"
+#include "QGraphicsDragIndex.h"
 #include <QGraphicsScene>
 #include <QGraphicsView>
 #include <QPainter>
+#include <QStyleOptionGraphicsItem>
 #include <QDebug>
 #include <cassert>
 
+// without a closing point equal to the first, so handles, metrics and
+// validity share the indices of vertices
+static QPolygonF _open_ring(const QPolygonF& polygon)
+{
+    QPolygonF ring = polygon;
+    if (ring.size() > 1 && ring.first() == ring.last()) {
+        ring.removeLast();
+    }
+    return ring;
+}
+
 QGraphicsPolygonObject::QGraphicsPolygonObject(const QPolygonF& polygon, QGraphicsItem* parent)
-    : QGraphicsObject(parent)
+    : QGraphicsROIObject(parent)
     , _handle_size(DEFAULT_HANDLE_SIZE)
+    , _roi_id(-1)
     , _shape_pen(QBrush(Qt::red), 1, Qt::SolidLine) 
     , _handle_pen(QBrush(Qt::green), 1, Qt::SolidLine) 
+    , _invalid_pen(QBrush(Qt::yellow), 2, Qt::SolidLine) 
 {
     setFlags(QGraphicsItem::ItemSendsGeometryChanges |
              QGraphicsItem::ItemIsMovable |
@@ -18,8 +36,12 @@ QGraphicsPolygonObject::QGraphicsPolygonObject(const QPolygonF& polygon, QGraphi
 
     _shape_pen.setCosmetic(true);
     _handle_pen.setCosmetic(true);
+    _invalid_pen.setCosmetic(true);
 
-    _polygon = mapFromScene(polygon);
+    _polygon = _open_ring(mapFromScene(polygon));
+    _validity.reset(_polygon); 
+    _metrics.reset(_polygon); 
+    _shape_bound = _polygon.boundingRect(); 
     _update_handles(); 
     _clear_mode(); 
 }
@@ -50,6 +72,85 @@ void QGraphicsPolygonObject::setHandleColor(const QColor& color)
     _handle_pen.setColor(color); 
 }
 
+void QGraphicsPolygonObject::setInvalidColor(const QColor& color)
+{
+    _invalid_pen.setColor(color); 
+}
+
+QPen QGraphicsPolygonObject::shapePen() const
+{
+    return _shape_pen; 
+}
+
+QGraphicsROIShape QGraphicsPolygonObject::roiShape() const
+{
+    QVector<QPolygonF> holes; 
+    foreach (const QPolygonF& hole, _holes) {
+        holes.append(mapToScene(hole)); 
+    }
+    return QGraphicsROIShape::fromPolygon(mapToScene(_polygon), holes); 
+}
+
+QGraphicsROIMetrics QGraphicsPolygonObject::metrics() const
+{
+    QGraphicsROIMetrics metrics = _metrics.metrics(); 
+    metrics.centroid = mapToScene(metrics.centroid); 
+    metrics.bound = mapRectToScene(metrics.bound); 
+    return metrics; 
+}
+
+// polygon in scene coords, without notifying 
+void QGraphicsPolygonObject::setPolygon(const QPolygonF& polygon)
+{
+    _polygon = _open_ring(mapFromScene(polygon));
+    _validity.reset(_polygon); 
+    _metrics.reset(_polygon, _holes); 
+    _fit_bound(_polygon.boundingRect()); 
+    _update_handles(); 
+    update(); 
+}
+
+// holes in scene coords, without notifying 
+void QGraphicsPolygonObject::setHoles(const QVector<QPolygonF>& holes)
+{
+    _holes.clear(); 
+    foreach (const QPolygonF& hole, holes) {
+        _holes.append(mapFromScene(hole)); 
+    }
+    _metrics.reset(_polygon, _holes); 
+    update(); 
+}
+
+void QGraphicsPolygonObject::setRoiId(qint64 id)
+{
+    _roi_id = id; 
+}
+
+qint64 QGraphicsPolygonObject::roiId() const
+{
+    return _roi_id; 
+}
+
+// transform polygon in scene coords in place, without notifying, 
+// for group edits of many items 
+void QGraphicsPolygonObject::transformShape(const QTransform& transform)
+{
+    _polygon = _open_ring(mapFromScene(transform.map(mapToScene(_polygon)))); 
+    for (int i = 0; i < _holes.size(); i++) {
+        _holes[i] = mapFromScene(transform.map(mapToScene(_holes[i]))); 
+    }
+    _validity.reset(_polygon); 
+    _metrics.reset(_polygon, _holes); 
+    _fit_bound(_polygon.boundingRect()); 
+    _update_handles(); 
+    update(); 
+}
+
+bool QGraphicsPolygonObject::isValid() const
+{
+    return _validity.isValid(); 
+}
+
 // return the actual bounding area of the item
 // include polygon bound box + handles 
 QRectF QGraphicsPolygonObject::boundingRect() const
@@ -58,8 +159,7 @@ QRectF QGraphicsPolygonObject::boundingRect() const
     qreal x_off = (_handle_size / t.m11()) / 2.0 + 1; 
     qreal y_off = (_handle_size / t.m22()) / 2.0 + 1; 
     // extend the area of polygon to include the handle rects
-    QRectF rect = _polygon.boundingRect();
-    return rect.adjusted(-x_off, -y_off, x_off, y_off);
+    return _shape_bound.adjusted(-x_off, -y_off, x_off, y_off);
 }
 
 void QGraphicsPolygonObject::_update_handles()
@@ -79,18 +179,62 @@ void QGraphicsPolygonObject::_update_handles()
 }
 
 // customized painting
-void QGraphicsPolygonObject::paint(QPainter* painter, const QStyleOptionGraphicsItem*, QWidget*)
+void QGraphicsPolygonObject::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget*)
 {
+    // static items are rendered in overlay tiles
+    if (!isSelected() && QGraphicsOverlayTiles::isActive(scene())) {
+        return; 
+    }
+    // small items are drawn as clusters 
+    qreal lod_cell = QGraphicsROIClusters::lodCellSize(scene()); 
+    if (lod_cell > 0 && !isSelected() && qMax(_shape_bound.width(), _shape_bound.height()) <= lod_cell) {
+        return; 
+    }
+    int fast_path = QGraphicsRenderQuality::activeFastPath(scene());
     painter->setPen(_shape_pen);
-    painter->drawPolygon(_polygon);
+    if (fast_path & QGraphicsRenderQuality::SIMPLIFIED_OUTLINES) {
+        qreal lod = option->levelOfDetailFromTransform(painter->worldTransform());
+        painter->drawPolygon(_simplified_polygon(lod));
+    }
+    else {
+        painter->drawPolygon(_polygon);
+    }
+    foreach (const QPolygonF& hole, _holes) {
+        painter->drawPolygon(hole);
+    }
+    // highlight self intersecting edges 
+    if (!_validity.isValid()) {
+        painter->setPen(_invalid_pen);
+        int n = _polygon.count();
+        foreach (int edge, _validity.invalidEdges()) {
+            painter->drawLine(_polygon[edge], _polygon[(edge + 1) % n]);
+        }
+    }
     // draw resize handles if the item is currectly selected
-    if (isSelected()) {
+    if (isSelected() && !(fast_path & QGraphicsRenderQuality::NO_HANDLES)) {
         _update_handles();
         painter->setPen(_handle_pen);
         painter->drawRects(_handles);
     }
 }
 
+// keep about one vertex per device pixel of the bounding box outline 
+QPolygonF QGraphicsPolygonObject::_simplified_polygon(qreal lod) const
+{
+    QRectF rect = _polygon.boundingRect(); 
+    int max_points = qMax(8, int((rect.width() + rect.height()) * lod)); 
+    int step = _polygon.count() / max_points; 
+    if (step <= 1) {
+        return _polygon; 
+    }
+    QPolygonF simplified; 
+    simplified.reserve(_polygon.count() / step + 1); 
+    for (int i = 0; i < _polygon.count(); i += step) {
+        simplified.append(_polygon[i]); 
+    }
+    return simplified; 
+}
+
 int QGraphicsPolygonObject::_check_pos_in_handle(const QPointF& pos)
 {
     for (int i = 0; i < _handles.size(); i++) {
@@ -140,6 +284,60 @@ void QGraphicsPolygonObject::_resize_polygon(const QPointF& pos)
     assert(_resizing); 
     assert(_resizing_handle >= 0); 
     _polygon[_resizing_handle] = pos;
+    // only the terms of the two adjacent edges are updated 
+    _metrics.moveVertex(_resizing_handle, pos); 
+}
+
+// damage of an edge 
+void QGraphicsPolygonObject::_edge_damage(int edge, QVector<QRectF>& damage) const
+{
+    qreal margin = _damage_margin(_handle_size, _shape_pen); 
+    const QPointF& a = _polygon[edge]; 
+    const QPointF& b = _polygon[(edge + 1) % _polygon.count()]; 
+    damage.append(QRectF(a, b).normalized().adjusted(-margin, -margin, margin, margin)); 
+}
+
+// damage of a vertex, its two adjacent edges and the handle 
+void QGraphicsPolygonObject::_vertex_damage(int index, QVector<QRectF>& damage) const
+{
+    int n = _polygon.count(); 
+    qreal margin = _damage_margin(_handle_size, _shape_pen); 
+    const QPointF& point = _polygon[index]; 
+    const QPointF& prev = _polygon[(index + n - 1) % n]; 
+    const QPointF& next = _polygon[(index + 1) % n]; 
+    damage.append(QRectF(prev, point).normalized().adjusted(-margin, -margin, margin, margin)); 
+    damage.append(QRectF(point, next).normalized().adjusted(-margin, -margin, margin, margin)); 
+}
+
+// move the resizing handle and repaint only the damaged area, 
+// the two adjacent edges and the handle, before and after the move. 
+// return damaged rects in local coords 
+QVector<QRectF> QGraphicsPolygonObject::_move_handle(const QPointF& pos)
+{
+    QVector<QRectF> damage; 
+    _vertex_damage(_resizing_handle, damage); 
+    _resize_polygon(pos); 
+    _vertex_damage(_resizing_handle, damage); 
+    // only the two adjacent edges are tested again, edges crossing them 
+    // before or after are repainted in their new state 
+    bool valid = _validity.isValid(); 
+    foreach (int edge, _validity.moveVertex(_resizing_handle, pos)) {
+        _edge_damage(edge, damage); 
+    }
+    if (valid != _validity.isValid()) {
+        Q_EMIT validityChanged(_validity.isValid()); 
+    }
+    if (_grow_bound(QRectF(pos, QSizeF(0, 0)))) {
+        // full repaint by geometry change 
+        damage.clear(); 
+        damage.append(boundingRect()); 
+    }
+    else {
+        for (int i = 0; i < damage.size(); i++) {
+            scene()->update(mapRectToScene(damage[i])); 
+        }
+    }
+    return damage; 
 }
 
 void QGraphicsPolygonObject::hoverEnterEvent(QGraphicsSceneHoverEvent* event)
@@ -168,28 +366,40 @@ void QGraphicsPolygonObject::mousePressEvent(QGraphicsSceneMouseEvent* event)
         _set_dragging_mode(); 
     }
     QGraphicsObject::mousePressEvent(event);
+    // selection is settled by the press 
+    if (!_resizing && event->button() == Qt::LeftButton) {
+        Q_EMIT dragStarted(); 
+    }
 }
 
 void QGraphicsPolygonObject::mouseMoveEvent(QGraphicsSceneMouseEvent* event)
 {
     if (_resizing) {
         if (scene()->sceneRect().contains(event->scenePos())) {
-            _resize_polygon(event->pos()); 
-            prepareGeometryChange();
-            update();
+            _move_handle(event->pos()); 
+            // only the vertex, the whole polygon is notified on release 
+            Q_EMIT vertexMoved(_resizing_handle, mapToScene(_polygon[_resizing_handle]));
         }
     }
     else {
+        // moving of all selected items is notified by itemChange() 
         QGraphicsObject::mouseMoveEvent(event);
     }
-    // notify changing
-    Q_EMIT polygonChanged(mapToScene(_polygon));
 }
 
 void QGraphicsPolygonObject::mouseReleaseEvent(QGraphicsSceneMouseEvent* event)
 {
+    bool resized = _resizing; 
+    if (_resizing) {
+        _fit_bound(_polygon.boundingRect()); 
+        // summed again from scratch, without rounding drift of the moves 
+        _metrics.reset(_polygon, _holes); 
+    }
     _clear_mode(); 
     QGraphicsObject::mouseReleaseEvent(event);
+    if (resized) {
+        Q_EMIT polygonChanged(mapToScene(_polygon));
+    }
 }
 
 // hook item changing 
@@ -201,10 +411,16 @@ QVariant QGraphicsPolygonObject::itemChange(GraphicsItemChange change, const QVa
     //     QPointF pt = value.toPointF(); // new pos
     // }
 
+    // moving of a large selection is notified once when dragging ends 
+    if (change == QGraphicsItem::ItemPositionHasChanged && !QGraphicsDragIndex::isDragging(scene())) {
+        Q_EMIT polygonChanged(mapToScene(_polygon));
+    }
+
     if (change == QGraphicsItem::ItemSelectedHasChanged) {
         // move to front when selected 
         bool selected = value.toBool();
         setZValue(selected ? 1 : 0);
+        Q_EMIT selectedChanged(selected); 
     }
     return QGraphicsItem::itemChange(change, value);
 }
@@ -1,13 +1,16 @@
 #pragma once 
 
-#include <QGraphicsObject>
+#include "QGraphicsROIObject.h"
 #include <QGraphicsSceneHoverEvent>
 #include <QGraphicsSceneMouseEvent>
 #include <QPen>
+#include "QGraphicsROIShape.h"
+#include "QGraphicsPolygonValidity.h"
+#include "QGraphicsROIMetrics.h"
 
 #define DEFAULT_HANDLE_SIZE 10
 
-class QGraphicsPolygonObject : public QGraphicsObject
+class QGraphicsPolygonObject : public QGraphicsROIObject
 {
     Q_OBJECT
 public:
@@ -22,9 +25,47 @@ public:
     void setHandleSize(int size); 
     void setHandleColor(const QColor& color); 
 
+    // set pen for self intersecting edges 
+    void setInvalidColor(const QColor& color); 
+
+    QPen shapePen() const; 
+
+    // polygon in scene coords 
+    QGraphicsROIShape roiShape() const; 
+    // area, perimeter, centroid and bound in scene coords, kept by vertex moves 
+    QGraphicsROIMetrics metrics() const; 
+    // polygon in scene coords, without notifying 
+    void setPolygon(const QPolygonF& polygon); 
+
+    // holes in scene coords, drawn but not edited, without notifying 
+    void setHoles(const QVector<QPolygonF>& holes); 
+
+    // identifier of the ROI, -1 by default 
+    void setRoiId(qint64 id); 
+    qint64 roiId() const; 
+
+    // transform polygon in scene coords in place, without notifying 
+    void transformShape(const QTransform& transform); 
+
+    // polygon has no self intersection, checked live while resizing 
+    bool isValid() const; 
+
 signals:
+    // polygon moved, or resized, once on release of the vertex 
     void polygonChanged(const QPolygonF&);
 
+    // vertex of given index moved to pos in scene coords, while resizing 
+    void vertexMoved(int index, const QPointF& pos);
+
+    // dragging with all selected items starts 
+    void dragStarted();
+
+    // item is selected or deselected 
+    void selectedChanged(bool);
+
+    // polygon becomes self intersecting, or simple again 
+    void validityChanged(bool);
+
 protected:
     QRectF boundingRect() const;
     void paint(QPainter*, const QStyleOptionGraphicsItem*, QWidget*);
@@ -42,7 +83,11 @@ protected:
     QVariant itemChange(GraphicsItemChange change, const QVariant &value); 
 
     void _update_handles(); 
+    QPolygonF _simplified_polygon(qreal lod) const; 
     void _resize_polygon(const QPointF& pos); 
+    QVector<QRectF> _move_handle(const QPointF& pos); 
+    void _vertex_damage(int index, QVector<QRectF>& damage) const; 
+    void _edge_damage(int edge, QVector<QRectF>& damage) const; 
     int _check_pos_in_handle(const QPointF& pos); 
     bool _set_resizing_mode(const QPointF& pos); 
     void _set_dragging_mode(); 
@@ -51,8 +96,12 @@ protected:
 protected:
     // Polygon and handles 
     int _handle_size; 
-    QPolygonF _polygon;
+    qint64 _roi_id; 
+    QPolygonF _polygon; // open ring, one handle per vertex 
+    QVector<QPolygonF> _holes; 
     QVector<QRectF> _handles;
+    QGraphicsPolygonValidity _validity; 
+    QGraphicsPolygonMetrics _metrics; 
 
     // Keep track of resizing 
     bool _resizing;
@@ -61,4 +110,5 @@ protected:
     // pens
     QPen _shape_pen; 
     QPen _handle_pen; 
+    QPen _invalid_pen; 
 };
@@ -1,13 +1,29 @@
 #include "QGraphicsPolygonSelector.h"
 #include "QGraphicsViewZoom.h"
+#include "QGraphicsRenderQuality.h"
 #include "QGraphicsPolygonObject.h"
 #include <QKeyEvent>
+#include <qmath.h>
 #include <QDebug>
 
 QGraphicsPolygonSelector::QGraphicsPolygonSelector(QWidget* parent)
     : QGraphicsView(parent)
-    , _drawing_line(NULL)
+    , _overlay(NULL)
+    , _clusters(NULL)
+    , _selecting_mode(false)
+    , _drawing_mode(false)
+    , _lasso_mode(false)
+    , _lasso_tolerance(1)
     , _drawing_pen(QBrush(Qt::red), 1, Qt::SolidLine) 
+    , _edge_snapping(false)
+    , _brush_mode(false)
+    , _brush_radius(10)
+    , _wand_mode(false)
+    , _wand_tolerance(32)
+    , _wand_drag_tolerance(32)
+    , _wand_commit(false)
+    , _superpixel_mode(false)
+    , _superpixel_hover(-1)
 {
     setFrameShape(QFrame::NoFrame);
     setHorizontalScrollBarPolicy(Qt::ScrollBarAsNeeded);
@@ -17,26 +33,180 @@ QGraphicsPolygonSelector::QGraphicsPolygonSelector(QWidget* parent)
     QGraphicsViewZoom* zoom = new QGraphicsViewZoom(this);
     zoom->set_modifiers(Qt::NoModifier);
 
+    // fast rendering while panning and zooming 
+    QGraphicsRenderQuality* quality = new QGraphicsRenderQuality(this);
+    connect(zoom, &QGraphicsViewZoom::zoomStarted, 
+            quality, &QGraphicsRenderQuality::beginInteraction);
+    connect(zoom, &QGraphicsViewZoom::zoomFinished, 
+            quality, &QGraphicsRenderQuality::endInteraction);
+    connect(quality, &QGraphicsRenderQuality::qualityChanged, 
+            this, &QGraphicsPolygonSelector::onQualityChanged);
+
     setScene(&_scene);
-    connect(&_scene, &QGraphicsScene::selectionChanged, 
-            this, &QGraphicsPolygonSelector::onSelectionChanged);
+
+    // polygon being drawn, one item appended point by point 
+    _drawing_lasso = new QGraphicsLassoItem(_drawing_pen);
+    _drawing_lasso->setZValue(1);
+    _scene.addItem(_drawing_lasso);
+
+    // segment to the mouse along edges, searched on a worker thread 
+    _live_wire = new QGraphicsLiveWire(this);
+    connect(_live_wire, &QGraphicsLiveWire::pathReady, 
+            this, &QGraphicsPolygonSelector::onSnappedPath);
+
+    // region of magic wand until released, not a ROI 
+    _wand_preview = new QGraphicsMaskObject();
+    _wand_preview->setFlags(QGraphicsItem::ItemUsesExtendedStyleOption);
+    _wand_preview->setZValue(1);
+    _scene.addItem(_wand_preview);
+
+    // similar pixels on a worker thread, latest request wins 
+    _wand = new QGraphicsMagicWand(this);
+    connect(_wand, &QGraphicsMagicWand::regionReady, 
+            this, &QGraphicsPolygonSelector::onWandRegion);
+
+    // superpixels of background, segmented on a worker thread when set 
+    _superpixels = new QGraphicsSuperpixels(this);
+    connect(_superpixels, &QGraphicsSuperpixels::segmentationReady, 
+            this, &QGraphicsPolygonSelector::onSegmentationReady);
+    _superpixel_preview = new QGraphicsMaskObject();
+    _superpixel_preview->setFlags(QGraphicsItem::ItemUsesExtendedStyleOption);
+    _superpixel_preview->setZValue(1);
+    _scene.addItem(_superpixel_preview);
+    _superpixel_highlight = new QGraphicsMaskObject();
+    _superpixel_highlight->setFlags(QGraphicsItem::ItemUsesExtendedStyleOption);
+    _superpixel_highlight->setShapeColor(QColor(255, 255, 0, 64));
+    _superpixel_highlight->setZValue(1);
+    _scene.addItem(_superpixel_highlight);
+
+    // selection tracked by changes 
+    _selection = new QGraphicsROISelection(this);
+
+    // move large selections unindexed 
+    _drag_index = new QGraphicsDragIndex(this);
+    connect(_drag_index, &QGraphicsDragIndex::itemsMoved, 
+            this, &QGraphicsPolygonSelector::onItemsMoved);
+
+    // ROIs from worker threads 
+    _queue = new QGraphicsROIQueue(this);
+    connect(_queue, &QGraphicsROIQueue::recordsReady, 
+            this, &QGraphicsPolygonSelector::onRecordsReady);
 
     // default scene 
-    scene()->addPixmap(QPixmap::fromImage(QImage(1920, 1080, QImage::Format_RGB888)));
+    _background = new QGraphicsImageItem();
+    _background->setImageData(QGraphicsImageData(1920, 1080, QGraphicsImageData::GRAY8));
+    scene()->addItem(_background);
     scene()->setSceneRect(QRectF(0, 0, 1920, 1080));
 }
 
 QGraphicsPolygonSelector::~QGraphicsPolygonSelector()
 {
+    delete _overlay; 
+    delete _clusters; 
+}
+
+void QGraphicsPolygonSelector::setBackgroundImage(const QImage& image)
+{
+    _set_background(QGraphicsImageData::fromImage(image), image);
+}
+
+void QGraphicsPolygonSelector::setBackgroundData(const QGraphicsImageData& data)
+{
+    double low, high;
+    data.range(low, high);
+    _set_background(data, data.toImage(low, high));
+}
+
+void QGraphicsPolygonSelector::setBackgroundFrame(const QGraphicsImageData& frame)
+{
+    if (frame.rect() != _background->imageData().rect()) {
+        scene()->setSceneRect(QRectF(frame.rect()));
+    }
+    _background->setFrame(frame);
+}
+
+void QGraphicsPolygonSelector::setBackgroundWindow(double low, double high)
+{
+    _background->setWindow(low, high);
+}
+
+void QGraphicsPolygonSelector::setBackgroundColormap(QGraphicsImageData::COLORMAP colormap)
+{
+    _background->setColormap(QGraphicsImageData::colormap(colormap));
+}
 
+// pixels whose center is in the ROI, in image coords 
+QGraphicsImageData::Statistics QGraphicsPolygonSelector::backgroundStatistics(QGraphicsItem* item) const
+{
+    QGraphicsRLEMask mask;
+    QGraphicsObject* object = item ? item->toGraphicsObject() : NULL;
+    QGraphicsPolygonObject* polygon = qobject_cast<QGraphicsPolygonObject*>(object);
+    QGraphicsMaskObject* painted = qobject_cast<QGraphicsMaskObject*>(object);
+    if (polygon) {
+        mask = QGraphicsRLEMask::fromShape(polygon->roiShape());
+    }
+    else if (painted) {
+        mask = painted->rleMask();
+    }
+    return _background->imageData().statistics(mask.translated(-_background->pos().toPoint()));
+}
+
+// image is the background as 8 bit for tools 
+void QGraphicsPolygonSelector::_set_background(const QGraphicsImageData& data, const QImage& image)
+{
+    _background->setImageData(data);
+    _background->setPos(0, 0);
+    scene()->setSceneRect(QRectF(QPointF(0, 0), image.size()));
+    _wand->setImage(image);
+    _live_wire->setImage(image);
+    _superpixels->setImage(image);
+    _superpixel_hover = -1;
+    _superpixel_labels.clear();
+    _superpixel_region = QGraphicsRLEMask();
+    _superpixel_preview->clear();
+    _superpixel_highlight->clear();
+    _wand_region = QGraphicsRLEMask();
+    _wand_preview->clear();
 }
 
 // add a polygon item
-void QGraphicsPolygonSelector::addPolygonItem(const QPolygonF& polygon)
+QGraphicsPolygonObject* QGraphicsPolygonSelector::addPolygonItem(const QPolygonF& polygon)
+{
+    return _add_polygon_item(polygon, QVector<QPolygonF>()); 
+}
+
+// holes set before the item is registered, so it is published once 
+QGraphicsPolygonObject* QGraphicsPolygonSelector::_add_polygon_item(const QPolygonF& polygon, const QVector<QPolygonF>& holes)
 {
     QGraphicsPolygonObject* item = new QGraphicsPolygonObject(polygon);
+    if (!holes.isEmpty()) {
+        item->setHoles(holes); 
+    }
     connect(item, SIGNAL(polygonChanged(const QPolygonF&)), this, SLOT(onPolygonChanged(const QPolygonF&)));
+    connect(item, SIGNAL(vertexMoved(int, const QPointF&)), this, SLOT(onVertexMoved(int, const QPointF&)));
+    connect(item, SIGNAL(dragStarted()), this, SLOT(onDragStarted()));
+    _selection->addItem(item); 
+    scene()->addItem(item); 
+    if (_overlay) {
+        _overlay->setShape(item, item->roiShape(), item->shapePen()); 
+    }
+    if (_clusters) {
+        _clusters->setItem(item, item->roiShape().boundingRect()); 
+    }
+    _publish(item); 
+    return item; 
+}
+
+// add an empty mask item 
+QGraphicsMaskObject* QGraphicsPolygonSelector::addMaskItem()
+{
+    QGraphicsMaskObject* item = new QGraphicsMaskObject();
+    connect(item, SIGNAL(maskChanged(const QRectF&)), this, SLOT(onMaskChanged(const QRectF&)));
+    _selection->addItem(item); 
     scene()->addItem(item); 
+    _brush_item = item; 
+    _publish(item); 
+    return item; 
 }
 
 // enable drawing polygon with mouse
@@ -44,22 +214,508 @@ void QGraphicsPolygonSelector::setDrawingMode(bool drawing)
 {
     _drawing_mode = drawing;
     if(_drawing_mode) {
+        _brush_mode = false;
+        _brush_item = NULL;
+        setWandMode(false);
+        setSuperpixelMode(false);
         setDragMode(QGraphicsView::NoDrag);
         viewport()->setCursor(Qt::CrossCursor);
     }
     else {
         setDragMode(QGraphicsView::ScrollHandDrag);
+        _lasso_mode = false;
         _clear_drawing(); 
     }
 }
 
+// freehand drawing is drawing mode, with vertices sampled from mouse moves 
+void QGraphicsPolygonSelector::setLassoMode(bool lasso)
+{
+    setDrawingMode(lasso);
+    _lasso_mode = lasso;
+}
+
+void QGraphicsPolygonSelector::setLassoTolerance(qreal pixels)
+{
+    _lasso_tolerance = pixels;
+}
+
+// the path from the last vertex is searched again as the mouse moves 
+void QGraphicsPolygonSelector::setEdgeSnapping(bool snapping)
+{
+    _edge_snapping = snapping;
+    _snapped_path.clear();
+    if (_edge_snapping && !_drawing_lasso->isEmpty()) {
+        _live_wire->setSeed(_image_pos(_drawing_lasso->points().last()));
+    }
+}
+
+// strokes paint into the last mask, or a new one, until brush mode ends 
+void QGraphicsPolygonSelector::setBrushMode(bool brush)
+{
+    if (brush) {
+        setDrawingMode(false);
+        setWandMode(false);
+        setSuperpixelMode(false);
+        setDragMode(QGraphicsView::NoDrag);
+        viewport()->setCursor(Qt::CrossCursor);
+    }
+    else if (_brush_mode) {
+        setDragMode(QGraphicsView::ScrollHandDrag);
+        _brush_item = NULL;
+    }
+    _brush_mode = brush;
+}
+
+void QGraphicsPolygonSelector::setBrushRadius(qreal radius)
+{
+    _brush_radius = radius;
+}
+
+// a region being dragged is dropped when wand mode ends 
+void QGraphicsPolygonSelector::setWandMode(bool wand)
+{
+    if (wand) {
+        setDrawingMode(false);
+        setBrushMode(false);
+        setSuperpixelMode(false);
+        setDragMode(QGraphicsView::NoDrag);
+        viewport()->setCursor(Qt::PointingHandCursor);
+    }
+    else if (_wand_mode) {
+        setDragMode(QGraphicsView::ScrollHandDrag);
+        _wand->cancel();
+        _wand_commit = false;
+        _wand_region = QGraphicsRLEMask();
+        _wand_preview->clear();
+    }
+    _wand_mode = wand;
+}
+
+void QGraphicsPolygonSelector::setWandTolerance(int tolerance)
+{
+    _wand_tolerance = qBound(0, tolerance, 255);
+}
+
+// superpixels clicked are dropped when superpixel mode ends 
+void QGraphicsPolygonSelector::setSuperpixelMode(bool superpixel)
+{
+    if (superpixel) {
+        setDrawingMode(false);
+        setBrushMode(false);
+        setWandMode(false);
+        setDragMode(QGraphicsView::NoDrag);
+        viewport()->setCursor(Qt::PointingHandCursor);
+    }
+    else if (_superpixel_mode) {
+        setDragMode(QGraphicsView::ScrollHandDrag);
+        _superpixel_hover = -1;
+        _superpixel_labels.clear();
+        _superpixel_region = QGraphicsRLEMask();
+        _superpixel_preview->clear();
+        _superpixel_highlight->clear();
+    }
+    _superpixel_mode = superpixel;
+}
+
+// select items intersecting the rubber band, by the index of the scene 
+void QGraphicsPolygonSelector::setSelectingMode(bool selecting)
+{
+    _selecting_mode = selecting;
+    if (_selecting_mode) {
+        setRubberBandSelectionMode(Qt::IntersectsItemBoundingRect);
+        setDragMode(QGraphicsView::RubberBandDrag);
+        viewport()->setCursor(Qt::ArrowCursor);
+    }
+    else {
+        setDragMode(QGraphicsView::ScrollHandDrag);
+    }
+}
+
+void QGraphicsPolygonSelector::moveSelected(const QPointF& offset)
+{
+    transformSelected(QTransform::fromTranslate(offset.x(), offset.y()));
+}
+
+// scale about the center of selected items 
+void QGraphicsPolygonSelector::scaleSelected(qreal factor)
+{
+    QRectF bound;
+    foreach (QGraphicsItem* item, _selection->items()) {
+        bound |= item->sceneBoundingRect();
+    }
+    QPointF center = bound.center();
+    QTransform transform;
+    transform.translate(center.x(), center.y());
+    transform.scale(factor, factor);
+    transform.translate(-center.x(), -center.y());
+    transformSelected(transform);
+}
+
+// geometry of items is transformed in place, without position changes and 
+// their notifications, and a large selection is transformed unindexed, 
+// the index is rebuilt once after a burst of key presses 
+void QGraphicsPolygonSelector::transformSelected(const QTransform& transform)
+{
+    if (_selection->count() == 0) {
+        return; 
+    }
+    QList<QGraphicsItem*> items = _selection->items().toList();
+    if (items.size() >= _drag_index->threshold()) {
+        _drag_index->suspend(); 
+    }
+    foreach (QGraphicsItem* item, items) {
+        QGraphicsPolygonObject* roi = qobject_cast<QGraphicsPolygonObject*>(item->toGraphicsObject()); 
+        QGraphicsMaskObject* mask = qobject_cast<QGraphicsMaskObject*>(item->toGraphicsObject()); 
+        if (roi) {
+            roi->transformShape(transform); 
+        }
+        else if (mask) {
+            mask->transformShape(transform); 
+        }
+    }
+    onItemsMoved(items);
+}
+
+// deleted items are dropped from selection without notification 
+void QGraphicsPolygonSelector::deleteSelected()
+{
+    QList<QGraphicsItem*> items = _selection->items().toList();
+    foreach (QGraphicsItem* item, items) {
+        _remove_item(item); 
+    }
+}
+
+void QGraphicsPolygonSelector::uniteSelected()
+{
+    _combine_selected(QGraphicsROIBoolean::UNITE); 
+}
+
+void QGraphicsPolygonSelector::intersectSelected()
+{
+    _combine_selected(QGraphicsROIBoolean::INTERSECT); 
+}
+
+void QGraphicsPolygonSelector::subtractSelected()
+{
+    _combine_selected(QGraphicsROIBoolean::SUBTRACT); 
+}
+
+// selected ROIs are combined one by one with the result so far, starting 
+// from the largest one, and replaced by the result 
+void QGraphicsPolygonSelector::_combine_selected(QGraphicsROIBoolean::OPERATION operation)
+{
+    // masks are left out 
+    QList<QGraphicsItem*> items; 
+    foreach (QGraphicsItem* item, _selection->items()) {
+        if (qobject_cast<QGraphicsPolygonObject*>(item->toGraphicsObject())) {
+            items.append(item); 
+        }
+    }
+    if (items.size() < 2) {
+        return; 
+    }
+    QVector<QGraphicsROIShape> shapes; 
+    int largest = 0; 
+    qreal largest_area = 0; 
+    for (int i = 0; i < items.size(); i++) {
+        shapes.append(static_cast<QGraphicsPolygonObject*>(items[i]->toGraphicsObject())->roiShape()); 
+        qreal area = QGraphicsROIBoolean::area(QGraphicsROIBoolean::rings(shapes[i])); 
+        if (qAbs(area) > largest_area) {
+            largest = i; 
+            largest_area = qAbs(area); 
+        }
+    }
+    QVector<QPolygonF> rings = QGraphicsROIBoolean::rings(shapes[largest]); 
+    for (int i = 0; i < shapes.size(); i++) {
+        if (i != largest) {
+            rings = QGraphicsROIBoolean::apply(rings, QGraphicsROIBoolean::rings(shapes[i]), operation); 
+        }
+    }
+    foreach (QGraphicsItem* item, items) {
+        _remove_item(item); 
+    }
+    foreach (QGraphicsPolygonObject* item, _add_regions(QGraphicsROIBoolean::regions(rings))) {
+        item->setSelected(true); 
+    }
+}
+
+QList<QGraphicsPolygonObject*> QGraphicsPolygonSelector::addBooleanItems(const QGraphicsROIShape& subject, const QGraphicsROIShape& clip, 
+                                                                         QGraphicsROIBoolean::OPERATION operation, qreal tolerance)
+{
+    return _add_regions(QGraphicsROIBoolean::apply(subject, clip, operation, tolerance)); 
+}
+
+QList<QGraphicsPolygonObject*> QGraphicsPolygonSelector::_add_regions(const QVector<QGraphicsROIShape>& regions)
+{
+    QList<QGraphicsPolygonObject*> items; 
+    foreach (const QGraphicsROIShape& region, regions) {
+        items.append(_add_polygon_item(region.polygon, region.holes)); 
+    }
+    return items; 
+}
+
+void QGraphicsPolygonSelector::_remove_item(QGraphicsItem* item)
+{
+    _drag_index->removeItem(item); 
+    if (_overlay) {
+        _overlay->removeShape(item); 
+    }
+    if (_clusters) {
+        _clusters->removeItem(item); 
+    }
+    if (_publisher) {
+        _publisher->publishRemove(item); 
+    }
+    _changed_masks.remove(qobject_cast<QGraphicsMaskObject*>(item->toGraphicsObject())); 
+    delete item; 
+}
+
+void QGraphicsPolygonSelector::_publish(QGraphicsPolygonObject* item)
+{
+    if (_publisher) {
+        _publisher->publishShape(item, item->roiShape()); 
+    }
+}
+
+void QGraphicsPolygonSelector::_publish(QGraphicsPolygonObject* item, const QGraphicsROIShape& shape)
+{
+    if (_publisher) {
+        _publisher->publishShape(item, shape); 
+    }
+}
+
+void QGraphicsPolygonSelector::_publish(QGraphicsMaskObject* item)
+{
+    _changed_masks.remove(item); 
+    if (_publisher) {
+        _publisher->publishMask(item, item->rleMask()); 
+    }
+}
+
+// masks are sent whole, so once per stroke or drag rather than per move 
+void QGraphicsPolygonSelector::_publish_masks()
+{
+    if (_publisher) {
+        foreach (QGraphicsMaskObject* item, _changed_masks) {
+            _publisher->publishMask(item, item->rleMask()); 
+        }
+    }
+    _changed_masks.clear(); 
+}
+
+QGraphicsROIQueue* QGraphicsPolygonSelector::roiQueue() const
+{
+    return _queue; 
+}
+
+// visible ROIs of the scene 
+QList<QGraphicsItem*> QGraphicsPolygonSelector::_roi_list() const
+{
+    QList<QGraphicsItem*> items; 
+    foreach (QGraphicsItem* item, _scene.items()) {
+        if (item->isVisible() && qobject_cast<QGraphicsPolygonObject*>(item->toGraphicsObject())) {
+            items.append(item); 
+        }
+    }
+    return items; 
+}
+
+QVector<QGraphicsROIOverlap::Pair> QGraphicsPolygonSelector::findOverlaps(QList<QGraphicsItem*>& items, qreal tolerance)
+{
+    items = _roi_list(); 
+    QVector<QGraphicsROIShape> shapes; 
+    shapes.reserve(items.size()); 
+    foreach (QGraphicsItem* item, items) {
+        shapes.append(static_cast<QGraphicsPolygonObject*>(item->toGraphicsObject())->roiShape()); 
+    }
+    QGraphicsROIOverlap overlap(shapes, tolerance); 
+    return overlap.pairs(); 
+}
+
+void QGraphicsPolygonSelector::selectOverlapping(qreal iou_threshold)
+{
+    QList<QGraphicsItem*> items; 
+    QVector<QGraphicsROIOverlap::Pair> pairs = findOverlaps(items); 
+    _scene.clearSelection(); 
+    foreach (const QGraphicsROIOverlap::Pair& pair, pairs) {
+        if (pair.iou > iou_threshold) {
+            items[pair.first]->setSelected(true); 
+            items[pair.second]->setSelected(true); 
+        }
+    }
+}
+
+int QGraphicsPolygonSelector::removeDuplicates(qreal iou_threshold)
+{
+    QList<QGraphicsItem*> items = _roi_list(); 
+    QVector<QGraphicsROIShape> shapes; 
+    shapes.reserve(items.size()); 
+    foreach (QGraphicsItem* item, items) {
+        shapes.append(static_cast<QGraphicsPolygonObject*>(item->toGraphicsObject())->roiShape()); 
+    }
+    QGraphicsROIOverlap overlap(shapes); 
+    int removed = 0; 
+    foreach (const QVector<int>& group, overlap.duplicates(iou_threshold)) {
+        int largest = group.first(); 
+        foreach (int i, group) {
+            if (overlap.area(i) > overlap.area(largest)) {
+                largest = i; 
+            }
+        }
+        foreach (int i, group) {
+            if (i != largest) {
+                _remove_item(items[i]); 
+                removed++; 
+            }
+        }
+    }
+    return removed; 
+}
+
+// render static ROIs into cached tiles on worker threads 
+void QGraphicsPolygonSelector::setOverlayTiles(bool enabled)
+{
+    if (enabled == (_overlay != NULL)) {
+        return; 
+    }
+    if (enabled) {
+        _overlay = new QGraphicsOverlayTiles(this); 
+        _overlay->setSelection(_selection); 
+        foreach (QGraphicsItem* item, _scene.items()) {
+            QGraphicsPolygonObject* roi = qobject_cast<QGraphicsPolygonObject*>(item->toGraphicsObject()); 
+            if (roi) {
+                _overlay->setShape(roi, roi->roiShape(), roi->shapePen()); 
+            }
+        }
+    }
+    else {
+        delete _overlay; 
+        _overlay = NULL; 
+    }
+    viewport()->update(); 
+}
+
+// polygons and masks in the scene published as added, previews of masks 
+// are not selectable and not ROIs 
+void QGraphicsPolygonSelector::setPublisher(QGraphicsROIPublisher* publisher)
+{
+    _publisher = publisher; 
+    foreach (QGraphicsItem* item, _scene.items()) {
+        QGraphicsPolygonObject* roi = qobject_cast<QGraphicsPolygonObject*>(item->toGraphicsObject()); 
+        QGraphicsMaskObject* mask = qobject_cast<QGraphicsMaskObject*>(item->toGraphicsObject()); 
+        if (roi) {
+            _publish(roi); 
+        }
+        else if (mask && (mask->flags() & QGraphicsItem::ItemIsSelectable)) {
+            _publish(mask); 
+        }
+    }
+    if (_publisher) {
+        _publisher->publishCommit(); 
+    }
+}
+
+// draw small ROIs as clusters below full detail zoom 
+void QGraphicsPolygonSelector::setLevelOfDetail(bool enabled)
+{
+    if (enabled == (_clusters != NULL)) {
+        return; 
+    }
+    if (enabled) {
+        _clusters = new QGraphicsROIClusters(this); 
+        foreach (QGraphicsItem* item, _scene.items()) {
+            QGraphicsPolygonObject* roi = qobject_cast<QGraphicsPolygonObject*>(item->toGraphicsObject()); 
+            if (roi) {
+                _clusters->setItem(roi, roi->roiShape().boundingRect()); 
+            }
+        }
+    }
+    else {
+        delete _clusters; 
+        _clusters = NULL; 
+    }
+    viewport()->update(); 
+}
+
+void QGraphicsPolygonSelector::drawForeground(QPainter* painter, const QRectF& rect)
+{
+    if (_clusters) {
+        _clusters->paint(painter, rect); 
+    }
+}
+
 void QGraphicsPolygonSelector::keyPressEvent(QKeyEvent *event)
 {
-    if (event->key() == Qt::Key_Shift) {
+    // plus is shifted on most layouts, and its Shift, pressed first, has 
+    // entered drawing mode, so leave it. equal is the same key unshifted 
+    if (event->key() == Qt::Key_Plus || event->key() == Qt::Key_Equal) {
+        if (event->modifiers() & Qt::ShiftModifier) {
+            setDrawingMode(false);
+        }
+        scaleSelected(1.1);
+    }
+    else if (event->key() == Qt::Key_Shift) {
         setDrawingMode(true);
     }
+    else if (event->key() == Qt::Key_L) {
+        setLassoMode(true);
+    }
+    else if (event->key() == Qt::Key_B) {
+        setBrushMode(true);
+    }
+    else if (event->key() == Qt::Key_W) {
+        setWandMode(true);
+    }
+    else if (event->key() == Qt::Key_E) {
+        setEdgeSnapping(!_edge_snapping);
+    }
+    else if (event->key() == Qt::Key_S) {
+        setSuperpixelMode(true);
+    }
+    else if ((event->key() == Qt::Key_Return || event->key() == Qt::Key_Enter) && _superpixel_mode) {
+        _commit_superpixels();
+    }
+    else if (event->key() == Qt::Key_Control) {
+        setSelectingMode(true);
+    }
     else if (event->key() == Qt::Key_Escape) {
         setDrawingMode(false);
+        setBrushMode(false);
+        setWandMode(false);
+        setSuperpixelMode(false);
+        setSelectingMode(false);
+    }
+    else if (event->key() == Qt::Key_Delete) {
+        deleteSelected();
+    }
+    else if (event->key() == Qt::Key_Left) {
+        moveSelected(QPointF(-1, 0));
+    }
+    else if (event->key() == Qt::Key_Right) {
+        moveSelected(QPointF(1, 0));
+    }
+    else if (event->key() == Qt::Key_Up) {
+        moveSelected(QPointF(0, -1));
+    }
+    else if (event->key() == Qt::Key_Down) {
+        moveSelected(QPointF(0, 1));
+    }
+    else if (event->key() == Qt::Key_Minus) {
+        scaleSelected(1 / 1.1);
+    }
+    else if (event->key() == Qt::Key_U) {
+        uniteSelected();
+    }
+    else if (event->key() == Qt::Key_I) {
+        intersectSelected();
+    }
+    else if (event->key() == Qt::Key_D) {
+        subtractSelected();
+    }
+    _publish_masks(); 
+    if (_publisher) {
+        _publisher->publishCommit(); 
     }
     // forward key press anyway
     QWidget::keyPressEvent(event);
@@ -67,29 +723,28 @@ void QGraphicsPolygonSelector::keyPressEvent(QKeyEvent *event)
 
 void QGraphicsPolygonSelector::_clear_drawing()
 {
-    if (_drawing_line) {
-        _scene.removeItem(_drawing_line);
-        delete _drawing_line;
-        _drawing_line = NULL;
-    }
-    for (int i = 0; i < _drawing_items.size(); i++) {
-        QGraphicsItem* item = _drawing_items[i];
-        _scene.removeItem(item);
-        delete item;
-    }
-    _drawing_items.clear();
-    _drawing_points.clear();
+    _drawing_lasso->clear();
+    _snapped_path.clear();
 }
 
 void QGraphicsPolygonSelector::_prepare_drawing(const QPointF& pos)
 {
     _clear_drawing(); 
-    assert(!_drawing_line);
-    assert(_drawing_items.size() == 0); 
-    assert(_drawing_points.size() == 0); 
+    // tolerance in scene units of one device pixel 
+    qreal scale = qSqrt(qAbs(transform().determinant()));
+    _drawing_lasso->setTolerance(_lasso_mode && scale > 0 ? _lasso_tolerance / scale : 0);
     // first point 
-    _drawing_points.append(pos);
-    _drawing_line = scene()->addLine(pos.x(), pos.y(), pos.x(), pos.y(), _drawing_pen);
+    _drawing_lasso->addPoint(pos);
+    if (_edge_snapping && !_lasso_mode) {
+        _live_wire->setSeed(_image_pos(pos));
+    }
+}
+
+// pixel of background under pos in scene coords 
+QPoint QGraphicsPolygonSelector::_image_pos(const QPointF& pos) const
+{
+    QPointF image_pos = _background->mapFromScene(pos);
+    return QPoint(qFloor(image_pos.x()), qFloor(image_pos.y()));
 }
 
 // polygon drawing with mouse:
@@ -98,34 +753,73 @@ void QGraphicsPolygonSelector::_prepare_drawing(const QPointF& pos)
 // drawing lines between added points and
 // from the last point to current mouse position;
 // complete polygon with right click;
+// with edge snapping, the line to current mouse position follows edges, and 
+// the path along edges is added with left release; 
 // cancel drawing when drawing mode is disabled;
+// in lasso mode, adding decimated points on mouse move with left button down 
+// and complete polygon with left release; 
+// in brush mode, painting mask with left button and erasing with right button; 
+// in wand mode, selecting similar pixels around left press, with tolerance 
+// changed by dragging, and adding the region with left release; 
+// in superpixel mode, adding or removing the superpixel under the mouse with 
+// left press, and adding the region with right press; 
 void QGraphicsPolygonSelector::mousePressEvent(QMouseEvent* event)
 {
-    if (_drawing_mode) {
+    if (_superpixel_mode) {
+        if (event->button() == Qt::LeftButton) {
+            // label mask in the bound of the label only 
+            int label = _superpixels->label(_image_pos(mapToScene(event->pos())));
+            if (label >= 0) {
+                QSet<int> labels;
+                labels.insert(label);
+                QGraphicsRLEMask mask = _superpixels->region(labels).translated(_background->pos().toPoint());
+                QGraphicsROIBoolean::OPERATION operation = QGraphicsROIBoolean::UNITE;
+                if (_superpixel_labels.contains(label)) {
+                    _superpixel_labels.remove(label);
+                    operation = QGraphicsROIBoolean::SUBTRACT;
+                }
+                else {
+                    _superpixel_labels.insert(label);
+                }
+                _superpixel_region = QGraphicsRLEMask::apply(_superpixel_region, mask, operation);
+                _superpixel_preview->setRleMask(_superpixel_region);
+            }
+        }
+        else if (event->button() == Qt::RightButton) {
+            _commit_superpixels();
+        }
+    }
+    else if (_wand_mode) {
+        if (event->button() == Qt::LeftButton) {
+            _wand_press = event->pos();
+            _wand_drag_tolerance = _wand_tolerance;
+            _wand_commit = false;
+            _wand_region = QGraphicsRLEMask();
+            _wand_preview->clear();
+            _wand->select(_image_pos(mapToScene(event->pos())), _wand_tolerance);
+        }
+    }
+    else if (_brush_mode) {
+        if (event->button() == Qt::LeftButton || event->button() == Qt::RightButton) {
+            if (!_brush_item) {
+                addMaskItem(); 
+            }
+            _brush_pos = mapToScene(event->pos());
+            _brush_item->paintStroke(_brush_pos, _brush_pos, _brush_radius, event->button() == Qt::RightButton);
+        }
+    }
+    else if (_drawing_mode) {
         if (event->button() == Qt::LeftButton) {
             QPointF mouse_point = mapToScene(event->pos());
-            if (_drawing_points.empty()) {
+            if (_drawing_lasso->isEmpty()) {
                 // add first point with left mouse press 
                 _prepare_drawing(mouse_point);
             }
-            // else { 
-            //     // add following points with left mouse press 
-            //     QPointF last_point = _drawing_points.last(); 
-            //     if (mouse_point != last_point) {
-            //         // add a point 
-            //         _drawing_points.append(mouse_point); 
-            //         assert(_drawing_line); 
-            //         _drawing_line->setLine(last_point.x(), last_point.y(), mouse_point.x(), mouse_point.y());
-            //         _drawing_items.append(_drawing_line); 
-            //         _drawing_line = scene()->addLine(mouse_point.x(), mouse_point.y(),
-            //                                 mouse_point.x(), mouse_point.y(), _drawing_pen);
-            //     }
-            // }
         }
-        else if (event->button() == Qt::RightButton) {
+        else if (event->button() == Qt::RightButton && !_lasso_mode) {
             // complete drawing
-            if (_drawing_points.size() > 3) {
-                addPolygonItem(QPolygonF(_drawing_points));
+            if (_drawing_lasso->points().size() > 3) {
+                addPolygonItem(_drawing_lasso->points());
             }
             _clear_drawing(); 
             setDrawingMode(false);
@@ -139,13 +833,43 @@ void QGraphicsPolygonSelector::mousePressEvent(QMouseEvent* event)
 // update line from last point to current mouse position 
 void QGraphicsPolygonSelector::mouseMoveEvent(QMouseEvent* event)
 {
-    if (_drawing_mode) {
-        if (_drawing_line) {
-            // set the line from last point to mouse
-            assert(_drawing_points.size() > 0); 
+    if (_superpixel_mode) {
+        _hover_superpixel(mapToScene(event->pos()));
+    }
+    else if (_wand_mode) {
+        // one tolerance step per two device pixels, the running fill is replaced 
+        if (event->buttons() & Qt::LeftButton) {
+            int tolerance = qBound(0, _wand_tolerance + (event->pos().x() - _wand_press.x()) / 2, 255);
+            if (tolerance != _wand_drag_tolerance) {
+                _wand_drag_tolerance = tolerance;
+                _wand->setTolerance(tolerance);
+            }
+        }
+    }
+    else if (_brush_mode) {
+        // stamp from last position, so fast moves leave no gaps 
+        if (_brush_item && (event->buttons() & (Qt::LeftButton | Qt::RightButton))) {
             QPointF mouse_point = mapToScene(event->pos());
-            QPointF last_point = _drawing_points.last();
-            _drawing_line->setLine(last_point.x(), last_point.y(), mouse_point.x(), mouse_point.y());
+            _brush_item->paintStroke(_brush_pos, mouse_point, _brush_radius, !(event->buttons() & Qt::LeftButton));
+            _brush_pos = mouse_point;
+        }
+    }
+    else if (_drawing_mode) {
+        if (!_drawing_lasso->isEmpty()) {
+            QPointF mouse_point = mapToScene(event->pos());
+            if (_lasso_mode) {
+                if (event->buttons() & Qt::LeftButton) {
+                    _drawing_lasso->addSample(mouse_point);
+                }
+            }
+            else if (_edge_snapping) {
+                // path along edges from last point to mouse, set when ready 
+                _live_wire->setTarget(_image_pos(mouse_point));
+            }
+            else {
+                // set the line from last point to mouse
+                _drawing_lasso->setFloatingPoint(mouse_point);
+            }
         }
     }
     QGraphicsView::mouseMoveEvent(event);
@@ -153,44 +877,238 @@ void QGraphicsPolygonSelector::mouseMoveEvent(QMouseEvent* event)
 
 void QGraphicsPolygonSelector::mouseReleaseEvent(QMouseEvent* event)
 {
-    if (_drawing_mode) {
+    if (_wand_mode) {
+        // add region now, or when the fill of the last tolerance returns 
         if (event->button() == Qt::LeftButton) {
-            // add following points with left mouse release 
+            _wand_tolerance = _wand_drag_tolerance;
+            _wand_commit = true;
+            if (!_wand->isBusy()) {
+                _commit_wand();
+            }
+        }
+    }
+    else if (_brush_mode) {
+        if (_brush_item) {
+            Q_EMIT metricsChanged(_brush_item, _brush_item->metrics()); 
+        }
+    }
+    else if (_drawing_mode) {
+        if (event->button() == Qt::LeftButton && !_drawing_lasso->isEmpty()) {
             QPointF mouse_point = mapToScene(event->pos());
-            assert(_drawing_points.size() > 0); 
-            QPointF last_point = _drawing_points.last(); 
-            if (mouse_point != last_point) {
-                // add a point 
-                _drawing_points.append(mouse_point); 
-                assert(_drawing_line); 
-                _drawing_line->setLine(last_point.x(), last_point.y(), mouse_point.x(), mouse_point.y());
-                _drawing_items.append(_drawing_line); 
-                _drawing_line = scene()->addLine(mouse_point.x(), mouse_point.y(),
-                                         mouse_point.x(), mouse_point.y(), _drawing_pen);
+            if (_lasso_mode) {
+                // complete lasso with left mouse release 
+                _drawing_lasso->addSample(mouse_point);
+                QPolygonF polygon = _drawing_lasso->polygon();
+                if (polygon.size() > 2) {
+                    addPolygonItem(polygon);
+                }
+                _clear_drawing(); 
+                setLassoMode(false);
+            }
+            else if (_edge_snapping) {
+                // add turning points of the path along edges, then search from the end 
+                for (int i = 1; i < _snapped_path.size(); i++) {
+                    _drawing_lasso->addPoint(_snapped_path[i]);
+                }
+                if (_snapped_path.isEmpty() || _image_pos(_snapped_path.last()) != _image_pos(mouse_point)) {
+                    _drawing_lasso->addPoint(mouse_point);
+                }
+                _snapped_path.clear();
+                _live_wire->setSeed(_image_pos(_drawing_lasso->points().last()));
+            }
+            else {
+                // add following points with left mouse release 
+                _drawing_lasso->addPoint(mouse_point);
             }
         }
     }
     QGraphicsView::mouseReleaseEvent(event);
+    // items are selected by the view 
+    if (_selecting_mode && event->button() == Qt::LeftButton) {
+        setSelectingMode(false);
+    }
+    _publish_masks(); 
+    if (_publisher) {
+        _publisher->publishCommit(); 
+    }
 }
 
 // on polygon moving and resizing 
 void QGraphicsPolygonSelector::onPolygonChanged(const QPolygonF& polygon)
 {
+    QGraphicsPolygonObject* item = qobject_cast<QGraphicsPolygonObject*>(sender()); 
+    if (item) {
+        _update_shapes(QList<QGraphicsItem*>() << item); 
+    }
     setDrawingMode(false);
 }
 
-// response to mouse click or set selection
-void QGraphicsPolygonSelector::onSelectionChanged()
+// metrics follow a moved vertex incrementally, shape is updated on release 
+void QGraphicsPolygonSelector::onVertexMoved(int, const QPointF&)
 {
-    QList<QGraphicsItem*> selections = _scene.selectedItems();
-    if (selections.empty()) {
-        //qDebug() << "No selected item";
+    QGraphicsPolygonObject* item = qobject_cast<QGraphicsPolygonObject*>(sender()); 
+    if (item) {
+        Q_EMIT metricsChanged(item, item->metrics()); 
     }
-    else if (selections.size() == 1) {
-        // one item is selected
-        QGraphicsItem* item = selections[0];
+}
+
+// published on release 
+void QGraphicsPolygonSelector::onMaskChanged(const QRectF&)
+{
+    QGraphicsMaskObject* item = qobject_cast<QGraphicsMaskObject*>(sender()); 
+    if (item) {
+        _changed_masks.insert(item); 
     }
-    else {
-        //qDebug() << "Number of selected items is greater than 1";
+}
+
+// dragging with all selected items 
+void QGraphicsPolygonSelector::onDragStarted()
+{
+    _drag_index->begin(qobject_cast<QGraphicsPolygonObject*>(sender())); 
+}
+
+// moving of a large selection, or group edit, notified once 
+void QGraphicsPolygonSelector::onItemsMoved(const QList<QGraphicsItem*>& items)
+{
+    _update_shapes(items);
+    setDrawingMode(false);
+}
+
+void QGraphicsPolygonSelector::_update_shapes(const QList<QGraphicsItem*>& items)
+{
+    foreach (QGraphicsItem* it, items) {
+        QGraphicsPolygonObject* item = qobject_cast<QGraphicsPolygonObject*>(it->toGraphicsObject()); 
+        if (item) {
+            QGraphicsROIShape shape = item->roiShape(); 
+            if (_overlay) {
+                _overlay->setShape(item, shape, item->shapePen()); 
+            }
+            if (_clusters) {
+                _clusters->setItem(item, shape.boundingRect()); 
+            }
+            _publish(item, shape); 
+            Q_EMIT metricsChanged(item, item->metrics()); 
+        }
+        QGraphicsMaskObject* mask = qobject_cast<QGraphicsMaskObject*>(it->toGraphicsObject()); 
+        if (mask) {
+            _publish(mask); 
+            Q_EMIT metricsChanged(mask, mask->metrics()); 
+        }
     }
 }
+
+// ROIs from worker threads, applied as one batch within the budget of the 
+// frame of the queue, the rest in next frames, without interrupting drawing. 
+// added and changed items are indexed by the scene in one pass at next query 
+void QGraphicsPolygonSelector::onRecordsReady()
+{
+    QSet<QGraphicsItem*> changed;
+    QGraphicsROIQueue::Record record;
+    while (_queue->take(record)) {
+        QGraphicsPolygonObject* item = _roi_items.value(record.id);
+        switch (record.type) {
+        case QGraphicsROIQueue::ADD_ROI:
+        case QGraphicsROIQueue::UPDATE_ROI:
+            if (item) {
+                item->setPolygon(record.shape.toPolygon());
+                item->setHoles(record.shape.holes);
+                changed.insert(item);
+            }
+            else {
+                item = _add_polygon_item(record.shape.toPolygon(), record.shape.holes);
+                item->setRoiId(record.id);
+                _roi_items.insert(record.id, item);
+            }
+            break;
+        case QGraphicsROIQueue::REMOVE_ROI:
+            if (item) {
+                changed.remove(item);
+                _remove_item(item);
+            }
+            _roi_items.remove(record.id);
+            break;
+        default:
+            break;
+        }
+    }
+    _update_shapes(changed.toList());
+    if (_publisher) {
+        _publisher->publishCommit(); 
+    }
+}
+
+// path of the latest mouse position, in image coords 
+void QGraphicsPolygonSelector::onSnappedPath(const QPolygonF& path)
+{
+    if (!_drawing_mode || _lasso_mode || !_edge_snapping || _drawing_lasso->isEmpty() || path.isEmpty()) {
+        return;
+    }
+    _snapped_path = _background->mapToScene(path);
+    _drawing_lasso->setFloatingPath(_snapped_path);
+}
+
+// superpixels of an image set before are ready 
+void QGraphicsPolygonSelector::onSegmentationReady()
+{
+    _superpixel_hover = -1;
+}
+
+// highlight superpixel under pos, in scene coords, redrawn when it changes 
+void QGraphicsPolygonSelector::_hover_superpixel(const QPointF& pos)
+{
+    int label = _superpixels->label(_image_pos(pos));
+    if (label == _superpixel_hover) {
+        return;
+    }
+    _superpixel_hover = label;
+    QSet<int> labels;
+    if (label >= 0) {
+        labels.insert(label);
+    }
+    _superpixel_highlight->setRleMask(_superpixels->region(labels).translated(_background->pos().toPoint()));
+}
+
+void QGraphicsPolygonSelector::_commit_superpixels()
+{
+    QList<QGraphicsPolygonObject*> items = _add_regions(_superpixel_region.toShapes());
+    foreach (QGraphicsPolygonObject* item, items) {
+        Q_EMIT metricsChanged(item, item->metrics());
+    }
+    _superpixel_labels.clear();
+    _superpixel_region = QGraphicsRLEMask();
+    _superpixel_preview->clear();
+}
+
+// preview region until released, in scene coords 
+void QGraphicsPolygonSelector::onWandRegion(const QPoint& seed, int tolerance, const QGraphicsRLEMask& region)
+{
+    Q_UNUSED(seed);
+    Q_UNUSED(tolerance);
+    if (!_wand_mode) {
+        return;
+    }
+    _wand_region = region.translated(_background->pos().toPoint());
+    _wand_preview->setRleMask(_wand_region);
+    if (_wand_commit && !_wand->isBusy()) {
+        _commit_wand();
+    }
+}
+
+// region traced along pixel borders into polygons with holes 
+void QGraphicsPolygonSelector::_commit_wand()
+{
+    QList<QGraphicsPolygonObject*> items = _add_regions(_wand_region.toShapes());
+    foreach (QGraphicsPolygonObject* item, items) {
+        Q_EMIT metricsChanged(item, item->metrics());
+    }
+    _wand_commit = false;
+    _wand_region = QGraphicsRLEMask();
+    _wand_preview->clear();
+}
+
+// nearest neighbour background on fast path 
+void QGraphicsPolygonSelector::onQualityChanged(int fast_path)
+{
+    bool nearest = fast_path & QGraphicsRenderQuality::NEAREST_BACKGROUND;
+    _background->setSmooth(!nearest);
+}
@@ -2,8 +2,23 @@
 
 #include <QGraphicsView>
 #include <QGraphicsScene>
+#include <QPointer>
+#include "QGraphicsOverlayTiles.h"
+#include "QGraphicsROIClusters.h"
+#include "QGraphicsDragIndex.h"
+#include "QGraphicsROISelection.h"
+#include "QGraphicsROIQueue.h"
+#include "QGraphicsROIOverlap.h"
+#include "QGraphicsROIBoolean.h"
+#include "QGraphicsPolygonObject.h"
+#include "QGraphicsLassoItem.h"
+#include "QGraphicsMaskObject.h"
+#include "QGraphicsMagicWand.h"
+#include "QGraphicsLiveWire.h"
+#include "QGraphicsSuperpixels.h"
+#include "QGraphicsImageItem.h"
+#include "QGraphicsROIPublisher.h"
 #include <QGraphicsItem>
-#include <QGraphicsLineItem>
 #include <QPen>
 
 /*!
@@ -11,7 +26,24 @@
  * When the "shift" key is pressed, user may draw polygon point by press the 
  * left mouse key and complete the polygon by press the right mouse key. 
  * Press "esc" key to cancel the polygon drawing. 
+ * Press "e" key to toggle snapping of the segment to the mouse onto edges of 
+ * the background, and the path along the edges is added when clicked. 
+ * When the "l" key is pressed, user may draw a freehand lasso by dragging with 
+ * the left mouse key, and the polygon is completed when the key is released. 
+ * When the "b" key is pressed, user may paint a mask ROI with a brush by 
+ * dragging with the left mouse key, and erase it with the right mouse key. 
+ * When the "w" key is pressed, user may click on the background to select the 
+ * region of similar pixels with a magic wand, dragging to the right or left 
+ * raises or lowers the tolerance, and the region is added when released. 
+ * When the "s" key is pressed, user may click superpixels of the background to 
+ * add them to a ROI, or remove them, and complete it with the right mouse key 
+ * or "enter" key. 
  * User may click on a polygon to move and resize the ROI.   
+ * When the "ctrl" key is pressed, user may select ROIs in an area with rubber 
+ * band. Selected ROIs are moved with arrow keys, scaled with "+" and "-" keys 
+ * and deleted with "delete" key, as a group. 
+ * Selected ROIs are replaced by their union with "u" key, their intersection 
+ * with "i" key, or the largest one less the others with "d" key. 
  * The view needs to get focus, by setFocus(), to capture the key press. 
  */
 class QGraphicsPolygonSelector : public QGraphicsView
@@ -21,13 +53,98 @@ public:
     QGraphicsPolygonSelector(QWidget *parent = 0);
     ~QGraphicsPolygonSelector();
 
+    // queue of ROIs from worker threads, drained on GUI thread once per frame 
+    QGraphicsROIQueue* roiQueue() const;
+
+    // overlapping pairs of visible ROIs, indices into the list of ROIs given 
+    QVector<QGraphicsROIOverlap::Pair> findOverlaps(QList<QGraphicsItem*>& items, qreal tolerance = 0.5);
+
+    // keep the largest ROI of each group of duplicates, return number of ROIs removed 
+    int removeDuplicates(qreal iou_threshold);
+
+    // add polygons, with holes, of boolean operation between two shapes of any type 
+    QList<QGraphicsPolygonObject*> addBooleanItems(const QGraphicsROIShape& subject, const QGraphicsROIShape& clip, 
+                                                   QGraphicsROIBoolean::OPERATION operation, qreal tolerance = 0.5);
+
+    // image shown below ROIs, pixel (x, y) at scene (x, y), and picked by magic wand 
+    void setBackgroundImage(const QImage& image);
+
+    // image kept at native depth, 16 bit or float, shown through a window and colormap, 
+    // tools work on it windowed to its range 
+    void setBackgroundData(const QGraphicsImageData& data);
+    // frames of a camera, converted only where visible, tools keep the last 
+    // image given above 
+    void setBackgroundFrame(const QGraphicsImageData& frame);
+    void setBackgroundWindow(double low, double high);
+    void setBackgroundColormap(QGraphicsImageData::COLORMAP colormap);
+
+    // statistics of native background values under a polygon or mask ROI 
+    QGraphicsImageData::Statistics backgroundStatistics(QGraphicsItem* item) const;
+
 public slots: 
     // add a polygon  
-    void addPolygonItem(const QPolygonF& polygon);
+    QGraphicsPolygonObject* addPolygonItem(const QPolygonF& polygon);
+
+    // add an empty mask, painted by following brush strokes 
+    QGraphicsMaskObject* addMaskItem();
 
     // enable polygon drawing with mouse
     virtual void setDrawingMode(bool drawing);
 
+    // enable freehand lasso drawing, samples decimated to tolerance in device pixels 
+    void setLassoMode(bool lasso);
+    void setLassoTolerance(qreal pixels);
+
+    // segments of polygon drawing follow edges of the background 
+    void setEdgeSnapping(bool snapping);
+
+    // enable painting of masks with a brush of given radius in scene units 
+    void setBrushMode(bool brush);
+    void setBrushRadius(qreal radius);
+
+    // enable magic wand selection on the background, with tolerance 0 to 255 
+    void setWandMode(bool wand);
+    void setWandTolerance(int tolerance);
+
+    // enable assembling of ROIs from superpixels of the background 
+    void setSuperpixelMode(bool superpixel);
+
+    // enable area selection with rubber band 
+    void setSelectingMode(bool selecting);
+
+    // edit all selected items as a group, with one repaint and notification 
+    void moveSelected(const QPointF& offset);
+    void scaleSelected(qreal factor);
+    void transformSelected(const QTransform& transform);
+    void deleteSelected();
+
+    // replace selected ROIs by their union, intersection, or the largest one less the others 
+    void uniteSelected();
+    void intersectSelected();
+    void subtractSelected();
+
+    // select ROIs overlapping another one with IoU over threshold 
+    void selectOverlapping(qreal iou_threshold);
+
+    // render static ROIs into cached tiles on worker threads 
+    void setOverlayTiles(bool enabled);
+
+    // draw small ROIs as clusters below full detail zoom 
+    void setLevelOfDetail(bool enabled);
+
+    // stream changes of polygon and mask ROIs to other processes, committed on 
+    // mouse release and key press, current ROIs published first, masks changed 
+    // by strokes or drags published on release 
+    void setPublisher(QGraphicsROIPublisher* publisher);
+
+signals:
+    // measurements of a ROI changed by an edit, or moved with a group 
+    void metricsChanged(QGraphicsItem* item, const QGraphicsROIMetrics& metrics);
+
+protected:
+    // composite clusters, overlay tiles are an item of the scene 
+    void drawForeground(QPainter* painter, const QRectF& rect);
+
 private slots:
     // press "shift" key to draw polygon 
     void keyPressEvent(QKeyEvent *event);
@@ -39,18 +156,85 @@ private slots:
 
     // on polygon moving and resizing 
     void onPolygonChanged(const QPolygonF&);
+    void onVertexMoved(int index, const QPointF& pos);
+
+    // on pixels of a mask painted or moved 
+    void onMaskChanged(const QRectF& rect);
+
+    // render background with lower fidelity on fast path
+    void onQualityChanged(int fast_path);
+
+    // on dragging of a large selection, and group edits 
+    void onDragStarted();
+    void onItemsMoved(const QList<QGraphicsItem*>& items);
+
+    // on ROIs from worker threads 
+    void onRecordsReady();
+
+    // on path along edges to the mouse 
+    void onSnappedPath(const QPolygonF& path);
+
+    // on superpixels of background 
+    void onSegmentationReady();
 
-    // on selection of the polygons 
-    void onSelectionChanged();
+    // on region of magic wand 
+    void onWandRegion(const QPoint& seed, int tolerance, const QGraphicsRLEMask& region);
 
 private:
     QGraphicsScene _scene;
+    QGraphicsImageItem* _background;
+    QGraphicsOverlayTiles* _overlay;
+    QGraphicsROIClusters* _clusters;
+    QPointer<QGraphicsROIPublisher> _publisher;
+    QSet<QGraphicsMaskObject*> _changed_masks; // not yet published 
+    QGraphicsDragIndex* _drag_index;
+    QGraphicsROISelection* _selection;
+    bool _selecting_mode;
+    QGraphicsROIQueue* _queue;
+    QHash<qint64, QPointer<QGraphicsPolygonObject> > _roi_items;
     bool _drawing_mode;
-    QVector<QPointF> _drawing_points;
-    QVector<QGraphicsItem*> _drawing_items;
-    QGraphicsLineItem* _drawing_line;
+    bool _lasso_mode;
+    qreal _lasso_tolerance;
+    QGraphicsLassoItem* _drawing_lasso;
     QPen _drawing_pen;
+    QGraphicsLiveWire* _live_wire;
+    bool _edge_snapping;
+    QPolygonF _snapped_path; // from last vertex, in scene coords 
+    bool _brush_mode;
+    qreal _brush_radius;
+    QPointer<QGraphicsMaskObject> _brush_item;
+    QPointF _brush_pos;
+    QGraphicsMagicWand* _wand;
+    bool _wand_mode;
+    int _wand_tolerance;
+    int _wand_drag_tolerance; // while dragging 
+    QPoint _wand_press; // in device pixels 
+    bool _wand_commit; // add region once the last one arrives 
+    QGraphicsRLEMask _wand_region; // in scene coords 
+    QGraphicsMaskObject* _wand_preview;
+    QGraphicsSuperpixels* _superpixels;
+    bool _superpixel_mode;
+    int _superpixel_hover; // label under mouse 
+    QSet<int> _superpixel_labels; // clicked 
+    QGraphicsRLEMask _superpixel_region; // of clicked, in scene coords 
+    QGraphicsMaskObject* _superpixel_preview;
+    QGraphicsMaskObject* _superpixel_highlight;
 
+    void _update_shapes(const QList<QGraphicsItem*>& items);
+    void _remove_item(QGraphicsItem* item);
+    void _publish(QGraphicsPolygonObject* item);
+    void _publish(QGraphicsPolygonObject* item, const QGraphicsROIShape& shape);
+    void _publish(QGraphicsMaskObject* item);
+    void _publish_masks();
+    QList<QGraphicsItem*> _roi_list() const;
+    void _combine_selected(QGraphicsROIBoolean::OPERATION operation);
+    QGraphicsPolygonObject* _add_polygon_item(const QPolygonF& polygon, const QVector<QPolygonF>& holes);
+    QList<QGraphicsPolygonObject*> _add_regions(const QVector<QGraphicsROIShape>& regions);
     void _clear_drawing(); 
     void _prepare_drawing(const QPointF& pos); 
+    void _commit_wand(); 
+    void _commit_superpixels(); 
+    void _hover_superpixel(const QPointF& pos); 
+    QPoint _image_pos(const QPointF& pos) const; 
+    void _set_background(const QGraphicsImageData& data, const QImage& image); 
 };
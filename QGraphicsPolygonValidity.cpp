@@ -0,0 +1,287 @@
+#include "QGraphicsPolygonValidity.h"
+#include <qmath.h>
+#include <algorithm>
+
+#define MAX_EDGE_CELLS 64
+
+static quint64 _cell_key(int cx, int cy)
+{
+    return (quint64(quint32(cx)) << 32) | quint32(cy);
+}
+
+static qreal _cross(const QPointF& a, const QPointF& b)
+{
+    return a.x() * b.y() - a.y() * b.x();
+}
+
+static int _sign(qreal value)
+{
+    return value > 0 ? 1 : (value < 0 ? -1 : 0);
+}
+
+// point on segment, known to be collinear
+static bool _on_segment(const QPointF& a, const QPointF& b, const QPointF& p)
+{
+    return qMin(a.x(), b.x()) <= p.x() && p.x() <= qMax(a.x(), b.x()) &&
+           qMin(a.y(), b.y()) <= p.y() && p.y() <= qMax(a.y(), b.y());
+}
+
+QGraphicsPolygonValidity::QGraphicsPolygonValidity()
+    : _cell_size(1)
+    , _stamp(0)
+{
+
+}
+
+void QGraphicsPolygonValidity::reset(const QPolygonF& polygon)
+{
+    _polygon = polygon;
+    int n = _polygon.size();
+    _grid.clear();
+    _partners.clear();
+    _partners.resize(n);
+    _invalid_edges.clear();
+    _stamps.fill(0, n);
+    _stamp = 0;
+    if (n < 3) {
+        return;
+    }
+
+    // cells about the mean edge size
+    qreal size = 0;
+    for (int i = 0; i < n; i++) {
+        QRectF bound = _edge_bound(i);
+        size += qMax(bound.width(), bound.height());
+    }
+    _cell_size = size > 0 ? size / n : 1;
+    for (int i = 0; i < n; i++) {
+        _insert(i);
+    }
+
+    QHash<int, bool> before;
+    for (int i = 0; i < n; i++) {
+        _test(i, before, true);
+    }
+}
+
+// the two edges of the vertex leave their cells and crossings, and are
+// tested again at the new position
+QVector<int> QGraphicsPolygonValidity::moveVertex(int index, const QPointF& pos)
+{
+    int n = _polygon.size();
+    QVector<int> changed;
+    if (n < 3) {
+        _polygon[index] = pos;
+        return changed;
+    }
+    int edges[2] = { (index + n - 1) % n, index };
+
+    // validity before the move of all edges involved
+    QHash<int, bool> before;
+    for (int k = 0; k < 2; k++) {
+        int edge = edges[k];
+        before.insert(edge, _partners[edge].isEmpty());
+        foreach (int partner, _partners[edge]) {
+            before.insert(partner, _partners[partner].isEmpty());
+        }
+    }
+    for (int k = 0; k < 2; k++) {
+        int edge = edges[k];
+        foreach (int partner, _partners[edge]) {
+            _partners[partner].removeOne(edge);
+        }
+        _partners[edge].clear();
+        _remove(edge);
+    }
+
+    _polygon[index] = pos;
+    for (int k = 0; k < 2; k++) {
+        _insert(edges[k]);
+    }
+    for (int k = 0; k < 2; k++) {
+        _test(edges[k], before, false);
+    }
+
+    QHash<int, bool>::const_iterator it;
+    for (it = before.constBegin(); it != before.constEnd(); ++it) {
+        bool valid = _partners[it.key()].isEmpty();
+        if (valid != it.value()) {
+            changed.append(it.key());
+            if (valid) {
+                _invalid_edges.remove(it.key());
+            }
+            else {
+                _invalid_edges.insert(it.key());
+            }
+        }
+    }
+    return changed;
+}
+
+bool QGraphicsPolygonValidity::isValid() const
+{
+    return _invalid_edges.isEmpty();
+}
+
+bool QGraphicsPolygonValidity::isEdgeValid(int edge) const
+{
+    return !_invalid_edges.contains(edge);
+}
+
+const QSet<int>& QGraphicsPolygonValidity::invalidEdges() const
+{
+    return _invalid_edges;
+}
+
+QRectF QGraphicsPolygonValidity::_edge_bound(int edge) const
+{
+    const QPointF& a = _polygon[edge];
+    const QPointF& b = _polygon[(edge + 1) % _polygon.size()];
+    return QRectF(QPointF(qMin(a.x(), b.x()), qMin(a.y(), b.y())),
+                  QPointF(qMax(a.x(), b.x()), qMax(a.y(), b.y())));
+}
+
+bool QGraphicsPolygonValidity::_adjacent(int e0, int e1) const
+{
+    int n = _polygon.size();
+    return (e0 + 1) % n == e1 || (e1 + 1) % n == e0;
+}
+
+bool QGraphicsPolygonValidity::_crossing(int e0, int e1) const
+{
+    int n = _polygon.size();
+    const QPointF& a = _polygon[e0];
+    const QPointF& b = _polygon[(e0 + 1) % n];
+    const QPointF& c = _polygon[e1];
+    const QPointF& d = _polygon[(e1 + 1) % n];
+    if (_adjacent(e0, e1)) {
+        // folding back at the shared vertex
+        bool forward = (e0 + 1) % n == e1;
+        QPointF u = forward ? a - b : b - a;
+        QPointF v = forward ? d - c : c - d;
+        return _cross(u, v) == 0 && QPointF::dotProduct(u, v) > 0;
+    }
+    int o1 = _sign(_cross(b - a, c - a));
+    int o2 = _sign(_cross(b - a, d - a));
+    int o3 = _sign(_cross(d - c, a - c));
+    int o4 = _sign(_cross(d - c, b - c));
+    if (o1 != o2 && o3 != o4) {
+        return true;
+    }
+    return (o1 == 0 && _on_segment(a, b, c)) || (o2 == 0 && _on_segment(a, b, d)) ||
+           (o3 == 0 && _on_segment(c, d, a)) || (o4 == 0 && _on_segment(c, d, b));
+}
+
+// cells of the edge bound, or of the cells walked along a long edge and their
+// neighbours, so rounding at cell borders never misses a crossing
+void QGraphicsPolygonValidity::_cells(int edge, QVector<quint64>& keys) const
+{
+    keys.clear();
+    QRectF bound = _edge_bound(edge);
+    int x0 = qFloor(bound.left() / _cell_size);
+    int x1 = qFloor(bound.right() / _cell_size);
+    int y0 = qFloor(bound.top() / _cell_size);
+    int y1 = qFloor(bound.bottom() / _cell_size);
+    if (qint64(x1 - x0 + 1) * (y1 - y0 + 1) <= MAX_EDGE_CELLS) {
+        for (int cy = y0; cy <= y1; cy++) {
+            for (int cx = x0; cx <= x1; cx++) {
+                keys.append(_cell_key(cx, cy));
+            }
+        }
+        return;
+    }
+    const QPointF& a = _polygon[edge];
+    const QPointF& b = _polygon[(edge + 1) % _polygon.size()];
+    QPointF d = b - a;
+    int cx = qFloor(a.x() / _cell_size);
+    int cy = qFloor(a.y() / _cell_size);
+    int ex = qFloor(b.x() / _cell_size);
+    int ey = qFloor(b.y() / _cell_size);
+    int step_x = d.x() > 0 ? 1 : -1;
+    int step_y = d.y() > 0 ? 1 : -1;
+    qreal t_x = d.x() != 0 ? ((cx + (d.x() > 0)) * _cell_size - a.x()) / d.x() : 2;
+    qreal t_y = d.y() != 0 ? ((cy + (d.y() > 0)) * _cell_size - a.y()) / d.y() : 2;
+    qreal dt_x = d.x() != 0 ? _cell_size / qAbs(d.x()) : 2;
+    qreal dt_y = d.y() != 0 ? _cell_size / qAbs(d.y()) : 2;
+    int steps = qAbs(ex - cx) + qAbs(ey - cy);
+    for (int i = 0; ; i++) {
+        for (int ny = -1; ny <= 1; ny++) {
+            for (int nx = -1; nx <= 1; nx++) {
+                keys.append(_cell_key(cx + nx, cy + ny));
+            }
+        }
+        if ((cx == ex && cy == ey) || i >= steps) {
+            break;
+        }
+        if (t_x < t_y) {
+            cx += step_x;
+            t_x += dt_x;
+        }
+        else {
+            cy += step_y;
+            t_y += dt_y;
+        }
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+}
+
+void QGraphicsPolygonValidity::_insert(int edge)
+{
+    QVector<quint64> keys;
+    _cells(edge, keys);
+    foreach (quint64 key, keys) {
+        _grid[key].append(edge);
+    }
+}
+
+void QGraphicsPolygonValidity::_remove(int edge)
+{
+    QVector<quint64> keys;
+    _cells(edge, keys);
+    foreach (quint64 key, keys) {
+        Grid::iterator it = _grid.find(key);
+        if (it != _grid.end()) {
+            it.value().removeOne(edge);
+            if (it.value().isEmpty()) {
+                _grid.erase(it);
+            }
+        }
+    }
+}
+
+void QGraphicsPolygonValidity::_link(int e0, int e1)
+{
+    _partners[e0].append(e1);
+    _partners[e1].append(e0);
+    _invalid_edges.insert(e0);
+    _invalid_edges.insert(e1);
+}
+
+// test an edge against the edges of its cells, only the later edges when
+// all pairs are tested
+void QGraphicsPolygonValidity::_test(int edge, QHash<int, bool>& before, bool later)
+{
+    _stamp++;
+    _stamps[edge] = _stamp;
+    QVector<quint64> keys;
+    _cells(edge, keys);
+    foreach (quint64 key, keys) {
+        Grid::const_iterator it = _grid.constFind(key);
+        if (it == _grid.constEnd()) {
+            continue;
+        }
+        foreach (int j, it.value()) {
+            if (_stamps[j] == _stamp || (later && j < edge) || _partners[edge].contains(j)) {
+                continue;
+            }
+            _stamps[j] = _stamp;
+            if (_crossing(edge, j)) {
+                if (!before.contains(j)) {
+                    before.insert(j, _partners[j].isEmpty());
+                }
+                _link(edge, j);
+            }
+        }
+    }
+}
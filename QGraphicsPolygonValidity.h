@@ -0,0 +1,67 @@
+#pragma once
+
+#include <QVector>
+#include <QHash>
+#include <QSet>
+#include <QPolygonF>
+#include <QRectF>
+
+/*!
+ * This class keeps track of self intersections of a polygon while its vertices
+ * are moved one at a time.
+ *
+ * Edges are kept in a uniform grid, cells about the mean edge size, and edge i
+ * joins vertex i and i + 1. A long edge is kept in the cells along it rather
+ * than all cells of its bound. reset() finds all crossing pairs of edges once.
+ * When a vertex moves, only its two adjacent edges are re-indexed and tested
+ * against the edges of the cells they cover, so a move costs about the number
+ * of edges nearby, not the size of the polygon.
+ *
+ * Non adjacent edges are invalid when they cross or touch, adjacent edges when
+ * they fold back onto each other. The polygon is an open ring: a closing point
+ * equal to the first would make a zero length edge touching edges on both
+ * sides, so items drop it before reset().
+ *
+ * Usage:
+ *
+ *   QGraphicsPolygonValidity validity;
+ *   validity.reset(polygon);
+ *   QVector<int> changed = validity.moveVertex(index, pos);
+ *   if (!validity.isValid()) { ... validity.invalidEdges() ... }
+ */
+class QGraphicsPolygonValidity
+{
+public:
+    QGraphicsPolygonValidity();
+
+    // index edges of polygon and find all crossing pairs
+    void reset(const QPolygonF& polygon);
+
+    // move a vertex and re-test its two edges, return the edges turning
+    // valid or invalid
+    QVector<int> moveVertex(int index, const QPointF& pos);
+
+    bool isValid() const;
+    bool isEdgeValid(int edge) const;
+    const QSet<int>& invalidEdges() const;
+
+private:
+    typedef QHash<quint64, QVector<int> > Grid;
+
+    QPolygonF _polygon;
+    qreal _cell_size;
+    Grid _grid;
+    QVector<QVector<int> > _partners; // crossing edges of each edge
+    QSet<int> _invalid_edges;
+    QVector<int> _stamps; // last test visiting each edge
+    int _stamp;
+
+    QRectF _edge_bound(int edge) const;
+    bool _adjacent(int e0, int e1) const;
+    bool _crossing(int e0, int e1) const;
+    void _cells(int edge, QVector<quint64>& keys) const;
+    void _insert(int edge);
+    void _remove(int edge);
+    void _link(int e0, int e1);
+    void _test(int edge, QHash<int, bool>& before, bool later);
+};
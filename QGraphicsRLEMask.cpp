@@ -0,0 +1,778 @@
+#include "QGraphicsRLEMask.h"
+#include <QtConcurrent>
+#include <QHash>
+#include <QMap>
+#include <qmath.h>
+#include <algorithm>
+#include <climits>
+
+#define BLOCK_ROWS 256
+
+static quint64 _vertex_key(int x, int y)
+{
+    return (quint64(quint32(x)) << 32) | quint32(y);
+}
+
+// polygon edge crossing the centers of rows [first, last], half open in y
+struct RowEdge
+{
+    QPointF p0;
+    qreal slope;
+    int first;
+    int last;
+};
+
+static bool _edge_less(const RowEdge& a, const RowEdge& b)
+{
+    return a.first < b.first;
+}
+
+static bool _inside(bool in_subject, bool in_clip, int operation)
+{
+    switch (operation) {
+    case QGraphicsROIBoolean::UNITE:
+        return in_subject || in_clip;
+    case QGraphicsROIBoolean::INTERSECT:
+        return in_subject && in_clip;
+    case QGraphicsROIBoolean::SUBTRACT:
+        return in_subject && !in_clip;
+    default:
+        return in_subject != in_clip;
+    }
+}
+
+// merge two rows of runs by their sorted borders, append the runs of the
+// result and return their number
+static int _merge(const int* a, int na, const int* b, int nb, int operation, QVector<int>& out)
+{
+    int i = 0;
+    int j = 0;
+    na *= 2;
+    nb *= 2;
+    bool in_a = false;
+    bool in_b = false;
+    bool in = false;
+    int count = 0;
+    while (i < na || j < nb) {
+        int x = (j >= nb || (i < na && a[i] <= b[j])) ? a[i] : b[j];
+        while (i < na && a[i] == x) {
+            in_a = !in_a;
+            i++;
+        }
+        while (j < nb && b[j] == x) {
+            in_b = !in_b;
+            j++;
+        }
+        bool now = _inside(in_a, in_b, operation);
+        if (now != in) {
+            out.append(x);
+            count += !now;
+            in = now;
+        }
+    }
+    return count;
+}
+
+static void _put_varint(QByteArray& bytes, quint32 value)
+{
+    while (value >= 0x80) {
+        bytes.append(char(value | 0x80));
+        value >>= 7;
+    }
+    bytes.append(char(value));
+}
+
+static bool _get_varint(const QByteArray& bytes, int& pos, quint32& value)
+{
+    value = 0;
+    for (int shift = 0; shift < 35 && pos < bytes.size(); shift += 7) {
+        uchar byte = uchar(bytes[pos++]);
+        value |= quint32(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static quint32 _zigzag(int value)
+{
+    return (quint32(value) << 1) ^ quint32(value >> 31);
+}
+
+static int _unzigzag(quint32 value)
+{
+    return int(value >> 1) ^ -int(value & 1);
+}
+
+QGraphicsRLEMask::QGraphicsRLEMask()
+    : _top(0)
+{
+    _row_start.append(0);
+}
+
+QGraphicsRLEMask QGraphicsRLEMask::fromShape(const QGraphicsROIShape& shape)
+{
+    QGraphicsRLEMask mask;
+    if (shape.type == QGraphicsROIShape::RECT_SHAPE) {
+        QRectF rect = shape.rect.normalized();
+        int y0 = qCeil(rect.top() - 0.5);
+        int y1 = qCeil(rect.bottom() - 0.5);
+        int run[2] = { qCeil(rect.left() - 0.5), qCeil(rect.right() - 0.5) };
+        if (run[0] < run[1] && y0 < y1) {
+            mask._top = y0;
+            for (int y = y0; y < y1; y++) {
+                mask._append_row(run, 1);
+            }
+        }
+    }
+    else if (shape.type == QGraphicsROIShape::CIRCLE_SHAPE) {
+        int y0 = qCeil(shape.center.y() - shape.radius - 0.5);
+        int y1 = qFloor(shape.center.y() + shape.radius - 0.5);
+        mask._top = y0;
+        for (int y = y0; y <= y1; y++) {
+            qreal dy = y + 0.5 - shape.center.y();
+            qreal w = qSqrt(qMax(qreal(0), shape.radius * shape.radius - dy * dy));
+            int run[2] = { qCeil(shape.center.x() - w - 0.5), qFloor(shape.center.x() + w - 0.5) + 1 };
+            mask._append_row(run, run[0] < run[1] ? 1 : 0);
+        }
+    }
+    else if (shape.type == QGraphicsROIShape::POLYGON_SHAPE) {
+        QVector<RowEdge> edges;
+        QVector<QPolygonF> rings = QGraphicsROIBoolean::rings(shape);
+        foreach (const QPolygonF& ring, rings) {
+            for (int i = 0; i < ring.size(); i++) {
+                QPointF p = ring[i];
+                QPointF q = ring[(i + 1) % ring.size()];
+                if (p.y() == q.y()) {
+                    continue;
+                }
+                if (p.y() > q.y()) {
+                    std::swap(p, q);
+                }
+                RowEdge edge;
+                edge.p0 = p;
+                edge.slope = (q.x() - p.x()) / (q.y() - p.y());
+                edge.first = qCeil(p.y() - 0.5);
+                edge.last = qCeil(q.y() - 0.5) - 1;
+                if (edge.first <= edge.last) {
+                    edges.append(edge);
+                }
+            }
+        }
+        if (edges.isEmpty()) {
+            return mask;
+        }
+        std::sort(edges.begin(), edges.end(), _edge_less);
+        int y0 = edges[0].first;
+        int y1 = edges[0].last;
+        foreach (const RowEdge& edge, edges) {
+            y1 = qMax(y1, edge.last);
+        }
+
+        // active edges of each row, crossings paired even-odd
+        mask._top = y0;
+        QVector<int> active;
+        QVector<qreal> xs;
+        QVector<int> runs;
+        int next = 0;
+        for (int y = y0; y <= y1; y++) {
+            while (next < edges.size() && edges[next].first == y) {
+                active.append(next++);
+            }
+            qreal yc = y + 0.5;
+            xs.clear();
+            int kept = 0;
+            for (int k = 0; k < active.size(); k++) {
+                const RowEdge& edge = edges[active[k]];
+                if (edge.last < y) {
+                    continue;
+                }
+                active[kept++] = active[k];
+                xs.append(edge.p0.x() + (yc - edge.p0.y()) * edge.slope);
+            }
+            active.resize(kept);
+            std::sort(xs.begin(), xs.end());
+            runs.clear();
+            for (int k = 0; k + 1 < xs.size(); k += 2) {
+                int begin = qCeil(xs[k] - 0.5);
+                int end = qCeil(xs[k + 1] - 0.5);
+                if (begin >= end) {
+                    continue;
+                }
+                if (!runs.isEmpty() && runs.last() >= begin) {
+                    runs.last() = qMax(runs.last(), end);
+                }
+                else {
+                    runs << begin << end;
+                }
+            }
+            mask._append_row(runs.constData(), runs.size() / 2);
+        }
+    }
+    mask._trim();
+    return mask;
+}
+
+// tiles in bands of rows, runs joined across tile borders
+QGraphicsRLEMask QGraphicsRLEMask::fromTiles(const QGraphicsMaskTiles& tiles, const QPoint& offset)
+{
+    QGraphicsRLEMask mask;
+    QMap<int, QVector<int> > bands;
+    foreach (const QPoint& tile, tiles.tiles()) {
+        bands[tile.y()].append(tile.x());
+    }
+    if (bands.isEmpty()) {
+        return mask;
+    }
+    mask._top = bands.firstKey() * MASK_TILE_SIZE + offset.y();
+    int next_band = bands.firstKey();
+    QVector<int> runs;
+    QMap<int, QVector<int> >::iterator band;
+    for (band = bands.begin(); band != bands.end(); ++band) {
+        for (; next_band < band.key(); next_band++) {
+            for (int r = 0; r < MASK_TILE_SIZE; r++) {
+                mask._append_row(NULL, 0);
+            }
+        }
+        next_band = band.key() + 1;
+        std::sort(band.value().begin(), band.value().end());
+        for (int r = 0; r < MASK_TILE_SIZE; r++) {
+            runs.clear();
+            foreach (int tx, band.value()) {
+                const uchar* row = tiles.tile(QPoint(tx, band.key())) + r * MASK_TILE_SIZE;
+                int x0 = tx * MASK_TILE_SIZE + offset.x();
+                for (int i = 0; i < MASK_TILE_SIZE; i++) {
+                    if (!row[i]) {
+                        continue;
+                    }
+                    int begin = i;
+                    while (i < MASK_TILE_SIZE && row[i]) {
+                        i++;
+                    }
+                    if (!runs.isEmpty() && runs.last() == x0 + begin) {
+                        runs.last() = x0 + i;
+                    }
+                    else {
+                        runs << x0 + begin << x0 + i;
+                    }
+                }
+            }
+            mask._append_row(runs.constData(), runs.size() / 2);
+        }
+    }
+    mask._trim();
+    return mask;
+}
+
+// runs sorted by row and begin, overlapping or touching ones merged
+QGraphicsRLEMask QGraphicsRLEMask::fromRuns(const QVector<int>& runs)
+{
+    QGraphicsRLEMask mask;
+    int count = runs.size() / 3;
+    if (count == 0) {
+        return mask;
+    }
+    QVector<int> order(count);
+    for (int i = 0; i < count; i++) {
+        order[i] = i;
+    }
+    const int* r = runs.constData();
+    std::sort(order.begin(), order.end(), [r](int a, int b) {
+        return r[3 * a] != r[3 * b] ? r[3 * a] < r[3 * b] : r[3 * a + 1] < r[3 * b + 1];
+    });
+    mask._top = r[3 * order[0]];
+    int y = mask._top;
+    QVector<int> row;
+    foreach (int i, order) {
+        for (; y < r[3 * i]; y++) {
+            mask._append_row(row.constData(), row.size() / 2);
+            row.clear();
+        }
+        if (!row.isEmpty() && row.last() >= r[3 * i + 1]) {
+            row.last() = qMax(row.last(), r[3 * i + 2]);
+        }
+        else {
+            row << r[3 * i + 1] << r[3 * i + 2];
+        }
+    }
+    mask._append_row(row.constData(), row.size() / 2);
+    return mask;
+}
+
+void QGraphicsRLEMask::toTiles(QGraphicsMaskTiles& tiles, const QPoint& offset) const
+{
+    QVector<QPoint> touched;
+    for (int i = 0; i < rowCount(); i++) {
+        touched.clear();
+        for (int k = _row_start[i]; k < _row_start[i + 1]; k += 2) {
+            tiles.fillSpan(_top + i + offset.y(), _runs[k] + offset.x(), _runs[k + 1] - 1 + offset.x(), true, touched);
+        }
+    }
+}
+
+// borders are directed with set pixels on the right, outlines are then
+// positive and holes negative in signed area; at a vertex shared by pixels
+// touching at a corner, turning right keeps to the same pixel
+QVector<QGraphicsROIShape> QGraphicsRLEMask::toShapes() const
+{
+    QVector<QPoint> from;
+    QVector<QPoint> to;
+    QVector<int> border;
+    for (int i = 0; i < rowCount(); i++) {
+        int y = _top + i;
+        int count, above_count, below_count;
+        const int* runs = row(y, count);
+        const int* above = row(y - 1, above_count);
+        const int* below = row(y + 1, below_count);
+        for (int k = 0; k < count; k++) {
+            from << QPoint(runs[2 * k], y + 1) << QPoint(runs[2 * k + 1], y);
+            to << QPoint(runs[2 * k], y) << QPoint(runs[2 * k + 1], y + 1);
+        }
+        border.clear();
+        int top_count = _merge(runs, count, above, above_count, QGraphicsROIBoolean::SUBTRACT, border);
+        for (int k = 0; k < top_count; k++) {
+            from << QPoint(border[2 * k], y);
+            to << QPoint(border[2 * k + 1], y);
+        }
+        border.clear();
+        int bottom_count = _merge(runs, count, below, below_count, QGraphicsROIBoolean::SUBTRACT, border);
+        for (int k = 0; k < bottom_count; k++) {
+            from << QPoint(border[2 * k + 1], y + 1);
+            to << QPoint(border[2 * k], y + 1);
+        }
+    }
+
+    int n = from.size();
+    QHash<quint64, int> first_out;
+    QVector<int> next_out(n, -1);
+    first_out.reserve(n);
+    for (int e = 0; e < n; e++) {
+        quint64 key = _vertex_key(from[e].x(), from[e].y());
+        QHash<quint64, int>::iterator it = first_out.find(key);
+        if (it == first_out.end()) {
+            first_out.insert(key, e);
+        }
+        else {
+            next_out[e] = it.value();
+            it.value() = e;
+        }
+    }
+
+    QVector<QPolygonF> rings;
+    QVector<bool> used(n, false);
+    for (int s = 0; s < n; s++) {
+        if (used[s]) {
+            continue;
+        }
+        QPolygonF ring;
+        int e = s;
+        while (!used[e]) {
+            used[e] = true;
+            ring.append(from[e]);
+            QPoint d = to[e] - from[e];
+            int next = first_out.value(_vertex_key(to[e].x(), to[e].y()), -1);
+            if (next >= 0 && next_out[next] >= 0) {
+                QPoint d0 = to[next] - from[next];
+                if (qint64(d.x()) * d0.y() - qint64(d.y()) * d0.x() <= 0) {
+                    next = next_out[next];
+                }
+            }
+            if (next < 0) {
+                break;
+            }
+            e = next;
+        }
+        // keep corners only
+        QPolygonF corners;
+        for (int i = 0; i < ring.size(); i++) {
+            const QPointF& a = ring[(i + ring.size() - 1) % ring.size()];
+            const QPointF& b = ring[i];
+            const QPointF& c = ring[(i + 1) % ring.size()];
+            if (!((a.x() == b.x() && b.x() == c.x()) || (a.y() == b.y() && b.y() == c.y()))) {
+                corners.append(b);
+            }
+        }
+        if (corners.size() >= 4) {
+            rings.append(corners);
+        }
+    }
+    return QGraphicsROIBoolean::regions(rings);
+}
+
+QGraphicsRLEMask QGraphicsRLEMask::apply(const QGraphicsRLEMask& subject, const QGraphicsRLEMask& clip,
+                                         QGraphicsROIBoolean::OPERATION operation)
+{
+    if (subject.isEmpty() || clip.isEmpty()) {
+        if (!_inside(!subject.isEmpty(), !clip.isEmpty(), operation)) {
+            return QGraphicsRLEMask();
+        }
+        return subject.isEmpty() ? clip : subject;
+    }
+    int top = qMin(subject._top, clip._top);
+    int bottom = qMax(subject._top + subject.rowCount(), clip._top + clip.rowCount());
+
+    QVector<Block> blocks;
+    for (int y = top; y < bottom; y += BLOCK_ROWS) {
+        Block block;
+        block.first = y;
+        block.count = qMin(BLOCK_ROWS, bottom - y);
+        blocks.append(block);
+    }
+    BlockOperation block_operation;
+    block_operation.subject = &subject;
+    block_operation.clip = &clip;
+    block_operation.operation = operation;
+    QtConcurrent::blockingMap(blocks, block_operation);
+    return _from_blocks(top, blocks);
+}
+
+QGraphicsRLEMask QGraphicsRLEMask::_from_blocks(int top, const QVector<Block>& blocks)
+{
+    QGraphicsRLEMask mask;
+    mask._top = top;
+    int runs = 0;
+    int rows = 0;
+    foreach (const Block& block, blocks) {
+        runs += block.runs.size();
+        rows += block.count;
+    }
+    mask._runs.reserve(runs);
+    mask._row_start.reserve(rows + 1);
+    foreach (const Block& block, blocks) {
+        const int* data = block.runs.constData();
+        foreach (int size, block.row_sizes) {
+            mask._append_row(data, size);
+            data += 2 * size;
+        }
+    }
+    mask._trim();
+    return mask;
+}
+
+void QGraphicsRLEMask::BlockOperation::operator()(Block& block) const
+{
+    for (int y = block.first; y < block.first + block.count; y++) {
+        int na, nb;
+        const int* a = subject->row(y, na);
+        const int* b = clip->row(y, nb);
+        block.row_sizes.append(_merge(a, na, b, nb, operation, block.runs));
+    }
+}
+
+QGraphicsRLEMask QGraphicsRLEMask::threshold(const uchar* data, int width, int height, int stride, int max_value)
+{
+    QVector<Block> blocks;
+    for (int y = 0; y < height; y += BLOCK_ROWS) {
+        Block block;
+        block.first = y;
+        block.count = qMin(BLOCK_ROWS, height - y);
+        blocks.append(block);
+    }
+    ThresholdOperation threshold_operation;
+    threshold_operation.data = data;
+    threshold_operation.width = width;
+    threshold_operation.stride = stride;
+    threshold_operation.max_value = max_value;
+    QtConcurrent::blockingMap(blocks, threshold_operation);
+    return _from_blocks(0, blocks);
+}
+
+void QGraphicsRLEMask::ThresholdOperation::operator()(Block& block) const
+{
+    for (int y = block.first; y < block.first + block.count; y++) {
+        const uchar* row = data + qint64(y) * stride;
+        int count = 0;
+        for (int x = 0; x < width; x++) {
+            if (row[x] > max_value) {
+                continue;
+            }
+            int begin = x;
+            while (x < width && row[x] <= max_value) {
+                x++;
+            }
+            block.runs << begin << x;
+            count++;
+        }
+        block.row_sizes.append(count);
+    }
+}
+
+// breadth first over runs, the runs of a next row overlapping a run are
+// found by binary search for the first one ending after its begin
+QGraphicsRLEMask QGraphicsRLEMask::component(const QPoint& seed) const
+{
+    QGraphicsRLEMask mask;
+    int count;
+    const int* runs = row(seed.y(), count);
+    int first = -1;
+    for (int k = 0; k < count; k++) {
+        if (runs[2 * k] <= seed.x() && seed.x() < runs[2 * k + 1]) {
+            first = (runs - _runs.constData()) / 2 + k;
+        }
+    }
+    if (first < 0) {
+        return mask;
+    }
+    // row of each run
+    QVector<int> run_row(runCount());
+    for (int i = 0; i < rowCount(); i++) {
+        for (int k = _row_start[i] / 2; k < _row_start[i + 1] / 2; k++) {
+            run_row[k] = i;
+        }
+    }
+    QVector<bool> reached(runCount(), false);
+    QVector<int> queue;
+    queue.append(first);
+    reached[first] = true;
+    for (int q = 0; q < queue.size(); q++) {
+        int run = queue[q];
+        int begin = _runs[2 * run];
+        int end = _runs[2 * run + 1];
+        for (int i = run_row[run] - 1; i <= run_row[run] + 1; i += 2) {
+            if (i < 0 || i >= rowCount()) {
+                continue;
+            }
+            int lo = _row_start[i] / 2;
+            int hi = _row_start[i + 1] / 2;
+            while (lo < hi) {
+                int mid = (lo + hi) / 2;
+                if (_runs[2 * mid + 1] <= begin) {
+                    lo = mid + 1;
+                }
+                else {
+                    hi = mid;
+                }
+            }
+            for (int k = lo; k < _row_start[i + 1] / 2 && _runs[2 * k] < end; k++) {
+                if (!reached[k]) {
+                    reached[k] = true;
+                    queue.append(k);
+                }
+            }
+        }
+    }
+    mask._top = _top;
+    for (int i = 0; i < rowCount(); i++) {
+        for (int k = _row_start[i] / 2; k < _row_start[i + 1] / 2; k++) {
+            if (reached[k]) {
+                mask._runs << _runs[2 * k] << _runs[2 * k + 1];
+            }
+        }
+        mask._row_start.append(mask._runs.size());
+    }
+    mask._trim();
+    return mask;
+}
+
+bool QGraphicsRLEMask::isEmpty() const
+{
+    return _runs.isEmpty();
+}
+
+qint64 QGraphicsRLEMask::area() const
+{
+    qint64 area = 0;
+    for (int k = 0; k < _runs.size(); k += 2) {
+        area += _runs[k + 1] - _runs[k];
+    }
+    return area;
+}
+
+QRect QGraphicsRLEMask::boundingRect() const
+{
+    if (isEmpty()) {
+        return QRect();
+    }
+    int left = _runs[0];
+    int right = _runs[1];
+    for (int i = 0; i < rowCount(); i++) {
+        if (_row_start[i] < _row_start[i + 1]) {
+            left = qMin(left, _runs[_row_start[i]]);
+            right = qMax(right, _runs[_row_start[i + 1] - 1]);
+        }
+    }
+    return QRect(left, _top, right - left, rowCount());
+}
+
+bool QGraphicsRLEMask::contains(int x, int y) const
+{
+    int count;
+    const int* runs = row(y, count);
+    // last run beginning at or before x
+    int lo = 0;
+    int hi = count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (runs[2 * mid] <= x) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    return lo > 0 && x < runs[2 * (lo - 1) + 1];
+}
+
+QGraphicsRLEMask QGraphicsRLEMask::translated(const QPoint& offset) const
+{
+    QGraphicsRLEMask mask = *this;
+    mask._top += offset.y();
+    for (int k = 0; k < mask._runs.size(); k++) {
+        mask._runs[k] += offset.x();
+    }
+    return mask;
+}
+
+// a run [begin, end) covers the pixels whose center maps into it, row by
+// row of the scaled mask, each taken from the row its center maps into
+QGraphicsRLEMask QGraphicsRLEMask::scaled(const QTransform& transform) const
+{
+    QGraphicsRLEMask mask;
+    qreal sx = transform.m11();
+    qreal sy = transform.m22();
+    if (isEmpty() || sx <= 0 || sy <= 0) {
+        return mask;
+    }
+    qreal dx = transform.dx();
+    qreal dy = transform.dy();
+    int rows = rowCount();
+    mask._top = qCeil(_top * sy + dy - 0.5);
+    int bottom = qCeil((_top + rows) * sy + dy - 0.5);
+    QVector<int> runs;
+    for (int y = mask._top; y < bottom; y++) {
+        runs.clear();
+        int source = qFloor((y + 0.5 - dy) / sy) - _top;
+        if (source >= 0 && source < rows) {
+            for (int k = _row_start[source]; k < _row_start[source + 1]; k += 2) {
+                int begin = qCeil(_runs[k] * sx + dx - 0.5);
+                int end = qCeil(_runs[k + 1] * sx + dx - 0.5);
+                if (begin >= end) {
+                    continue;
+                }
+                if (!runs.isEmpty() && runs.last() >= begin) {
+                    runs.last() = end;
+                }
+                else {
+                    runs << begin << end;
+                }
+            }
+        }
+        mask._append_row(runs.constData(), runs.size() / 2);
+    }
+    mask._trim();
+    return mask;
+}
+
+int QGraphicsRLEMask::top() const
+{
+    return _top;
+}
+
+int QGraphicsRLEMask::rowCount() const
+{
+    return _row_start.size() - 1;
+}
+
+int QGraphicsRLEMask::runCount() const
+{
+    return _runs.size() / 2;
+}
+
+const int* QGraphicsRLEMask::row(int y, int& count) const
+{
+    int i = y - _top;
+    if (i < 0 || i >= rowCount() || _row_start[i] == _row_start[i + 1]) {
+        count = 0;
+        return NULL;
+    }
+    count = (_row_start[i + 1] - _row_start[i]) / 2;
+    return _runs.constData() + _row_start[i];
+}
+
+// top and rows, then for each row its number of runs, and each run as gap
+// from the end of the previous one and length
+QByteArray QGraphicsRLEMask::toByteArray() const
+{
+    QByteArray bytes;
+    _put_varint(bytes, _zigzag(_top));
+    _put_varint(bytes, rowCount());
+    for (int i = 0; i < rowCount(); i++) {
+        _put_varint(bytes, (_row_start[i + 1] - _row_start[i]) / 2);
+        int end = 0;
+        for (int k = _row_start[i]; k < _row_start[i + 1]; k += 2) {
+            _put_varint(bytes, _zigzag(_runs[k] - end));
+            _put_varint(bytes, _runs[k + 1] - _runs[k]);
+            end = _runs[k + 1];
+        }
+    }
+    return bytes;
+}
+
+// empty mask on malformed bytes: runs out of order, touching or empty,
+// or coords out of int
+QGraphicsRLEMask QGraphicsRLEMask::fromByteArray(const QByteArray& bytes)
+{
+    QGraphicsRLEMask mask;
+    int pos = 0;
+    quint32 top, rows;
+    if (!_get_varint(bytes, pos, top) || !_get_varint(bytes, pos, rows) || rows > quint32(bytes.size())) {
+        return QGraphicsRLEMask();
+    }
+    mask._top = _unzigzag(top);
+    if (qint64(mask._top) + rows > INT_MAX) {
+        return QGraphicsRLEMask();
+    }
+    QVector<int> runs;
+    for (quint32 i = 0; i < rows; i++) {
+        quint32 count;
+        if (!_get_varint(bytes, pos, count) || count > quint32(bytes.size() - pos)) {
+            return QGraphicsRLEMask();
+        }
+        runs.clear();
+        qint64 end = 0;
+        for (quint32 k = 0; k < count; k++) {
+            quint32 gap, length;
+            if (!_get_varint(bytes, pos, gap) || !_get_varint(bytes, pos, length)) {
+                return QGraphicsRLEMask();
+            }
+            qint64 begin = end + _unzigzag(gap);
+            if ((k > 0 && begin <= end) || length == 0 || begin < INT_MIN || begin + length > INT_MAX) {
+                return QGraphicsRLEMask();
+            }
+            end = begin + length;
+            runs << int(begin) << int(end);
+        }
+        mask._append_row(runs.constData(), count);
+    }
+    mask._trim();
+    return mask;
+}
+
+void QGraphicsRLEMask::_append_row(const int* runs, int count)
+{
+    for (int k = 0; k < 2 * count; k++) {
+        _runs.append(runs[k]);
+    }
+    _row_start.append(_runs.size());
+}
+
+// drop empty rows at top and bottom
+void QGraphicsRLEMask::_trim()
+{
+    int rows = rowCount();
+    int first = 0;
+    while (first < rows && _row_start[first] == _row_start[first + 1]) {
+        first++;
+    }
+    if (first == rows) {
+        *this = QGraphicsRLEMask();
+        return;
+    }
+    int last = rows - 1;
+    while (_row_start[last] == _row_start[last + 1]) {
+        last--;
+    }
+    _top += first;
+    _row_start = _row_start.mid(first, last - first + 2);
+}
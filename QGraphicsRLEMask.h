@@ -0,0 +1,122 @@
+#pragma once
+
+#include <QVector>
+#include <QRect>
+#include <QPoint>
+#include <QByteArray>
+#include <QTransform>
+#include "QGraphicsROIShape.h"
+#include "QGraphicsROIBoolean.h"
+#include "QGraphicsMaskTiles.h"
+
+/*!
+ * Run length encoded mask of pixels, in scene coords, pixel (x, y) covering
+ * [x, x + 1) x [y, y + 1). It is a value type and may be copied to worker
+ * threads.
+ *
+ * Each row from top() holds sorted, disjoint and non touching runs of set
+ * pixels, [begin, end) in x. Memory is two ints per run, so it follows the
+ * length of the boundary and not the area of the mask.
+ *
+ * Rect, polygon and circle shapes are rasterized by the centers of pixels,
+ * polygons with holes by even-odd scanlines. Boolean operations merge the runs
+ * of both masks row by row, on row blocks in parallel with QtConcurrent, as
+ * does thresholding of byte images. Connected components are found over runs
+ * rather than pixels. The mask is traced back to polygons with holes along
+ * pixel borders, pixels touching at a corner only are kept apart.
+ *
+ * Usage:
+ *
+ *   QGraphicsRLEMask a = QGraphicsRLEMask::fromShape(polygon);
+ *   QGraphicsRLEMask b = QGraphicsRLEMask::fromShape(circle);
+ *   QGraphicsRLEMask c = QGraphicsRLEMask::apply(a, b, QGraphicsROIBoolean::SUBTRACT);
+ *   qint64 area = c.area();
+ *   QVector<QGraphicsROIShape> shapes = c.toShapes();
+ */
+class QGraphicsRLEMask
+{
+public:
+    QGraphicsRLEMask();
+
+    // pixels whose center is in the shape
+    static QGraphicsRLEMask fromShape(const QGraphicsROIShape& shape);
+
+    // set pixels of tiles, moved by offset
+    static QGraphicsRLEMask fromTiles(const QGraphicsMaskTiles& tiles, const QPoint& offset = QPoint());
+
+    // set the pixels of the mask in tiles, moved by offset
+    void toTiles(QGraphicsMaskTiles& tiles, const QPoint& offset = QPoint()) const;
+
+    // runs as y, begin and end triples, in any order
+    static QGraphicsRLEMask fromRuns(const QVector<int>& runs);
+
+    // pixels of a byte image at most max_value, row blocks in parallel
+    static QGraphicsRLEMask threshold(const uchar* data, int width, int height, int stride, int max_value);
+
+    // 4-connected pixels reached from seed, by runs overlapping in next rows
+    QGraphicsRLEMask component(const QPoint& seed) const;
+
+    // outlines along pixel borders, with holes
+    QVector<QGraphicsROIShape> toShapes() const;
+
+    // union, intersection, difference or xor, row blocks in parallel
+    static QGraphicsRLEMask apply(const QGraphicsRLEMask& subject, const QGraphicsRLEMask& clip,
+                                  QGraphicsROIBoolean::OPERATION operation);
+
+    bool isEmpty() const;
+    qint64 area() const;
+    QRect boundingRect() const;
+    bool contains(int x, int y) const;
+    QGraphicsRLEMask translated(const QPoint& offset) const;
+    // pixels whose center maps back into the mask, by the scale and
+    // translation of transform, rotation and shear are ignored
+    QGraphicsRLEMask scaled(const QTransform& transform) const;
+
+    // rows and runs
+    int top() const;
+    int rowCount() const;
+    int runCount() const;
+    // runs of a row as begin and end pairs, NULL when none
+    const int* row(int y, int& count) const;
+
+    // compact bytes, varint deltas of runs, for storage and export
+    QByteArray toByteArray() const;
+    static QGraphicsRLEMask fromByteArray(const QByteArray& bytes);
+
+private:
+    int _top;
+    QVector<int> _row_start; // rows + 1 offsets into runs
+    QVector<int> _runs; // begin and end of each run, flat
+
+    // rows of a block, merged on a worker thread
+    struct Block
+    {
+        int first;
+        int count;
+        QVector<int> row_sizes; // runs of each row
+        QVector<int> runs;
+    };
+
+    struct BlockOperation
+    {
+        typedef void result_type;
+        const QGraphicsRLEMask* subject;
+        const QGraphicsRLEMask* clip;
+        int operation;
+        void operator()(Block& block) const;
+    };
+
+    struct ThresholdOperation
+    {
+        typedef void result_type;
+        const uchar* data;
+        int width;
+        int stride;
+        int max_value;
+        void operator()(Block& block) const;
+    };
+
+    static QGraphicsRLEMask _from_blocks(int top, const QVector<Block>& blocks);
+    void _append_row(const int* runs, int count);
+    void _trim();
+};
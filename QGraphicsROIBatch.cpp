@@ -0,0 +1,417 @@
+#include "QGraphicsROIBatch.h"
+#include <QtConcurrent>
+#include <QThreadPool>
+#include <QElapsedTimer>
+#include <QImageReader>
+#include <QImageWriter>
+#include <QFileInfo>
+#include <QFile>
+#include <QDir>
+#include "QGraphicsROIMetrics.h"
+
+#define DEFAULT_OPACITY 0.4
+
+static const QRgb _colors[] = { 0xffe6194b, 0xff3cb44b, 0xffffe119, 0xff4363d8, 0xfff58231,
+                                0xff911eb4, 0xff46f0f0, 0xfff032e6, 0xffbcf60c, 0xff008080 };
+
+// runs of mask within width and height, as callback(y, begin, end)
+template <typename Callback>
+static void _for_each_run(const QGraphicsRLEMask& mask, int width, int height, Callback callback)
+{
+    int top = qMax(mask.top(), 0);
+    int bottom = qMin(mask.top() + mask.rowCount(), height);
+    for (int y = top; y < bottom; y++) {
+        int count;
+        const int* runs = mask.row(y, count);
+        for (int k = 0; k < count; k++) {
+            int begin = qMax(runs[2 * k], 0);
+            int end = qMin(runs[2 * k + 1], width);
+            if (begin < end) {
+                callback(y, begin, end);
+            }
+        }
+    }
+}
+
+// pixels with a 4-neighbour out of mask
+static QGraphicsRLEMask _border(const QGraphicsRLEMask& mask)
+{
+    QGraphicsRLEMask inner = mask;
+    const QPoint offsets[] = { QPoint(1, 0), QPoint(-1, 0), QPoint(0, 1), QPoint(0, -1) };
+    for (int i = 0; i < 4; i++) {
+        inner = QGraphicsRLEMask::apply(inner, mask.translated(offsets[i]), QGraphicsROIBoolean::INTERSECT);
+    }
+    return QGraphicsRLEMask::apply(mask, inner, QGraphicsROIBoolean::SUBTRACT);
+}
+
+// of a mask, summed over its traced outlines
+static QGraphicsROIMetrics _mask_metrics(const QGraphicsRLEMask& mask)
+{
+    QGraphicsROIMetrics metrics;
+    QPointF moment;
+    foreach (const QGraphicsROIShape& shape, mask.toShapes()) {
+        QGraphicsROIMetrics part = QGraphicsROIMetrics::fromShape(shape);
+        metrics.area += part.area;
+        metrics.perimeter += part.perimeter;
+        moment += part.centroid * part.area;
+    }
+    if (metrics.area > 0) {
+        metrics.centroid = moment / metrics.area;
+    }
+    metrics.bound = QRectF(mask.boundingRect());
+    return metrics;
+}
+
+static QString _csv_text(const QString& text)
+{
+    if (!text.contains(',') && !text.contains('"') && !text.contains('\n')) {
+        return text;
+    }
+    return '"' + QString(text).replace("\"", "\"\"") + '"';
+}
+
+static const char* _shape_name(const QGraphicsROIFile::Entry& entry)
+{
+    switch (entry.shape.type) {
+    case QGraphicsROIShape::RECT_SHAPE:
+        return "rect";
+    case QGraphicsROIShape::POLYGON_SHAPE:
+        return "polygon";
+    case QGraphicsROIShape::CIRCLE_SHAPE:
+        return "circle";
+    default:
+        return "mask";
+    }
+}
+
+void QGraphicsROIBatch::Channel::open(int producers)
+{
+    QMutexLocker locker(&_mutex);
+    _producers = producers;
+}
+
+void QGraphicsROIBatch::Channel::push(Job* job)
+{
+    QMutexLocker locker(&_mutex);
+    _jobs.enqueue(job);
+    _ready.wakeOne();
+}
+
+QGraphicsROIBatch::Job* QGraphicsROIBatch::Channel::pop()
+{
+    QMutexLocker locker(&_mutex);
+    while (_jobs.isEmpty() && _producers > 0) {
+        _ready.wait(&_mutex);
+    }
+    return _jobs.isEmpty() ? NULL : _jobs.dequeue();
+}
+
+void QGraphicsROIBatch::Channel::close()
+{
+    QMutexLocker locker(&_mutex);
+    if (--_producers == 0) {
+        _ready.wakeAll();
+    }
+}
+
+QGraphicsROIBatch::QGraphicsROIBatch()
+    : _outputs(MASK_OUTPUT)
+    , _output_dir(".")
+    , _threads(0)
+    , _max_in_flight(0)
+    , _opacity(DEFAULT_OPACITY)
+    , _processed(0)
+{
+    for (int i = 0; i < 3; i++) {
+        _stage_time[i] = 0;
+    }
+}
+
+void QGraphicsROIBatch::setOutputs(int outputs)
+{
+    _outputs = outputs;
+}
+
+void QGraphicsROIBatch::setOutputDir(const QString& dir)
+{
+    _output_dir = dir;
+}
+
+void QGraphicsROIBatch::setRoiDir(const QString& dir)
+{
+    _roi_dir = dir;
+}
+
+void QGraphicsROIBatch::setThreads(int count)
+{
+    _threads = qMax(0, count);
+}
+
+void QGraphicsROIBatch::setMaxInFlight(int count)
+{
+    _max_in_flight = qMax(0, count);
+}
+
+void QGraphicsROIBatch::setOverlayOpacity(qreal opacity)
+{
+    _opacity = qBound(qreal(0), opacity, qreal(1));
+}
+
+// a quarter of the threads decode, a quarter encode, the rest rasterize
+bool QGraphicsROIBatch::run(const QStringList& images)
+{
+    int threads = _threads > 0 ? _threads : QThread::idealThreadCount();
+    int decoders = qMax(1, threads / 4);
+    int encoders = qMax(1, threads / 4);
+    int rasterizers = qMax(1, threads - decoders - encoders);
+    int in_flight = _max_in_flight > 0 ? _max_in_flight : 2 * threads;
+
+    _images = images;
+    _next.store(0);
+    _free.acquire(_free.available());
+    _free.release(in_flight);
+    _processed = 0;
+    _errors.clear();
+    _statistics.clear();
+    for (int i = 0; i < 3; i++) {
+        _stage_time[i] = 0;
+    }
+    QDir().mkpath(_output_dir);
+    _rasterize_channel.open(decoders);
+    _encode_channel.open(rasterizers);
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(decoders + rasterizers + encoders);
+    for (int i = 0; i < decoders; i++) {
+        QtConcurrent::run(&pool, this, &QGraphicsROIBatch::_decode_loop);
+    }
+    for (int i = 0; i < rasterizers; i++) {
+        QtConcurrent::run(&pool, this, &QGraphicsROIBatch::_rasterize_loop);
+    }
+    for (int i = 0; i < encoders; i++) {
+        QtConcurrent::run(&pool, this, &QGraphicsROIBatch::_encode_loop);
+    }
+    pool.waitForDone();
+
+    if (_outputs & STATISTICS_OUTPUT) {
+        QFile file(QDir(_output_dir).filePath("statistics.csv"));
+        if (file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            file.write("image,id,label,type,area,perimeter,centroid_x,centroid_y,bound_x,bound_y,bound_width,"
+                       "bound_height,pixels,min,max,mean,deviation\n");
+            foreach (const QByteArray& lines, _statistics) {
+                file.write(lines);
+            }
+        }
+        else {
+            _errors.append(file.fileName() + ": " + file.errorString());
+        }
+    }
+    return _errors.isEmpty();
+}
+
+int QGraphicsROIBatch::processedCount() const
+{
+    QMutexLocker locker(&_mutex);
+    return _processed;
+}
+
+int QGraphicsROIBatch::failedCount() const
+{
+    QMutexLocker locker(&_mutex);
+    return _errors.size();
+}
+
+QStringList QGraphicsROIBatch::errors() const
+{
+    QMutexLocker locker(&_mutex);
+    return _errors;
+}
+
+qint64 QGraphicsROIBatch::stageTime(STAGE stage) const
+{
+    QMutexLocker locker(&_mutex);
+    return _stage_time[stage] / 1000000;
+}
+
+// waits for a free slot before decoding, so memory stays bounded
+void QGraphicsROIBatch::_decode_loop()
+{
+    int index;
+    while ((index = _next.fetchAndAddRelaxed(1)) < _images.size()) {
+        _free.acquire();
+        Job* job = new Job;
+        job->index = index;
+        job->path = _images[index];
+        QElapsedTimer timer;
+        timer.start();
+        _decode(job);
+        _add_time(DECODE_STAGE, timer.nsecsElapsed());
+        _rasterize_channel.push(job);
+    }
+    _rasterize_channel.close();
+}
+
+void QGraphicsROIBatch::_rasterize_loop()
+{
+    Job* job;
+    while ((job = _rasterize_channel.pop()) != NULL) {
+        QElapsedTimer timer;
+        timer.start();
+        if (job->error.isEmpty()) {
+            _rasterize(job);
+        }
+        _add_time(RASTERIZE_STAGE, timer.nsecsElapsed());
+        _encode_channel.push(job);
+    }
+    _encode_channel.close();
+}
+
+void QGraphicsROIBatch::_encode_loop()
+{
+    Job* job;
+    while ((job = _encode_channel.pop()) != NULL) {
+        QElapsedTimer timer;
+        timer.start();
+        if (job->error.isEmpty()) {
+            _encode(job);
+        }
+        _add_time(ENCODE_STAGE, timer.nsecsElapsed());
+        {
+            QMutexLocker locker(&_mutex);
+            _processed++;
+            if (!job->error.isEmpty()) {
+                _errors.append(job->path + ": " + job->error);
+            }
+            else if (_outputs & STATISTICS_OUTPUT) {
+                _statistics.insert(job->index, job->statistics);
+            }
+        }
+        delete job;
+        _free.release();
+    }
+}
+
+// only the header when masks alone are written
+void QGraphicsROIBatch::_decode(Job* job) const
+{
+    QFileInfo info(job->path);
+    QString roi_dir = _roi_dir.isEmpty() ? info.absolutePath() : _roi_dir;
+    QString error;
+    if (!QGraphicsROIFile::read(QDir(roi_dir).filePath(info.completeBaseName() + ".json"), job->entries, &error)) {
+        job->error = "ROI file: " + error;
+        return;
+    }
+    QImageReader reader(job->path);
+    if (!(_outputs & (OVERLAY_OUTPUT | STATISTICS_OUTPUT))) {
+        job->size = reader.size();
+    }
+    // pixels needed, or a format not telling its size in the header
+    if (job->size.isEmpty()) {
+        job->image = reader.read();
+        job->size = job->image.size();
+    }
+    if (job->size.isEmpty()) {
+        job->error = reader.errorString();
+        return;
+    }
+    if (_outputs & STATISTICS_OUTPUT) {
+        job->data = QGraphicsImageData::fromImage(job->image);
+    }
+}
+
+void QGraphicsROIBatch::_rasterize(Job* job) const
+{
+    int width = job->size.width();
+    int height = job->size.height();
+    if (_outputs & MASK_OUTPUT) {
+        job->mask = QImage(width, height, QImage::Format_Grayscale8);
+        job->mask.fill(0);
+    }
+    if (_outputs & OVERLAY_OUTPUT) {
+        job->overlay = job->image.convertToFormat(QImage::Format_RGB32);
+    }
+    job->image = QImage();
+    QString name = _csv_text(QFileInfo(job->path).fileName());
+    int alpha = qRound(_opacity * 256);
+    for (int i = 0; i < job->entries.size(); i++) {
+        const QGraphicsROIFile::Entry& entry = job->entries[i];
+        QGraphicsRLEMask mask = entry.toMask();
+        if (_outputs & MASK_OUTPUT) {
+            uchar value = uchar(qMin(i + 1, 255));
+            QImage& image = job->mask;
+            _for_each_run(mask, width, height, [&image, value](int y, int begin, int end) {
+                memset(image.scanLine(y) + begin, value, end - begin);
+            });
+        }
+        if (_outputs & OVERLAY_OUTPUT) {
+            QRgb color = _colors[i % (sizeof(_colors) / sizeof(_colors[0]))];
+            int r = qRed(color) * alpha;
+            int g = qGreen(color) * alpha;
+            int b = qBlue(color) * alpha;
+            QImage& image = job->overlay;
+            _for_each_run(mask, width, height, [&image, r, g, b, alpha](int y, int begin, int end) {
+                QRgb* row = reinterpret_cast<QRgb*>(image.scanLine(y));
+                for (int x = begin; x < end; x++) {
+                    QRgb pixel = row[x];
+                    row[x] = qRgb((qRed(pixel) * (256 - alpha) + r) >> 8, (qGreen(pixel) * (256 - alpha) + g) >> 8,
+                                  (qBlue(pixel) * (256 - alpha) + b) >> 8);
+                }
+            });
+            _for_each_run(_border(mask), width, height, [&image, color](int y, int begin, int end) {
+                QRgb* row = reinterpret_cast<QRgb*>(image.scanLine(y));
+                for (int x = begin; x < end; x++) {
+                    row[x] = color;
+                }
+            });
+        }
+        if (_outputs & STATISTICS_OUTPUT) {
+            QGraphicsROIMetrics metrics =
+                entry.shape.isNull() ? _mask_metrics(mask) : QGraphicsROIMetrics::fromShape(entry.shape);
+            QGraphicsImageData::Statistics statistics = job->data.statistics(mask);
+            QString line = QString("%1,%2,%3,%4")
+                               .arg(name)
+                               .arg(entry.id)
+                               .arg(_csv_text(entry.label))
+                               .arg(_shape_name(entry));
+            QList<double> values;
+            values << metrics.area << metrics.perimeter << metrics.centroid.x() << metrics.centroid.y()
+                   << metrics.bound.x() << metrics.bound.y() << metrics.bound.width() << metrics.bound.height()
+                   << double(statistics.count) << statistics.min << statistics.max << statistics.mean
+                   << statistics.deviation;
+            foreach (double value, values) {
+                line += ',' + QString::number(value, 'g', 10);
+            }
+            job->statistics += line.toUtf8() + '\n';
+        }
+    }
+    job->data = QGraphicsImageData();
+}
+
+void QGraphicsROIBatch::_encode(Job* job) const
+{
+    if (_outputs & MASK_OUTPUT) {
+        QImageWriter writer(_output_path(job, "_mask.png"), "png");
+        if (!writer.write(job->mask)) {
+            job->error = writer.errorString();
+        }
+        job->mask = QImage();
+    }
+    if (_outputs & OVERLAY_OUTPUT) {
+        QImageWriter writer(_output_path(job, "_overlay.png"), "png");
+        if (!writer.write(job->overlay)) {
+            job->error = writer.errorString();
+        }
+        job->overlay = QImage();
+    }
+}
+
+void QGraphicsROIBatch::_add_time(STAGE stage, qint64 nsecs)
+{
+    QMutexLocker locker(&_mutex);
+    _stage_time[stage] += nsecs;
+}
+
+QString QGraphicsROIBatch::_output_path(const Job* job, const QString& suffix) const
+{
+    return QDir(_output_dir).filePath(QFileInfo(job->path).completeBaseName() + suffix);
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <QString>
+#include <QStringList>
+#include <QImage>
+#include <QMap>
+#include <QQueue>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QSemaphore>
+#include <QAtomicInt>
+#include "QGraphicsROIFile.h"
+#include "QGraphicsImageData.h"
+
+/*!
+ * This class renders masks, overlays and statistics of ROI files for a list
+ * of images, without graphics items or widgets, for batch jobs.
+ *
+ * The ROIs of image dir/name.png are read from name.json, in the ROI dir or
+ * next to the image, as written by QGraphicsROIFile. Outputs, in the output
+ * dir:
+ *
+ *   name_mask.png     8 bit, pixels of the n-th ROI are n, 255 from the
+ *                     255-th on, later ROIs over earlier ones
+ *   name_overlay.png  the image with ROIs tinted and outlined
+ *   statistics.csv    metrics of each ROI, and statistics of the values of
+ *                     the image in it, in the order of images
+ *
+ * Images go through three stages, each on its own threads: decode reads an
+ * image and its ROI file, rasterize makes masks of ROIs and renders the
+ * outputs, encode writes them. Stages are joined by queues, so decoding of
+ * an image overlaps rendering and writing of others. At most
+ * setMaxInFlight() images are between decode and encode, which bounds the
+ * memory whatever the number of images. Pixels are not decoded when only
+ * masks are written, the size of the image is enough.
+ *
+ * Usage:
+ *
+ *   QGraphicsROIBatch batch;
+ *   batch.setOutputs(QGraphicsROIBatch::MASK_OUTPUT | QGraphicsROIBatch::STATISTICS_OUTPUT);
+ *   batch.setOutputDir(dir);
+ *   if (!batch.run(images)) {
+ *       foreach (const QString& error, batch.errors()) ...
+ *   }
+ */
+class QGraphicsROIBatch
+{
+public:
+    enum OUTPUT
+    {
+        MASK_OUTPUT = 1,
+        OVERLAY_OUTPUT = 2,
+        STATISTICS_OUTPUT = 4
+    };
+
+    enum STAGE
+    {
+        DECODE_STAGE = 0,
+        RASTERIZE_STAGE = 1,
+        ENCODE_STAGE = 2
+    };
+
+    QGraphicsROIBatch();
+
+    void setOutputs(int outputs);
+    void setOutputDir(const QString& dir);
+    // empty for ROI files next to images
+    void setRoiDir(const QString& dir);
+    // threads of all stages, 0 for the number of cores
+    void setThreads(int count);
+    // images decoded and not yet written, 0 for twice the threads
+    void setMaxInFlight(int count);
+    void setOverlayOpacity(qreal opacity);
+
+    // blocks until all images are done, false when any failed
+    bool run(const QStringList& images);
+
+    int processedCount() const;
+    int failedCount() const;
+    // of images failed, with their paths
+    QStringList errors() const;
+    // msec spent in a stage, summed over its threads
+    qint64 stageTime(STAGE stage) const;
+
+private:
+    // an image on its way through the stages
+    struct Job
+    {
+        int index;
+        QString path;
+        QSize size;
+        QImage image;
+        QGraphicsImageData data; // for statistics
+        QVector<QGraphicsROIFile::Entry> entries;
+        QImage mask;
+        QImage overlay;
+        QByteArray statistics; // lines of csv
+        QString error;
+    };
+
+    // queue between two stages, closed when its producers are done
+    class Channel
+    {
+    public:
+        Channel() : _producers(0) {}
+        void open(int producers);
+        void push(Job* job);
+        // NULL when closed and empty
+        Job* pop();
+        void close();
+
+    private:
+        QMutex _mutex;
+        QWaitCondition _ready;
+        QQueue<Job*> _jobs;
+        int _producers;
+    };
+
+    int _outputs;
+    QString _output_dir;
+    QString _roi_dir;
+    int _threads;
+    int _max_in_flight;
+    qreal _opacity;
+
+    QStringList _images;
+    QAtomicInt _next;
+    QSemaphore _free; // of images in flight
+    Channel _rasterize_channel;
+    Channel _encode_channel;
+
+    mutable QMutex _mutex; // for results below
+    int _processed;
+    QStringList _errors;
+    QMap<int, QByteArray> _statistics;
+    qint64 _stage_time[3];
+
+    void _decode_loop();
+    void _rasterize_loop();
+    void _encode_loop();
+    void _decode(Job* job) const;
+    void _rasterize(Job* job) const;
+    void _encode(Job* job) const;
+    void _add_time(STAGE stage, qint64 nsecs);
+    QString _output_path(const Job* job, const QString& suffix) const;
+};
@@ -0,0 +1,632 @@
+#include "QGraphicsROIBoolean.h"
+#include "QGraphicsROIOverlap.h"
+#include <QHash>
+#include <QPair>
+#include <qmath.h>
+#include <algorithm>
+#include <cstring>
+
+#define MAX_EDGE_CELLS 64
+#define MAX_BANDS 4096
+#define SNAP_BITS 36
+
+// edge of an input ring
+struct BooleanEdge
+{
+    QPointF a;
+    QPointF b;
+    int operand;
+    int next; // next edge of the ring
+    bool first; // first edge of the ring
+};
+
+// intersection point on an edge, at parameter t
+struct BooleanSplit
+{
+    qreal t;
+    QPointF point;
+    bool operator<(const BooleanSplit& other) const { return t < other.t; }
+};
+
+// piece of an edge between intersections
+struct BooleanSegment
+{
+    int a;
+    int b; // vertices
+    int edge;
+    int group;
+    bool first;
+};
+
+// coincident segments, classified along the first one
+struct BooleanGroup
+{
+    int a;
+    int b;
+    int count[2]; // segments of each operand
+    QVector<int> edges;
+    bool classified;
+    bool left[2]; // inside of each operand on both sides
+    bool right[2];
+};
+
+// output edge with the result inside on its left
+struct BooleanLink
+{
+    int a;
+    int b;
+};
+
+typedef QPair<quint64, quint64> PointKey;
+
+static quint64 _cell_key(int cx, int cy)
+{
+    return (quint64(quint32(cx)) << 32) | quint32(cy);
+}
+
+static qreal _cross(const QPointF& a, const QPointF& b)
+{
+    return a.x() * b.y() - a.y() * b.x();
+}
+
+// exact bits of a point, without negative zero
+static PointKey _point_key(const QPointF& point)
+{
+    double x = point.x() + 0.0;
+    double y = point.y() + 0.0;
+    quint64 kx, ky;
+    memcpy(&kx, &x, sizeof(kx));
+    memcpy(&ky, &y, sizeof(ky));
+    return qMakePair(kx, ky);
+}
+
+static bool _result(int operation, bool a, bool b)
+{
+    switch (operation) {
+    case QGraphicsROIBoolean::UNITE:
+        return a || b;
+    case QGraphicsROIBoolean::INTERSECT:
+        return a && b;
+    case QGraphicsROIBoolean::SUBTRACT:
+        return a && !b;
+    default:
+        return a != b;
+    }
+}
+
+static void _add_rings(QVector<BooleanEdge>& edges, const QVector<QPolygonF>& rings, int operand)
+{
+    foreach (const QPolygonF& ring, rings) {
+        QPolygonF points;
+        points.reserve(ring.size());
+        foreach (const QPointF& point, ring) {
+            if (points.isEmpty() || points.last() != point) {
+                points.append(point);
+            }
+        }
+        while (points.size() > 1 && points.first() == points.last()) {
+            points.removeLast();
+        }
+        int n = points.size();
+        if (n < 3) {
+            continue;
+        }
+        int start = edges.size();
+        for (int i = 0; i < n; i++) {
+            BooleanEdge edge;
+            edge.a = points[i];
+            edge.b = points[(i + 1) % n];
+            edge.operand = operand;
+            edge.next = start + (i + 1) % n;
+            edge.first = i == 0;
+            edges.append(edge);
+        }
+    }
+}
+
+static void _add_split(QVector<BooleanSplit>& splits, qreal t, const QPointF& point)
+{
+    if (t > 0 && t < 1) {
+        BooleanSplit split;
+        split.t = t;
+        split.point = point;
+        splits.append(split);
+    }
+}
+
+// split both edges at their intersection, or at the endpoints on the other edge
+static void _intersect(const BooleanEdge& e0, const BooleanEdge& e1,
+                       QVector<BooleanSplit>& s0, QVector<BooleanSplit>& s1)
+{
+    QPointF r = e0.b - e0.a;
+    QPointF s = e1.b - e1.a;
+    qreal oc = _cross(r, e1.a - e0.a);
+    qreal od = _cross(r, e1.b - e0.a);
+    if ((oc > 0 && od > 0) || (oc < 0 && od < 0)) {
+        return;
+    }
+    qreal oa = _cross(s, e0.a - e1.a);
+    qreal ob = _cross(s, e0.b - e1.a);
+    if ((oa > 0 && ob > 0) || (oa < 0 && ob < 0)) {
+        return;
+    }
+    qreal rr = QPointF::dotProduct(r, r);
+    qreal ss = QPointF::dotProduct(s, s);
+    if (oc == 0 && od == 0) {
+        // collinear, endpoints inside the other edge
+        _add_split(s0, QPointF::dotProduct(e1.a - e0.a, r) / rr, e1.a);
+        _add_split(s0, QPointF::dotProduct(e1.b - e0.a, r) / rr, e1.b);
+        _add_split(s1, QPointF::dotProduct(e0.a - e1.a, s) / ss, e0.a);
+        _add_split(s1, QPointF::dotProduct(e0.b - e1.a, s) / ss, e0.b);
+        return;
+    }
+    if (oc == 0 || od == 0 || oa == 0 || ob == 0) {
+        if (oc == 0) {
+            _add_split(s0, QPointF::dotProduct(e1.a - e0.a, r) / rr, e1.a);
+        }
+        if (od == 0) {
+            _add_split(s0, QPointF::dotProduct(e1.b - e0.a, r) / rr, e1.b);
+        }
+        if (oa == 0) {
+            _add_split(s1, QPointF::dotProduct(e0.a - e1.a, s) / ss, e0.a);
+        }
+        if (ob == 0) {
+            _add_split(s1, QPointF::dotProduct(e0.b - e1.a, s) / ss, e0.b);
+        }
+        return;
+    }
+    // the same point on both edges
+    QPointF point = e0.a + r * (oa / (oa - ob));
+    _add_split(s0, oa / (oa - ob), point);
+    _add_split(s1, oc / (oc - od), point);
+}
+
+static bool _touching(const QRectF& a, const QRectF& b)
+{
+    return a.left() <= b.right() && b.left() <= a.right() &&
+           a.top() <= b.bottom() && b.top() <= a.bottom();
+}
+
+static bool _adjacent(const QVector<BooleanEdge>& edges, int i, int j)
+{
+    return edges[i].next == j || edges[j].next == i;
+}
+
+// candidate pairs from a uniform grid of edge bounds, each pair tested by the
+// cell holding the top left corner of the intersection of their bounds
+static void _split_edges(const QVector<BooleanEdge>& edges, QVector<QVector<BooleanSplit> >& splits)
+{
+    int n = edges.size();
+    QVector<QRectF> bounds(n);
+    qreal size = 0;
+    for (int i = 0; i < n; i++) {
+        const BooleanEdge& edge = edges[i];
+        bounds[i] = QRectF(QPointF(qMin(edge.a.x(), edge.b.x()), qMin(edge.a.y(), edge.b.y())),
+                           QPointF(qMax(edge.a.x(), edge.b.x()), qMax(edge.a.y(), edge.b.y())));
+        size += qMax(bounds[i].width(), bounds[i].height());
+    }
+    qreal cell_size = size / n;
+    if (cell_size <= 0) {
+        return;
+    }
+
+    QHash<quint64, QVector<int> > grid;
+    QVector<int> large;
+    QVector<bool> is_large(n, false);
+    for (int i = 0; i < n; i++) {
+        const QRectF& bound = bounds[i];
+        int x0 = qFloor(bound.left() / cell_size);
+        int x1 = qFloor(bound.right() / cell_size);
+        int y0 = qFloor(bound.top() / cell_size);
+        int y1 = qFloor(bound.bottom() / cell_size);
+        if (qint64(x1 - x0 + 1) * (y1 - y0 + 1) > MAX_EDGE_CELLS) {
+            large.append(i);
+            is_large[i] = true;
+            continue;
+        }
+        for (int cy = y0; cy <= y1; cy++) {
+            for (int cx = x0; cx <= x1; cx++) {
+                grid[_cell_key(cx, cy)].append(i);
+            }
+        }
+    }
+
+    QHash<quint64, QVector<int> >::const_iterator it;
+    for (it = grid.constBegin(); it != grid.constEnd(); ++it) {
+        const QVector<int>& cell = it.value();
+        for (int p = 0; p < cell.size(); p++) {
+            for (int q = p + 1; q < cell.size(); q++) {
+                int i = cell[p];
+                int j = cell[q];
+                if (!_touching(bounds[i], bounds[j]) || _adjacent(edges, i, j)) {
+                    continue;
+                }
+                qreal left = qMax(bounds[i].left(), bounds[j].left());
+                qreal top = qMax(bounds[i].top(), bounds[j].top());
+                if (_cell_key(qFloor(left / cell_size), qFloor(top / cell_size)) != it.key()) {
+                    continue;
+                }
+                _intersect(edges[i], edges[j], splits[i], splits[j]);
+            }
+        }
+    }
+    foreach (int i, large) {
+        for (int j = 0; j < n; j++) {
+            if (j == i || (is_large[j] && j < i)) {
+                continue;
+            }
+            if (_touching(bounds[i], bounds[j]) && !_adjacent(edges, i, j)) {
+                _intersect(edges[i], edges[j], splits[i], splits[j]);
+            }
+        }
+    }
+}
+
+// edges in horizontal bands, for ray casting
+class BooleanBands
+{
+public:
+    BooleanBands(const QVector<BooleanEdge>& edges)
+        : _edges(edges)
+        , _top(0)
+        , _height(1)
+    {
+        qreal bottom = 0;
+        for (int i = 0; i < edges.size(); i++) {
+            qreal y0 = qMin(edges[i].a.y(), edges[i].b.y());
+            qreal y1 = qMax(edges[i].a.y(), edges[i].b.y());
+            _top = i == 0 ? y0 : qMin(_top, y0);
+            bottom = i == 0 ? y1 : qMax(bottom, y1);
+        }
+        int count = qBound(1, edges.size() / 8, MAX_BANDS);
+        if (bottom > _top) {
+            _height = (bottom - _top) / count;
+        }
+        else {
+            count = 1;
+        }
+        _bands.resize(count);
+        for (int i = 0; i < edges.size(); i++) {
+            // horizontal edges never cross a ray
+            if (edges[i].a.y() == edges[i].b.y()) {
+                continue;
+            }
+            int b0 = _band(qMin(edges[i].a.y(), edges[i].b.y()));
+            int b1 = _band(qMax(edges[i].a.y(), edges[i].b.y()));
+            for (int b = b0; b <= b1; b++) {
+                _bands[b].append(i);
+            }
+        }
+    }
+
+    // parity of crossings of the ray to the right of point, without given edges,
+    // a point on a vertex is taken slightly above it
+    void cast(const QPointF& point, const QVector<int>& excluded, bool parity[2]) const
+    {
+        parity[0] = parity[1] = false;
+        qreal y = point.y();
+        foreach (int i, _bands[_band(y)]) {
+            const BooleanEdge& edge = _edges[i];
+            if (!((edge.a.y() <= y && y < edge.b.y()) || (edge.b.y() <= y && y < edge.a.y()))) {
+                continue;
+            }
+            if (excluded.contains(i)) {
+                continue;
+            }
+            qreal x = edge.a.x() + (y - edge.a.y()) * (edge.b.x() - edge.a.x()) / (edge.b.y() - edge.a.y());
+            if (x > point.x()) {
+                parity[edge.operand] = !parity[edge.operand];
+            }
+        }
+    }
+
+private:
+    const QVector<BooleanEdge>& _edges;
+    QVector<QVector<int> > _bands;
+    qreal _top;
+    qreal _height;
+
+    int _band(qreal y) const
+    {
+        return qBound(0, int((y - _top) / _height), _bands.size() - 1);
+    }
+};
+
+// inside of both operands on both sides of the group
+static void _classify(BooleanGroup& group, const QVector<QPointF>& vertices, const BooleanBands& bands)
+{
+    const QPointF& a = vertices[group.a];
+    const QPointF& b = vertices[group.b];
+    bool parity[2];
+    bands.cast((a + b) / 2, group.edges, parity);
+    // the ray starts on the right side of edges going up, and edges going left,
+    // as points on horizontal edges are taken slightly above
+    QPointF d = b - a;
+    bool ray_right = d.y() > 0 || (d.y() == 0 && d.x() < 0);
+    for (int o = 0; o < 2; o++) {
+        bool other = parity[o] != bool(group.count[o] & 1);
+        group.right[o] = ray_right ? parity[o] : other;
+        group.left[o] = ray_right ? other : parity[o];
+    }
+    group.classified = true;
+}
+
+// drop vertices in the middle of straight runs
+static QPolygonF _simplified(const QPolygonF& ring)
+{
+    QPolygonF points = ring;
+    bool removed = true;
+    while (removed && points.size() > 3) {
+        removed = false;
+        QPolygonF kept;
+        int n = points.size();
+        for (int i = 0; i < n; i++) {
+            const QPointF& prev = kept.isEmpty() ? points[n - 1] : kept.last();
+            QPointF d0 = points[i] - prev;
+            QPointF d1 = points[(i + 1) % n] - points[i];
+            if (_cross(d0, d1) == 0 && QPointF::dotProduct(d0, d1) > 0) {
+                removed = true;
+                continue;
+            }
+            kept.append(points[i]);
+        }
+        points.swap(kept);
+    }
+    return points;
+}
+
+static bool _contains(const QPolygonF& polygon, const QPointF& point)
+{
+    bool inside = false;
+    int n = polygon.size();
+    for (int i = 0, j = n - 1; i < n; j = i++) {
+        const QPointF& a = polygon[i];
+        const QPointF& b = polygon[j];
+        if ((a.y() > point.y()) != (b.y() > point.y()) &&
+            point.x() < (b.x() - a.x()) * (point.y() - a.y()) / (b.y() - a.y()) + a.x()) {
+            inside = !inside;
+        }
+    }
+    return inside;
+}
+
+QVector<QGraphicsROIShape> QGraphicsROIBoolean::apply(const QGraphicsROIShape& subject, const QGraphicsROIShape& clip,
+                                                      OPERATION operation, qreal tolerance)
+{
+    return regions(apply(rings(subject, tolerance), rings(clip, tolerance), operation));
+}
+
+QVector<QPolygonF> QGraphicsROIBoolean::apply(const QVector<QPolygonF>& subject, const QVector<QPolygonF>& clip,
+                                              OPERATION operation)
+{
+    QVector<BooleanEdge> edges;
+    _add_rings(edges, subject, 0);
+    _add_rings(edges, clip, 1);
+    if (edges.isEmpty()) {
+        return QVector<QPolygonF>();
+    }
+
+    QVector<QVector<BooleanSplit> > splits(edges.size());
+    _split_edges(edges, splits);
+
+    // points are snapped to a fine power of two grid, so the intersections of
+    // nearly equal lines meet at the same vertex
+    qreal extent = 0;
+    foreach (const BooleanEdge& edge, edges) {
+        extent = qMax(extent, qMax(qAbs(edge.a.x()), qAbs(edge.a.y())));
+    }
+    int exponent = 0;
+    frexp(qMax(extent, qreal(1e-300)), &exponent);
+    qreal quantum = ldexp(1.0, exponent - SNAP_BITS);
+
+    QHash<PointKey, int> vertex_ids;
+    QVector<QPointF> vertices;
+    QVector<int> degree;
+    QVector<BooleanSegment> segments;
+    QHash<quint64, int> group_ids;
+    QVector<BooleanGroup> groups;
+    segments.reserve(edges.size());
+    vertices.reserve(edges.size());
+    for (int i = 0; i < edges.size(); i++) {
+        QVector<BooleanSplit>& points = splits[i];
+        std::sort(points.begin(), points.end());
+        bool first = edges[i].first;
+        int previous = -1;
+        for (int k = -1; k <= points.size(); k++) {
+            QPointF point = k < 0 ? edges[i].a : (k == points.size() ? edges[i].b : points[k].point);
+            point = QPointF(floor(point.x() / quantum + 0.5) * quantum, floor(point.y() / quantum + 0.5) * quantum);
+            PointKey key = _point_key(point);
+            QHash<PointKey, int>::const_iterator found = vertex_ids.constFind(key);
+            int vertex;
+            if (found != vertex_ids.constEnd()) {
+                vertex = found.value();
+            }
+            else {
+                vertex = vertices.size();
+                vertex_ids.insert(key, vertex);
+                vertices.append(point);
+                degree.append(0);
+            }
+            if (previous >= 0 && vertex != previous) {
+                BooleanSegment segment;
+                segment.a = previous;
+                segment.b = vertex;
+                segment.edge = i;
+                segment.first = first;
+                first = false;
+                quint64 group_key = (quint64(qMin(previous, vertex)) << 32) | quint32(qMax(previous, vertex));
+                QHash<quint64, int>::const_iterator group = group_ids.constFind(group_key);
+                if (group != group_ids.constEnd()) {
+                    segment.group = group.value();
+                }
+                else {
+                    segment.group = groups.size();
+                    group_ids.insert(group_key, segment.group);
+                    BooleanGroup g;
+                    g.a = previous;
+                    g.b = vertex;
+                    g.count[0] = g.count[1] = 0;
+                    g.classified = false;
+                    groups.append(g);
+                }
+                BooleanGroup& g = groups[segment.group];
+                g.count[edges[i].operand]++;
+                if (!g.edges.contains(i)) {
+                    g.edges.append(i);
+                }
+                degree[previous]++;
+                degree[vertex]++;
+                segments.append(segment);
+            }
+            previous = vertex;
+        }
+    }
+
+    // classified by ray casting at the start of each chain of segments, and
+    // carried along the chain through vertices of no other segment
+    BooleanBands bands(edges);
+    for (int k = 0; k < segments.size(); k++) {
+        const BooleanSegment& segment = segments[k];
+        BooleanGroup& group = groups[segment.group];
+        if (group.classified) {
+            continue;
+        }
+        if (!segment.first && degree[segment.a] == 2 && segments[k - 1].b == segment.a) {
+            const BooleanGroup& previous = groups[segments[k - 1].group];
+            for (int o = 0; o < 2; o++) {
+                group.left[o] = previous.left[o];
+                group.right[o] = previous.right[o];
+            }
+            group.classified = true;
+        }
+        else {
+            _classify(group, vertices, bands);
+        }
+    }
+
+    // edges of the result, inside on the left
+    QVector<BooleanLink> links;
+    foreach (const BooleanGroup& group, groups) {
+        bool left = _result(operation, group.left[0], group.left[1]);
+        bool right = _result(operation, group.right[0], group.right[1]);
+        if (left != right) {
+            BooleanLink link;
+            link.a = left ? group.a : group.b;
+            link.b = left ? group.b : group.a;
+            links.append(link);
+        }
+    }
+
+    // links leaving each vertex
+    QVector<int> offsets(vertices.size() + 1, 0);
+    foreach (const BooleanLink& link, links) {
+        offsets[link.a + 1]++;
+    }
+    for (int v = 0; v < vertices.size(); v++) {
+        offsets[v + 1] += offsets[v];
+    }
+    QVector<int> outgoing(links.size());
+    QVector<int> filled = offsets;
+    for (int i = 0; i < links.size(); i++) {
+        outgoing[filled[links[i].a]++] = i;
+    }
+
+    // rings turning left at shared vertices
+    QVector<QPolygonF> result;
+    QVector<bool> used(links.size(), false);
+    for (int start = 0; start < links.size(); start++) {
+        if (used[start]) {
+            continue;
+        }
+        used[start] = true;
+        QPolygonF ring;
+        ring.append(vertices[links[start].a]);
+        int current = start;
+        while (links[current].b != links[start].a) {
+            int v = links[current].b;
+            ring.append(vertices[v]);
+            QPointF incoming = vertices[v] - vertices[links[current].a];
+            int next = -1;
+            qreal best = 0;
+            for (int k = offsets[v]; k < offsets[v + 1]; k++) {
+                int candidate = outgoing[k];
+                if (used[candidate]) {
+                    continue;
+                }
+                QPointF d = vertices[links[candidate].b] - vertices[v];
+                qreal cross = _cross(incoming, d);
+                qreal dot = QPointF::dotProduct(incoming, d);
+                qreal turn = (cross == 0 && dot < 0) ? -M_PI : qAtan2(cross, dot);
+                if (next < 0 || turn > best) {
+                    next = candidate;
+                    best = turn;
+                }
+            }
+            if (next < 0) {
+                break;
+            }
+            used[next] = true;
+            current = next;
+        }
+        ring = _simplified(ring);
+        if (ring.size() >= 3) {
+            result.append(ring);
+        }
+    }
+    return result;
+}
+
+QVector<QPolygonF> QGraphicsROIBoolean::rings(const QGraphicsROIShape& shape, qreal tolerance)
+{
+    QVector<QPolygonF> rings;
+    if (!shape.isNull()) {
+        rings.append(shape.toPolygon(tolerance));
+        rings += shape.holes;
+    }
+    return rings;
+}
+
+QVector<QGraphicsROIShape> QGraphicsROIBoolean::regions(const QVector<QPolygonF>& rings)
+{
+    int n = rings.size();
+    QVector<qreal> areas(n);
+    QVector<QRectF> bounds(n);
+    QVector<int> shape_index(n, -1);
+    QVector<QGraphicsROIShape> shapes;
+    for (int i = 0; i < n; i++) {
+        areas[i] = QGraphicsROIOverlap::signedArea(rings[i]);
+        bounds[i] = rings[i].boundingRect();
+        if (areas[i] > 0) {
+            shape_index[i] = shapes.size();
+            shapes.append(QGraphicsROIShape::fromPolygon(rings[i]));
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        if (areas[i] >= 0) {
+            continue;
+        }
+        QPointF point = (rings[i][0] + rings[i][1]) / 2;
+        int outline = -1;
+        for (int j = 0; j < n; j++) {
+            if (areas[j] <= 0 || (outline >= 0 && areas[j] >= areas[outline])) {
+                continue;
+            }
+            if (bounds[j].contains(bounds[i]) && _contains(rings[j], point)) {
+                outline = j;
+            }
+        }
+        if (outline >= 0) {
+            shapes[shape_index[outline]].holes.append(rings[i]);
+        }
+    }
+    return shapes;
+}
+
+qreal QGraphicsROIBoolean::area(const QVector<QPolygonF>& rings)
+{
+    qreal sum = 0;
+    foreach (const QPolygonF& ring, rings) {
+        sum += QGraphicsROIOverlap::signedArea(ring);
+    }
+    return sum;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <QVector>
+#include <QPolygonF>
+#include "QGraphicsROIShape.h"
+
+/*!
+ * This class computes union, intersection, difference and xor of ROIs.
+ *
+ * An operand is a set of rings with even-odd fill, as polygons are drawn, so
+ * holes and self intersecting polygons need no special care. Rects are taken
+ * as-is, circles are converted to polygons within given tolerance.
+ *
+ * All edges of both operands are split at their intersections, found with a
+ * uniform grid of edges. The inside of both operands on each side of an edge
+ * is found by ray casting over horizontal bands of edges, once per chain of
+ * edges between intersections, and carried along the chain. Coincident edges
+ * are kept once. Edges with the result inside on one side only are linked into
+ * rings, turning left at shared vertices so rings touching at a vertex are kept
+ * apart. Intersection points are shared exactly by the edges split at them.
+ *
+ * Result rings are counter clockwise outlines, positive signed area, and
+ * clockwise holes, which regions() assigns to the smallest enclosing outline.
+ *
+ * Usage:
+ *
+ *   QVector<QGraphicsROIShape> regions = QGraphicsROIBoolean::apply(polygon, circle,
+ *                                                                   QGraphicsROIBoolean::SUBTRACT);
+ */
+class QGraphicsROIBoolean
+{
+public:
+    enum OPERATION
+    {
+        UNITE = 0,
+        INTERSECT = 1,
+        SUBTRACT = 2,
+        XOR = 3,
+    };
+
+    // result regions as polygon shapes with holes
+    static QVector<QGraphicsROIShape> apply(const QGraphicsROIShape& subject, const QGraphicsROIShape& clip,
+                                            OPERATION operation, qreal tolerance = 0.5);
+
+    // result rings of two sets of rings, may be chained
+    static QVector<QPolygonF> apply(const QVector<QPolygonF>& subject, const QVector<QPolygonF>& clip,
+                                    OPERATION operation);
+
+    // outline and holes of a shape
+    static QVector<QPolygonF> rings(const QGraphicsROIShape& shape, qreal tolerance = 0.5);
+
+    // polygon shapes of result rings, holes in their smallest enclosing outline
+    static QVector<QGraphicsROIShape> regions(const QVector<QPolygonF>& rings);
+
+    // area of result rings, outlines less holes
+    static qreal area(const QVector<QPolygonF>& rings);
+};
@@ -0,0 +1,189 @@
+#include "QGraphicsROIClusters.h"
+#include <QPainter>
+#include <qmath.h>
+#include <cassert>
+
+#define LOD_PROPERTY "lod_cell_size"
+#define MAX_LEVELS 24
+#define DEFAULT_CLUSTER_SIZE 16
+
+static quint64 _cell_key(const QPointF& pos, qreal cell)
+{
+    qint32 cx = qint32(qFloor(pos.x() / cell));
+    qint32 cy = qint32(qFloor(pos.y() / cell));
+    return (quint64(quint32(cx)) << 32) | quint32(cy);
+}
+
+// of the view, also when rotated, as m11 is the scale times the cosine
+static qreal _view_zoom(const QGraphicsView* view)
+{
+    return qSqrt(qAbs(view->transform().determinant()));
+}
+
+QGraphicsROIClusters::QGraphicsROIClusters(QGraphicsView* view)
+    : QObject(view)
+    , _view(view)
+    , _scene(view->scene())
+    , _cluster_size(DEFAULT_CLUSTER_SIZE)
+    , _full_detail_zoom(1.0)
+    , _style(CLUSTER_MARKERS)
+    , _level(-1)
+    , _levels(MAX_LEVELS)
+{
+    assert(_scene);
+    // select level before items are painted
+    _view->viewport()->installEventFilter(this);
+    _update_level();
+}
+
+QGraphicsROIClusters::~QGraphicsROIClusters()
+{
+    if (_scene) {
+        _scene->setProperty(LOD_PROPERTY, 0);
+    }
+}
+
+void QGraphicsROIClusters::setClusterSize(int size)
+{
+    _cluster_size = size;
+    _view->viewport()->update();
+}
+
+void QGraphicsROIClusters::setFullDetailZoom(qreal zoom)
+{
+    _full_detail_zoom = zoom;
+    _view->viewport()->update();
+}
+
+void QGraphicsROIClusters::setStyle(int style)
+{
+    _style = style;
+    _view->viewport()->update();
+}
+
+qreal QGraphicsROIClusters::lodCellSize(const QGraphicsScene* scene)
+{
+    return scene ? scene->property(LOD_PROPERTY).toReal() : 0;
+}
+
+void QGraphicsROIClusters::setItem(QGraphicsItem* item, const QRectF& bound)
+{
+    QHash<QGraphicsItem*, Entry>::iterator it = _entries.find(item);
+    if (it != _entries.end()) {
+        _add(*it, -1);
+    }
+    else {
+        it = _entries.insert(item, Entry());
+    }
+    qreal size = qMax(bound.width(), bound.height());
+    it->center = bound.center();
+    it->level = size <= 1 ? 0 : qMin(MAX_LEVELS, int(qCeil(log2(size))));
+    _add(*it, 1);
+}
+
+void QGraphicsROIClusters::removeItem(QGraphicsItem* item)
+{
+    QHash<QGraphicsItem*, Entry>::iterator it = _entries.find(item);
+    if (it != _entries.end()) {
+        _add(*it, -1);
+        _entries.erase(it);
+    }
+}
+
+void QGraphicsROIClusters::clear()
+{
+    _entries.clear();
+    for (int l = 0; l < _levels.size(); l++) {
+        _levels[l].clear();
+    }
+}
+
+// count or discount the item in one cell per level
+void QGraphicsROIClusters::_add(const Entry& entry, int sign)
+{
+    for (int l = entry.level; l < MAX_LEVELS; l++) {
+        quint64 key = _cell_key(entry.center, qreal(1 << l));
+        Cell& cell = _levels[l][key];
+        cell.count += sign;
+        cell.sum += entry.center * sign;
+        if (cell.count <= 0) {
+            _levels[l].remove(key);
+        }
+    }
+}
+
+bool QGraphicsROIClusters::eventFilter(QObject* object, QEvent* event)
+{
+    if (event->type() == QEvent::Paint) {
+        _update_level();
+    }
+    Q_UNUSED(object)
+    return false;
+}
+
+// level with cells of about cluster size in device pixels
+void QGraphicsROIClusters::_update_level()
+{
+    qreal zoom = _view_zoom(_view);
+    if (zoom >= _full_detail_zoom || zoom <= 0) {
+        _level = -1;
+    }
+    else {
+        _level = qBound(0, int(qCeil(log2(_cluster_size / zoom))), MAX_LEVELS - 1);
+    }
+    if (_scene) {
+        _scene->setProperty(LOD_PROPERTY, _level < 0 ? qreal(0) : qreal(1 << _level));
+    }
+}
+
+void QGraphicsROIClusters::paint(QPainter* painter, const QRectF& rect)
+{
+    if (_level < 0) {
+        return;
+    }
+    qreal cell_size = qreal(1 << _level);
+    const QHash<quint64, Cell>& cells = _levels[_level];
+    painter->save();
+    painter->setPen(Qt::NoPen);
+    painter->setBrush(QColor(255, 0, 0, 160));
+    // look up exposed cells, or walk all cells of the level if fewer
+    int x0 = qFloor(rect.left() / cell_size);
+    int x1 = qFloor(rect.right() / cell_size);
+    int y0 = qFloor(rect.top() / cell_size);
+    int y1 = qFloor(rect.bottom() / cell_size);
+    if (qint64(x1 - x0 + 1) * (y1 - y0 + 1) < cells.size()) {
+        for (int cy = y0; cy <= y1; cy++) {
+            for (int cx = x0; cx <= x1; cx++) {
+                quint64 key = (quint64(quint32(cx)) << 32) | quint32(cy);
+                QHash<quint64, Cell>::const_iterator it = cells.constFind(key);
+                if (it != cells.constEnd()) {
+                    _paint_cell(painter, key, *it);
+                }
+            }
+        }
+    }
+    else {
+        QHash<quint64, Cell>::const_iterator it;
+        for (it = cells.constBegin(); it != cells.constEnd(); ++it) {
+            _paint_cell(painter, it.key(), *it);
+        }
+    }
+    painter->restore();
+}
+
+void QGraphicsROIClusters::_paint_cell(QPainter* painter, quint64 key, const Cell& cell)
+{
+    qreal cell_size = qreal(1 << _level);
+    if (_style == DENSITY_HEAT) {
+        qreal cx = qint32(key >> 32) * cell_size;
+        qreal cy = qint32(key & 0xffffffff) * cell_size;
+        int alpha = qMin(255, 48 + int(48 * log2(qreal(cell.count))));
+        painter->fillRect(QRectF(cx, cy, cell_size, cell_size), QColor(255, 0, 0, alpha));
+    }
+    else {
+        // marker at centroid of the cluster, growing with count
+        qreal zoom = _view_zoom(_view);
+        qreal radius = qMin(_cluster_size / 2.0, 2 + sqrt(qreal(cell.count))) / zoom;
+        painter->drawEllipse(cell.sum / cell.count, radius, radius);
+    }
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <QObject>
+#include <QGraphicsView>
+#include <QGraphicsScene>
+#include <QGraphicsItem>
+#include <QHash>
+#include <QVector>
+#include <QPointer>
+
+/*!
+ * This class draws ROIs too small to be seen at current zoom level as clusters,
+ * instead of painting them one by one.
+ *
+ * ROIs are kept in a hierarchical grid, level l has cells of 2^l scene units.
+ * A ROI of size s (larger side of its bounding box) is counted in the cell of its
+ * center at all levels where s <= 2^l. Adding, removing and moving a ROI updates
+ * one cell per level.
+ *
+ * Before the view is painted, the level whose cells are about setClusterSize()
+ * device pixels is selected. ROIs counted at that level are drawn as clusters
+ * by paint(), and items skip painting when lodCellSize(scene()) is not less than
+ * their size. Past setFullDetailZoom() all items are painted in full detail.
+ *
+ * Usage:
+ *
+ *   QGraphicsROIClusters* clusters = new QGraphicsROIClusters(view);
+ *   clusters->setItem(item, item->roiShape().boundingRect());
+ *   // in drawForeground() of the view
+ *   clusters->paint(painter, rect);
+ */
+class QGraphicsROIClusters : public QObject
+{
+    Q_OBJECT
+public:
+    enum CLUSTER_STYLE
+    {
+        CLUSTER_MARKERS = 0,
+        DENSITY_HEAT = 1,
+    };
+
+    QGraphicsROIClusters(QGraphicsView* view);
+    ~QGraphicsROIClusters();
+
+    // items smaller than a cell of this size in device pixels are clustered
+    void setClusterSize(int size);
+
+    // zoom level from which all items are painted in full detail
+    void setFullDetailZoom(qreal zoom);
+
+    void setStyle(int style);
+
+    // ROIs in the grid, bound in scene coords
+    void setItem(QGraphicsItem* item, const QRectF& bound);
+    void removeItem(QGraphicsItem* item);
+    void clear();
+
+    // draw clusters intersecting given area in scene coords
+    void paint(QPainter* painter, const QRectF& rect);
+
+    // size of cells clustered in scene coords, 0 for full detail
+    static qreal lodCellSize(const QGraphicsScene* scene);
+
+private:
+    struct Cell
+    {
+        Cell() : count(0) {}
+        int count;
+        QPointF sum; // of centers
+    };
+
+    struct Entry
+    {
+        QPointF center;
+        int level; // lowest level the item is counted in
+    };
+
+    QGraphicsView* _view;
+    QPointer<QGraphicsScene> _scene;
+    int _cluster_size;
+    qreal _full_detail_zoom;
+    int _style;
+    int _level; // current level, -1 for full detail
+    QHash<QGraphicsItem*, Entry> _entries;
+    QVector<QHash<quint64, Cell> > _levels;
+
+    bool eventFilter(QObject* object, QEvent* event);
+    void _update_level();
+    void _paint_cell(QPainter* painter, quint64 key, const Cell& cell);
+    void _add(const Entry& entry, int sign);
+};
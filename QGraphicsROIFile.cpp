@@ -0,0 +1,162 @@
+#include "QGraphicsROIFile.h"
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+
+static QJsonArray _points_to_json(const QPolygonF& polygon)
+{
+    QJsonArray points;
+    foreach (const QPointF& point, polygon) {
+        points.append(QJsonArray() << point.x() << point.y());
+    }
+    return points;
+}
+
+static bool _points_from_json(const QJsonValue& value, QPolygonF& polygon)
+{
+    if (!value.isArray()) {
+        return false;
+    }
+    QJsonArray points = value.toArray();
+    polygon.resize(points.size());
+    for (int i = 0; i < points.size(); i++) {
+        QJsonArray point = points[i].toArray();
+        if (point.size() != 2) {
+            return false;
+        }
+        polygon[i] = QPointF(point[0].toDouble(), point[1].toDouble());
+    }
+    return true;
+}
+
+QGraphicsRLEMask QGraphicsROIFile::Entry::toMask() const
+{
+    return shape.isNull() ? mask : QGraphicsRLEMask::fromShape(shape);
+}
+
+bool QGraphicsROIFile::read(const QString& path, QVector<Entry>& entries, QString* error)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (error) {
+            *error = file.errorString();
+        }
+        return false;
+    }
+    return fromJson(file.readAll(), entries, error);
+}
+
+bool QGraphicsROIFile::write(const QString& path, const QVector<Entry>& entries, QString* error)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(toJson(entries)) < 0) {
+        if (error) {
+            *error = file.errorString();
+        }
+        return false;
+    }
+    return true;
+}
+
+// the first ROI not understood fails the file, rather than being skipped
+bool QGraphicsROIFile::fromJson(const QByteArray& json, QVector<Entry>& entries, QString* error)
+{
+    QJsonParseError parse_error;
+    QJsonDocument document = QJsonDocument::fromJson(json, &parse_error);
+    entries.clear();
+    if (!document.isObject()) {
+        if (error) {
+            *error = parse_error.errorString();
+        }
+        return false;
+    }
+    QJsonArray rois = document.object().value("rois").toArray();
+    entries.reserve(rois.size());
+    for (int i = 0; i < rois.size(); i++) {
+        QJsonObject roi = rois[i].toObject();
+        Entry entry;
+        entry.id = roi.contains("id") ? qint64(roi.value("id").toDouble()) : i + 1;
+        entry.label = roi.value("label").toString();
+        bool valid = false;
+        if (roi.contains("rect")) {
+            QJsonArray rect = roi.value("rect").toArray();
+            valid = rect.size() == 4;
+            entry.shape = QGraphicsROIShape::fromRect(
+                QRectF(rect[0].toDouble(), rect[1].toDouble(), rect[2].toDouble(), rect[3].toDouble()));
+        }
+        else if (roi.contains("polygon")) {
+            QPolygonF polygon;
+            QVector<QPolygonF> holes;
+            valid = _points_from_json(roi.value("polygon"), polygon) && polygon.size() >= 3;
+            QJsonArray rings = roi.value("holes").toArray();
+            holes.resize(rings.size());
+            for (int k = 0; k < rings.size() && valid; k++) {
+                valid = _points_from_json(rings[k], holes[k]);
+            }
+            entry.shape = QGraphicsROIShape::fromPolygon(polygon, holes);
+        }
+        else if (roi.contains("circle")) {
+            QJsonArray circle = roi.value("circle").toArray();
+            valid = circle.size() == 3;
+            entry.shape = QGraphicsROIShape::fromCircle(QPointF(circle[0].toDouble(), circle[1].toDouble()),
+                                                        circle[2].toDouble());
+        }
+        else if (roi.contains("mask")) {
+            // decoded to pixels, or the bytes of the empty mask
+            QByteArray bytes = QByteArray::fromBase64(roi.value("mask").toString().toLatin1());
+            entry.mask = QGraphicsRLEMask::fromByteArray(bytes);
+            valid = !entry.mask.isEmpty() || bytes == QGraphicsRLEMask().toByteArray();
+        }
+        if (!valid) {
+            if (error) {
+                *error = QString("ROI %1 has no valid rect, polygon, circle or mask").arg(i);
+            }
+            entries.clear();
+            return false;
+        }
+        entries.append(entry);
+    }
+    return true;
+}
+
+QByteArray QGraphicsROIFile::toJson(const QVector<Entry>& entries)
+{
+    QJsonArray rois;
+    foreach (const Entry& entry, entries) {
+        QJsonObject roi;
+        if (entry.id >= 0) {
+            roi.insert("id", double(entry.id));
+        }
+        if (!entry.label.isEmpty()) {
+            roi.insert("label", entry.label);
+        }
+        const QGraphicsROIShape& shape = entry.shape;
+        switch (shape.type) {
+        case QGraphicsROIShape::RECT_SHAPE:
+            roi.insert("rect", QJsonArray() << shape.rect.x() << shape.rect.y() << shape.rect.width()
+                                            << shape.rect.height());
+            break;
+        case QGraphicsROIShape::POLYGON_SHAPE:
+            roi.insert("polygon", _points_to_json(shape.polygon));
+            if (!shape.holes.isEmpty()) {
+                QJsonArray holes;
+                foreach (const QPolygonF& hole, shape.holes) {
+                    holes.append(_points_to_json(hole));
+                }
+                roi.insert("holes", holes);
+            }
+            break;
+        case QGraphicsROIShape::CIRCLE_SHAPE:
+            roi.insert("circle", QJsonArray() << shape.center.x() << shape.center.y() << shape.radius);
+            break;
+        default:
+            roi.insert("mask", QString::fromLatin1(entry.mask.toByteArray().toBase64()));
+            break;
+        }
+        rois.append(roi);
+    }
+    QJsonObject root;
+    root.insert("rois", rois);
+    return QJsonDocument(root).toJson(QJsonDocument::Indented);
+}
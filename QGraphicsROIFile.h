@@ -0,0 +1,53 @@
+#pragma once
+
+#include <QString>
+#include <QVector>
+#include <QByteArray>
+#include "QGraphicsROIShape.h"
+#include "QGraphicsRLEMask.h"
+
+/*!
+ * This class reads and writes the ROIs of an image as a JSON file, so they
+ * may be made and used without graphics items, as by batch jobs.
+ *
+ * A file holds a list of ROIs, each with an optional id and label, and one
+ * of a rect, a polygon with optional holes, a circle or a mask, in image
+ * coords:
+ *
+ *   { "rois": [
+ *       { "id": 1, "label": "car", "rect": [x, y, width, height] },
+ *       { "polygon": [[x, y], ...], "holes": [[[x, y], ...], ...] },
+ *       { "circle": [x, y, radius] },
+ *       { "mask": "base64 of QGraphicsRLEMask::toByteArray()" }
+ *   ] }
+ *
+ * Usage:
+ *
+ *   QVector<QGraphicsROIFile::Entry> entries;
+ *   QString error;
+ *   if (!QGraphicsROIFile::read(path, entries, &error)) {
+ *       ...
+ *   }
+ *   QGraphicsRLEMask mask = entries[0].toMask();
+ */
+class QGraphicsROIFile
+{
+public:
+    struct Entry
+    {
+        Entry() : id(-1) {}
+        qint64 id;
+        QString label;
+        QGraphicsROIShape shape; // null for a mask
+        QGraphicsRLEMask mask;
+
+        // pixels of shape, or the mask
+        QGraphicsRLEMask toMask() const;
+    };
+
+    static bool read(const QString& path, QVector<Entry>& entries, QString* error = NULL);
+    static bool write(const QString& path, const QVector<Entry>& entries, QString* error = NULL);
+
+    static bool fromJson(const QByteArray& json, QVector<Entry>& entries, QString* error = NULL);
+    static QByteArray toJson(const QVector<Entry>& entries);
+};
@@ -0,0 +1,146 @@
+#include "QGraphicsROIMetrics.h"
+#include <qmath.h>
+
+static qreal _cross(const QPointF& a, const QPointF& b)
+{
+    return a.x() * b.y() - a.y() * b.x();
+}
+
+static qreal _length(const QPointF& d)
+{
+    return qSqrt(d.x() * d.x() + d.y() * d.y());
+}
+
+QGraphicsROIMetrics::QGraphicsROIMetrics()
+    : area(0)
+    , perimeter(0)
+{
+
+}
+
+QGraphicsROIMetrics QGraphicsROIMetrics::fromShape(const QGraphicsROIShape& shape)
+{
+    QGraphicsROIMetrics metrics;
+    switch (shape.type) {
+    case QGraphicsROIShape::RECT_SHAPE:
+        metrics.area = shape.rect.width() * shape.rect.height();
+        metrics.perimeter = 2 * (shape.rect.width() + shape.rect.height());
+        metrics.centroid = shape.rect.center();
+        metrics.bound = shape.rect;
+        break;
+    case QGraphicsROIShape::CIRCLE_SHAPE:
+        metrics.area = M_PI * shape.radius * shape.radius;
+        metrics.perimeter = 2 * M_PI * shape.radius;
+        metrics.centroid = shape.center;
+        metrics.bound = shape.boundingRect();
+        break;
+    case QGraphicsROIShape::POLYGON_SHAPE: {
+        QGraphicsPolygonMetrics polygon;
+        polygon.reset(shape.polygon, shape.holes);
+        metrics = polygon.metrics();
+        break;
+    }
+    default:
+        break;
+    }
+    return metrics;
+}
+
+QGraphicsPolygonMetrics::QGraphicsPolygonMetrics()
+    : _area2(0)
+    , _perimeter(0)
+    , _hole_area(0)
+    , _hole_perimeter(0)
+{
+
+}
+
+void QGraphicsPolygonMetrics::reset(const QPolygonF& polygon, const QVector<QPolygonF>& holes)
+{
+    _polygon = polygon;
+    _sum();
+
+    // holes are not edited, summed once
+    _hole_area = 0;
+    _hole_moment = QPointF();
+    _hole_perimeter = 0;
+    foreach (const QPolygonF& hole, holes) {
+        QGraphicsPolygonMetrics metrics;
+        metrics.reset(hole);
+        QGraphicsROIMetrics m = metrics.metrics();
+        _hole_area += m.area;
+        _hole_moment += m.centroid * m.area;
+        _hole_perimeter += m.perimeter;
+    }
+}
+
+// terms of the two adjacent edges out, and in again at the new position
+void QGraphicsPolygonMetrics::moveVertex(int index, const QPointF& pos)
+{
+    int n = _polygon.size();
+    if (n < 3) {
+        _polygon[index] = pos;
+        _sum();
+        return;
+    }
+    int prev = (index + n - 1) % n;
+    _add_edge(prev, -1);
+    _add_edge(index, -1);
+    QPointF old = _polygon[index];
+    _polygon[index] = pos;
+    _add_edge(prev, 1);
+    _add_edge(index, 1);
+
+    if (old.x() == _bound.left() || old.x() == _bound.right() || old.y() == _bound.top() || old.y() == _bound.bottom()) {
+        // the vertex may have been the only one on a side, moved in or out
+        _fit_bound();
+    }
+    else if (pos.x() < _bound.left() || pos.x() > _bound.right() || pos.y() < _bound.top() || pos.y() > _bound.bottom()) {
+        _bound = QRectF(QPointF(qMin(_bound.left(), pos.x()), qMin(_bound.top(), pos.y())),
+                        QPointF(qMax(_bound.right(), pos.x()), qMax(_bound.bottom(), pos.y())));
+    }
+}
+
+QGraphicsROIMetrics QGraphicsPolygonMetrics::metrics() const
+{
+    QGraphicsROIMetrics metrics;
+    qreal area = qAbs(_area2) / 2;
+    metrics.area = area - _hole_area;
+    metrics.perimeter = _perimeter + _hole_perimeter;
+    metrics.bound = _bound;
+    if (_area2 != 0 && metrics.area > 0) {
+        // centroid of the outline is moments over 3 times twice the area
+        QPointF centroid = _moment6 / (3 * _area2);
+        metrics.centroid = (centroid * area - _hole_moment) / metrics.area;
+    }
+    else {
+        metrics.centroid = _bound.center();
+    }
+    return metrics;
+}
+
+void QGraphicsPolygonMetrics::_sum()
+{
+    _area2 = 0;
+    _moment6 = QPointF();
+    _perimeter = 0;
+    for (int i = 0; i < _polygon.size(); i++) {
+        _add_edge(i, 1);
+    }
+    _fit_bound();
+}
+
+void QGraphicsPolygonMetrics::_add_edge(int edge, qreal sign)
+{
+    const QPointF& a = _polygon[edge];
+    const QPointF& b = _polygon[(edge + 1) % _polygon.size()];
+    qreal cross = _cross(a, b);
+    _area2 += sign * cross;
+    _moment6 += sign * cross * (a + b);
+    _perimeter += sign * _length(b - a);
+}
+
+void QGraphicsPolygonMetrics::_fit_bound()
+{
+    _bound = _polygon.boundingRect();
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <QVector>
+#include <QPointF>
+#include <QRectF>
+#include <QPolygonF>
+#include "QGraphicsROIShape.h"
+
+/*!
+ * Geometric measurements of a ROI in scene coordinates. Area and perimeter of
+ * polygons include their holes.
+ */
+struct QGraphicsROIMetrics
+{
+    QGraphicsROIMetrics();
+
+    // computed from the whole shape
+    static QGraphicsROIMetrics fromShape(const QGraphicsROIShape& shape);
+
+    qreal area;
+    qreal perimeter;
+    QPointF centroid;
+    QRectF bound;
+};
+
+/*!
+ * This class keeps the metrics of a polygon while its vertices are moved one at
+ * a time.
+ *
+ * It holds the shoelace sums of area and first moments and the perimeter, as
+ * sums over edges. Moving a vertex takes out the terms of its two adjacent
+ * edges and adds them back at the new position. The bound grows when a vertex
+ * inside it moves out, and is found again whenever a vertex on it moves. Holes
+ * are summed once by reset(). Vertex i is point i of the polygon given, which
+ * should be an open ring, as a closing point is a vertex of its own.
+ *
+ * Usage:
+ *
+ *   QGraphicsPolygonMetrics metrics;
+ *   metrics.reset(polygon);
+ *   metrics.moveVertex(index, pos);
+ *   qreal area = metrics.metrics().area;
+ */
+class QGraphicsPolygonMetrics
+{
+public:
+    QGraphicsPolygonMetrics();
+
+    void reset(const QPolygonF& polygon, const QVector<QPolygonF>& holes = QVector<QPolygonF>());
+    void moveVertex(int index, const QPointF& pos);
+
+    QGraphicsROIMetrics metrics() const;
+
+private:
+    QPolygonF _polygon;
+    qreal _area2; // twice the signed area
+    QPointF _moment6; // six times the signed first moments
+    qreal _perimeter;
+    QRectF _bound;
+    qreal _hole_area;
+    QPointF _hole_moment; // area times centroid, summed over holes
+    qreal _hole_perimeter;
+
+    void _sum();
+    void _add_edge(int edge, qreal sign);
+    void _fit_bound();
+};
@@ -0,0 +1,42 @@
+#include "QGraphicsROIObject.h"
+#include <QGraphicsScene>
+#include <QGraphicsView>
+#include <qmath.h>
+
+QGraphicsROIObject::QGraphicsROIObject(QGraphicsItem* parent)
+    : QGraphicsObject(parent)
+{
+}
+
+// zoom of the first view, the same on both axes when the view is rotated 
+qreal QGraphicsROIObject::_damage_margin(int handle_size, const QPen& pen) const
+{
+    qreal scale = 1; 
+    if (scene() && !scene()->views().isEmpty()) {
+        scale = qSqrt(qAbs(scene()->views().at(0)->transform().determinant())); 
+    }
+    return (handle_size / 2.0 + pen.widthF() + 2) / scale; 
+}
+
+// slack of an eighth of the perimeter on each side 
+bool QGraphicsROIObject::_grow_bound(const QRectF& rect)
+{
+    if (rect.left() >= _shape_bound.left() && rect.right() <= _shape_bound.right() &&
+        rect.top() >= _shape_bound.top() && rect.bottom() <= _shape_bound.bottom()) {
+        return false; 
+    }
+    QRectF bound(QPointF(qMin(rect.left(), _shape_bound.left()), qMin(rect.top(), _shape_bound.top())), 
+                 QPointF(qMax(rect.right(), _shape_bound.right()), qMax(rect.bottom(), _shape_bound.bottom()))); 
+    qreal slack = (bound.width() + bound.height()) / 8; 
+    prepareGeometryChange(); 
+    _shape_bound = bound.adjusted(-slack, -slack, slack, slack); 
+    return true; 
+}
+
+void QGraphicsROIObject::_fit_bound(const QRectF& bound)
+{
+    if (bound != _shape_bound) {
+        prepareGeometryChange(); 
+        _shape_bound = bound; 
+    }
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <QGraphicsObject>
+#include <QPen>
+
+/*!
+ * Base of the rect, polygon and circle items, for the bound they share. 
+ *
+ * While a shape is resized, the bound grows with slack so geometry changes, 
+ * and the full repaints they cause, are rare. Only the damaged edges are 
+ * repainted, with a margin for pen and handles. The bound is fitted to the 
+ * shape again when resizing is done. 
+ *
+ * Usage: 
+ *
+ *   class QGraphicsRectObject : public QGraphicsROIObject 
+ *   // while resizing 
+ *   if (!_grow_bound(_rect)) scene()->update(mapRectToScene(damage)); 
+ *   // on release 
+ *   _fit_bound(_rect); 
+ */
+class QGraphicsROIObject : public QGraphicsObject
+{
+    Q_OBJECT
+public:
+    QGraphicsROIObject(QGraphicsItem* parent = 0);
+
+protected:
+    // damage margin around edges in local coords, covering pen and handles 
+    qreal _damage_margin(int handle_size, const QPen& pen) const; 
+    // grow bound to cover given rect, true when the geometry changed 
+    bool _grow_bound(const QRectF& rect); 
+    // tight bound when resizing is done 
+    void _fit_bound(const QRectF& bound); 
+
+    QRectF _shape_bound; // bound of shape, with slack while resizing 
+};
@@ -0,0 +1,438 @@
+#include "QGraphicsROIOverlap.h"
+#include <QtConcurrent>
+#include <QHash>
+#include <qmath.h>
+#include <algorithm>
+#include <cassert>
+
+#define MAX_SHAPE_CELLS 256
+
+static quint64 _cell_key(int cx, int cy)
+{
+    return (quint64(quint32(cx)) << 32) | quint32(cy);
+}
+
+static qreal _cross(const QPointF& a, const QPointF& b)
+{
+    return a.x() * b.y() - a.y() * b.x();
+}
+
+static int _find(QVector<int>& parents, int i)
+{
+    while (parents[i] != i) {
+        parents[i] = parents[parents[i]];
+        i = parents[i];
+    }
+    return i;
+}
+
+QGraphicsROIOverlap::QGraphicsROIOverlap(const QVector<QGraphicsROIShape>& shapes, qreal tolerance)
+    : _paired(false)
+{
+    _shapes.reserve(shapes.size());
+    for (int i = 0; i < shapes.size(); i++) {
+        _shapes.append(_prepare(shapes[i], tolerance));
+    }
+}
+
+int QGraphicsROIOverlap::count() const
+{
+    return _shapes.size();
+}
+
+qreal QGraphicsROIOverlap::area(int index) const
+{
+    return _shapes[index].area;
+}
+
+qreal QGraphicsROIOverlap::area(const QGraphicsROIShape& shape)
+{
+    return _prepare(shape, 0.5).area;
+}
+
+qreal QGraphicsROIOverlap::intersectionArea(const QGraphicsROIShape& a, const QGraphicsROIShape& b, qreal tolerance)
+{
+    return _intersection(_prepare(a, tolerance), _prepare(b, tolerance));
+}
+
+qreal QGraphicsROIOverlap::signedArea(const QPolygonF& polygon)
+{
+    qreal sum = 0;
+    int n = polygon.size();
+    for (int i = 0; i < n; i++) {
+        sum += _cross(polygon[i], polygon[(i + 1) % n]);
+    }
+    return sum / 2;
+}
+
+// polygon without closing point, counter clockwise, and convexity by the
+// turning of edges, all on the same side and once around
+QGraphicsROIOverlap::Prepared QGraphicsROIOverlap::_prepare(const QGraphicsROIShape& shape, qreal tolerance)
+{
+    Prepared prepared;
+    prepared.shape = shape;
+    prepared.polygon = shape.toPolygon(tolerance);
+    qreal signed_area = signedArea(prepared.polygon);
+    if (signed_area < 0) {
+        std::reverse(prepared.polygon.begin(), prepared.polygon.end());
+    }
+    prepared.bound = shape.boundingRect();
+    switch (shape.type) {
+    case QGraphicsROIShape::RECT_SHAPE:
+        prepared.area = shape.rect.width() * shape.rect.height();
+        prepared.convex = true;
+        break;
+    case QGraphicsROIShape::CIRCLE_SHAPE:
+        prepared.area = M_PI * shape.radius * shape.radius;
+        prepared.convex = true;
+        break;
+    default: {
+        prepared.area = qAbs(signed_area);
+        const QPolygonF& polygon = prepared.polygon;
+        int n = polygon.size();
+        bool convex = n >= 3;
+        qreal turning = 0;
+        for (int i = 0; i < n && convex; i++) {
+            QPointF e0 = polygon[(i + 1) % n] - polygon[i];
+            QPointF e1 = polygon[(i + 2) % n] - polygon[(i + 1) % n];
+            qreal cross = _cross(e0, e1);
+            convex = cross >= 0;
+            turning += qAtan2(cross, QPointF::dotProduct(e0, e1));
+        }
+        prepared.convex = convex && qAbs(turning - 2 * M_PI) < 1e-6;
+        break;
+    }
+    }
+    return prepared;
+}
+
+// Sutherland-Hodgman, the convex polygon is counter clockwise
+QPolygonF QGraphicsROIOverlap::_clip(const QPolygonF& polygon, const QPolygonF& convex)
+{
+    QPolygonF output = polygon;
+    int m = convex.size();
+    for (int k = 0; k < m && !output.isEmpty(); k++) {
+        QPointF c0 = convex[k];
+        QPointF edge = convex[(k + 1) % m] - c0;
+        QPolygonF input;
+        input.swap(output);
+        int n = input.size();
+        QPointF s = input[n - 1];
+        qreal ds = _cross(edge, s - c0);
+        for (int i = 0; i < n; i++) {
+            QPointF e = input[i];
+            qreal de = _cross(edge, e - c0);
+            if (de >= 0) {
+                if (ds < 0) {
+                    output.append(s + (e - s) * (ds / (ds - de)));
+                }
+                output.append(e);
+            }
+            else if (ds >= 0) {
+                output.append(s + (e - s) * (ds / (ds - de)));
+            }
+            s = e;
+            ds = de;
+        }
+    }
+    return output;
+}
+
+qreal QGraphicsROIOverlap::convexClipArea(const QPolygonF& polygon, const QPolygonF& convex)
+{
+    return qAbs(signedArea(_clip(polygon, convex)));
+}
+
+// triangles from a common origin to each edge cover a polygon with signed
+// multiplicity, so the intersection is the signed sum of clipped triangle pairs
+qreal QGraphicsROIOverlap::_fan_intersection(const QPolygonF& a, const QPolygonF& b, const QRectF& overlap)
+{
+    QPointF origin = overlap.center();
+    struct Triangle
+    {
+        QPolygonF polygon;
+        QRectF bound;
+        qreal sign;
+    };
+    QVector<Triangle> triangles;
+    triangles.reserve(b.size());
+    for (int j = 0; j < b.size(); j++) {
+        Triangle t;
+        t.polygon << origin << b[j] << b[(j + 1) % b.size()];
+        qreal s = signedArea(t.polygon);
+        if (s == 0) {
+            continue;
+        }
+        if (s < 0) {
+            std::swap(t.polygon[1], t.polygon[2]);
+        }
+        t.bound = t.polygon.boundingRect();
+        t.sign = s > 0 ? 1 : -1;
+        triangles.append(t);
+    }
+    qreal sum = 0;
+    for (int i = 0; i < a.size(); i++) {
+        QPolygonF ta;
+        ta << origin << a[i] << a[(i + 1) % a.size()];
+        qreal s = signedArea(ta);
+        if (s == 0) {
+            continue;
+        }
+        if (s < 0) {
+            std::swap(ta[1], ta[2]);
+        }
+        QRectF bound = ta.boundingRect();
+        qreal sign = s > 0 ? 1 : -1;
+        for (int j = 0; j < triangles.size(); j++) {
+            const Triangle& tb = triangles[j];
+            if (bound.intersects(tb.bound)) {
+                sum += sign * tb.sign * qAbs(signedArea(_clip(ta, tb.polygon)));
+            }
+        }
+    }
+    return qMax(qreal(0), sum);
+}
+
+qreal QGraphicsROIOverlap::_intersection(const Prepared& a, const Prepared& b)
+{
+    QRectF overlap = a.bound & b.bound;
+    if (overlap.isEmpty() || a.area <= 0 || b.area <= 0) {
+        return 0;
+    }
+    int ta = a.shape.type;
+    int tb = b.shape.type;
+    if (ta == QGraphicsROIShape::RECT_SHAPE && tb == QGraphicsROIShape::RECT_SHAPE) {
+        return overlap.width() * overlap.height();
+    }
+    if (ta == QGraphicsROIShape::CIRCLE_SHAPE && tb == QGraphicsROIShape::CIRCLE_SHAPE) {
+        qreal r0 = a.shape.radius;
+        qreal r1 = b.shape.radius;
+        QPointF c = a.shape.center - b.shape.center;
+        qreal d = qSqrt(QPointF::dotProduct(c, c));
+        if (d >= r0 + r1) {
+            return 0;
+        }
+        if (d <= qAbs(r0 - r1)) {
+            return M_PI * qMin(r0, r1) * qMin(r0, r1);
+        }
+        // area of the lens
+        qreal a0 = qAcos(qBound(qreal(-1), (d * d + r0 * r0 - r1 * r1) / (2 * d * r0), qreal(1)));
+        qreal a1 = qAcos(qBound(qreal(-1), (d * d + r1 * r1 - r0 * r0) / (2 * d * r1), qreal(1)));
+        qreal k = (-d + r0 + r1) * (d + r0 - r1) * (d - r0 + r1) * (d + r0 + r1);
+        return r0 * r0 * a0 + r1 * r1 * a1 - qSqrt(qMax(qreal(0), k)) / 2;
+    }
+    if (a.convex) {
+        return convexClipArea(b.polygon, a.polygon);
+    }
+    if (b.convex) {
+        return convexClipArea(a.polygon, b.polygon);
+    }
+    return _fan_intersection(a.polygon, b.polygon, overlap);
+}
+
+void QGraphicsROIOverlap::PairArea::operator()(Pair& pair) const
+{
+    const Prepared& a = shapes->at(pair.first);
+    const Prepared& b = shapes->at(pair.second);
+    pair.intersection = _intersection(a, b);
+    qreal total = a.area + b.area - pair.intersection;
+    pair.iou = total > 0 ? pair.intersection / total : 0;
+    pair.first_contained = a.area > 0 ? pair.intersection / a.area : 0;
+    pair.second_contained = b.area > 0 ? pair.intersection / b.area : 0;
+}
+
+// pairs of intersecting bounding boxes from the grid, and of large shapes
+// covering too many cells against all others
+void QGraphicsROIOverlap::_find_candidates()
+{
+    int n = _shapes.size();
+    qreal size = 0;
+    int valid = 0;
+    for (int i = 0; i < n; i++) {
+        const QRectF& bound = _shapes[i].bound;
+        if (!bound.isEmpty()) {
+            size += qMax(bound.width(), bound.height());
+            valid++;
+        }
+    }
+    if (valid < 2) {
+        return;
+    }
+    qreal cell = size / valid;
+    QHash<quint64, QVector<int> > grid;
+    QVector<bool> large(n, false);
+    QVector<int> large_shapes;
+    for (int i = 0; i < n; i++) {
+        const QRectF& bound = _shapes[i].bound;
+        if (bound.isEmpty()) {
+            continue;
+        }
+        int x0 = qFloor(bound.left() / cell);
+        int x1 = qFloor(bound.right() / cell);
+        int y0 = qFloor(bound.top() / cell);
+        int y1 = qFloor(bound.bottom() / cell);
+        if (qint64(x1 - x0 + 1) * (y1 - y0 + 1) > MAX_SHAPE_CELLS) {
+            large[i] = true;
+            large_shapes.append(i);
+            continue;
+        }
+        for (int cy = y0; cy <= y1; cy++) {
+            for (int cx = x0; cx <= x1; cx++) {
+                grid[_cell_key(cx, cy)].append(i);
+            }
+        }
+    }
+    Pair candidate = { 0, 0, 0, 0, 0, 0 };
+    QHash<quint64, QVector<int> >::const_iterator it;
+    for (it = grid.constBegin(); it != grid.constEnd(); ++it) {
+        const QVector<int>& ids = it.value();
+        for (int p = 0; p < ids.size(); p++) {
+            const QRectF& a = _shapes[ids[p]].bound;
+            for (int q = p + 1; q < ids.size(); q++) {
+                const QRectF& b = _shapes[ids[q]].bound;
+                if (!a.intersects(b)) {
+                    continue;
+                }
+                quint64 key = _cell_key(qFloor(qMax(a.left(), b.left()) / cell),
+                                        qFloor(qMax(a.top(), b.top()) / cell));
+                if (key == it.key()) {
+                    candidate.first = qMin(ids[p], ids[q]);
+                    candidate.second = qMax(ids[p], ids[q]);
+                    _pairs.append(candidate);
+                }
+            }
+        }
+    }
+    foreach (int i, large_shapes) {
+        for (int j = 0; j < n; j++) {
+            if (j == i || (large[j] && j < i) || _shapes[j].bound.isEmpty()) {
+                continue;
+            }
+            if (_shapes[i].bound.intersects(_shapes[j].bound)) {
+                candidate.first = qMin(i, j);
+                candidate.second = qMax(i, j);
+                _pairs.append(candidate);
+            }
+        }
+    }
+}
+
+const QVector<QGraphicsROIOverlap::Pair>& QGraphicsROIOverlap::pairs()
+{
+    if (_paired) {
+        return _pairs;
+    }
+    _paired = true;
+    _find_candidates();
+    PairArea pair_area;
+    pair_area.shapes = &_shapes;
+    QtConcurrent::blockingMap(_pairs, pair_area);
+    // drop boxes intersecting without shapes overlapping
+    int kept = 0;
+    for (int i = 0; i < _pairs.size(); i++) {
+        if (_pairs[i].intersection > 0) {
+            _pairs[kept++] = _pairs[i];
+        }
+    }
+    _pairs.resize(kept);
+    return _pairs;
+}
+
+QVector<int> QGraphicsROIOverlap::suppress(const QVector<qreal>& scores, qreal iou_threshold)
+{
+    assert(scores.size() == _shapes.size());
+    int n = _shapes.size();
+    QVector<QVector<int> > neighbours(n);
+    foreach (const Pair& pair, pairs()) {
+        if (pair.iou > iou_threshold) {
+            neighbours[pair.first].append(pair.second);
+            neighbours[pair.second].append(pair.first);
+        }
+    }
+    QVector<int> order(n);
+    for (int i = 0; i < n; i++) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&scores](int a, int b) { return scores[a] > scores[b]; });
+    QVector<bool> suppressed(n, false);
+    QVector<int> kept;
+    foreach (int i, order) {
+        if (suppressed[i]) {
+            continue;
+        }
+        kept.append(i);
+        foreach (int j, neighbours[i]) {
+            suppressed[j] = true;
+        }
+    }
+    return kept;
+}
+
+QVector<QVector<int> > QGraphicsROIOverlap::_groups(qreal iou_threshold)
+{
+    int n = _shapes.size();
+    QVector<int> parents(n);
+    for (int i = 0; i < n; i++) {
+        parents[i] = i;
+    }
+    foreach (const Pair& pair, pairs()) {
+        if (pair.iou > iou_threshold) {
+            parents[_find(parents, pair.first)] = _find(parents, pair.second);
+        }
+    }
+    QHash<int, int> group_of_root;
+    QVector<QVector<int> > groups;
+    for (int i = 0; i < n; i++) {
+        int root = _find(parents, i);
+        if (!group_of_root.contains(root)) {
+            group_of_root.insert(root, groups.size());
+            groups.append(QVector<int>());
+        }
+        groups[group_of_root.value(root)].append(i);
+    }
+    return groups;
+}
+
+QVector<QVector<int> > QGraphicsROIOverlap::duplicates(qreal iou_threshold)
+{
+    QVector<QVector<int> > groups;
+    foreach (const QVector<int>& group, _groups(iou_threshold)) {
+        if (group.size() > 1) {
+            groups.append(group);
+        }
+    }
+    return groups;
+}
+
+QVector<QGraphicsROIShape> QGraphicsROIOverlap::merge(const QVector<qreal>& scores, qreal iou_threshold)
+{
+    assert(scores.size() == _shapes.size());
+    QVector<QGraphicsROIShape> merged;
+    foreach (const QVector<int>& group, _groups(iou_threshold)) {
+        int best = group.first();
+        bool rects = true;
+        qreal weights = 0;
+        foreach (int i, group) {
+            if (scores[i] > scores[best]) {
+                best = i;
+            }
+            rects = rects && _shapes[i].shape.type == QGraphicsROIShape::RECT_SHAPE;
+            weights += scores[i];
+        }
+        if (!rects || group.size() == 1 || weights <= 0) {
+            merged.append(_shapes[best].shape);
+            continue;
+        }
+        qreal left = 0, top = 0, right = 0, bottom = 0;
+        foreach (int i, group) {
+            const QRectF& rect = _shapes[i].shape.rect;
+            qreal w = scores[i] / weights;
+            left += w * rect.left();
+            top += w * rect.top();
+            right += w * rect.right();
+            bottom += w * rect.bottom();
+        }
+        merged.append(QGraphicsROIShape::fromRect(QRectF(QPointF(left, top), QPointF(right, bottom))));
+    }
+    return merged;
+}
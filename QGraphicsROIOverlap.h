@@ -0,0 +1,100 @@
+#pragma once
+
+#include <QVector>
+#include <QPolygonF>
+#include <QRectF>
+#include "QGraphicsROIShape.h"
+
+/*!
+ * This class analyses overlaps between many ROIs: intersection area, IoU and
+ * containment of all overlapping pairs, with non-maximum suppression and merging
+ * of duplicates on top of them.
+ *
+ * Candidate pairs are found with a uniform grid of bounding boxes, cells about
+ * the mean ROI size, so only pairs with intersecting boxes are tested. Each pair
+ * is reported by the one cell holding the top left corner of their intersection.
+ *
+ * Exact areas of candidates are computed in parallel with QtConcurrent. Rect and
+ * rect, circle and circle are analytic. Otherwise, when one of the shapes is
+ * convex, the other is clipped by it (Sutherland-Hodgman), and two concave
+ * polygons are decomposed into signed triangle fans which are clipped pairwise.
+ * Circles are converted to polygons within given tolerance, holes of polygons
+ * are not taken into account.
+ *
+ * Usage:
+ *
+ *   QGraphicsROIOverlap overlap(shapes);
+ *   foreach (const QGraphicsROIOverlap::Pair& pair, overlap.pairs()) { ... }
+ *   QVector<int> kept = overlap.suppress(scores, 0.5);
+ */
+class QGraphicsROIOverlap
+{
+public:
+    struct Pair
+    {
+        int first;
+        int second; // first < second
+        qreal intersection; // area
+        qreal iou;
+        qreal first_contained; // fraction of first inside second
+        qreal second_contained;
+    };
+
+    QGraphicsROIOverlap(const QVector<QGraphicsROIShape>& shapes, qreal tolerance = 0.5);
+
+    int count() const;
+    qreal area(int index) const;
+
+    // all pairs with positive intersection area, computed once
+    const QVector<Pair>& pairs();
+
+    // indices of kept shapes by decreasing score, a shape is suppressed when
+    // overlapping a kept one with IoU over threshold
+    QVector<int> suppress(const QVector<qreal>& scores, qreal iou_threshold);
+
+    // groups of duplicates, shapes connected by pairs with IoU over threshold
+    QVector<QVector<int> > duplicates(qreal iou_threshold);
+
+    // one shape per group of duplicates, the score weighted mean of rects,
+    // or the best scored shape of other groups
+    QVector<QGraphicsROIShape> merge(const QVector<qreal>& scores, qreal iou_threshold);
+
+    static qreal area(const QGraphicsROIShape& shape);
+    static qreal intersectionArea(const QGraphicsROIShape& a, const QGraphicsROIShape& b,
+                                  qreal tolerance = 0.5);
+
+    // area of intersection of a polygon with a convex polygon
+    static qreal convexClipArea(const QPolygonF& polygon, const QPolygonF& convex);
+
+    // signed area, positive for counter clockwise in y-up coords
+    static qreal signedArea(const QPolygonF& polygon);
+
+private:
+    struct Prepared
+    {
+        QGraphicsROIShape shape;
+        QPolygonF polygon; // open, positive signed area
+        QRectF bound;
+        qreal area;
+        bool convex;
+    };
+
+    struct PairArea
+    {
+        typedef void result_type;
+        const QVector<Prepared>* shapes;
+        void operator()(Pair& pair) const;
+    };
+
+    QVector<Prepared> _shapes;
+    QVector<Pair> _pairs;
+    bool _paired;
+
+    static Prepared _prepare(const QGraphicsROIShape& shape, qreal tolerance);
+    static qreal _intersection(const Prepared& a, const Prepared& b);
+    static qreal _fan_intersection(const QPolygonF& a, const QPolygonF& b, const QRectF& overlap);
+    static QPolygonF _clip(const QPolygonF& polygon, const QPolygonF& convex);
+
+    void _find_candidates();
+    QVector<QVector<int> > _groups(qreal iou_threshold);
+};
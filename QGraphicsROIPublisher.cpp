@@ -0,0 +1,262 @@
+#include "QGraphicsROIPublisher.h"
+#include <QLocalServer>
+#include <QLocalSocket>
+
+#define DEFAULT_MAX_QUEUED_BATCHES 64
+#define FRAME_INTERVAL 16
+
+QGraphicsROIPublisher::QGraphicsROIPublisher(QObject* parent)
+    : QObject(parent)
+    , _server(NULL)
+    , _max_queued(DEFAULT_MAX_QUEUED_BATCHES)
+    , _next_id(1)
+    , _uncommitted(false)
+    , _batch_number(0)
+    , _sent(0)
+    , _dropped(0)
+{
+    _frame_timer.setSingleShot(true);
+    _frame_timer.setInterval(FRAME_INTERVAL);
+    connect(&_frame_timer, SIGNAL(timeout()), this, SLOT(onFrame()));
+}
+
+QGraphicsROIPublisher::~QGraphicsROIPublisher()
+{
+    close();
+}
+
+// a socket left by a crashed publisher is removed first
+bool QGraphicsROIPublisher::listen(const QString& name)
+{
+    close();
+    _server = new QLocalServer(this);
+    connect(_server, SIGNAL(newConnection()), this, SLOT(onNewConnection()));
+    QLocalServer::removeServer(name);
+    if (!_server->listen(name)) {
+        delete _server;
+        _server = NULL;
+        return false;
+    }
+    return true;
+}
+
+void QGraphicsROIPublisher::close()
+{
+    foreach (const Subscriber& subscriber, _subscribers) {
+        subscriber.socket->disconnect(this);
+        subscriber.socket->abort();
+        subscriber.socket->deleteLater();
+    }
+    _subscribers.clear();
+    delete _server;
+    _server = NULL;
+}
+
+bool QGraphicsROIPublisher::isListening() const
+{
+    return _server && _server->isListening();
+}
+
+int QGraphicsROIPublisher::subscriberCount() const
+{
+    return _subscribers.size();
+}
+
+void QGraphicsROIPublisher::setMaxQueuedBatches(int count)
+{
+    _max_queued = qMax(1, count);
+}
+
+qint64 QGraphicsROIPublisher::publishShape(QGraphicsItem* item, const QGraphicsROIShape& shape)
+{
+    QGraphicsROIStream::Event event;
+    event.shape = shape;
+    return _publish(item, event);
+}
+
+qint64 QGraphicsROIPublisher::publishMask(QGraphicsItem* item, const QGraphicsRLEMask& mask)
+{
+    QGraphicsROIStream::Event event;
+    event.mask = mask;
+    return _publish(item, event);
+}
+
+void QGraphicsROIPublisher::publishRemove(QGraphicsItem* item)
+{
+    QHash<QGraphicsItem*, qint64>::iterator it = _ids.find(item);
+    if (it == _ids.end()) {
+        return;
+    }
+    QGraphicsROIStream::Event event;
+    event.type = QGraphicsROIStream::REMOVE_EVENT;
+    event.id = it.value();
+    _ids.erase(it);
+    _rois.remove(event.id);
+    _append(event);
+}
+
+// only after events, so a release without edit is not a commit
+void QGraphicsROIPublisher::publishCommit()
+{
+    if (!_uncommitted) {
+        return;
+    }
+    QGraphicsROIStream::Event event;
+    event.type = QGraphicsROIStream::COMMIT_EVENT;
+    _append(event);
+}
+
+qint64 QGraphicsROIPublisher::sentBatches() const
+{
+    return _sent;
+}
+
+qint64 QGraphicsROIPublisher::droppedBatches() const
+{
+    return _dropped;
+}
+
+// added the first time, updated later
+qint64 QGraphicsROIPublisher::_publish(QGraphicsItem* item, QGraphicsROIStream::Event& event)
+{
+    QHash<QGraphicsItem*, qint64>::const_iterator it = _ids.constFind(item);
+    if (it == _ids.constEnd()) {
+        event.type = QGraphicsROIStream::ADD_EVENT;
+        event.id = _next_id++;
+        _ids.insert(item, event.id);
+    }
+    else {
+        event.type = QGraphicsROIStream::UPDATE_EVENT;
+        event.id = it.value();
+    }
+    _append(event);
+    event.type = QGraphicsROIStream::ADD_EVENT;
+    _rois.insert(event.id, event);
+    return event.id;
+}
+
+// an update replaces the last add or update of its ROI since a commit, as
+// subscribers see the batch at once
+void QGraphicsROIPublisher::_append(const QGraphicsROIStream::Event& event)
+{
+    if (event.type == QGraphicsROIStream::COMMIT_EVENT) {
+        _batch_index.clear();
+        _uncommitted = false;
+    }
+    else {
+        _uncommitted = true;
+    }
+    if (event.type == QGraphicsROIStream::UPDATE_EVENT) {
+        QHash<qint64, int>::const_iterator it = _batch_index.constFind(event.id);
+        if (it != _batch_index.constEnd()) {
+            _batch.events[it.value()].shape = event.shape;
+            _batch.events[it.value()].mask = event.mask;
+            return;
+        }
+    }
+    if (event.type == QGraphicsROIStream::REMOVE_EVENT) {
+        _batch_index.remove(event.id);
+    }
+    else if (event.type != QGraphicsROIStream::COMMIT_EVENT) {
+        _batch_index.insert(event.id, _batch.events.size());
+    }
+    _batch.events.append(event);
+    if (!_frame_timer.isActive()) {
+        _frame_timer.start();
+    }
+}
+
+// encoded once, shared by the queues of all subscribers
+void QGraphicsROIPublisher::onFrame()
+{
+    if (_batch.events.isEmpty()) {
+        return;
+    }
+    _batch.number = ++_batch_number;
+    if (!_subscribers.isEmpty()) {
+        QByteArray message = QGraphicsROIStream::encode(_batch);
+        for (int i = 0; i < _subscribers.size(); i++) {
+            _enqueue(_subscribers[i], message);
+            _write(_subscribers[i]);
+        }
+    }
+    _batch.events.clear();
+    _batch_index.clear();
+}
+
+// current ROIs as added, then committed. The pending batch is sent first,
+// so the snapshot is the state of the batches sent, and the next batch has
+// only events after it
+void QGraphicsROIPublisher::onNewConnection()
+{
+    onFrame();
+    while (_server && _server->hasPendingConnections()) {
+        Subscriber subscriber;
+        subscriber.socket = _server->nextPendingConnection();
+        connect(subscriber.socket, SIGNAL(bytesWritten(qint64)), this, SLOT(onBytesWritten()));
+        connect(subscriber.socket, SIGNAL(disconnected()), this, SLOT(onDisconnected()));
+        QGraphicsROIStream::Batch snapshot;
+        snapshot.number = _batch_number;
+        foreach (const QGraphicsROIStream::Event& event, _rois) {
+            snapshot.events.append(event);
+        }
+        snapshot.events.append(QGraphicsROIStream::Event());
+        _subscribers.append(subscriber);
+        _enqueue(_subscribers.last(), QGraphicsROIStream::encode(snapshot));
+        _write(_subscribers.last());
+    }
+}
+
+void QGraphicsROIPublisher::onBytesWritten()
+{
+    int index = _find(qobject_cast<QLocalSocket*>(sender()));
+    if (index >= 0) {
+        _write(_subscribers[index]);
+    }
+}
+
+void QGraphicsROIPublisher::onDisconnected()
+{
+    int index = _find(qobject_cast<QLocalSocket*>(sender()));
+    if (index >= 0) {
+        _subscribers[index].socket->deleteLater();
+        _subscribers.removeAt(index);
+    }
+}
+
+// oldest dropped when full
+void QGraphicsROIPublisher::_enqueue(Subscriber& subscriber, const QByteArray& message)
+{
+    while (subscriber.queue.size() >= _max_queued) {
+        subscriber.queue.dequeue();
+        subscriber.dropped++;
+        _dropped++;
+    }
+    subscriber.queue.enqueue(message);
+}
+
+// a batch at a time, so batches wait in the bounded queue rather than in
+// the unbounded buffer of the socket
+void QGraphicsROIPublisher::_write(Subscriber& subscriber)
+{
+    if (subscriber.socket->bytesToWrite() > 0 || subscriber.queue.isEmpty()) {
+        return;
+    }
+    QByteArray message = subscriber.queue.dequeue();
+    if (subscriber.dropped > 0) {
+        QGraphicsROIStream::setDropped(message, subscriber.dropped);
+        subscriber.dropped = 0;
+    }
+    subscriber.socket->write(message);
+    _sent++;
+}
+
+int QGraphicsROIPublisher::_find(QLocalSocket* socket) const
+{
+    for (int i = 0; i < _subscribers.size(); i++) {
+        if (_subscribers[i].socket == socket) {
+            return i;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include <QQueue>
+#include <QTimer>
+#include <QGraphicsItem>
+#include "QGraphicsROIStream.h"
+
+class QLocalServer;
+class QLocalSocket;
+
+/*!
+ * This class streams changes of ROIs to other processes over a local socket,
+ * a Unix domain socket, so they follow edits without polling.
+ *
+ * Selectors publish add, update and remove of the ROI of an item, a shape or
+ * a mask, and a commit when an edit is finished. Events of a frame are gathered into one
+ * batch, updates of a ROI replacing earlier ones in it, and encoded once as
+ * a QGraphicsROIStream message for all subscribers.
+ *
+ * Each subscriber has a queue of at most setMaxQueuedBatches() batches. Only
+ * the batch at its head is given to the socket, once the socket has written
+ * the one before, so a slow subscriber holds at most that many batches, and
+ * the oldest are dropped when it is full. The next batch sent tells how many
+ * were dropped, and a subscriber missing batches may connect again. A new
+ * subscriber gets all current ROIs first, as added in one batch.
+ *
+ * Usage:
+ *
+ *   QGraphicsROIPublisher* publisher = new QGraphicsROIPublisher(view);
+ *   publisher->listen("qgraphicsroi");
+ *   selector->setPublisher(publisher);
+ *   // or by hand
+ *   publisher->publishShape(item, item->roiShape());
+ *   publisher->publishCommit();
+ */
+class QGraphicsROIPublisher : public QObject
+{
+    Q_OBJECT
+public:
+    QGraphicsROIPublisher(QObject* parent = NULL);
+    ~QGraphicsROIPublisher();
+
+    // name of the socket, a path in the temporary directory on Unix
+    bool listen(const QString& name);
+    void close();
+    bool isListening() const;
+    int subscriberCount() const;
+
+    // batches held for a subscriber not reading
+    void setMaxQueuedBatches(int count);
+
+    // added the first time, updated later, id of the ROI returned
+    qint64 publishShape(QGraphicsItem* item, const QGraphicsROIShape& shape);
+    // mask in scene coords, sent whole
+    qint64 publishMask(QGraphicsItem* item, const QGraphicsRLEMask& mask);
+    void publishRemove(QGraphicsItem* item);
+    // the events since the last commit are a finished edit
+    void publishCommit();
+
+    // batches sent and dropped, over all subscribers
+    qint64 sentBatches() const;
+    qint64 droppedBatches() const;
+
+private slots:
+    void onNewConnection();
+    void onBytesWritten();
+    void onDisconnected();
+    void onFrame();
+
+private:
+    struct Subscriber
+    {
+        Subscriber() : socket(NULL), dropped(0) {}
+        QLocalSocket* socket;
+        QQueue<QByteArray> queue;
+        quint32 dropped; // since the last batch sent
+    };
+
+    QLocalServer* _server;
+    QList<Subscriber> _subscribers;
+    int _max_queued;
+
+    QHash<QGraphicsItem*, qint64> _ids;
+    QHash<qint64, QGraphicsROIStream::Event> _rois; // current, as added, for new subscribers
+    qint64 _next_id;
+
+    QGraphicsROIStream::Batch _batch;
+    QHash<qint64, int> _batch_index; // of the last add or update of a ROI in batch
+    bool _uncommitted;
+    quint32 _batch_number;
+    QTimer _frame_timer;
+
+    qint64 _sent;
+    qint64 _dropped;
+
+    qint64 _publish(QGraphicsItem* item, QGraphicsROIStream::Event& event);
+    void _append(const QGraphicsROIStream::Event& event);
+    void _enqueue(Subscriber& subscriber, const QByteArray& message);
+    void _write(Subscriber& subscriber);
+    int _find(QLocalSocket* socket) const;
+};
@@ -0,0 +1,203 @@
+#include "QGraphicsROIQueue.h"
+#include <QElapsedTimer>
+#include <QMetaObject>
+
+#define DEFAULT_TIME_BUDGET 4
+#define DEFAULT_MAX_BATCH 2000
+#define FRAME_INTERVAL 16
+#define POOL_SIZE 4096
+
+QGraphicsROIQueue::QGraphicsROIQueue(QObject* parent)
+    : QObject(parent)
+    , _head(&_stub)
+    , _tail(&_stub)
+    , _scheduled(0)
+    , _pool(new Node[POOL_SIZE])
+    , _free(0)
+    , _time_budget(DEFAULT_TIME_BUDGET)
+    , _max_batch(DEFAULT_MAX_BATCH)
+    , _taken(0)
+{
+    _stub.next.store(NULL);
+    for (int i = 0; i < POOL_SIZE; i++) {
+        _pool[i].index = i;
+        _pool[i].free_next.store(i + 1 < POOL_SIZE ? i + 2 : 0);
+    }
+    _free.store(1);
+    _frame_clock.start();
+    _frame_timer.setSingleShot(true);
+    _frame_timer.setInterval(FRAME_INTERVAL);
+    connect(&_frame_timer, SIGNAL(timeout()), this, SLOT(onFrame()));
+}
+
+// producers are expected to be stopped
+QGraphicsROIQueue::~QGraphicsROIQueue()
+{
+    Record record;
+    while (_pop(record)) {
+    }
+    delete[] _pool;
+}
+
+void QGraphicsROIQueue::setTimeBudget(int msec)
+{
+    _time_budget = msec;
+}
+
+void QGraphicsROIQueue::setMaxBatch(int count)
+{
+    _max_batch = count;
+}
+
+void QGraphicsROIQueue::pushAdd(qint64 id, const QGraphicsROIShape& shape)
+{
+    Record record;
+    record.type = ADD_ROI;
+    record.id = id;
+    record.shape = shape;
+    push(record);
+}
+
+void QGraphicsROIQueue::pushUpdate(qint64 id, const QGraphicsROIShape& shape)
+{
+    Record record;
+    record.type = UPDATE_ROI;
+    record.id = id;
+    record.shape = shape;
+    push(record);
+}
+
+void QGraphicsROIQueue::pushRemove(qint64 id)
+{
+    Record record;
+    record.type = REMOVE_ROI;
+    record.id = id;
+    push(record);
+}
+
+// the first record after a drain schedules the next frame, by a posted event
+void QGraphicsROIQueue::push(const Record& record)
+{
+    Node* node = _alloc();
+    node->record = record;
+    _push(node);
+    if (_scheduled.testAndSetOrdered(0, 1)) {
+        QMetaObject::invokeMethod(this, "onSchedule", Qt::QueuedConnection);
+    }
+}
+
+// the tag changes with every update of the top, so a top popped and pushed
+// back meanwhile fails the exchange
+QGraphicsROIQueue::Node* QGraphicsROIQueue::_alloc()
+{
+    quint64 top = _free.loadAcquire();
+    while (quint32(top)) {
+        Node* node = &_pool[quint32(top) - 1];
+        quint64 next = (((top >> 32) + 1) << 32) | quint32(node->free_next.loadAcquire());
+        if (_free.testAndSetOrdered(top, next, top)) {
+            return node;
+        }
+    }
+    return new Node;
+}
+
+void QGraphicsROIQueue::_release(Node* node)
+{
+    if (node->index < 0) {
+        delete node;
+        return;
+    }
+    node->record = Record();
+    quint64 top = _free.loadAcquire();
+    forever {
+        node->free_next.store(int(quint32(top)));
+        quint64 next = (((top >> 32) + 1) << 32) | quint32(node->index + 1);
+        if (_free.testAndSetOrdered(top, next, top)) {
+            return;
+        }
+    }
+}
+
+void QGraphicsROIQueue::_push(Node* node)
+{
+    node->next.store(NULL);
+    Node* prev = _head.fetchAndStoreOrdered(node);
+    // the list is broken here until the link is stored, see _pop()
+    prev->next.storeRelease(node);
+}
+
+// single consumer, the stub node keeps the list non-empty
+bool QGraphicsROIQueue::_pop(Record& record)
+{
+    Node* tail = _tail;
+    Node* next = tail->next.loadAcquire();
+    if (tail == &_stub) {
+        if (!next) {
+            return false;
+        }
+        _tail = next;
+        tail = next;
+        next = next->next.loadAcquire();
+    }
+    if (next) {
+        _tail = next;
+        record = tail->record;
+        _release(tail);
+        return true;
+    }
+    if (tail != _head.loadAcquire()) {
+        return false; // a producer is linking, retry later
+    }
+    _push(&_stub);
+    next = tail->next.loadAcquire();
+    if (next) {
+        _tail = next;
+        record = tail->record;
+        _release(tail);
+        return true;
+    }
+    return false;
+}
+
+// a record, or a producer linking one, is left
+bool QGraphicsROIQueue::_is_empty() const
+{
+    return _tail == &_stub && _head.loadAcquire() == &_stub;
+}
+
+void QGraphicsROIQueue::onSchedule()
+{
+    if (!_frame_timer.isActive()) {
+        _frame_timer.start();
+    }
+}
+
+bool QGraphicsROIQueue::take(Record& record)
+{
+    if (_taken >= _max_batch) {
+        return false;
+    }
+    // check the clock every 16 records
+    if (_taken > 0 && (_taken & 15) == 0 && _frame_clock.elapsed() >= _time_budget) {
+        return false;
+    }
+    if (!_pop(record)) {
+        return false;
+    }
+    _taken++;
+    return true;
+}
+
+// receivers take and apply records within the budget, the rest is left for
+// next frame
+void QGraphicsROIQueue::onFrame()
+{
+    _frame_clock.start();
+    _taken = 0;
+    Q_EMIT recordsReady();
+    // rescheduled by next push once drained, or a record left after reset
+    _scheduled.store(0);
+    if (!_is_empty() && _scheduled.testAndSetOrdered(0, 1)) {
+        _frame_timer.start();
+    }
+}
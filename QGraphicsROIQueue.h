@@ -0,0 +1,116 @@
+#pragma once
+
+#include <QObject>
+#include <QAtomicPointer>
+#include <QAtomicInt>
+#include <QAtomicInteger>
+#include <QElapsedTimer>
+#include <QVector>
+#include <QTimer>
+#include "QGraphicsROIShape.h"
+
+/*!
+ * This class passes ROIs produced by worker threads to the GUI thread.
+ *
+ * Workers push add, update and remove records from any thread. The queue is a
+ * lock-free multi-producer single-consumer linked list, so a push is one atomic
+ * exchange and never waits for the GUI thread, or for other producers.
+ *
+ * Nodes come from a pool allocated with the queue. Producers take them from
+ * a lock-free free list, tagged against reuse, and the consumer gives them
+ * back, so a push allocates nothing while the pool lasts. When it runs out,
+ * nodes are allocated one by one and deleted once popped.
+ *
+ * On the GUI thread, the queue is drained once per frame. recordsReady() is
+ * emitted and the receiver takes records with take(), and applies them,
+ * until it returns false, at setTimeBudget() msec since the frame started or
+ * setMaxBatch() records. The budget covers applying records, not only
+ * popping them. What is left stays queued for the next frame, so a burst of
+ * records is spread over frames instead of stalling the view.
+ *
+ * Usage:
+ *
+ *   QGraphicsROIQueue* queue = new QGraphicsROIQueue(view);
+ *   connect(queue, &QGraphicsROIQueue::recordsReady, ...);
+ *   // on any thread
+ *   queue->pushAdd(id, QGraphicsROIShape::fromRect(rect));
+ *   // on recordsReady()
+ *   QGraphicsROIQueue::Record record;
+ *   while (queue->take(record)) { ... }
+ *
+ * The object lives on the GUI thread, only push functions are thread-safe.
+ */
+class QGraphicsROIQueue : public QObject
+{
+    Q_OBJECT
+public:
+    enum RECORD_TYPE
+    {
+        ADD_ROI = 0,
+        UPDATE_ROI = 1,
+        REMOVE_ROI = 2,
+    };
+
+    struct Record
+    {
+        Record() : type(ADD_ROI), id(-1) {}
+        int type;
+        qint64 id;
+        QGraphicsROIShape shape; // in scene coords, empty for removing
+    };
+
+    QGraphicsROIQueue(QObject* parent = 0);
+    ~QGraphicsROIQueue();
+
+    // time and number of records drained per frame
+    void setTimeBudget(int msec);
+    void setMaxBatch(int count);
+
+    // thread-safe
+    void push(const Record& record);
+    void pushAdd(qint64 id, const QGraphicsROIShape& shape);
+    void pushUpdate(qint64 id, const QGraphicsROIShape& shape);
+    void pushRemove(qint64 id);
+
+    // GUI thread, on recordsReady(), next record, false when the queue is
+    // drained or the budget of the frame is spent
+    bool take(Record& record);
+
+signals:
+    void recordsReady();
+
+private slots:
+    void onSchedule();
+    void onFrame();
+
+private:
+    struct Node
+    {
+        Node() : index(-1), free_next(0) {}
+        QAtomicPointer<Node> next;
+        Record record;
+        int index; // in pool, -1 when allocated alone
+        QAtomicInt free_next; // index + 1 of next free node, 0 for none
+    };
+
+    // producers append at head, consumer pops at tail
+    QAtomicPointer<Node> _head;
+    Node* _tail;
+    Node _stub;
+    QAtomicInt _scheduled;
+    Node* _pool;
+    // top of free list, index + 1 in low and tag in high 32 bits
+    QAtomicInteger<quint64> _free;
+
+    int _time_budget;
+    int _max_batch;
+    QTimer _frame_timer;
+    QElapsedTimer _frame_clock;
+    int _taken; // in this frame
+
+    Node* _alloc();
+    void _release(Node* node);
+    void _push(Node* node);
+    bool _pop(Record& record);
+    bool _is_empty() const;
+};
@@ -0,0 +1,93 @@
+#include "QGraphicsROISelection.h"
+#include <cassert>
+
+QGraphicsROISelection::QGraphicsROISelection(QGraphicsView* view)
+    : QObject(view)
+    , _scene(view->scene())
+{
+    assert(_scene);
+    // the scene signals once per action
+    connect(_scene, SIGNAL(selectionChanged()), this, SLOT(flush()));
+    foreach (QGraphicsItem* item, _scene->selectedItems()) {
+        _selected.insert(item);
+    }
+}
+
+QGraphicsROISelection::~QGraphicsROISelection()
+{
+
+}
+
+void QGraphicsROISelection::addItem(QGraphicsObject* item)
+{
+    connect(item, SIGNAL(selectedChanged(bool)), this, SLOT(onItemSelectedChanged(bool)));
+    connect(item, SIGNAL(destroyed(QObject*)), this, SLOT(onItemDestroyed(QObject*)));
+    if (item->isSelected()) {
+        _set_selected(item, true);
+    }
+}
+
+int QGraphicsROISelection::count() const
+{
+    return _selected.size();
+}
+
+bool QGraphicsROISelection::contains(QGraphicsItem* item) const
+{
+    return _selected.contains(item);
+}
+
+const QSet<QGraphicsItem*>& QGraphicsROISelection::items() const
+{
+    return _selected;
+}
+
+void QGraphicsROISelection::onItemSelectedChanged(bool selected)
+{
+    QGraphicsObject* item = qobject_cast<QGraphicsObject*>(sender());
+    if (item) {
+        _set_selected(item, selected);
+    }
+}
+
+// items deleted while selected are not deselected, and are not reported,
+// only the address is used, the object is already destroyed
+void QGraphicsROISelection::onItemDestroyed(QObject* object)
+{
+    QGraphicsItem* item = static_cast<QGraphicsObject*>(object);
+    _selected.remove(item);
+    _added.remove(item);
+    _removed.remove(item);
+}
+
+// a change cancels the pending opposite change
+void QGraphicsROISelection::_set_selected(QGraphicsItem* item, bool selected)
+{
+    if (selected) {
+        if (!_selected.contains(item)) {
+            _selected.insert(item);
+            if (!_removed.remove(item)) {
+                _added.insert(item);
+            }
+        }
+    }
+    else {
+        if (_selected.remove(item)) {
+            if (!_added.remove(item)) {
+                _removed.insert(item);
+            }
+        }
+    }
+}
+
+void QGraphicsROISelection::flush()
+{
+    if (_added.isEmpty() && _removed.isEmpty()) {
+        return;
+    }
+    QList<QGraphicsItem*> added = _added.toList();
+    QList<QGraphicsItem*> removed = _removed.toList();
+    _added.clear();
+    _removed.clear();
+    Q_EMIT selectionChanged(added, removed);
+}
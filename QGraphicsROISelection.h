@@ -0,0 +1,62 @@
+#pragma once
+
+#include <QObject>
+#include <QGraphicsView>
+#include <QGraphicsScene>
+#include <QGraphicsObject>
+#include <QList>
+#include <QSet>
+#include <QPointer>
+
+/*!
+ * This class tracks selected ROIs of a view incrementally, instead of building
+ * the list of selectedItems() of the scene on each selection change.
+ *
+ * Tracked items report their own selection changes with selectedChanged(bool),
+ * which are collected as added and removed items. The scene signals the end
+ * of each user action, a click, a rubber band step or a clearSelection(), by
+ * selectionChanged(), and the collected deltas are then emitted once. So the
+ * cost of an action is linear in the number of items changed.
+ *
+ * Usage:
+ *
+ *   QGraphicsROISelection* selection = new QGraphicsROISelection(view);
+ *   selection->addItem(item);
+ *   connect(selection, &QGraphicsROISelection::selectionChanged, ...);
+ *   int count = selection->count();
+ *   foreach (QGraphicsItem* item, selection->items()) { ... }
+ */
+class QGraphicsROISelection : public QObject
+{
+    Q_OBJECT
+public:
+    QGraphicsROISelection(QGraphicsView* view);
+    ~QGraphicsROISelection();
+
+    // track selection of item, which emits selectedChanged(bool)
+    void addItem(QGraphicsObject* item);
+
+    // selected items
+    int count() const;
+    bool contains(QGraphicsItem* item) const;
+    const QSet<QGraphicsItem*>& items() const;
+
+public slots:
+    // emit collected changes now
+    void flush();
+
+signals:
+    void selectionChanged(const QList<QGraphicsItem*>& added, const QList<QGraphicsItem*>& removed);
+
+private slots:
+    void onItemSelectedChanged(bool selected);
+    void onItemDestroyed(QObject* object);
+
+private:
+    QPointer<QGraphicsScene> _scene;
+    QSet<QGraphicsItem*> _selected;
+    QSet<QGraphicsItem*> _added;
+    QSet<QGraphicsItem*> _removed;
+
+    void _set_selected(QGraphicsItem* item, bool selected);
+};
@@ -0,0 +1,121 @@
+#include "QGraphicsROIShape.h"
+#include <qmath.h>
+
+QGraphicsROIShape::QGraphicsROIShape()
+    : type(NO_SHAPE)
+    , radius(0)
+{
+
+}
+
+QGraphicsROIShape QGraphicsROIShape::fromRect(const QRectF& rect)
+{
+    QGraphicsROIShape shape;
+    shape.type = RECT_SHAPE;
+    shape.rect = rect.normalized();
+    return shape;
+}
+
+QGraphicsROIShape QGraphicsROIShape::fromPolygon(const QPolygonF& polygon, const QVector<QPolygonF>& holes)
+{
+    QGraphicsROIShape shape;
+    shape.type = POLYGON_SHAPE;
+    shape.polygon = polygon;
+    shape.holes = holes;
+    return shape;
+}
+
+QGraphicsROIShape QGraphicsROIShape::fromCircle(const QPointF& center, qreal radius)
+{
+    QGraphicsROIShape shape;
+    shape.type = CIRCLE_SHAPE;
+    shape.center = center;
+    shape.radius = radius;
+    return shape;
+}
+
+bool QGraphicsROIShape::isNull() const
+{
+    return type == NO_SHAPE;
+}
+
+QRectF QGraphicsROIShape::boundingRect() const
+{
+    switch (type) {
+    case RECT_SHAPE:
+        return rect;
+    case POLYGON_SHAPE:
+        return polygon.boundingRect();
+    case CIRCLE_SHAPE:
+        return QRectF(center.x() - radius, center.y() - radius, 2 * radius, 2 * radius);
+    default:
+        return QRectF();
+    }
+}
+
+QGraphicsROIShape QGraphicsROIShape::translated(const QPointF& offset) const
+{
+    QGraphicsROIShape shape = *this;
+    shape.rect.translate(offset);
+    shape.polygon.translate(offset);
+    for (int i = 0; i < shape.holes.size(); i++) {
+        shape.holes[i].translate(offset);
+    }
+    shape.center += offset;
+    return shape;
+}
+
+// open rings, QPolygonF(rect) would repeat the first corner
+QPolygonF QGraphicsROIShape::toPolygon(qreal tolerance) const
+{
+    switch (type) {
+    case RECT_SHAPE:
+        return QPolygonF() << rect.topLeft() << rect.topRight() << rect.bottomRight() << rect.bottomLeft();
+    case POLYGON_SHAPE: {
+        QPolygonF ring = polygon;
+        if (ring.size() > 1 && ring.first() == ring.last()) {
+            ring.removeLast();
+        }
+        return ring;
+    }
+    case CIRCLE_SHAPE: {
+        // chord error of n segments is r * (1 - cos(pi / n))
+        int n = 8;
+        if (tolerance > 0 && tolerance < radius) {
+            n = qMax(n, int(ceil(M_PI / acos(1 - tolerance / radius))));
+        }
+        QPolygonF circle(n);
+        for (int i = 0; i < n; i++) {
+            qreal a = 2 * M_PI * i / n;
+            circle[i] = QPointF(center.x() + radius * cos(a), center.y() + radius * sin(a));
+        }
+        return circle;
+    }
+    default:
+        return QPolygonF();
+    }
+}
+
+QPainterPath QGraphicsROIShape::toPath() const
+{
+    QPainterPath path;
+    switch (type) {
+    case RECT_SHAPE:
+        path.addRect(rect);
+        break;
+    case POLYGON_SHAPE:
+        path.addPolygon(polygon);
+        path.closeSubpath();
+        foreach (const QPolygonF& hole, holes) {
+            path.addPolygon(hole);
+            path.closeSubpath();
+        }
+        break;
+    case CIRCLE_SHAPE:
+        path.addEllipse(center, radius, radius);
+        break;
+    default:
+        break;
+    }
+    return path;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <QRectF>
+#include <QPointF>
+#include <QPolygonF>
+#include <QPainterPath>
+#include <QVector>
+
+/*!
+ * Plain geometry of a ROI in scene coordinates, independent of graphics items.
+ * It only holds value types and may be copied to worker threads.
+ */
+struct QGraphicsROIShape
+{
+    enum SHAPE_TYPE
+    {
+        NO_SHAPE = 0,
+        RECT_SHAPE = 1,
+        POLYGON_SHAPE = 2,
+        CIRCLE_SHAPE = 3,
+    };
+
+    QGraphicsROIShape();
+
+    static QGraphicsROIShape fromRect(const QRectF& rect);
+    static QGraphicsROIShape fromPolygon(const QPolygonF& polygon,
+                                         const QVector<QPolygonF>& holes = QVector<QPolygonF>());
+    static QGraphicsROIShape fromCircle(const QPointF& center, qreal radius);
+
+    bool isNull() const;
+    QRectF boundingRect() const;
+    QGraphicsROIShape translated(const QPointF& offset) const;
+
+    // outline as an open ring, without closing point and holes, circle is
+    // approximated within given tolerance
+    QPolygonF toPolygon(qreal tolerance = 0.5) const;
+    QPainterPath toPath() const;
+
+    int type;
+    QRectF rect;
+    QPolygonF polygon;
+    QVector<QPolygonF> holes; // of polygon
+    QPointF center;
+    qreal radius;
+};
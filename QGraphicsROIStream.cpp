@@ -0,0 +1,219 @@
+#include "QGraphicsROIStream.h"
+#include <QtEndian>
+#include <cstring>
+
+#define MESSAGE_HEADER_SIZE 16
+#define MAX_MESSAGE_SIZE (256 << 20)
+
+template <typename T>
+static void _append(QByteArray& bytes, T value)
+{
+    uchar data[sizeof(T)];
+    qToLittleEndian(value, data);
+    bytes.append(reinterpret_cast<const char*>(data), int(sizeof(T)));
+}
+
+static void _append_float(QByteArray& bytes, qreal value)
+{
+    float f = float(value);
+    quint32 bits;
+    memcpy(&bits, &f, sizeof(bits));
+    _append(bytes, bits);
+}
+
+// false when the message ends before the value
+template <typename T>
+static bool _read(const uchar*& data, const uchar* end, T& value)
+{
+    if (end - data < int(sizeof(T))) {
+        return false;
+    }
+    value = qFromLittleEndian<T>(data);
+    data += sizeof(T);
+    return true;
+}
+
+static bool _read_float(const uchar*& data, const uchar* end, qreal& value)
+{
+    quint32 bits;
+    if (!_read(data, end, bits)) {
+        return false;
+    }
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    value = f;
+    return true;
+}
+
+static void _append_points(QByteArray& bytes, const QPolygonF& polygon)
+{
+    _append(bytes, quint32(polygon.size()));
+    foreach (const QPointF& point, polygon) {
+        _append_float(bytes, point.x());
+        _append_float(bytes, point.y());
+    }
+}
+
+static bool _read_points(const uchar*& data, const uchar* end, QPolygonF& polygon)
+{
+    quint32 count;
+    if (!_read(data, end, count) || qint64(count) * 8 > end - data) {
+        return false;
+    }
+    polygon.resize(int(count));
+    for (int i = 0; i < int(count); i++) {
+        qreal x, y;
+        _read_float(data, end, x);
+        _read_float(data, end, y);
+        polygon[i] = QPointF(x, y);
+    }
+    return true;
+}
+
+static void _append_mask(QByteArray& bytes, const QGraphicsRLEMask& mask)
+{
+    QByteArray runs = mask.toByteArray();
+    _append(bytes, quint32(runs.size()));
+    bytes.append(runs);
+}
+
+// size is written last, once the events are in
+QByteArray QGraphicsROIStream::encode(const Batch& batch)
+{
+    QByteArray bytes;
+    bytes.reserve(MESSAGE_HEADER_SIZE + batch.events.size() * 32);
+    _append(bytes, quint32(0));
+    _append(bytes, batch.number);
+    _append(bytes, batch.dropped);
+    _append(bytes, quint32(batch.events.size()));
+    foreach (const Event& event, batch.events) {
+        _append(bytes, quint8(event.type));
+        _append(bytes, event.id);
+        if (event.type == ADD_EVENT || event.type == UPDATE_EVENT) {
+            _append_shape(bytes, event.shape, event.mask);
+        }
+    }
+    qToLittleEndian(quint32(bytes.size() - 4), reinterpret_cast<uchar*>(bytes.data()));
+    return bytes;
+}
+
+int QGraphicsROIStream::decode(const QByteArray& buffer, Batch& batch)
+{
+    if (buffer.size() < MESSAGE_HEADER_SIZE) {
+        return 0;
+    }
+    const uchar* data = reinterpret_cast<const uchar*>(buffer.constData());
+    quint32 size = qFromLittleEndian<quint32>(data);
+    if (size < MESSAGE_HEADER_SIZE - 4 || size > MAX_MESSAGE_SIZE) {
+        return -1;
+    }
+    if (qint64(buffer.size()) < qint64(size) + 4) {
+        return 0;
+    }
+    const uchar* end = data + 4 + size;
+    data += 4;
+    quint32 count;
+    _read(data, end, batch.number);
+    _read(data, end, batch.dropped);
+    _read(data, end, count);
+    batch.events.clear();
+    for (quint32 i = 0; i < count; i++) {
+        Event event;
+        quint8 type;
+        if (!_read(data, end, type) || !_read(data, end, event.id)) {
+            return -1;
+        }
+        event.type = type;
+        if ((type == ADD_EVENT || type == UPDATE_EVENT) && !_read_shape(data, end, event.shape, event.mask)) {
+            return -1;
+        }
+        batch.events.append(event);
+    }
+    return int(size) + 4;
+}
+
+void QGraphicsROIStream::setDropped(QByteArray& message, quint32 dropped)
+{
+    if (message.size() >= MESSAGE_HEADER_SIZE) {
+        qToLittleEndian(dropped, reinterpret_cast<uchar*>(message.data()) + 8);
+    }
+}
+
+void QGraphicsROIStream::_append_shape(QByteArray& bytes, const QGraphicsROIShape& shape,
+                                       const QGraphicsRLEMask& mask)
+{
+    _append(bytes, quint8(shape.type));
+    switch (shape.type) {
+    case QGraphicsROIShape::RECT_SHAPE:
+        _append_float(bytes, shape.rect.x());
+        _append_float(bytes, shape.rect.y());
+        _append_float(bytes, shape.rect.width());
+        _append_float(bytes, shape.rect.height());
+        break;
+    case QGraphicsROIShape::POLYGON_SHAPE:
+        _append(bytes, quint32(1 + shape.holes.size()));
+        _append_points(bytes, shape.polygon);
+        foreach (const QPolygonF& hole, shape.holes) {
+            _append_points(bytes, hole);
+        }
+        break;
+    case QGraphicsROIShape::CIRCLE_SHAPE:
+        _append_float(bytes, shape.center.x());
+        _append_float(bytes, shape.center.y());
+        _append_float(bytes, shape.radius);
+        break;
+    default:
+        _append_mask(bytes, mask);
+        break;
+    }
+}
+
+bool QGraphicsROIStream::_read_shape(const uchar*& data, const uchar* end, QGraphicsROIShape& shape,
+                                     QGraphicsRLEMask& mask)
+{
+    quint8 type;
+    if (!_read(data, end, type)) {
+        return false;
+    }
+    shape = QGraphicsROIShape();
+    shape.type = type;
+    if (type == QGraphicsROIShape::RECT_SHAPE) {
+        qreal x, y, width, height;
+        if (!_read_float(data, end, x) || !_read_float(data, end, y) || !_read_float(data, end, width) ||
+            !_read_float(data, end, height)) {
+            return false;
+        }
+        shape.rect = QRectF(x, y, width, height);
+    }
+    else if (type == QGraphicsROIShape::POLYGON_SHAPE) {
+        quint32 rings;
+        if (!_read(data, end, rings) || rings == 0 || qint64(rings) * 4 > end - data ||
+            !_read_points(data, end, shape.polygon)) {
+            return false;
+        }
+        shape.holes.resize(int(rings - 1));
+        for (int i = 0; i < shape.holes.size(); i++) {
+            if (!_read_points(data, end, shape.holes[i])) {
+                return false;
+            }
+        }
+    }
+    else if (type == QGraphicsROIShape::CIRCLE_SHAPE) {
+        qreal x, y;
+        if (!_read_float(data, end, x) || !_read_float(data, end, y) || !_read_float(data, end, shape.radius)) {
+            return false;
+        }
+        shape.center = QPointF(x, y);
+    }
+    else if (type == QGraphicsROIShape::NO_SHAPE) {
+        quint32 size;
+        if (!_read(data, end, size) || qint64(size) > end - data) {
+            return false;
+        }
+        // read in place, without copying the runs
+        QByteArray runs = QByteArray::fromRawData(reinterpret_cast<const char*>(data), int(size));
+        mask = QGraphicsRLEMask::fromByteArray(runs);
+        data += size;
+    }
+    return true;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <QByteArray>
+#include <QVector>
+#include "QGraphicsROIShape.h"
+#include "QGraphicsRLEMask.h"
+
+/*!
+ * This class encodes batches of ROI change events into the binary messages
+ * sent by QGraphicsROIPublisher, and decodes them for subscribers.
+ *
+ * A message is a batch of the events of a frame, all numbers little endian:
+ *
+ *   quint32 size     // bytes of the message after this field
+ *   quint32 number   // of the batch, counted by the publisher
+ *   quint32 dropped  // batches dropped for the subscriber before this one
+ *   quint32 count    // of events
+ *   events:
+ *     quint8 type    // ADD_EVENT, UPDATE_EVENT, REMOVE_EVENT or COMMIT_EVENT
+ *     qint64 id      // of the ROI, -1 for commit
+ *     shape, for add and update:
+ *       quint8 type  // QGraphicsROIShape::SHAPE_TYPE
+ *       rect:        float x, y, width, height
+ *       polygon:     quint32 rings, outline then holes, each quint32 points
+ *                    then float x, y of points
+ *       circle:      float x, y, radius
+ *       mask, of no shape:
+ *                    quint32 bytes then QGraphicsRLEMask::toByteArray()
+ *
+ * Coordinates are in scene coords, as float, exact to far below a pixel for
+ * images up to 65536 pixels wide. Masks are in scene pixels, sent whole on
+ * each add and update. A commit marks the events before it as a finished
+ * edit, a state a subscriber may keep.
+ *
+ * Usage:
+ *
+ *   QGraphicsROIStream::Batch batch;
+ *   int used;
+ *   while ((used = QGraphicsROIStream::decode(buffer, batch)) > 0) {
+ *       buffer.remove(0, used);
+ *       ...
+ *   }
+ */
+class QGraphicsROIStream
+{
+public:
+    enum EVENT_TYPE
+    {
+        ADD_EVENT = 1,
+        UPDATE_EVENT = 2,
+        REMOVE_EVENT = 3,
+        COMMIT_EVENT = 4
+    };
+
+    struct Event
+    {
+        Event() : type(COMMIT_EVENT), id(-1) {}
+        int type;
+        qint64 id;
+        QGraphicsROIShape shape; // null for a mask
+        QGraphicsRLEMask mask;
+    };
+
+    struct Batch
+    {
+        Batch() : number(0), dropped(0) {}
+        quint32 number;
+        quint32 dropped;
+        QVector<Event> events;
+    };
+
+    static QByteArray encode(const Batch& batch);
+
+    // bytes of the message decoded at the start of buffer, 0 when it is not
+    // all received yet, -1 when it is not a message
+    static int decode(const QByteArray& buffer, Batch& batch);
+
+    // of a message, for dropped to be set in place when it is sent
+    static void setDropped(QByteArray& message, quint32 dropped);
+
+private:
+    static void _append_shape(QByteArray& bytes, const QGraphicsROIShape& shape, const QGraphicsRLEMask& mask);
+    static bool _read_shape(const uchar*& data, const uchar* end, QGraphicsROIShape& shape, QGraphicsRLEMask& mask);
+};
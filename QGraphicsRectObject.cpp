@@ -1,4 +1,8 @@
 #include "QGraphicsRectObject.h"
+#include "QGraphicsRenderQuality.h"
+#include "QGraphicsOverlayTiles.h"
+#include "QGraphicsROIClusters.h"
+#include "QGraphicsDragIndex.h"
 #include <QGraphicsScene>
 #include <QGraphicsView>
 #include <QPainter>
@@ -6,8 +10,9 @@
 #include <cassert>
 
 QGraphicsRectObject::QGraphicsRectObject(const QRectF& rect, QGraphicsItem* parent)
-    : QGraphicsObject(parent)
+    : QGraphicsROIObject(parent)
     , _handle_size(DEFAULT_HANDLE_SIZE)
+    , _roi_id(-1)
     , _shape_pen(QBrush(Qt::red), 1, Qt::SolidLine) 
     , _handle_pen(QBrush(Qt::green), 1, Qt::SolidLine) 
 {  
@@ -20,6 +25,7 @@ QGraphicsRectObject::QGraphicsRectObject(const QRectF& rect, QGraphicsItem* pare
     _handle_pen.setCosmetic(true);
 
     _rect = QRectF(mapFromScene(rect.topLeft()), mapFromScene(rect.bottomRight()));
+    _shape_bound = _rect; 
     _update_handles(); 
     _clear_mode(); 
 }
@@ -50,6 +56,50 @@ void QGraphicsRectObject::setHandleColor(const QColor& color)
     _handle_pen.setColor(color); 
 }
 
+QPen QGraphicsRectObject::shapePen() const
+{
+    return _shape_pen; 
+}
+
+QGraphicsROIShape QGraphicsRectObject::roiShape() const
+{
+    return QGraphicsROIShape::fromRect(QRectF(mapToScene(_rect.topLeft()), mapToScene(_rect.bottomRight()))); 
+}
+
+QGraphicsROIMetrics QGraphicsRectObject::metrics() const
+{
+    return QGraphicsROIMetrics::fromShape(roiShape()); 
+}
+
+// rect in scene coords, without notifying 
+void QGraphicsRectObject::setRect(const QRectF& rect)
+{
+    _rect = QRectF(mapFromScene(rect.topLeft()), mapFromScene(rect.bottomRight()));
+    _fit_bound(_rect); 
+    _update_handles(); 
+    update(); 
+}
+
+void QGraphicsRectObject::setRoiId(qint64 id)
+{
+    _roi_id = id; 
+}
+
+qint64 QGraphicsRectObject::roiId() const
+{
+    return _roi_id; 
+}
+
+// transform rect in scene coords in place, without notifying, 
+// for group edits of many items 
+void QGraphicsRectObject::transformShape(const QTransform& transform)
+{
+    _rect = mapRectFromScene(transform.mapRect(mapRectToScene(_rect))); 
+    _fit_bound(_rect); 
+    _update_handles(); 
+    update(); 
+}
+
 // Return the bounding area of the item
 // the actual rect + the handles
 QRectF QGraphicsRectObject::boundingRect() const
@@ -57,7 +107,50 @@ QRectF QGraphicsRectObject::boundingRect() const
     auto t = this->scene()->views().at(0)->transform(); //get current sace factors
     qreal x_off = (_handle_size / t.m11()) / 2.0 + 1; 
     qreal y_off = (_handle_size / t.m22()) / 2.0 + 1; 
-    return _rect.adjusted(-x_off, -y_off, x_off, y_off);
+    return _shape_bound.adjusted(-x_off, -y_off, x_off, y_off);
+}
+
+// centers of handles, in order of HANDLE_ID 
+static QVector<QPointF> _handle_centers(const QRectF& rect)
+{
+    QVector<QPointF> centers(8); 
+    centers[QGraphicsRectObject::TOP_LEFT_HANDLE] = rect.topLeft(); 
+    centers[QGraphicsRectObject::TOP_RIGHT_HANDLE] = rect.topRight(); 
+    centers[QGraphicsRectObject::BOTTOM_LEFT_HANDLE] = rect.bottomLeft(); 
+    centers[QGraphicsRectObject::BOTTOM_RIGHT_HANDLE] = rect.bottomRight(); 
+    centers[QGraphicsRectObject::TOP_HANDLE] = QPointF(rect.center().x(), rect.top()); 
+    centers[QGraphicsRectObject::BOTTOM_HANDLE] = QPointF(rect.center().x(), rect.bottom()); 
+    centers[QGraphicsRectObject::LEFT_HANDLE] = QPointF(rect.left(), rect.center().y()); 
+    centers[QGraphicsRectObject::RIGHT_HANDLE] = QPointF(rect.right(), rect.center().y()); 
+    return centers; 
+}
+
+static QRectF _line_rect(const QPointF& p1, const QPointF& p2, qreal margin)
+{
+    return QRectF(p1, p2).normalized().adjusted(-margin, -margin, margin, margin); 
+}
+
+// damage of an axis aligned edge, 
+// only the moved ends if it stays on the same line 
+static void _edge_damage(const QLineF& before, const QLineF& after, qreal margin, QVector<QRectF>& damage)
+{
+    if (before == after) {
+        return; 
+    }
+    bool same_line = (before.dy() == 0 && after.dy() == 0 && before.y1() == after.y1()) || 
+                     (before.dx() == 0 && after.dx() == 0 && before.x1() == after.x1()); 
+    if (same_line) {
+        if (before.p1() != after.p1()) {
+            damage.append(_line_rect(before.p1(), after.p1(), margin)); 
+        }
+        if (before.p2() != after.p2()) {
+            damage.append(_line_rect(before.p2(), after.p2(), margin)); 
+        }
+    }
+    else {
+        damage.append(_line_rect(before.p1(), before.p2(), margin)); 
+        damage.append(_line_rect(after.p1(), after.p2(), margin)); 
+    }
 }
 
 // update handles based on current rect 
@@ -72,23 +165,29 @@ void QGraphicsRectObject::_update_handles()
         _handles.fill(QRectF(0, 0, _handle_size, _handle_size), 8); 
     }
     // move rect of handles to proper position 
-    _handles[TOP_LEFT_HANDLE].moveCenter(_rect.topLeft()); 
-    _handles[TOP_RIGHT_HANDLE].moveCenter(_rect.topRight()); 
-    _handles[BOTTOM_LEFT_HANDLE].moveCenter(_rect.bottomLeft()); 
-    _handles[BOTTOM_RIGHT_HANDLE].moveCenter(_rect.bottomRight());
-    _handles[TOP_HANDLE].moveCenter(QPointF(_rect.center().x(), _rect.top()));
-    _handles[BOTTOM_HANDLE].moveCenter(QPointF(_rect.center().x(), _rect.bottom()));
-    _handles[LEFT_HANDLE].moveCenter(QPointF(_rect.left(), _rect.center().y()));
-    _handles[RIGHT_HANDLE].moveCenter(QPointF(_rect.right(), _rect.center().y()));
+    QVector<QPointF> centers = _handle_centers(_rect); 
+    for (int i = 0; i < centers.size(); i++) {
+        _handles[i].moveCenter(centers[i]); 
+    }
 }
 
 // customized painting
 void QGraphicsRectObject::paint(QPainter* painter, const QStyleOptionGraphicsItem*, QWidget*)
 {
+    // static items are rendered in overlay tiles
+    if (!isSelected() && QGraphicsOverlayTiles::isActive(scene())) {
+        return; 
+    }
+    // small items are drawn as clusters 
+    qreal lod_cell = QGraphicsROIClusters::lodCellSize(scene()); 
+    if (lod_cell > 0 && !isSelected() && qMax(_shape_bound.width(), _shape_bound.height()) <= lod_cell) {
+        return; 
+    }
+    int fast_path = QGraphicsRenderQuality::activeFastPath(scene());
     painter->setPen(_shape_pen);
     painter->drawRect(_rect);
     //draw handles for currently selected item 
-    if(isSelected()) {
+    if(isSelected() && !(fast_path & QGraphicsRenderQuality::NO_HANDLES)) {
         _update_handles(); 
         painter->setPen(_handle_pen);
         painter->drawRects(_handles);
@@ -193,6 +292,46 @@ void QGraphicsRectObject::_resize_rect(const QPointF& pos)
     _rect = _rect.normalized();
 }
 
+// damage of edges and handles changed from one rect to another 
+void QGraphicsRectObject::_edges_damage(const QRectF& before, const QRectF& after, QVector<QRectF>& damage) const
+{
+    qreal margin = _damage_margin(_handle_size, _shape_pen); 
+    _edge_damage(QLineF(before.topLeft(), before.topRight()), QLineF(after.topLeft(), after.topRight()), margin, damage); 
+    _edge_damage(QLineF(before.topRight(), before.bottomRight()), QLineF(after.topRight(), after.bottomRight()), margin, damage); 
+    _edge_damage(QLineF(before.bottomLeft(), before.bottomRight()), QLineF(after.bottomLeft(), after.bottomRight()), margin, damage); 
+    _edge_damage(QLineF(before.topLeft(), before.bottomLeft()), QLineF(after.topLeft(), after.bottomLeft()), margin, damage); 
+    QVector<QPointF> centers_before = _handle_centers(before); 
+    QVector<QPointF> centers_after = _handle_centers(after); 
+    for (int i = 0; i < centers_before.size(); i++) {
+        if (centers_before[i] != centers_after[i]) {
+            damage.append(_line_rect(centers_before[i], centers_before[i], margin)); 
+            damage.append(_line_rect(centers_after[i], centers_after[i], margin)); 
+        }
+    }
+}
+
+// move the resizing handle and repaint only the damaged area, 
+// the changed edges and handles, before and after the move. 
+// return damaged rects in local coords 
+QVector<QRectF> QGraphicsRectObject::_move_handle(const QPointF& pos)
+{
+    QRectF before = _rect; 
+    _resize_rect(pos); 
+    QVector<QRectF> damage; 
+    _edges_damage(before, _rect, damage); 
+    if (_grow_bound(_rect)) {
+        // full repaint by geometry change 
+        damage.clear(); 
+        damage.append(boundingRect()); 
+    }
+    else {
+        for (int i = 0; i < damage.size(); i++) {
+            scene()->update(mapRectToScene(damage[i])); 
+        }
+    }
+    return damage; 
+}
+
 void QGraphicsRectObject::hoverEnterEvent(QGraphicsSceneHoverEvent* event)
 {
     _clear_mode(); 
@@ -219,6 +358,10 @@ void QGraphicsRectObject::mousePressEvent(QGraphicsSceneMouseEvent* event)
         _set_dragging_mode(); 
     }
     QGraphicsObject::mousePressEvent(event);
+    // selection is settled by the press 
+    if (!_resizing && event->button() == Qt::LeftButton) {
+        Q_EMIT dragStarted(); 
+    }
 }
 
 void QGraphicsRectObject::mouseMoveEvent(QGraphicsSceneMouseEvent* event)
@@ -226,23 +369,24 @@ void QGraphicsRectObject::mouseMoveEvent(QGraphicsSceneMouseEvent* event)
     if(_resizing) {
         // resize the rect 
         if (scene()->sceneRect().contains(event->scenePos())) {
-            _resize_rect(event->pos()); 
-            prepareGeometryChange();
-            update();
+            _move_handle(event->pos()); 
         }
+        // notify resizing 
+        QPointF tl = mapToScene(_rect.topLeft());
+        QPointF br = mapToScene(_rect.bottomRight());
+        Q_EMIT rectChanged(QRectF(tl, br));
     }
     else {
-        // move the rect 
+        // move the rect, moving of all selected items is notified by itemChange() 
         QGraphicsObject::mouseMoveEvent(event);
     }
-    // notify both resizing and moving 
-    QPointF tl = mapToScene(_rect.topLeft());
-    QPointF br = mapToScene(_rect.bottomRight());
-    Q_EMIT rectChanged(QRectF(tl, br));
 }
 
 void QGraphicsRectObject::mouseReleaseEvent(QGraphicsSceneMouseEvent* event)
 {
+    if (_resizing) {
+        _fit_bound(_rect); 
+    }
     _clear_mode(); 
     QGraphicsObject::mouseReleaseEvent(event);
 }
@@ -258,10 +402,18 @@ QVariant QGraphicsRectObject::itemChange(GraphicsItemChange change, const QVaria
     //     return QGraphicsItem::itemChange(change, pt);
     // }
 
+    // moving of a large selection is notified once when dragging ends 
+    if(change == QGraphicsItem::ItemPositionHasChanged && !QGraphicsDragIndex::isDragging(scene())) {
+        QPointF tl = mapToScene(_rect.topLeft());
+        QPointF br = mapToScene(_rect.bottomRight());
+        Q_EMIT rectChanged(QRectF(tl, br));
+    }
+
     if(change == QGraphicsItem::ItemSelectedHasChanged) {
         // move to front when selected 
         bool selected = value.toBool();
         setZValue(selected ? 1 : 0);
+        Q_EMIT selectedChanged(selected); 
     }
     return QGraphicsItem::itemChange(change, value);
 }
@@ -1,13 +1,15 @@
 #pragma once
 
-#include <QGraphicsObject>
+#include "QGraphicsROIObject.h"
 #include <QGraphicsSceneHoverEvent>
 #include <QGraphicsSceneMouseEvent>
 #include <QPen>
+#include "QGraphicsROIShape.h"
+#include "QGraphicsROIMetrics.h"
 
 #define DEFAULT_HANDLE_SIZE 10
 
-class QGraphicsRectObject : public QGraphicsObject
+class QGraphicsRectObject : public QGraphicsROIObject
 {
     Q_OBJECT
 public:
@@ -38,9 +40,31 @@ public:
     void setHandleSize(int size);
     void setHandleColor(const QColor& color); 
 
+    QPen shapePen() const; 
+
+    // rect in scene coords 
+    QGraphicsROIShape roiShape() const; 
+    // area, perimeter, centroid and bound in scene coords 
+    QGraphicsROIMetrics metrics() const; 
+    // rect in scene coords, without notifying 
+    void setRect(const QRectF& rect); 
+
+    // identifier of the ROI, -1 by default 
+    void setRoiId(qint64 id); 
+    qint64 roiId() const; 
+
+    // transform rect in scene coords in place, without notifying 
+    void transformShape(const QTransform& transform); 
+
 signals:
     void rectChanged(const QRectF&);
 
+    // dragging with all selected items starts 
+    void dragStarted();
+
+    // item is selected or deselected 
+    void selectedChanged(bool);
+
 protected:
     QRectF boundingRect() const;
     void paint(QPainter*, const QStyleOptionGraphicsItem*, QWidget*);
@@ -59,6 +83,8 @@ protected:
 
     void _update_handles();
     void _resize_rect(const QPointF& pos); 
+    QVector<QRectF> _move_handle(const QPointF& pos); 
+    void _edges_damage(const QRectF& before, const QRectF& after, QVector<QRectF>& damage) const; 
     int _check_pos_in_handle(const QPointF& pos);
     bool _set_resizing_mode(const QPointF& pos); 
     void _set_dragging_mode(); 
@@ -67,6 +93,7 @@ protected:
 protected:
     // rect and handles 
     int _handle_size;
+    qint64 _roi_id; 
     QRectF _rect; 
     QVector<QRectF> _handles;
 
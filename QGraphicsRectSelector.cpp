@@ -1,11 +1,20 @@
 #include "QGraphicsRectSelector.h"
 #include "QGraphicsViewZoom.h"
+#include "QGraphicsRenderQuality.h"
 #include "QGraphicsRectObject.h"
 #include <QKeyEvent>
 #include <QDebug>
+#include <qmath.h>
+#include <algorithm>
+
+#define DEFAULT_MATCH_THRESHOLD 0.3
 
 QGraphicsRectSelector::QGraphicsRectSelector(QWidget *parent)
     : QGraphicsView(parent)
+    , _overlay(NULL)
+    , _clusters(NULL)
+    , _selecting_mode(false)
+    , _match_threshold(DEFAULT_MATCH_THRESHOLD)
 {
     setFrameShape(QFrame::NoFrame);
     setHorizontalScrollBarPolicy(Qt::ScrollBarAsNeeded);
@@ -15,30 +24,59 @@ QGraphicsRectSelector::QGraphicsRectSelector(QWidget *parent)
     QGraphicsViewZoom* zoom = new QGraphicsViewZoom(this);
     zoom->set_modifiers(Qt::NoModifier);
 
+    // fast rendering while panning and zooming 
+    QGraphicsRenderQuality* quality = new QGraphicsRenderQuality(this);
+    connect(zoom, &QGraphicsViewZoom::zoomStarted, 
+            quality, &QGraphicsRenderQuality::beginInteraction);
+    connect(zoom, &QGraphicsViewZoom::zoomFinished, 
+            quality, &QGraphicsRenderQuality::endInteraction);
+    connect(quality, &QGraphicsRenderQuality::qualityChanged, 
+            this, &QGraphicsRectSelector::onQualityChanged);
+
     // draw rectangle with built-in rubber band operation 
     connect(this, SIGNAL(rubberBandChanged(QRect,QPointF,QPointF)),
             this, SLOT(onRubberBandChanged(QRect,QPointF,QPointF)));
 
     setScene(&_scene);
-    connect(&_scene, &QGraphicsScene::selectionChanged, 
-            this, &QGraphicsRectSelector::onSelectionChanged);
+
+    // selection tracked by changes 
+    _selection = new QGraphicsROISelection(this);
+
+    // move large selections unindexed 
+    _drag_index = new QGraphicsDragIndex(this);
+    connect(_drag_index, &QGraphicsDragIndex::itemsMoved, 
+            this, &QGraphicsRectSelector::onItemsMoved);
+
+    // ROIs from worker threads 
+    _queue = new QGraphicsROIQueue(this);
+    connect(_queue, &QGraphicsROIQueue::recordsReady, 
+            this, &QGraphicsRectSelector::onRecordsReady);
 
     // default scene 
-    scene()->addPixmap(QPixmap::fromImage(QImage(1920, 1080, QImage::Format_RGB888)));
+    _background = new QGraphicsImageItem();
+    _background->setImageData(QGraphicsImageData(1920, 1080, QGraphicsImageData::GRAY8));
+    scene()->addItem(_background);
     scene()->setSceneRect(QRectF(0, 0, 1920, 1080));
 }
 
 QGraphicsRectSelector::~QGraphicsRectSelector()
 {
-
+    delete _overlay; 
+    delete _clusters; 
 }
 
 // add a rectangle item
-void QGraphicsRectSelector::addRectItem(const QRectF& rect)
+QGraphicsRectObject* QGraphicsRectSelector::addRectItem(const QRectF& rect)
 {
-    QGraphicsRectObject* item = new QGraphicsRectObject(rect);
-    connect(item, SIGNAL(rectChanged(const QRectF&)), this, SLOT(onRectChanged(const QRectF&)));
-    scene()->addItem(item); 
+    QGraphicsRectObject* item = _create_item(rect); 
+    if (_overlay) {
+        _overlay->setShape(item, item->roiShape(), item->shapePen()); 
+    }
+    if (_clusters) {
+        _clusters->setItem(item, item->roiShape().boundingRect()); 
+    }
+    _publish(item); 
+    return item; 
 }
 
 // enable drawing rectangle with mouse
@@ -53,25 +91,526 @@ void QGraphicsRectSelector::setDrawingMode(bool drawing)
     }
 }
 
+// select items intersecting the rubber band, by the index of the scene 
+void QGraphicsRectSelector::setSelectingMode(bool selecting)
+{
+    _selecting_mode = selecting;
+    if (_selecting_mode) {
+        setRubberBandSelectionMode(Qt::IntersectsItemBoundingRect);
+        setDragMode(QGraphicsView::RubberBandDrag);
+        viewport()->setCursor(Qt::ArrowCursor);
+    }
+    else {
+        setDragMode(QGraphicsView::ScrollHandDrag);
+    }
+}
+
+void QGraphicsRectSelector::moveSelected(const QPointF& offset)
+{
+    transformSelected(QTransform::fromTranslate(offset.x(), offset.y()));
+}
+
+// scale about the center of selected items 
+void QGraphicsRectSelector::scaleSelected(qreal factor)
+{
+    QRectF bound;
+    foreach (QGraphicsItem* item, _selection->items()) {
+        bound |= item->sceneBoundingRect();
+    }
+    QPointF center = bound.center();
+    QTransform transform;
+    transform.translate(center.x(), center.y());
+    transform.scale(factor, factor);
+    transform.translate(-center.x(), -center.y());
+    transformSelected(transform);
+}
+
+// geometry of items is transformed in place, without position changes and 
+// their notifications, and a large selection is transformed unindexed, 
+// the index is rebuilt once after a burst of key presses 
+void QGraphicsRectSelector::transformSelected(const QTransform& transform)
+{
+    if (_selection->count() == 0) {
+        return; 
+    }
+    QList<QGraphicsItem*> items = _selection->items().toList();
+    if (items.size() >= _drag_index->threshold()) {
+        _drag_index->suspend(); 
+    }
+    foreach (QGraphicsItem* item, items) {
+        QGraphicsRectObject* roi = qobject_cast<QGraphicsRectObject*>(item->toGraphicsObject()); 
+        if (roi) {
+            roi->transformShape(transform); 
+        }
+    }
+    onItemsMoved(items);
+}
+
+// deleted items are dropped from selection without notification 
+void QGraphicsRectSelector::deleteSelected()
+{
+    QList<QGraphicsItem*> items = _selection->items().toList();
+    foreach (QGraphicsItem* item, items) {
+        _remove_item(item); 
+    }
+}
+
+void QGraphicsRectSelector::_remove_item(QGraphicsItem* item)
+{
+    _drag_index->removeItem(item); 
+    if (_overlay) {
+        _overlay->removeShape(item); 
+    }
+    if (_clusters) {
+        _clusters->removeItem(item); 
+    }
+    if (_publisher) {
+        _publisher->publishRemove(item); 
+    }
+    delete item; 
+}
+
+void QGraphicsRectSelector::_publish(QGraphicsRectObject* item)
+{
+    if (_publisher) {
+        _publisher->publishShape(item, item->roiShape()); 
+    }
+}
+
+QGraphicsROIQueue* QGraphicsRectSelector::roiQueue() const
+{
+    return _queue; 
+}
+
+void QGraphicsRectSelector::setMatchThreshold(qreal iou)
+{
+    _match_threshold = iou; 
+}
+
+void QGraphicsRectSelector::setBackgroundImage(const QImage& image)
+{
+    setBackgroundData(QGraphicsImageData::fromImage(image));
+}
+
+void QGraphicsRectSelector::setBackgroundData(const QGraphicsImageData& data)
+{
+    _background->setImageData(data);
+    _background->setPos(0, 0);
+    scene()->setSceneRect(QRectF(data.rect()));
+}
+
+void QGraphicsRectSelector::setBackgroundFrame(const QGraphicsImageData& frame)
+{
+    if (frame.rect() != _background->imageData().rect()) {
+        scene()->setSceneRect(QRectF(frame.rect()));
+    }
+    _background->setFrame(frame);
+}
+
+void QGraphicsRectSelector::setBackgroundWindow(double low, double high)
+{
+    _background->setWindow(low, high);
+}
+
+void QGraphicsRectSelector::setBackgroundColormap(QGraphicsImageData::COLORMAP colormap)
+{
+    _background->setColormap(QGraphicsImageData::colormap(colormap));
+}
+
+static qreal _iou(const QRectF& a, const QRectF& b)
+{
+    QRectF overlap = a & b; 
+    qreal area = overlap.width() * overlap.height(); 
+    qreal total = a.width() * a.height() + b.width() * b.height() - area; 
+    return total > 0 ? area / total : 0; 
+}
+
+static quint64 _cell_key(int cx, int cy)
+{
+    return (quint64(quint32(cx)) << 32) | quint32(cy);
+}
+
+struct IoUMatch
+{
+    qreal iou; 
+    int detection; 
+    QGraphicsRectObject* item; 
+    bool operator<(const IoUMatch& other) const { return iou > other.iou; }
+};
+
+// detections are matched to items of previous frame without reallocation, 
+// and geometry is updated without notifications 
+void QGraphicsRectSelector::setFrameDetections(const QVector<Detection>& detections)
+{
+    QSet<QGraphicsRectObject*> previous; 
+    for (int i = 0; i < _frame_items.size(); i++) {
+        if (_frame_items[i]) {
+            previous.insert(_frame_items[i]); 
+        }
+    }
+    // tracked detections by id 
+    QVector<QGraphicsRectObject*> matched(detections.size(), NULL); 
+    for (int i = 0; i < detections.size(); i++) {
+        if (detections[i].id >= 0) {
+            QGraphicsRectObject* item = _detection_items.value(detections[i].id); 
+            if (item && previous.remove(item)) {
+                matched[i] = item; 
+            }
+        }
+    }
+    // others by overlap 
+    _match_by_iou(detections, previous, matched); 
+
+    QList<QGraphicsItem*> changed; 
+    _frame_items.resize(detections.size()); 
+    for (int i = 0; i < detections.size(); i++) {
+        QGraphicsRectObject* item = matched[i]; 
+        if (item) {
+            previous.remove(item); 
+            item->setRect(detections[i].box); 
+        }
+        else {
+            item = _take_pooled_item(detections[i].box); 
+        }
+        qint64 id = detections[i].id; 
+        if (item->roiId() != id) {
+            if (_detection_items.value(item->roiId()) == item) {
+                _detection_items.remove(item->roiId()); 
+            }
+            item->setRoiId(id); 
+            if (id >= 0) {
+                _detection_items.insert(id, item); 
+            }
+        }
+        _frame_items[i] = item; 
+        changed.append(item); 
+    }
+    foreach (QGraphicsRectObject* item, previous) {
+        _pool_item(item); 
+    }
+    _trim_pool(detections.size()); 
+    _update_shapes(changed); 
+    if (_publisher) {
+        _publisher->publishCommit(); 
+    }
+}
+
+// greedy matching of best IoU first, candidates found in a grid of boxes 
+void QGraphicsRectSelector::_match_by_iou(const QVector<Detection>& detections, 
+                                          const QSet<QGraphicsRectObject*>& candidates, 
+                                          QVector<QGraphicsRectObject*>& matched) const
+{
+    if (candidates.isEmpty()) {
+        return; 
+    }
+    QHash<QGraphicsRectObject*, QRectF> boxes; 
+    qreal size = 0; 
+    foreach (QGraphicsRectObject* item, candidates) {
+        QRectF box = item->roiShape().rect; 
+        boxes.insert(item, box); 
+        size += qMax(box.width(), box.height()); 
+    }
+    qreal cell = qMax(qreal(1), size / candidates.size()); 
+    QHash<quint64, QVector<QGraphicsRectObject*> > grid; 
+    QHash<QGraphicsRectObject*, QRectF>::const_iterator it; 
+    for (it = boxes.constBegin(); it != boxes.constEnd(); ++it) {
+        const QRectF& box = it.value(); 
+        for (int cy = qFloor(box.top() / cell); cy <= qFloor(box.bottom() / cell); cy++) {
+            for (int cx = qFloor(box.left() / cell); cx <= qFloor(box.right() / cell); cx++) {
+                grid[_cell_key(cx, cy)].append(it.key()); 
+            }
+        }
+    }
+    QVector<IoUMatch> matches; 
+    for (int i = 0; i < detections.size(); i++) {
+        if (matched[i]) {
+            continue; 
+        }
+        const QRectF& box = detections[i].box; 
+        QSet<QGraphicsRectObject*> tested; 
+        for (int cy = qFloor(box.top() / cell); cy <= qFloor(box.bottom() / cell); cy++) {
+            for (int cx = qFloor(box.left() / cell); cx <= qFloor(box.right() / cell); cx++) {
+                foreach (QGraphicsRectObject* item, grid.value(_cell_key(cx, cy))) {
+                    if (tested.contains(item)) {
+                        continue; 
+                    }
+                    tested.insert(item); 
+                    qreal iou = _iou(box, boxes.value(item)); 
+                    if (iou >= _match_threshold) {
+                        IoUMatch match = { iou, i, item }; 
+                        matches.append(match); 
+                    }
+                }
+            }
+        }
+    }
+    std::sort(matches.begin(), matches.end()); 
+    QSet<QGraphicsRectObject*> used; 
+    for (int i = 0; i < matches.size(); i++) {
+        const IoUMatch& match = matches[i]; 
+        if (!matched[match.detection] && !used.contains(match.item)) {
+            matched[match.detection] = match.item; 
+            used.insert(match.item); 
+        }
+    }
+}
+
+// item in the scene, not yet in tiles, clusters or published 
+QGraphicsRectObject* QGraphicsRectSelector::_create_item(const QRectF& rect)
+{
+    QGraphicsRectObject* item = new QGraphicsRectObject(rect);
+    connect(item, SIGNAL(rectChanged(const QRectF&)), this, SLOT(onRectChanged(const QRectF&)));
+    connect(item, SIGNAL(dragStarted()), this, SLOT(onDragStarted()));
+    _selection->addItem(item); 
+    scene()->addItem(item); 
+    return item; 
+}
+
+// reuse a hidden item, or create one when the pool is empty, registered 
+// and published with the other items of the frame 
+QGraphicsRectObject* QGraphicsRectSelector::_take_pooled_item(const QRectF& rect)
+{
+    while (!_pool.isEmpty()) {
+        QGraphicsRectObject* item = _pool.takeLast(); 
+        if (item) {
+            item->setRect(rect); 
+            item->show(); 
+            return item; 
+        }
+    }
+    return _create_item(rect); 
+}
+
+// hidden items are out of tiles, clusters and a drag, but kept in the scene 
+void QGraphicsRectSelector::_pool_item(QGraphicsRectObject* item)
+{
+    _drag_index->removeItem(item); 
+    item->setSelected(false); 
+    item->hide(); 
+    if (_detection_items.value(item->roiId()) == item) {
+        _detection_items.remove(item->roiId()); 
+    }
+    item->setRoiId(-1); 
+    if (_overlay) {
+        _overlay->removeShape(item); 
+    }
+    if (_clusters) {
+        _clusters->removeItem(item); 
+    }
+    if (_publisher) {
+        _publisher->publishRemove(item); 
+    }
+    _pool.append(item); 
+}
+
+// pooled items are out of everything but the scene and a drag started 
+// before they were pooled, and simply deleted 
+void QGraphicsRectSelector::_trim_pool(int size)
+{
+    while (_pool.size() > size) {
+        QGraphicsRectObject* item = _pool.takeFirst().data(); 
+        _drag_index->removeItem(item); 
+        delete item; 
+    }
+}
+
+// visible ROIs of the scene 
+QList<QGraphicsItem*> QGraphicsRectSelector::_roi_list() const
+{
+    QList<QGraphicsItem*> items; 
+    foreach (QGraphicsItem* item, _scene.items()) {
+        if (item->isVisible() && qobject_cast<QGraphicsRectObject*>(item->toGraphicsObject())) {
+            items.append(item); 
+        }
+    }
+    return items; 
+}
+
+QVector<QGraphicsROIOverlap::Pair> QGraphicsRectSelector::findOverlaps(QList<QGraphicsItem*>& items, qreal tolerance)
+{
+    items = _roi_list(); 
+    QVector<QGraphicsROIShape> shapes; 
+    shapes.reserve(items.size()); 
+    foreach (QGraphicsItem* item, items) {
+        shapes.append(static_cast<QGraphicsRectObject*>(item->toGraphicsObject())->roiShape()); 
+    }
+    QGraphicsROIOverlap overlap(shapes, tolerance); 
+    return overlap.pairs(); 
+}
+
+void QGraphicsRectSelector::selectOverlapping(qreal iou_threshold)
+{
+    QList<QGraphicsItem*> items; 
+    QVector<QGraphicsROIOverlap::Pair> pairs = findOverlaps(items); 
+    _scene.clearSelection(); 
+    foreach (const QGraphicsROIOverlap::Pair& pair, pairs) {
+        if (pair.iou > iou_threshold) {
+            items[pair.first]->setSelected(true); 
+            items[pair.second]->setSelected(true); 
+        }
+    }
+}
+
+int QGraphicsRectSelector::removeDuplicates(qreal iou_threshold)
+{
+    QList<QGraphicsItem*> items = _roi_list(); 
+    QVector<QGraphicsROIShape> shapes; 
+    shapes.reserve(items.size()); 
+    foreach (QGraphicsItem* item, items) {
+        shapes.append(static_cast<QGraphicsRectObject*>(item->toGraphicsObject())->roiShape()); 
+    }
+    QGraphicsROIOverlap overlap(shapes); 
+    int removed = 0; 
+    foreach (const QVector<int>& group, overlap.duplicates(iou_threshold)) {
+        int largest = group.first(); 
+        foreach (int i, group) {
+            if (overlap.area(i) > overlap.area(largest)) {
+                largest = i; 
+            }
+        }
+        foreach (int i, group) {
+            if (i != largest) {
+                _remove_item(items[i]); 
+                removed++; 
+            }
+        }
+    }
+    return removed; 
+}
+
+// render static ROIs into cached tiles on worker threads 
+void QGraphicsRectSelector::setOverlayTiles(bool enabled)
+{
+    if (enabled == (_overlay != NULL)) {
+        return; 
+    }
+    if (enabled) {
+        _overlay = new QGraphicsOverlayTiles(this); 
+        _overlay->setSelection(_selection); 
+        foreach (QGraphicsItem* item, _roi_list()) {
+            QGraphicsRectObject* roi = qobject_cast<QGraphicsRectObject*>(item->toGraphicsObject()); 
+            if (roi) {
+                _overlay->setShape(roi, roi->roiShape(), roi->shapePen()); 
+            }
+        }
+    }
+    else {
+        delete _overlay; 
+        _overlay = NULL; 
+    }
+    viewport()->update(); 
+}
+
+// visible rectangles in the scene published as added 
+void QGraphicsRectSelector::setPublisher(QGraphicsROIPublisher* publisher)
+{
+    _publisher = publisher; 
+    foreach (QGraphicsItem* item, _roi_list()) {
+        QGraphicsRectObject* roi = qobject_cast<QGraphicsRectObject*>(item->toGraphicsObject()); 
+        if (roi) {
+            _publish(roi); 
+        }
+    }
+    if (_publisher) {
+        _publisher->publishCommit(); 
+    }
+}
+
+// draw small ROIs as clusters below full detail zoom 
+void QGraphicsRectSelector::setLevelOfDetail(bool enabled)
+{
+    if (enabled == (_clusters != NULL)) {
+        return; 
+    }
+    if (enabled) {
+        _clusters = new QGraphicsROIClusters(this); 
+        foreach (QGraphicsItem* item, _roi_list()) {
+            QGraphicsRectObject* roi = qobject_cast<QGraphicsRectObject*>(item->toGraphicsObject()); 
+            if (roi) {
+                _clusters->setItem(roi, roi->roiShape().boundingRect()); 
+            }
+        }
+    }
+    else {
+        delete _clusters; 
+        _clusters = NULL; 
+    }
+    viewport()->update(); 
+}
+
+void QGraphicsRectSelector::drawForeground(QPainter* painter, const QRectF& rect)
+{
+    if (_clusters) {
+        _clusters->paint(painter, rect); 
+    }
+}
+
 void QGraphicsRectSelector::keyPressEvent(QKeyEvent *event)
 {
-    if (event->key() == Qt::Key_Shift) {
+    // plus is shifted on most layouts, and its Shift, pressed first, has 
+    // entered drawing mode, so leave it. equal is the same key unshifted 
+    if (event->key() == Qt::Key_Plus || event->key() == Qt::Key_Equal) {
+        if (event->modifiers() & Qt::ShiftModifier) {
+            setDrawingMode(false);
+        }
+        scaleSelected(1.1);
+    }
+    else if (event->key() == Qt::Key_Shift) {
         setDrawingMode(true);
     }
+    else if (event->key() == Qt::Key_Control) {
+        setSelectingMode(true);
+    }
     else if (event->key() == Qt::Key_Escape) {
         setDrawingMode(false);
+        setSelectingMode(false);
+    }
+    else if (event->key() == Qt::Key_Delete) {
+        deleteSelected();
+    }
+    else if (event->key() == Qt::Key_Left) {
+        moveSelected(QPointF(-1, 0));
+    }
+    else if (event->key() == Qt::Key_Right) {
+        moveSelected(QPointF(1, 0));
+    }
+    else if (event->key() == Qt::Key_Up) {
+        moveSelected(QPointF(0, -1));
+    }
+    else if (event->key() == Qt::Key_Down) {
+        moveSelected(QPointF(0, 1));
+    }
+    else if (event->key() == Qt::Key_Minus) {
+        scaleSelected(1 / 1.1);
+    }
+    if (_publisher) {
+        _publisher->publishCommit(); 
     }
     QWidget::keyPressEvent(event);
 }
 
+void QGraphicsRectSelector::mouseReleaseEvent(QMouseEvent* event)
+{
+    QGraphicsView::mouseReleaseEvent(event);
+    if (_publisher) {
+        _publisher->publishCommit(); 
+    }
+}
+
 // drag and draw a rectangle
 void QGraphicsRectSelector::onRubberBandChanged(QRect rubberBandRect, 
                         QPointF fromScenePoint, QPointF toScenePoint)
 {
     static QRectF rect;
     if (rubberBandRect.isEmpty()) { // complete rubber rect
-        addRectItem(rect);
-        setDrawingMode(false);
+        if (_selecting_mode) {
+            // items are selected by the view 
+            setSelectingMode(false);
+        }
+        else {
+            addRectItem(rect);
+            setDrawingMode(false);
+        }
     }
     else {
         rect.setTopLeft(fromScenePoint);
@@ -85,21 +624,92 @@ void QGraphicsRectSelector::onRubberBandChanged(QRect rubberBandRect,
 // on rectangle moving and resizing 
 void QGraphicsRectSelector::onRectChanged(const QRectF& rect)
 {
+    QGraphicsRectObject* item = qobject_cast<QGraphicsRectObject*>(sender()); 
+    if (_overlay && item) {
+        _overlay->setShape(item, item->roiShape(), item->shapePen()); 
+    }
+    if (_clusters && item) {
+        _clusters->setItem(item, item->roiShape().boundingRect()); 
+    }
+    if (item) {
+        _publish(item); 
+        Q_EMIT metricsChanged(item, item->metrics()); 
+    }
     setDrawingMode(false);
 }
 
-// on selection of the rectangles 
-void QGraphicsRectSelector::onSelectionChanged()
+// dragging with all selected items 
+void QGraphicsRectSelector::onDragStarted()
+{
+    _drag_index->begin(qobject_cast<QGraphicsRectObject*>(sender())); 
+}
+
+// moving of a large selection, or group edit, notified once 
+void QGraphicsRectSelector::onItemsMoved(const QList<QGraphicsItem*>& items)
 {
-    QList<QGraphicsItem*> selections = _scene.selectedItems();
-    if (selections.empty()) {
-        //qDebug() << "No selected item";
+    _update_shapes(items);
+    setDrawingMode(false);
+}
+
+void QGraphicsRectSelector::_update_shapes(const QList<QGraphicsItem*>& items)
+{
+    foreach (QGraphicsItem* it, items) {
+        QGraphicsRectObject* item = qobject_cast<QGraphicsRectObject*>(it->toGraphicsObject()); 
+        if (_overlay && item) {
+            _overlay->setShape(item, item->roiShape(), item->shapePen()); 
+        }
+        if (_clusters && item) {
+            _clusters->setItem(item, item->roiShape().boundingRect()); 
+        }
+        if (item) {
+            _publish(item); 
+            Q_EMIT metricsChanged(item, item->metrics()); 
+        }
     }
-    else if (selections.size() == 1) {
-        // one item is selected
-        QGraphicsItem* item = selections[0];
+}
+
+// ROIs from worker threads, applied as one batch within the budget of the 
+// frame of the queue, the rest in next frames, without interrupting drawing. 
+// added and changed items are indexed by the scene in one pass at next query 
+void QGraphicsRectSelector::onRecordsReady()
+{
+    QSet<QGraphicsItem*> changed;
+    QGraphicsROIQueue::Record record;
+    while (_queue->take(record)) {
+        QGraphicsRectObject* item = _roi_items.value(record.id);
+        switch (record.type) {
+        case QGraphicsROIQueue::ADD_ROI:
+        case QGraphicsROIQueue::UPDATE_ROI:
+            if (item) {
+                item->setRect(record.shape.boundingRect());
+                changed.insert(item);
+            }
+            else {
+                item = addRectItem(record.shape.boundingRect());
+                item->setRoiId(record.id);
+                _roi_items.insert(record.id, item);
+            }
+            break;
+        case QGraphicsROIQueue::REMOVE_ROI:
+            if (item) {
+                changed.remove(item);
+                _remove_item(item);
+            }
+            _roi_items.remove(record.id);
+            break;
+        default:
+            break;
+        }
     }
-    else {
-        //qDebug() << "Number of selected items is greater than 1";
+    _update_shapes(changed.toList());
+    if (_publisher) {
+        _publisher->publishCommit(); 
     }
 }
+
+// nearest neighbour background on fast path 
+void QGraphicsRectSelector::onQualityChanged(int fast_path)
+{
+    bool nearest = fast_path & QGraphicsRenderQuality::NEAREST_BACKGROUND;
+    _background->setSmooth(!nearest);
+}
@@ -2,6 +2,16 @@
 
 #include <QGraphicsView>
 #include <QGraphicsScene>
+#include <QPointer>
+#include "QGraphicsOverlayTiles.h"
+#include "QGraphicsROIClusters.h"
+#include "QGraphicsDragIndex.h"
+#include "QGraphicsROISelection.h"
+#include "QGraphicsROIQueue.h"
+#include "QGraphicsROIOverlap.h"
+#include "QGraphicsRectObject.h"
+#include "QGraphicsImageItem.h"
+#include "QGraphicsROIPublisher.h"
 
 /*!
  * This class show a graphics view that supports ROI selection with rectangle.
@@ -9,6 +19,9 @@
  * mouse key and move in the view. The rectangle ROI will be added when the mouse 
  * key is released. Press "esc" key to cancel the rectangle drawing. 
  * User may click on a rectangle to move and resize the ROI.   
+ * When the "ctrl" key is pressed, user may select ROIs in an area with rubber 
+ * band. Selected ROIs are moved with arrow keys, scaled with "+" and "-" keys 
+ * and deleted with "delete" key, as a group. 
  * The view needs to get focus, by setFocus(), to capture the key press. 
  */
 class QGraphicsRectSelector : public QGraphicsView
@@ -18,26 +31,126 @@ public:
     QGraphicsRectSelector(QWidget *parent = 0);
     ~QGraphicsRectSelector();
 
+    // box of a detection in scene coords, id is -1 when not tracked 
+    struct Detection
+    {
+        Detection() : id(-1) {}
+        qint64 id;
+        QRectF box;
+    };
+
+    // queue of ROIs from worker threads, drained on GUI thread once per frame 
+    QGraphicsROIQueue* roiQueue() const;
+
+    // overlapping pairs of visible ROIs, indices into the list of ROIs given 
+    QVector<QGraphicsROIOverlap::Pair> findOverlaps(QList<QGraphicsItem*>& items, qreal tolerance = 0.5);
+
+    // keep the largest ROI of each group of duplicates, return number of ROIs removed 
+    int removeDuplicates(qreal iou_threshold);
+
+    // minimal IoU to match a detection without id to an item of previous frame 
+    void setMatchThreshold(qreal iou);
+
+    // image shown below ROIs, pixel (x, y) at scene (x, y) 
+    void setBackgroundImage(const QImage& image);
+
+    // image kept at native depth, 16 bit or float, shown through a window and colormap 
+    void setBackgroundData(const QGraphicsImageData& data);
+    // frames of a camera, converted only where visible 
+    void setBackgroundFrame(const QGraphicsImageData& frame);
+    void setBackgroundWindow(double low, double high);
+    void setBackgroundColormap(QGraphicsImageData::COLORMAP colormap);
+
 public slots:
     // add a rectangle
-    void addRectItem(const QRectF& rect);
+    QGraphicsRectObject* addRectItem(const QRectF& rect);
 
     // enable rectangle drawing with mouse 
     void setDrawingMode(bool drawing);
 
+    // enable area selection with rubber band 
+    void setSelectingMode(bool selecting);
+
+    // edit all selected items as a group, with one repaint and notification 
+    void moveSelected(const QPointF& offset);
+    void scaleSelected(qreal factor);
+    void transformSelected(const QTransform& transform);
+    void deleteSelected();
+
+    // select ROIs overlapping another one with IoU over threshold 
+    void selectOverlapping(qreal iou_threshold);
+
+    // replace detections of previous frame, items are matched by id, or by IoU 
+    // without id, and updated in place, unused items are hidden in a pool of 
+    // at most the number of detections of the frame, ids are apart from the 
+    // ids of queue records 
+    void setFrameDetections(const QVector<QGraphicsRectSelector::Detection>& detections);
+
+    // render static ROIs into cached tiles on worker threads 
+    void setOverlayTiles(bool enabled);
+
+    // draw small ROIs as clusters below full detail zoom 
+    void setLevelOfDetail(bool enabled);
+
+    // stream changes of rectangle ROIs to other processes, committed on mouse 
+    // release, key press and frame detections, current ROIs published first 
+    void setPublisher(QGraphicsROIPublisher* publisher);
+
+signals:
+    // measurements of a ROI changed by an edit, or moved with a group 
+    void metricsChanged(QGraphicsItem* item, const QGraphicsROIMetrics& metrics);
+
+protected:
+    // composite clusters, overlay tiles are an item of the scene 
+    void drawForeground(QPainter* painter, const QRectF& rect);
+
 private slots:
     // press "shift" key to draw rectangle 
     void keyPressEvent(QKeyEvent *event);
 
+    // end of a drag or resize of rectangles 
+    void mouseReleaseEvent(QMouseEvent*);
+
     // on rubber band operation 
     void onRubberBandChanged(QRect rubberBandRect, QPointF fromScenePoint, QPointF toScenePoint);
 
     // on resrectangle moving and resizing 
     void onRectChanged(const QRectF&);
 
-    // on selection of the rectangles 
-    void onSelectionChanged();
+    // render background with lower fidelity on fast path
+    void onQualityChanged(int fast_path);
+
+    // on dragging of a large selection, and group edits 
+    void onDragStarted();
+    void onItemsMoved(const QList<QGraphicsItem*>& items);
+
+    // on ROIs from worker threads 
+    void onRecordsReady();
 
 private:
     QGraphicsScene _scene;
+    QGraphicsImageItem* _background;
+    QGraphicsOverlayTiles* _overlay;
+    QGraphicsROIClusters* _clusters;
+    QPointer<QGraphicsROIPublisher> _publisher;
+    QGraphicsDragIndex* _drag_index;
+    QGraphicsROISelection* _selection;
+    bool _selecting_mode;
+    QGraphicsROIQueue* _queue;
+    QHash<qint64, QPointer<QGraphicsRectObject> > _roi_items; // of queue records 
+    QHash<qint64, QPointer<QGraphicsRectObject> > _detection_items; // of frame detections 
+    QVector<QPointer<QGraphicsRectObject> > _frame_items;
+    QVector<QPointer<QGraphicsRectObject> > _pool;
+    qreal _match_threshold;
+
+    void _update_shapes(const QList<QGraphicsItem*>& items);
+    void _remove_item(QGraphicsItem* item);
+    void _publish(QGraphicsRectObject* item);
+    QList<QGraphicsItem*> _roi_list() const;
+    void _match_by_iou(const QVector<Detection>& detections, const QSet<QGraphicsRectObject*>& candidates, 
+                       QVector<QGraphicsRectObject*>& matched) const;
+    QGraphicsRectObject* _create_item(const QRectF& rect);
+    QGraphicsRectObject* _take_pooled_item(const QRectF& rect);
+    void _pool_item(QGraphicsRectObject* item);
+    void _trim_pool(int size);
 };
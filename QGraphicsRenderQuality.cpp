@@ -0,0 +1,115 @@
+#include "QGraphicsRenderQuality.h"
+#include <QScrollBar>
+
+#define FAST_PATH_PROPERTY "fast_path"
+#define DEFAULT_IDLE_DELAY 150
+
+QGraphicsRenderQuality::QGraphicsRenderQuality(QGraphicsView* view)
+    : QObject(view)
+    , _view(view)
+    , _fast_path(ALL_FAST_PATHS)
+    , _active_fast_path(0)
+    , _interactions(0)
+    , _saved_antialiasing(false)
+{
+    // panning in any way moves the scroll bars
+    connect(_view->horizontalScrollBar(), SIGNAL(valueChanged(int)), this, SLOT(onScrolled()));
+    connect(_view->verticalScrollBar(), SIGNAL(valueChanged(int)), this, SLOT(onScrolled()));
+
+    _idle_timer.setSingleShot(true);
+    _idle_timer.setInterval(DEFAULT_IDLE_DELAY);
+    connect(&_idle_timer, SIGNAL(timeout()), this, SLOT(onIdle()));
+}
+
+QGraphicsRenderQuality::~QGraphicsRenderQuality()
+{
+
+}
+
+void QGraphicsRenderQuality::setFastPath(int flags)
+{
+    _fast_path = flags;
+    if (_active_fast_path) {
+        _set_active(_fast_path);
+    }
+}
+
+int QGraphicsRenderQuality::fastPath() const
+{
+    return _fast_path;
+}
+
+void QGraphicsRenderQuality::setIdleDelay(int msec)
+{
+    _idle_timer.setInterval(msec);
+}
+
+int QGraphicsRenderQuality::idleDelay() const
+{
+    return _idle_timer.interval();
+}
+
+int QGraphicsRenderQuality::activeFastPath() const
+{
+    return _active_fast_path;
+}
+
+// flags are kept on the scene, so items need no pointer to this object
+int QGraphicsRenderQuality::activeFastPath(const QGraphicsScene* scene)
+{
+    return scene ? scene->property(FAST_PATH_PROPERTY).toInt() : 0;
+}
+
+void QGraphicsRenderQuality::beginInteraction()
+{
+    _interactions++;
+    _idle_timer.stop();
+    _set_active(_fast_path);
+}
+
+void QGraphicsRenderQuality::endInteraction()
+{
+    if (_interactions > 0) {
+        _interactions--;
+    }
+    if (_interactions == 0) {
+        _idle_timer.start();
+    }
+}
+
+void QGraphicsRenderQuality::onScrolled()
+{
+    _set_active(_fast_path);
+    if (_interactions == 0) {
+        _idle_timer.start();
+    }
+}
+
+void QGraphicsRenderQuality::onIdle()
+{
+    _set_active(0);
+}
+
+void QGraphicsRenderQuality::_set_active(int flags)
+{
+    if (flags == _active_fast_path) {
+        return;
+    }
+    // hint of the view saved when the fast path turns it off, and restored
+    // when it ends, so the view keeps its own hints at full quality
+    bool was_off = _active_fast_path & NO_ANTIALIASING;
+    bool off = flags & NO_ANTIALIASING;
+    if (off && !was_off) {
+        _saved_antialiasing = _view->renderHints() & QPainter::Antialiasing;
+        _view->setRenderHint(QPainter::Antialiasing, false);
+    }
+    else if (!off && was_off) {
+        _view->setRenderHint(QPainter::Antialiasing, _saved_antialiasing);
+    }
+    _active_fast_path = flags;
+    if (_view->scene()) {
+        _view->scene()->setProperty(FAST_PATH_PROPERTY, flags);
+    }
+    Q_EMIT qualityChanged(flags);
+    _view->viewport()->update();
+}
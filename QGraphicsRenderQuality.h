@@ -0,0 +1,80 @@
+#pragma once
+
+#include <QObject>
+#include <QGraphicsView>
+#include <QGraphicsScene>
+#include <QTimer>
+
+/*!
+ * This class switches a graphics view to a fast rendering path while the user
+ * is panning or zooming, and back to full quality after a short idle period.
+ *
+ * Panning is detected from scroll bar changes, so ScrollHandDrag, keyboard and
+ * wheel scrolling are all covered. Zooming is reported with beginInteraction()
+ * and endInteraction(), e.g. connected to zoomStarted() and zoomFinished() of
+ * QGraphicsViewZoom.
+ *
+ * The fast path is a combination of FAST_PATH flags, set by setFastPath().
+ * Antialiasing of the view is turned off for the fast path and set back as it
+ * was after, the hints of the view are not changed otherwise. Items read the
+ * active flags of their scene with activeFastPath(scene()) in paint(), and the
+ * owner of the background follows qualityChanged() signal.
+ *
+ * Usage:
+ *
+ *   QGraphicsRenderQuality* quality = new QGraphicsRenderQuality(view);
+ *   connect(zoom, SIGNAL(zoomStarted()), quality, SLOT(beginInteraction()));
+ *   connect(zoom, SIGNAL(zoomFinished()), quality, SLOT(endInteraction()));
+ *
+ * The object will be deleted automatically when the view is deleted.
+ */
+class QGraphicsRenderQuality : public QObject
+{
+    Q_OBJECT
+public:
+    enum FAST_PATH
+    {
+        NO_ANTIALIASING = 0x1,
+        NO_HANDLES = 0x2,
+        SIMPLIFIED_OUTLINES = 0x4,
+        NEAREST_BACKGROUND = 0x8,
+        ALL_FAST_PATHS = 0xf,
+    };
+
+    QGraphicsRenderQuality(QGraphicsView* view);
+    ~QGraphicsRenderQuality();
+
+    // fast path policy, 0 to always render at full quality
+    void setFastPath(int flags);
+    int fastPath() const;
+
+    // idle period before re-rendering at full quality
+    void setIdleDelay(int msec);
+    int idleDelay() const;
+
+    // currently active flags, 0 when rendering at full quality
+    int activeFastPath() const;
+    static int activeFastPath(const QGraphicsScene* scene);
+
+public slots:
+    // interaction not visible from scroll bars, e.g. zoom animation
+    void beginInteraction();
+    void endInteraction();
+
+signals:
+    void qualityChanged(int active_flags);
+
+private slots:
+    void onScrolled();
+    void onIdle();
+
+private:
+    QGraphicsView* _view;
+    int _fast_path;
+    int _active_fast_path;
+    int _interactions;
+    bool _saved_antialiasing; // hint of the view before the fast path
+    QTimer _idle_timer;
+
+    void _set_active(int flags);
+};
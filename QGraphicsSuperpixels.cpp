@@ -0,0 +1,342 @@
+#include "QGraphicsSuperpixels.h"
+#include <QtConcurrent>
+
+#define SUPERPIXEL_TILE_SIZE 256
+#define SUPERPIXEL_ITERATIONS 5
+#define SUPERPIXEL_CACHE_IMAGES 4
+
+QGraphicsSuperpixels::QGraphicsSuperpixels(QObject* parent)
+    : QObject(parent)
+    , _region_size(32)
+    , _compactness(20)
+    , _image_key(0)
+    , _pending(false)
+{
+    _watcher = new QFutureWatcher<Segmentation>(this);
+    connect(_watcher, SIGNAL(finished()), this, SLOT(onFinished()));
+}
+
+QGraphicsSuperpixels::~QGraphicsSuperpixels()
+{
+    _watcher->waitForFinished();
+}
+
+void QGraphicsSuperpixels::setRegionSize(int size)
+{
+    _region_size = qMax(2, size);
+    _cache.clear();
+    _cache_order.clear();
+    _request();
+}
+
+void QGraphicsSuperpixels::setCompactness(qreal compactness)
+{
+    _compactness = compactness;
+    _cache.clear();
+    _cache_order.clear();
+    _request();
+}
+
+// keyed by the image given, as a converted copy has a key of its own
+void QGraphicsSuperpixels::setImage(const QImage& image)
+{
+    _image_key = image.cacheKey();
+    if (image.format() == QImage::Format_RGB32 || image.format() == QImage::Format_ARGB32) {
+        _image = image;
+    }
+    else {
+        _image = image.convertToFormat(QImage::Format_RGB32);
+    }
+    _request();
+}
+
+bool QGraphicsSuperpixels::isReady() const
+{
+    return !_current.labels.isEmpty();
+}
+
+int QGraphicsSuperpixels::label(const QPoint& pos) const
+{
+    if (pos.x() < 0 || pos.y() < 0 || pos.x() >= _current.width || pos.y() >= _current.height) {
+        return -1;
+    }
+    return _current.labels[pos.y() * _current.width + pos.x()];
+}
+
+int QGraphicsSuperpixels::labelCount() const
+{
+    return _current.bounds.size();
+}
+
+QRect QGraphicsSuperpixels::labelRect(int label) const
+{
+    return _current.bounds.value(label);
+}
+
+// bytes of the bound of superpixels, 0 where selected, thresholded into runs
+QGraphicsRLEMask QGraphicsSuperpixels::region(const QSet<int>& labels) const
+{
+    QRect bound;
+    foreach (int label, labels) {
+        bound |= labelRect(label);
+    }
+    if (bound.isEmpty()) {
+        return QGraphicsRLEMask();
+    }
+    int single = labels.size() == 1 ? *labels.begin() : -1;
+    QVector<uchar> bytes(bound.width() * bound.height());
+    for (int y = 0; y < bound.height(); y++) {
+        const int* row = _current.labels.constData() + (bound.top() + y) * _current.width + bound.left();
+        uchar* out = bytes.data() + y * bound.width();
+        for (int x = 0; x < bound.width(); x++) {
+            bool inside = single >= 0 ? row[x] == single : labels.contains(row[x]);
+            out[x] = inside ? 0 : 1;
+        }
+    }
+    return QGraphicsRLEMask::threshold(bytes.constData(), bound.width(), bound.height(), bound.width(), 0)
+               .translated(bound.topLeft());
+}
+
+void QGraphicsSuperpixels::_request()
+{
+    if (_image.isNull()) {
+        return;
+    }
+    if (_cache.contains(_image_key)) {
+        _current = _cache.value(_image_key);
+        Q_EMIT segmentationReady();
+        return;
+    }
+    _current = Segmentation();
+    if (_watcher->isRunning()) {
+        _pending = true;
+    }
+    else {
+        _start();
+    }
+}
+
+void QGraphicsSuperpixels::_start()
+{
+    _pending = false;
+    _watcher->setFuture(QtConcurrent::run(&QGraphicsSuperpixels::_segment, _image, _image_key,
+                                          _region_size, _compactness));
+}
+
+// a segmentation of another image is cached, the image set since segmented,
+// and one of previous parameters dropped
+void QGraphicsSuperpixels::onFinished()
+{
+    Segmentation segmentation = _watcher->result();
+    if (segmentation.region_size != _region_size || segmentation.compactness != _compactness) {
+        _pending = false;
+        _request();
+        return;
+    }
+    _store(segmentation);
+    if (_pending) {
+        _start();
+        return;
+    }
+    if (segmentation.image_key == _image_key) {
+        _current = segmentation;
+        Q_EMIT segmentationReady();
+    }
+}
+
+void QGraphicsSuperpixels::_store(const Segmentation& segmentation)
+{
+    if (!_cache.contains(segmentation.image_key)) {
+        _cache_order.append(segmentation.image_key);
+    }
+    _cache.insert(segmentation.image_key, segmentation);
+    while (_cache_order.size() > SUPERPIXEL_CACHE_IMAGES) {
+        _cache.remove(_cache_order.takeFirst());
+    }
+}
+
+QGraphicsSuperpixels::Segmentation QGraphicsSuperpixels::_segment(const QImage& image, qint64 key, int region_size,
+                                                                  qreal compactness)
+{
+    Segmentation segmentation;
+    segmentation.image_key = key;
+    segmentation.region_size = region_size;
+    segmentation.compactness = compactness;
+    segmentation.width = image.width();
+    segmentation.height = image.height();
+    segmentation.labels.resize(image.width() * image.height());
+    if (image.isNull()) {
+        return segmentation;
+    }
+
+    // centers on a grid
+    int columns = (image.width() + region_size - 1) / region_size;
+    int rows = (image.height() + region_size - 1) / region_size;
+    QVector<Center> centers(columns * rows);
+    for (int gy = 0; gy < rows; gy++) {
+        for (int gx = 0; gx < columns; gx++) {
+            Center& center = centers[gy * columns + gx];
+            center.x = qMin(gx * region_size + region_size / 2, image.width() - 1);
+            center.y = qMin(gy * region_size + region_size / 2, image.height() - 1);
+            QRgb pixel = image.pixel(int(center.x), int(center.y));
+            center.r = qRed(pixel);
+            center.g = qGreen(pixel);
+            center.b = qBlue(pixel);
+        }
+    }
+
+    // tiles with the grid cells of the centers their pixels may join
+    QVector<Tile> tiles;
+    for (int y = 0; y < image.height(); y += SUPERPIXEL_TILE_SIZE) {
+        for (int x = 0; x < image.width(); x += SUPERPIXEL_TILE_SIZE) {
+            Tile tile;
+            tile.rect = QRect(x, y, qMin(SUPERPIXEL_TILE_SIZE, image.width() - x),
+                              qMin(SUPERPIXEL_TILE_SIZE, image.height() - y));
+            int left = qMax(tile.rect.left() / region_size - 1, 0);
+            int top = qMax(tile.rect.top() / region_size - 1, 0);
+            int right = qMin(tile.rect.right() / region_size + 1, columns - 1);
+            int bottom = qMin(tile.rect.bottom() / region_size + 1, rows - 1);
+            tile.cells = QRect(QPoint(left, top), QPoint(right, bottom));
+            tiles.append(tile);
+        }
+    }
+
+    TileAssignment assignment;
+    assignment.image = &image;
+    assignment.centers = &centers;
+    assignment.labels = segmentation.labels.data();
+    assignment.region_size = region_size;
+    assignment.columns = columns;
+    assignment.rows = rows;
+    assignment.weight = float(compactness * compactness / (region_size * region_size));
+    for (int iteration = 0; iteration < SUPERPIXEL_ITERATIONS; iteration++) {
+        QtConcurrent::blockingMap(tiles, assignment);
+        // move centers to the mean of their pixels
+        QVector<double> sums(centers.size() * 6, 0);
+        foreach (const Tile& tile, tiles) {
+            for (int i = 0; i < tile.cells.width() * tile.cells.height(); i++) {
+                int gx = tile.cells.left() + i % tile.cells.width();
+                int gy = tile.cells.top() + i / tile.cells.width();
+                double* sum = sums.data() + (gy * columns + gx) * 6;
+                const double* part = tile.sums.constData() + i * 6;
+                for (int k = 0; k < 6; k++) {
+                    sum[k] += part[k];
+                }
+            }
+        }
+        for (int i = 0; i < centers.size(); i++) {
+            const double* sum = sums.constData() + i * 6;
+            if (sum[5] > 0) {
+                centers[i].r = float(sum[0] / sum[5]);
+                centers[i].g = float(sum[1] / sum[5]);
+                centers[i].b = float(sum[2] / sum[5]);
+                centers[i].x = float(sum[3] / sum[5]);
+                centers[i].y = float(sum[4] / sum[5]);
+            }
+        }
+    }
+    _connect_labels(segmentation, region_size * region_size / 4);
+    return segmentation;
+}
+
+// nearest of the centers in the 3 x 3 grid cells around the pixel
+void QGraphicsSuperpixels::TileAssignment::operator()(Tile& tile) const
+{
+    tile.sums.fill(0, tile.cells.width() * tile.cells.height() * 6);
+    int width = image->width();
+    for (int y = tile.rect.top(); y <= tile.rect.bottom(); y++) {
+        const QRgb* pixels = reinterpret_cast<const QRgb*>(image->constScanLine(y));
+        int cy = y / region_size;
+        int top = qMax(cy - 1, 0);
+        int bottom = qMin(cy + 1, rows - 1);
+        for (int x = tile.rect.left(); x <= tile.rect.right(); x++) {
+            float r = qRed(pixels[x]);
+            float g = qGreen(pixels[x]);
+            float b = qBlue(pixels[x]);
+            int cx = x / region_size;
+            int left = qMax(cx - 1, 0);
+            int right = qMin(cx + 1, columns - 1);
+            int best = -1;
+            float nearest = 0;
+            for (int gy = top; gy <= bottom; gy++) {
+                for (int gx = left; gx <= right; gx++) {
+                    const Center& center = (*centers)[gy * columns + gx];
+                    float dr = r - center.r;
+                    float dg = g - center.g;
+                    float db = b - center.b;
+                    float dx = x - center.x;
+                    float dy = y - center.y;
+                    float d = dr * dr + dg * dg + db * db + weight * (dx * dx + dy * dy);
+                    if (best < 0 || d < nearest) {
+                        best = gy * columns + gx;
+                        nearest = d;
+                    }
+                }
+            }
+            labels[y * width + x] = best;
+            int local = (best / columns - tile.cells.top()) * tile.cells.width() + (best % columns - tile.cells.left());
+            double* sum = tile.sums.data() + local * 6;
+            sum[0] += r;
+            sum[1] += g;
+            sum[2] += b;
+            sum[3] += x;
+            sum[4] += y;
+            sum[5] += 1;
+        }
+    }
+}
+
+// 4-connected pieces of each label numbered again, those smaller than
+// min_size join the piece left of or above their first pixel
+void QGraphicsSuperpixels::_connect_labels(Segmentation& segmentation, int min_size)
+{
+    int width = segmentation.width;
+    int height = segmentation.height;
+    const QVector<int>& labels = segmentation.labels;
+    QVector<int> connected(labels.size(), -1);
+    QVector<QRect> bounds;
+    QVector<int> queue;
+    for (int i = 0; i < labels.size(); i++) {
+        if (connected[i] >= 0) {
+            continue;
+        }
+        int x = i % width;
+        int y = i / width;
+        int adjacent = x > 0 ? connected[i - 1] : (y > 0 ? connected[i - width] : -1);
+        int number = bounds.size();
+        int left = x, top = y, right = x, bottom = y;
+        queue.clear();
+        queue.append(i);
+        connected[i] = number;
+        for (int q = 0; q < queue.size(); q++) {
+            int index = queue[q];
+            int px = index % width;
+            int py = index / width;
+            left = qMin(left, px);
+            right = qMax(right, px);
+            top = qMin(top, py);
+            bottom = qMax(bottom, py);
+            int neighbours[4] = { px > 0 ? index - 1 : -1, px < width - 1 ? index + 1 : -1,
+                                  py > 0 ? index - width : -1, py < height - 1 ? index + width : -1 };
+            for (int k = 0; k < 4; k++) {
+                int next = neighbours[k];
+                if (next >= 0 && connected[next] < 0 && labels[next] == labels[i]) {
+                    connected[next] = number;
+                    queue.append(next);
+                }
+            }
+        }
+        QRect bound(QPoint(left, top), QPoint(right, bottom));
+        if (queue.size() < min_size && adjacent >= 0) {
+            foreach (int index, queue) {
+                connected[index] = adjacent;
+            }
+            bounds[adjacent] |= bound;
+        }
+        else {
+            bounds.append(bound);
+        }
+    }
+    segmentation.labels = connected;
+    segmentation.bounds = bounds;
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <QObject>
+#include <QFutureWatcher>
+#include <QImage>
+#include <QHash>
+#include <QList>
+#include <QSet>
+#include <QVector>
+#include <QRect>
+#include <QPoint>
+#include "QGraphicsRLEMask.h"
+
+/*!
+ * This class segments an image into superpixels, SLIC style, on a worker
+ * thread as soon as the image is set, for ROIs assembled by clicking them.
+ *
+ * Centers start on a grid of region size and each pixel joins the nearest of
+ * the 9 centers of grid cells around its own, by color and by distance weighted
+ * with compactness. Pixels are assigned in tiles in parallel, each tile summing
+ * the pixels of the centers near it, and the sums are merged to move centers.
+ * Superpixels are then made connected, small pieces joining a neighbour.
+ *
+ * Labels are kept per pixel, so the label under the cursor is read in O(1),
+ * with the bound of each superpixel, so the region of a few superpixels is
+ * scanned in their bound only. Segmentations are cached by the cache key of
+ * the image, and an image set again is not segmented again.
+ *
+ * Usage:
+ *
+ *   QGraphicsSuperpixels* superpixels = new QGraphicsSuperpixels(view);
+ *   connect(superpixels, &QGraphicsSuperpixels::segmentationReady, ...);
+ *   superpixels->setImage(image);
+ *   // on mouse move
+ *   int label = superpixels->label(pos);
+ *   QGraphicsRLEMask region = superpixels->region(labels);
+ */
+class QGraphicsSuperpixels : public QObject
+{
+    Q_OBJECT
+public:
+    QGraphicsSuperpixels(QObject* parent = 0);
+    ~QGraphicsSuperpixels();
+
+    // width of superpixels in pixels, 32 by default, and weight of distance
+    // against RGB color, 20 by default, cached segmentations are dropped
+    void setRegionSize(int size);
+    void setCompactness(qreal compactness);
+
+    // segment image on a worker thread, unless cached
+    void setImage(const QImage& image);
+
+    // segmentation of current image is ready
+    bool isReady() const;
+
+    // superpixel of pixel in image coords, -1 when outside or not ready
+    int label(const QPoint& pos) const;
+    int labelCount() const;
+    QRect labelRect(int label) const;
+
+    // pixels of superpixels in image coords
+    QGraphicsRLEMask region(const QSet<int>& labels) const;
+
+signals:
+    void segmentationReady();
+
+private slots:
+    void onFinished();
+
+private:
+    struct Segmentation
+    {
+        Segmentation() : image_key(0), region_size(0), compactness(0), width(0), height(0) {}
+        qint64 image_key;
+        int region_size;
+        qreal compactness;
+        int width;
+        int height;
+        QVector<int> labels; // per pixel
+        QVector<QRect> bounds; // per superpixel
+    };
+
+    struct Center
+    {
+        float r, g, b;
+        float x, y;
+    };
+
+    // pixels of a tile assigned to centers, sums of those near the tile
+    struct Tile
+    {
+        QRect rect;
+        QRect cells; // grid cells of centers summed
+        QVector<double> sums; // r, g, b, x, y, count per center of cells
+    };
+
+    struct TileAssignment
+    {
+        typedef void result_type;
+        const QImage* image;
+        const QVector<Center>* centers;
+        int* labels;
+        int region_size;
+        int columns;
+        int rows;
+        float weight; // of squared distance
+        void operator()(Tile& tile) const;
+    };
+
+    int _region_size;
+    qreal _compactness;
+    QImage _image; // RGB32
+    qint64 _image_key; // of the image given
+    Segmentation _current;
+    QHash<qint64, Segmentation> _cache;
+    QList<qint64> _cache_order; // oldest first
+    QFutureWatcher<Segmentation>* _watcher;
+    bool _pending;
+
+    void _request();
+    void _start();
+    void _store(const Segmentation& segmentation);
+    static Segmentation _segment(const QImage& image, qint64 key, int region_size, qreal compactness);
+    static void _connect_labels(Segmentation& segmentation, int min_size);
+};
@@ -1,6 +1,7 @@
 #include "QGraphicsViewZoom.h"
 #include <QMouseEvent>
 #include <QApplication>
+#include <QScrollBar>
 #include <qmath.h>
 
 QGraphicsViewZoom::QGraphicsViewZoom(QGraphicsView* view)
@@ -10,16 +11,19 @@ QGraphicsViewZoom::QGraphicsViewZoom(QGraphicsView* view)
 	_view->setMouseTracking(true);
 	_modifiers = Qt::ControlModifier;
 	_zoom_factor_base = 1.0015;
+	_min_zoom = 0.01;
+	_max_zoom = 100;
+	_easing = 0.35;
+	_target_zoom = _current_zoom();
+	// one zoom step per frame
+	_frame_timer.setInterval(16);
+	connect(&_frame_timer, SIGNAL(timeout()), this, SLOT(on_frame()));
 }
 
 void QGraphicsViewZoom::gentle_zoom(double factor) 
 {
-	_view->scale(factor, factor);
-	_view->centerOn(target_scene_pos);
-	QPointF center(_view->viewport()->width() / 2.0, _view->viewport()->height() / 2.0);
-	QPointF delta_viewport_pos = target_viewport_pos - center; 
-	QPointF viewport_center = _view->mapFromScene(target_scene_pos) - delta_viewport_pos;
-	_view->centerOn(_view->mapToScene(viewport_center.toPoint()));
+	_target_zoom = qBound(_min_zoom, _current_zoom() * factor, _max_zoom);
+	_apply_zoom(_target_zoom);
 	Q_EMIT zoomed();
 }
 
@@ -33,6 +37,61 @@ void QGraphicsViewZoom::set_zoom_factor_base(double value)
 	_zoom_factor_base = value;
 }
 
+void QGraphicsViewZoom::set_zoom_range(double min_zoom, double max_zoom)
+{
+	_min_zoom = min_zoom;
+	_max_zoom = max_zoom;
+	_target_zoom = qBound(_min_zoom, _target_zoom, _max_zoom);
+}
+
+void QGraphicsViewZoom::set_easing(double easing)
+{
+	_easing = qBound(0.01, easing, 1.0);
+}
+
+bool QGraphicsViewZoom::is_zooming() const
+{
+	return _frame_timer.isActive();
+}
+
+// scale the view to given zoom level in one transform, keeping any rotation
+// or shear, then scroll to keep the target scene point under the cursor
+void QGraphicsViewZoom::_apply_zoom(double zoom)
+{
+	double factor = zoom / _current_zoom();
+	_view->scale(factor, factor);
+	QPointF delta = _view->mapFromScene(target_scene_pos) - target_viewport_pos;
+	QScrollBar* h_bar = _view->horizontalScrollBar();
+	QScrollBar* v_bar = _view->verticalScrollBar();
+	h_bar->setValue(h_bar->value() + qRound(delta.x()));
+	v_bar->setValue(v_bar->value() + qRound(delta.y()));
+}
+
+// scale of the view transform, also when rotated or sheared
+double QGraphicsViewZoom::_current_zoom() const
+{
+	return qSqrt(qAbs(_view->transform().determinant()));
+}
+
+// ease towards target zoom, one transform per frame
+void QGraphicsViewZoom::on_frame()
+{
+	double zoom = _current_zoom();
+	double remaining = qLn(_target_zoom / zoom);
+	if (qAbs(remaining) < 1e-3 || _easing >= 1.0) {
+		zoom = _target_zoom;
+	}
+	else {
+		zoom *= qExp(remaining * _easing);
+	}
+	_apply_zoom(zoom);
+	Q_EMIT zoomed();
+	if (zoom == _target_zoom) {
+		_frame_timer.stop();
+		Q_EMIT zoomFinished();
+	}
+}
+
 bool QGraphicsViewZoom::eventFilter(QObject *object, QEvent *event) 
 {
 	if (event->type() == QEvent::MouseMove) {
@@ -50,8 +109,15 @@ bool QGraphicsViewZoom::eventFilter(QObject *object, QEvent *event)
             double angle = wheel_event->angleDelta().y();
             if (angle != 0) {
                 //double angle = wheel_event->angleDelta().y();
-				double factor = qPow(_zoom_factor_base, angle);
-				gentle_zoom(factor);
+				// accumulate deltas, applied by frame timer
+				if (!is_zooming()) {
+					_target_zoom = _current_zoom();
+				}
+				_target_zoom = qBound(_min_zoom, _target_zoom * qPow(_zoom_factor_base, angle), _max_zoom);
+				if (!is_zooming()) {
+					_frame_timer.start();
+					Q_EMIT zoomStarted();
+				}
 				return true;
 			}
 		}
@@ -2,6 +2,7 @@
 
 #include <QObject>
 #include <QGraphicsView>
+#include <QTimer>
 
 /*!
  * This class adds ability to zoom QGraphicsView using mouse wheel. The point under cursor
@@ -17,6 +18,11 @@
  * each scrolling step because that approach leads to position errors due to before-mentioned
  * positioning restrictions.
  *
+ * Wheel and trackpad deltas are not applied one by one. They are accumulated into a target
+ * zoom level, and a frame timer eases the view towards it with one transform per frame.
+ * zoomStarted() is emitted when the animation begins and zoomFinished() when the target is
+ * reached, so the view may render with lower fidelity in between.
+ *
  * When zommed using scroll, this class emits zoomed() signal.
  *
  * Usage:
@@ -32,6 +38,10 @@
  * Zoom coefficient is calculated as zoom_factor_base^angle_delta
  * (see QWheelEvent::angleDelta).
  * The default zoom factor base is 1.0015.
+ *
+ * The zoom level is clamped by set_zoom_range(), default from 0.01 to 100.
+ * The easing is set by set_easing(), the fraction of the remaining zoom (in log scale)
+ * applied per frame, default 0.35. An easing of 1 applies accumulated deltas at next frame.
  */
 class QGraphicsViewZoom : public QObject 
 {
@@ -42,14 +52,30 @@ public:
 	void gentle_zoom(double factor);
 	void set_modifiers(Qt::KeyboardModifiers modifiers);
 	void set_zoom_factor_base(double value);
+	void set_zoom_range(double min_zoom, double max_zoom);
+	void set_easing(double easing);
+
+	// zoom animation is running
+	bool is_zooming() const;
+
+private slots:
+	void on_frame();
 
 private:
 	QGraphicsView* _view;
 	Qt::KeyboardModifiers _modifiers;
 	double _zoom_factor_base;
+	double _min_zoom, _max_zoom;
+	double _easing;
+	double _target_zoom;
+	QTimer _frame_timer;
 	QPointF target_scene_pos, target_viewport_pos;
 	bool eventFilter(QObject* object, QEvent* event);
+	void _apply_zoom(double zoom);
+	double _current_zoom() const;
 
 signals:
 	void zoomed();
+	void zoomStarted();
+	void zoomFinished();
 };
@@ -0,0 +1,1101 @@
+#include <QApplication>
+#include <QGraphicsView>
+#include <QGraphicsScene>
+#include <QGraphicsPixmapItem>
+#include <QScrollBar>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QEventLoop>
+#include <QTimer>
+#include <random>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include <qmath.h>
+#include "QGraphicsRenderQuality.h"
+#include "QGraphicsDragIndex.h"
+#include "QGraphicsROIOverlap.h"
+#include "QGraphicsROIBoolean.h"
+#include "QGraphicsPolygonValidity.h"
+#include "QGraphicsROIMetrics.h"
+#include "QGraphicsLassoItem.h"
+#include "QGraphicsMaskObject.h"
+#include "QGraphicsRLEMask.h"
+#include "QGraphicsMagicWand.h"
+#include "QGraphicsLiveWire.h"
+#include "QGraphicsSuperpixels.h"
+#include "QGraphicsImageItem.h"
+#include "QGraphicsROIPublisher.h"
+#include "QGraphicsROIBatch.h"
+#include <QTemporaryDir>
+#include <QLocalSocket>
+#ifdef Q_OS_UNIX
+#include "QGraphicsFrameSource.h"
+#endif
+#include "QGraphicsRectObject.h"
+#include "QGraphicsRectSelector.h"
+#include "QGraphicsPolygonObject.h"
+
+// Benchmarks of rendering and editing paths.
+// Usage: QGraphicsROIBench [name filter]
+// Runs on offscreen platform unless QT_QPA_PLATFORM is set.
+
+static QTextStream out(stdout);
+
+// pan a 4K view over dense rectangle ROIs, at full quality and on fast path
+static void bench_pan_quality()
+{
+    const int count = 20000;
+    const int frames = 120;
+    const QRectF scene_rect(0, 0, 7680, 4320);
+
+    QGraphicsScene scene(scene_rect);
+    QGraphicsView view(&scene);
+    view.resize(3840, 2160);
+    view.setDragMode(QGraphicsView::ScrollHandDrag);
+    QGraphicsRenderQuality* quality = new QGraphicsRenderQuality(&view);
+
+    QGraphicsPixmapItem* background = scene.addPixmap(QPixmap::fromImage(QImage(3840, 2160, QImage::Format_RGB888)));
+    background->setScale(2);
+    QObject::connect(quality, &QGraphicsRenderQuality::qualityChanged, [background](int fast_path) {
+        bool nearest = fast_path & QGraphicsRenderQuality::NEAREST_BACKGROUND;
+        background->setTransformationMode(nearest ? Qt::FastTransformation : Qt::SmoothTransformation);
+    });
+    background->setTransformationMode(Qt::SmoothTransformation);
+
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<qreal> x(0, scene_rect.width() - 100);
+    std::uniform_real_distribution<qreal> y(0, scene_rect.height() - 100);
+    std::uniform_real_distribution<qreal> size(4, 100);
+    for (int i = 0; i < count; i++) {
+        QGraphicsRectObject* item = new QGraphicsRectObject(QRectF(x(rng), y(rng), size(rng), size(rng)));
+        scene.addItem(item);
+        item->setSelected(i % 100 == 0);
+    }
+    view.show();
+    QApplication::processEvents();
+
+    const char* names[] = { "full", "fast" };
+    const int policies[] = { 0, QGraphicsRenderQuality::ALL_FAST_PATHS };
+    for (int p = 0; p < 2; p++) {
+        quality->setFastPath(policies[p]);
+        QScrollBar* h_bar = view.horizontalScrollBar();
+        h_bar->setValue(0);
+        view.viewport()->repaint();
+        QElapsedTimer timer;
+        timer.start();
+        for (int i = 0; i < frames; i++) {
+            h_bar->setValue((i * 16) % qMax(1, h_bar->maximum()));
+            view.viewport()->repaint();
+        }
+        double ms = timer.nsecsElapsed() / 1e6 / frames;
+        out << "pan_quality " << names[p] << ": " << count << " rois, "
+            << ms << " ms/frame, " << 1000.0 / ms << " fps\n";
+        out.flush();
+    }
+}
+
+// expose vertex moving of polygon
+class BenchPolygonObject : public QGraphicsPolygonObject
+{
+public:
+    BenchPolygonObject(const QPolygonF& polygon) : QGraphicsPolygonObject(polygon) {}
+
+    // repaint the whole item on each move, return repainted area
+    qreal moveFull(int handle, const QPointF& pos)
+    {
+        _resizing = true;
+        _resizing_handle = handle;
+        _resize_polygon(pos);
+        prepareGeometryChange();
+        update();
+        return boundingRect().width() * boundingRect().height();
+    }
+
+    // repaint damaged area only, return repainted area
+    qreal moveDamage(int handle, const QPointF& pos)
+    {
+        _resizing = true;
+        _resizing_handle = handle;
+        QVector<QRectF> damage = _move_handle(pos);
+        qreal area = 0;
+        for (int i = 0; i < damage.size(); i++) {
+            area += damage[i].width() * damage[i].height();
+        }
+        return area;
+    }
+};
+
+// drag single vertices of a large selected polygon, full and damaged area repaint
+static void bench_move_damage()
+{
+    const int count = 10000;
+    const int moves = 200;
+    QGraphicsScene scene(0, 0, 1920, 1080);
+    QGraphicsView view(&scene);
+    view.resize(1920, 1080);
+
+    QPolygonF polygon(count);
+    for (int i = 0; i < count; i++) {
+        qreal a = 2 * M_PI * i / count;
+        qreal r = (i % 2) ? 400 : 380;
+        polygon[i] = QPointF(960 + r * qCos(a), 540 + r * qSin(a));
+    }
+    BenchPolygonObject* item = new BenchPolygonObject(polygon);
+    scene.addItem(item);
+    item->setSelected(true);
+    view.show();
+    QApplication::processEvents();
+
+    const char* names[] = { "full", "damage" };
+    for (int p = 0; p < 2; p++) {
+        qreal area = 0;
+        QElapsedTimer timer;
+        timer.start();
+        for (int i = 0; i < moves; i++) {
+            // move vertices inwards and back
+            int handle = (i * 37) % count;
+            QPointF pos = polygon[handle] + QPointF((i % 2) ? 5 : -5, (i % 2) ? -5 : 5);
+            area += p ? item->moveDamage(handle, pos) : item->moveFull(handle, pos);
+            QApplication::processEvents();
+        }
+        double ms = timer.nsecsElapsed() / 1e6 / moves;
+        out << "move_damage " << names[p] << ": " << count << " vertices, "
+            << area / moves << " px2/move, " << ms << " ms/move\n";
+        out.flush();
+    }
+}
+
+// drag 5k selected rectangles among 20k, with the scene index and unindexed
+static void bench_drag_selection()
+{
+    const int count = 20000;
+    const int selected = 5000;
+    const int steps = 60;
+    const QRectF scene_rect(0, 0, 7680, 4320);
+
+    QGraphicsScene scene(scene_rect);
+    QGraphicsView view(&scene);
+    view.resize(1920, 1080);
+    QGraphicsDragIndex* drag_index = new QGraphicsDragIndex(&view);
+
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<qreal> x(0, scene_rect.width() - 100);
+    std::uniform_real_distribution<qreal> y(0, scene_rect.height() - 100);
+    std::uniform_real_distribution<qreal> size(4, 100);
+    for (int i = 0; i < count; i++) {
+        QGraphicsRectObject* item = new QGraphicsRectObject(QRectF(x(rng), y(rng), size(rng), size(rng)));
+        scene.addItem(item);
+        item->setSelected(i % (count / selected) == 0);
+    }
+    view.show();
+    QApplication::processEvents();
+
+    const char* names[] = { "indexed", "unindexed" };
+    for (int p = 0; p < 2; p++) {
+        QList<QGraphicsItem*> selection = scene.selectedItems();
+        QElapsedTimer timer;
+        timer.start();
+        if (p) {
+            drag_index->begin(selection.first());
+        }
+        // as dragging by mouse, move all selected items, hit test and repaint
+        int hits = 0;
+        for (int i = 0; i < steps; i++) {
+            QPointF delta((i % 2) ? -4 : 4, 2);
+            foreach (QGraphicsItem* item, selection) {
+                item->setPos(item->pos() + delta);
+            }
+            QPointF pos = selection.first()->sceneBoundingRect().center();
+            hits += p ? drag_index->itemsAt(pos).size() : scene.items(pos).size();
+            view.viewport()->repaint();
+        }
+        double ms = timer.nsecsElapsed() / 1e6 / steps;
+        timer.restart();
+        if (p) {
+            drag_index->end();
+        }
+        // first query after dragging updates the index
+        hits += scene.items(scene_rect.center()).size();
+        double end_ms = timer.nsecsElapsed() / 1e6;
+        out << "drag_selection " << names[p] << ": " << selection.size() << " of " << count << " rois, "
+            << ms << " ms/step, " << end_ms << " ms at release, " << hits << " hits\n";
+        out.flush();
+    }
+}
+
+// move 5k selected rectangles among 20k, per item and as a group edit
+static void bench_group_move()
+{
+    const int count = 20000;
+    const int selected = 5000;
+    const int moves = 20;
+    const QRectF scene_rect(0, 0, 1920, 1080);
+
+    QGraphicsRectSelector view;
+    view.resize(1920, 1080);
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<qreal> x(0, scene_rect.width() - 20);
+    std::uniform_real_distribution<qreal> y(0, scene_rect.height() - 20);
+    std::uniform_real_distribution<qreal> size(2, 20);
+    for (int i = 0; i < count; i++) {
+        view.addRectItem(QRectF(x(rng), y(rng), size(rng), size(rng)));
+    }
+    QList<QGraphicsItem*> items = view.scene()->items();
+    for (int i = 0; i < items.size(); i++) {
+        items[i]->setSelected(i % (count / selected) == 0);
+    }
+    view.show();
+    QApplication::processEvents();
+
+    const char* names[] = { "per_item", "group" };
+    for (int p = 0; p < 2; p++) {
+        QList<QGraphicsItem*> selection = view.scene()->selectedItems();
+        QElapsedTimer timer;
+        timer.start();
+        for (int i = 0; i < moves; i++) {
+            QPointF offset((i % 2) ? -1 : 1, 0);
+            if (p) {
+                view.moveSelected(offset);
+            }
+            else {
+                foreach (QGraphicsItem* item, selection) {
+                    item->setPos(item->pos() + offset);
+                }
+            }
+            view.viewport()->repaint();
+        }
+        double ms = timer.nsecsElapsed() / 1e6 / moves;
+        out << "group_move " << names[p] << ": " << selection.size() << " of " << count << " rois, "
+            << ms << " ms/move\n";
+        out.flush();
+    }
+}
+
+// burst of 40k detections from 4 worker threads into the ROI queue
+static void bench_ingest_burst()
+{
+    const int producers = 4;
+    const int count = 10000;
+    QGraphicsRectSelector view;
+    view.resize(1920, 1080);
+    view.show();
+    QApplication::processEvents();
+    QGraphicsROIQueue* queue = view.roiQueue();
+
+    QElapsedTimer timer;
+    timer.start();
+    std::vector<std::thread> threads;
+    std::vector<double> push_ns(producers);
+    for (int p = 0; p < producers; p++) {
+        threads.push_back(std::thread([queue, p, count, &push_ns]() {
+            std::mt19937 rng(p);
+            std::uniform_real_distribution<qreal> x(0, 1900);
+            std::uniform_real_distribution<qreal> y(0, 1060);
+            QElapsedTimer push_timer;
+            push_timer.start();
+            for (int i = 0; i < count; i++) {
+                queue->pushAdd(qint64(p) * count + i, QGraphicsROIShape::fromRect(QRectF(x(rng), y(rng), 20, 20)));
+            }
+            push_ns[p] = double(push_timer.nsecsElapsed()) / count;
+        }));
+    }
+    for (size_t i = 0; i < threads.size(); i++) {
+        threads[i].join();
+    }
+
+    // drain frame by frame, the longest event loop iteration is a stall
+    double max_frame_ms = 0;
+    int frames = 0;
+    while (view.scene()->items().size() < producers * count + 1) {
+        QElapsedTimer frame_timer;
+        frame_timer.start();
+        QApplication::processEvents(QEventLoop::WaitForMoreEvents);
+        max_frame_ms = qMax(max_frame_ms, frame_timer.nsecsElapsed() / 1e6);
+        frames++;
+    }
+    double total_ms = timer.nsecsElapsed() / 1e6;
+    double push = 0;
+    for (int p = 0; p < producers; p++) {
+        push += push_ns[p] / producers;
+    }
+    out << "ingest_burst: " << producers * count << " rois, " << push << " ns/push, "
+        << frames << " frames, " << max_frame_ms << " ms max frame, " << total_ms << " ms total\n";
+    out.flush();
+}
+
+// replace 500 detections per frame, by deleting and creating items or by diffing
+static void bench_frame_detections()
+{
+    const int count = 500;
+    const int frames = 300;
+    QGraphicsRectSelector view;
+    view.resize(1920, 1080);
+    view.show();
+    QApplication::processEvents();
+
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<qreal> x(0, 1800);
+    std::uniform_real_distribution<qreal> y(0, 1000);
+    std::uniform_real_distribution<qreal> jitter(-3, 3);
+    QVector<QGraphicsRectSelector::Detection> detections(count);
+    for (int i = 0; i < count; i++) {
+        detections[i].box = QRectF(x(rng), y(rng), 60, 60);
+    }
+
+    const char* names[] = { "recreate", "diff" };
+    for (int p = 0; p < 2; p++) {
+        QList<QGraphicsRectObject*> items;
+        QElapsedTimer timer;
+        timer.start();
+        for (int f = 0; f < frames; f++) {
+            // boxes move a little, half of them are tracked by id
+            for (int i = 0; i < count; i++) {
+                detections[i].id = (i % 2) ? i : -1;
+                detections[i].box.translate(jitter(rng), jitter(rng));
+            }
+            if (p) {
+                view.setFrameDetections(detections);
+            }
+            else {
+                qDeleteAll(items);
+                items.clear();
+                for (int i = 0; i < count; i++) {
+                    items.append(view.addRectItem(detections[i].box));
+                }
+            }
+            view.viewport()->repaint();
+        }
+        double ms = timer.nsecsElapsed() / 1e6 / frames;
+        qDeleteAll(items);
+        out << "frame_detections " << names[p] << ": " << count << " boxes, " << ms << " ms/frame\n";
+        out.flush();
+    }
+}
+
+// dedupe 100k imported detections, 50k boxes each detected twice
+static void bench_overlap_dedupe()
+{
+    const int count = 50000;
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<qreal> x(0, 7680);
+    std::uniform_real_distribution<qreal> y(0, 4320);
+    std::uniform_real_distribution<qreal> size(10, 60);
+    std::uniform_real_distribution<qreal> jitter(-3, 3);
+    std::uniform_real_distribution<qreal> score(0, 1);
+    QVector<QGraphicsROIShape> shapes;
+    QVector<qreal> scores;
+    for (int i = 0; i < count; i++) {
+        QRectF box(x(rng), y(rng), size(rng), size(rng));
+        shapes.append(QGraphicsROIShape::fromRect(box));
+        shapes.append(QGraphicsROIShape::fromRect(box.translated(QPointF(jitter(rng), jitter(rng)))));
+        scores.append(score(rng));
+        scores.append(score(rng));
+    }
+    QElapsedTimer timer;
+    timer.start();
+    QGraphicsROIOverlap overlap(shapes);
+    int pairs = overlap.pairs().size();
+    double pairs_ms = timer.nsecsElapsed() / 1e6;
+    timer.restart();
+    int kept = overlap.suppress(scores, 0.5).size();
+    double nms_ms = timer.nsecsElapsed() / 1e6;
+    timer.restart();
+    int merged = overlap.merge(scores, 0.5).size();
+    double merge_ms = timer.nsecsElapsed() / 1e6;
+    out << "overlap_dedupe: " << shapes.size() << " rois, " << pairs << " pairs in " << pairs_ms << " ms, "
+        << kept << " kept by nms in " << nms_ms << " ms, " << merged << " merged in " << merge_ms << " ms\n";
+    out.flush();
+}
+
+// boolean operations of two 10k vertex polygons, by the kernel and by QPainterPath
+static void bench_boolean_ops()
+{
+    const int vertices = 10000;
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<qreal> noise(0.995, 1.005);
+    QPolygonF subject(vertices);
+    QPolygonF clip(vertices);
+    for (int i = 0; i < vertices; i++) {
+        qreal a = 2 * M_PI * i / vertices;
+        qreal r = 1000 * (1 + 0.1 * qSin(12 * a)) * noise(rng);
+        subject[i] = QPointF(r * qCos(a), r * qSin(a));
+        clip[i] = QPointF(300 + 900 * noise(rng) * qCos(a), 100 + 900 * noise(rng) * qSin(a));
+    }
+    QVector<QPolygonF> subject_rings;
+    QVector<QPolygonF> clip_rings;
+    subject_rings.append(subject);
+    clip_rings.append(clip);
+    QPainterPath subject_path;
+    QPainterPath clip_path;
+    subject_path.addPolygon(subject);
+    subject_path.closeSubpath();
+    clip_path.addPolygon(clip);
+    clip_path.closeSubpath();
+
+    const char* names[] = { "unite", "intersect", "subtract" };
+    for (int op = 0; op < 3; op++) {
+        QElapsedTimer timer;
+        timer.start();
+        QVector<QPolygonF> rings = QGraphicsROIBoolean::apply(subject_rings, clip_rings, QGraphicsROIBoolean::OPERATION(op));
+        double kernel_ms = timer.nsecsElapsed() / 1e6;
+        timer.restart();
+        QPainterPath path;
+        switch (op) {
+        case QGraphicsROIBoolean::UNITE:
+            path = subject_path.united(clip_path);
+            break;
+        case QGraphicsROIBoolean::INTERSECT:
+            path = subject_path.intersected(clip_path);
+            break;
+        default:
+            path = subject_path.subtracted(clip_path);
+            break;
+        }
+        double path_ms = timer.nsecsElapsed() / 1e6;
+        out << "boolean_ops " << names[op] << ": " << rings.size() << " rings, area " << QGraphicsROIBoolean::area(rings)
+            << ", " << kernel_ms << " ms, QPainterPath " << path.elementCount() << " elements, " << path_ms << " ms\n";
+        out.flush();
+    }
+}
+
+// self intersection check of a 20k vertex polygon, full and per vertex move,
+// and of a closed rectangle given to an item, which should be valid
+static void bench_polygon_validity()
+{
+    const int vertices = 20000;
+    const int moves = 10000;
+    QPolygonF polygon(vertices);
+    for (int i = 0; i < vertices; i++) {
+        qreal a = 2 * M_PI * i / vertices;
+        qreal r = 1000 * (1 + 0.05 * qSin(40 * a));
+        polygon[i] = QPointF(r * qCos(a), r * qSin(a));
+    }
+    QGraphicsPolygonValidity validity;
+    QElapsedTimer timer;
+    timer.start();
+    validity.reset(polygon);
+    double reset_ms = timer.nsecsElapsed() / 1e6;
+
+    // drag steps of a few pixels, each vertex is moved and put back
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<int> vertex(0, vertices - 1);
+    std::uniform_real_distribution<qreal> step(-3, 3);
+    double total_us = 0;
+    double max_us = 0;
+    int invalid = 0;
+    for (int m = 0; m < moves; m++) {
+        int i = vertex(rng);
+        timer.restart();
+        validity.moveVertex(i, polygon[i] + QPointF(step(rng), step(rng)));
+        double us = timer.nsecsElapsed() / 1e3;
+        invalid += validity.isValid() ? 0 : 1;
+        validity.moveVertex(i, polygon[i]);
+        total_us += us;
+        max_us = qMax(max_us, us);
+    }
+    out << "polygon_validity: " << vertices << " vertices, reset " << reset_ms << " ms, move "
+        << total_us / moves << " us avg, " << max_us << " us max, " << invalid << " invalid moves\n";
+
+    QGraphicsPolygonObject closed(QPolygonF(QRectF(0, 0, 100, 50)));
+    out << "polygon_validity closed rect: " << closed.roiShape().polygon.size() << " vertices, "
+        << (closed.isValid() ? "valid" : "INVALID") << "\n";
+    out.flush();
+}
+
+// metrics of a 20k vertex polygon per vertex move, summed again or updated
+static void bench_polygon_metrics()
+{
+    const int vertices = 20000;
+    const int moves = 10000;
+    QPolygonF polygon(vertices);
+    for (int i = 0; i < vertices; i++) {
+        qreal a = 2 * M_PI * i / vertices;
+        polygon[i] = QPointF(1000 * qCos(a), 1000 * qSin(a));
+    }
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<int> vertex(0, vertices - 1);
+    std::uniform_real_distribution<qreal> step(-3, 3);
+
+    const char* names[] = { "full", "incremental" };
+    for (int p = 0; p < 2; p++) {
+        QPolygonF moving = polygon;
+        QGraphicsPolygonMetrics metrics;
+        metrics.reset(moving);
+        qreal area = 0;
+        QElapsedTimer timer;
+        timer.start();
+        for (int m = 0; m < moves; m++) {
+            int i = vertex(rng);
+            moving[i] += QPointF(step(rng), step(rng));
+            if (p) {
+                metrics.moveVertex(i, moving[i]);
+                area = metrics.metrics().area;
+            }
+            else {
+                area = QGraphicsROIMetrics::fromShape(QGraphicsROIShape::fromPolygon(moving)).area;
+            }
+        }
+        double us = timer.nsecsElapsed() / 1e3 / moves;
+        out << "polygon_metrics " << names[p] << ": " << vertices << " vertices, " << us << " us/move, area " << area << "\n";
+        out.flush();
+    }
+}
+
+// 20 seconds of freehand stroke sampled at 1000 Hz, drawn as one line item per
+// sample or as one decimated lasso item
+static void bench_lasso_stroke()
+{
+    const int samples = 20000;
+    QVector<QPointF> stroke(samples);
+    std::mt19937 rng(1);
+    std::normal_distribution<qreal> turn(0, 0.05);
+    std::normal_distribution<qreal> jitter(0, 0.05);
+    QPointF pos(960, 540);
+    qreal angle = 0;
+    for (int i = 0; i < samples; i++) {
+        angle += turn(rng);
+        pos += QPointF(0.5 * qCos(angle) + jitter(rng), 0.5 * qSin(angle) + jitter(rng));
+        stroke[i] = pos;
+    }
+    QPen pen(Qt::red);
+
+    const char* names[] = { "line items", "lasso" };
+    for (int p = 0; p < 2; p++) {
+        QGraphicsScene scene(QRectF(0, 0, 1920, 1080));
+        QGraphicsLassoItem* lasso = new QGraphicsLassoItem(pen);
+        scene.addItem(lasso);
+        QElapsedTimer timer;
+        timer.start();
+        for (int i = 1; i < samples; i++) {
+            if (p) {
+                lasso->addSample(stroke[i]);
+            }
+            else {
+                scene.addLine(QLineF(stroke[i - 1], stroke[i]), pen);
+            }
+        }
+        double us = timer.nsecsElapsed() / 1e3 / samples;
+        out << "lasso_stroke " << names[p] << ": " << samples << " samples, " << us << " us/sample, "
+            << scene.items().size() << " items, " << lasso->polygon().size() << " vertices\n";
+        out.flush();
+    }
+}
+
+// brush strokes on a 40k x 40k image, 20 seconds at 1000 Hz, stamped into a
+// sparse mask, compared with the size of a full image bitmap
+static void bench_mask_brush()
+{
+    const int samples = 20000;
+    const qreal radius = 20;
+    QGraphicsScene scene(QRectF(0, 0, 40000, 40000));
+    QGraphicsMaskObject* item = new QGraphicsMaskObject();
+    scene.addItem(item);
+
+    std::mt19937 rng(1);
+    std::normal_distribution<qreal> turn(0, 0.05);
+    QPointF pos(20000, 20000);
+    qreal angle = 0;
+    QElapsedTimer timer;
+    timer.start();
+    qint64 worst = 0;
+    for (int i = 0; i < samples; i++) {
+        angle += turn(rng);
+        QPointF next = pos + QPointF(4 * qCos(angle), 4 * qSin(angle));
+        qint64 t0 = timer.nsecsElapsed();
+        item->paintStroke(pos, next, radius, i % 1000 >= 900);
+        worst = qMax(worst, timer.nsecsElapsed() - t0);
+        pos = next;
+    }
+    double us = timer.nsecsElapsed() / 1e3 / samples;
+    int tiles = item->mask().tileCount();
+    double mb = tiles * double(MASK_TILE_SIZE * MASK_TILE_SIZE) / (1 << 20);
+    out << "mask_brush: " << samples << " strokes, " << us << " us/stroke, worst " << worst / 1e3 << " us, "
+        << tiles << " tiles, " << mb << " MB vs " << 40000.0 * 40000 / (1 << 20) << " MB dense\n";
+    out.flush();
+}
+
+// boolean operations of 16k x 16k masks as runs, against the size of dense
+// bitmaps, and the trace back to polygons
+static void bench_rle_boolean()
+{
+    QPolygonF star;
+    for (int i = 0; i < 2000; i++) {
+        qreal a = 2 * M_PI * i / 2000;
+        qreal r = 6000 + 800 * qSin(37 * a);
+        star << QPointF(8000 + r * qCos(a), 8000 + r * qSin(a));
+    }
+    QElapsedTimer timer;
+    timer.start();
+    QGraphicsRLEMask subject = QGraphicsRLEMask::fromShape(QGraphicsROIShape::fromPolygon(star));
+    QGraphicsRLEMask clip = QGraphicsRLEMask::fromShape(QGraphicsROIShape::fromCircle(QPointF(9000, 9000), 5000));
+    out << "rle_boolean rasterize: " << timer.nsecsElapsed() / 1e6 << " ms, "
+        << subject.runCount() + clip.runCount() << " runs\n";
+
+    const char* names[] = { "unite", "intersect", "subtract", "xor" };
+    QGraphicsRLEMask result;
+    for (int op = 0; op < 4; op++) {
+        timer.restart();
+        result = QGraphicsRLEMask::apply(subject, clip, QGraphicsROIBoolean::OPERATION(op));
+        qint64 ns = timer.nsecsElapsed();
+        out << "rle_boolean " << names[op] << ": " << ns / 1e6 << " ms, area " << result.area() << ", "
+            << result.toByteArray().size() / 1024.0 << " KB vs " << 16000.0 * 16000 / (1 << 20) << " MB dense\n";
+        out.flush();
+    }
+    timer.restart();
+    QVector<QGraphicsROIShape> shapes = result.toShapes();
+    out << "rle_boolean trace: " << timer.nsecsElapsed() / 1e6 << " ms, " << shapes.size() << " regions\n";
+    out.flush();
+}
+
+static void bench_magic_wand()
+{
+    // noisy disc on a noisy background, 4K 
+    std::mt19937 random(11);
+    QImage image(4096, 4096, QImage::Format_RGB32);
+    for (int y = 0; y < image.height(); y++) {
+        QRgb* pixels = reinterpret_cast<QRgb*>(image.scanLine(y));
+        for (int x = 0; x < image.width(); x++) {
+            int base = (x - 2048) * (x - 2048) + (y - 2048) * (y - 2048) < 1500 * 1500 ? 40 : 160;
+            int noise = random() % 24;
+            pixels[x] = qRgb(base + noise, base + noise / 2, base);
+        }
+    }
+    QElapsedTimer timer;
+    int tolerances[] = { 8, 32, 128 };
+    for (int i = 0; i < 3; i++) {
+        timer.restart();
+        QGraphicsRLEMask region = QGraphicsMagicWand::fill(image, QPoint(2048, 2048), tolerances[i]);
+        out << "magic_wand fill tolerance " << tolerances[i] << ": " << timer.nsecsElapsed() / 1e6 << " ms, area "
+            << region.area() << ", " << region.runCount() << " runs\n";
+        out.flush();
+    }
+
+    // dragging tolerance, only the last request is filled to the end 
+    QGraphicsMagicWand wand;
+    wand.setImage(image);
+    QEventLoop loop;
+    QObject::connect(&wand, &QGraphicsMagicWand::regionReady, &loop, &QEventLoop::quit);
+    wand.select(QPoint(2048, 2048), 8);
+    loop.exec();
+    timer.restart();
+    for (int tolerance = 8; tolerance <= 40; tolerance++) {
+        wand.setTolerance(tolerance);
+    }
+    loop.exec();
+    out << "magic_wand drag of 33 tolerances: " << timer.nsecsElapsed() / 1e6 << " ms to last region\n";
+    out.flush();
+}
+
+static void bench_live_wire()
+{
+    // 8K image of noisy rings, the cursor follows one from the seed 
+    std::mt19937 random(13);
+    QImage image(8192, 8192, QImage::Format_Grayscale8);
+    for (int y = 0; y < image.height(); y++) {
+        uchar* pixels = image.scanLine(y);
+        for (int x = 0; x < image.width(); x++) {
+            int ring = int(qSqrt(qreal(x - 4096) * (x - 4096) + qreal(y - 4096) * (y - 4096))) / 300;
+            pixels[x] = uchar((ring % 2 ? 70 : 170) + random() % 32);
+        }
+    }
+    QGraphicsLiveWire wire;
+    wire.setImage(image);
+    QEventLoop loop;
+    QObject::connect(&wire, &QGraphicsLiveWire::pathReady, &loop, &QEventLoop::quit);
+    QPoint seed(4096 + 1200, 4096);
+    wire.setSeed(seed);
+
+    QElapsedTimer timer;
+    qint64 worst = 0;
+    qint64 total = 0;
+    int moves = 400;
+    for (int i = 1; i <= moves; i++) {
+        qreal angle = 0.5 * M_PI * i / moves;
+        QPoint target(4096 + qRound(1200 * qCos(angle)), 4096 + qRound(1200 * qSin(angle)));
+        timer.restart();
+        // paths over settled pixels are emitted at once 
+        wire.setTarget(target);
+        if (wire.isBusy()) {
+            loop.exec();
+        }
+        qint64 ns = timer.nsecsElapsed();
+        worst = qMax(worst, ns);
+        total += ns;
+    }
+    int points = QGraphicsLiveWire::shortestPath(image, seed, QPoint(4096, 4096 + 1200)).size();
+    out << "live_wire " << moves << " moves along quarter ring: " << total / 1e6 / moves << " ms per move, worst "
+        << worst / 1e6 << " ms, " << points << " turning points from scratch\n";
+    out.flush();
+}
+
+static void bench_superpixels()
+{
+    // 4K image of noisy blocks 
+    std::mt19937 random(17);
+    QImage image(3840, 2160, QImage::Format_RGB32);
+    for (int y = 0; y < image.height(); y++) {
+        QRgb* pixels = reinterpret_cast<QRgb*>(image.scanLine(y));
+        for (int x = 0; x < image.width(); x++) {
+            int v = ((x / 90 + y / 70) % 3) * 80;
+            pixels[x] = qRgb(v + random() % 20, 255 - v, random() % 20);
+        }
+    }
+    QGraphicsSuperpixels superpixels;
+    QEventLoop loop;
+    QObject::connect(&superpixels, &QGraphicsSuperpixels::segmentationReady, &loop, &QEventLoop::quit);
+    QElapsedTimer timer;
+    timer.start();
+    superpixels.setImage(image);
+    loop.exec();
+    out << "superpixels segment 3840x2160: " << timer.nsecsElapsed() / 1e6 << " ms, "
+        << superpixels.labelCount() << " superpixels\n";
+    out.flush();
+
+    // cached with the image 
+    timer.restart();
+    superpixels.setImage(image);
+    out << "superpixels cached: " << timer.nsecsElapsed() / 1e3 << " us\n";
+
+    // hover and click 
+    int lookups = 1000000;
+    qint64 sum = 0;
+    timer.restart();
+    for (int i = 0; i < lookups; i++) {
+        sum += superpixels.label(QPoint(random() % image.width(), random() % image.height()));
+    }
+    out << "superpixels label lookup: " << timer.nsecsElapsed() / double(lookups) << " ns (" << sum % 2 << ")\n";
+    QSet<int> labels;
+    QGraphicsRLEMask region;
+    timer.restart();
+    for (int i = 0; i < 100; i++) {
+        labels.clear();
+        labels.insert(superpixels.label(QPoint(random() % image.width(), random() % image.height())));
+        region = QGraphicsRLEMask::apply(region, superpixels.region(labels), QGraphicsROIBoolean::UNITE);
+    }
+    out << "superpixels click: " << timer.nsecsElapsed() / 1e6 / 100 << " ms, area " << region.area() << "\n";
+    out.flush();
+}
+
+static void bench_background_window()
+{
+    // 8K 16 bit image of a gradient with noise 
+    std::mt19937 random(23);
+    QGraphicsImageData data(7680, 4320, QGraphicsImageData::GRAY16);
+    for (int y = 0; y < data.height(); y++) {
+        quint16* pixels = reinterpret_cast<quint16*>(data.scanLine(y));
+        for (int x = 0; x < data.width(); x++) {
+            pixels[x] = quint16(x * 4 + y * 2 + random() % 256);
+        }
+    }
+    QVector<QRgb> colormap = QGraphicsImageData::colormap(QGraphicsImageData::HOT);
+
+    // the visible region mapped at full size and zoomed out 
+    const int frames = 20;
+    const int steps[] = { 1, 4 };
+    for (int s = 0; s < 2; s++) {
+        QRect visible(1000, 1000, 1920 * steps[s], 1080 * steps[s]);
+        QElapsedTimer timer;
+        timer.start();
+        for (int i = 0; i < frames; i++) {
+            data.map(visible, steps[s], 1000 + i * 100, 30000, colormap);
+        }
+        out << "background map 1920x1080 of 7680x4320 at step " << steps[s] << ": "
+            << timer.nsecsElapsed() / 1e6 / frames << " ms\n";
+    }
+    out.flush();
+
+    // window dragged on an item in a view, visible tiles mapped in parallel 
+    QGraphicsScene scene(data.rect());
+    QGraphicsView view(&scene);
+    view.resize(1920, 1080);
+    QGraphicsImageItem* item = new QGraphicsImageItem();
+    item->setImageData(data);
+    item->setColormap(colormap);
+    scene.addItem(item);
+    view.show();
+    QApplication::processEvents();
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < frames; i++) {
+        item->setWindow(1000 + i * 100, 30000);
+        view.viewport()->repaint();
+    }
+    out << "background window drag in view: " << timer.nsecsElapsed() / 1e6 / frames << " ms per frame\n";
+
+    // statistics under a large ROI 
+    QGraphicsRLEMask mask = QGraphicsRLEMask::fromShape(QGraphicsROIShape::fromCircle(QPointF(3000, 2000), 1800));
+    timer.restart();
+    QGraphicsImageData::Statistics statistics = data.statistics(mask);
+    out << "background statistics of " << statistics.count << " pixels: " << timer.nsecsElapsed() / 1e6
+        << " ms, mean " << statistics.mean << "\n";
+    out.flush();
+}
+
+static void bench_frame_formats()
+{
+    struct Format
+    {
+        const char* name;
+        QGraphicsImageData::FORMAT format;
+    };
+    const Format formats[] = {
+        { "nv12", QGraphicsImageData::NV12 },
+        { "yuyv", QGraphicsImageData::YUYV },
+        { "bayer_rggb", QGraphicsImageData::BAYER_RGGB },
+        { "gray16", QGraphicsImageData::GRAY16 },
+    };
+    const QSize sizes[] = { QSize(1920, 1080), QSize(3840, 2160) };
+    QVector<QRgb> colormap = QGraphicsImageData::colormap(QGraphicsImageData::GRAY);
+    std::mt19937 random(29);
+    const int frames = 20;
+    for (const Format& format : formats) {
+        for (const QSize& size : sizes) {
+            QGraphicsImageData frame(size.width(), size.height(), format.format);
+            uchar* bits = frame.bits();
+            for (qint64 i = 0; i < frame.byteCount(); i++) {
+                bits[i] = uchar(random());
+            }
+            double high = format.format == QGraphicsImageData::GRAY16 ? 65535 : 255;
+
+            // whole frame, as a tool would take it 
+            QElapsedTimer timer;
+            timer.start();
+            for (int i = 0; i < frames; i++) {
+                frame.map(frame.rect(), 1, 0, high, colormap);
+            }
+            out << "frame " << format.name << " " << size.width() << "x" << size.height()
+                << " full: " << timer.nsecsElapsed() / 1e6 / frames << " ms";
+
+            // zoomed in 4x on a 1920x1080 view, as visible tiles of the item 
+            QRect visible(size.width() / 3, size.height() / 3, 480, 270);
+            timer.restart();
+            for (int i = 0; i < frames; i++) {
+                frame.map(visible, 1, 0, high, colormap);
+            }
+            out << ", visible 480x270: " << timer.nsecsElapsed() / 1e6 / frames << " ms\n";
+            out.flush();
+        }
+    }
+}
+
+static void bench_roi_stream()
+{
+    // 1000 ROIs dragged each frame, to a subscriber reading and one not 
+    const int count = 1000;
+    const int frames = 120;
+    QGraphicsROIPublisher publisher;
+    publisher.setMaxQueuedBatches(16);
+    if (!publisher.listen("qgraphicsroi_bench")) {
+        out << "roi stream: cannot listen\n";
+        return;
+    }
+    QLocalSocket fast;
+    QLocalSocket slow;
+    fast.connectToServer("qgraphicsroi_bench");
+    slow.connectToServer("qgraphicsroi_bench");
+    slow.setReadBufferSize(4096);
+    QByteArray buffer;
+    qint64 received = 0;
+    qint64 dropped = 0;
+    QObject::connect(&fast, &QLocalSocket::readyRead, [&]() {
+        buffer.append(fast.readAll());
+        QGraphicsROIStream::Batch batch;
+        int used;
+        while ((used = QGraphicsROIStream::decode(buffer, batch)) > 0) {
+            buffer.remove(0, used);
+            received += batch.events.size();
+            dropped += batch.dropped;
+        }
+    });
+    QEventLoop loop;
+    QTimer::singleShot(100, &loop, &QEventLoop::quit);
+    loop.exec();
+
+    std::vector<QGraphicsRectItem> items(count);
+    QGraphicsROIStream::Batch batch;
+    for (int i = 0; i < count; i++) {
+        QGraphicsROIStream::Event event;
+        event.type = QGraphicsROIStream::UPDATE_EVENT;
+        event.id = i;
+        event.shape = QGraphicsROIShape::fromRect(QRectF(i % 40 * 50, i / 40 * 50, 40, 40));
+        batch.events.append(event);
+    }
+    QElapsedTimer timer;
+    timer.start();
+    int bytes = 0;
+    for (int i = 0; i < 100; i++) {
+        bytes = QGraphicsROIStream::encode(batch).size();
+    }
+    double encode_ms = timer.nsecsElapsed() / 1e6 / 100;
+
+    timer.restart();
+    for (int frame = 0; frame < frames; frame++) {
+        for (int i = 0; i < count; i++) {
+            // several moves of a ROI in a frame, coalesced into one update 
+            for (int move = 0; move < 4; move++) {
+                publisher.publishShape(&items[i], QGraphicsROIShape::fromRect(
+                    QRectF(i % 40 * 50 + frame + move, i / 40 * 50, 40, 40)));
+            }
+        }
+        publisher.publishCommit();
+        QTimer::singleShot(16, &loop, &QEventLoop::quit);
+        loop.exec();
+    }
+    QTimer::singleShot(200, &loop, &QEventLoop::quit);
+    loop.exec();
+    double seconds = timer.nsecsElapsed() / 1e9;
+    out << "roi stream " << count << " rois: encode " << encode_ms << " ms for " << bytes / 1024 << " KB, "
+        << qint64(received / seconds) << " events/s delivered, " << publisher.sentBatches() << " batches sent, "
+        << publisher.droppedBatches() << " dropped for slow subscriber (" << dropped << " seen by fast)\n";
+    out.flush();
+    publisher.close();
+}
+
+static void bench_roi_batch()
+{
+    // 32 images of 1920x1080 with 50 ROIs each, on one thread and on all 
+    const int count = 32;
+    QTemporaryDir dir;
+    std::mt19937 random(7);
+    std::uniform_real_distribution<qreal> x(0, 1800);
+    std::uniform_real_distribution<qreal> y(0, 960);
+    QStringList images;
+    QImage image(1920, 1080, QImage::Format_RGB32);
+    for (int i = 0; i < count; i++) {
+        image.fill(qRgb(i * 7 % 256, 90, 160));
+        QString path = dir.filePath(QString("image%1.png").arg(i));
+        image.save(path);
+        images << path;
+        QVector<QGraphicsROIFile::Entry> entries(50);
+        for (int k = 0; k < entries.size(); k++) {
+            QPointF origin(x(random), y(random));
+            QPolygonF polygon;
+            polygon << origin << origin + QPointF(110, 20) << origin + QPointF(80, 115) << origin + QPointF(-10, 90);
+            entries[k].shape = k % 2 ? QGraphicsROIShape::fromPolygon(polygon)
+                                     : QGraphicsROIShape::fromCircle(origin + QPointF(50, 50), 45);
+        }
+        QGraphicsROIFile::write(dir.filePath(QString("image%1.json").arg(i)), entries);
+    }
+    const int threads[] = { 1, 0 };
+    for (int i = 0; i < 2; i++) {
+        QGraphicsROIBatch batch;
+        batch.setOutputs(QGraphicsROIBatch::MASK_OUTPUT | QGraphicsROIBatch::OVERLAY_OUTPUT |
+                         QGraphicsROIBatch::STATISTICS_OUTPUT);
+        batch.setOutputDir(dir.filePath("output"));
+        batch.setThreads(threads[i]);
+        QElapsedTimer timer;
+        timer.start();
+        batch.run(images);
+        qint64 elapsed = timer.elapsed();
+        out << "roi batch " << count << " images, " << (threads[i] ? "1 thread" : "all threads") << ": "
+            << elapsed << " ms, " << count * 1000.0 / qMax<qint64>(elapsed, 1) << " images/s, decode "
+            << batch.stageTime(QGraphicsROIBatch::DECODE_STAGE) << " ms, rasterize "
+            << batch.stageTime(QGraphicsROIBatch::RASTERIZE_STAGE) << " ms, encode "
+            << batch.stageTime(QGraphicsROIBatch::ENCODE_STAGE) << " ms, failed " << batch.failedCount() << "\n";
+        out.flush();
+    }
+}
+
+#ifdef Q_OS_UNIX
+static void bench_frame_ring()
+{
+    // 4K NV12 frames written as fast as slots are free, shown on this thread 
+    const int width = 3840;
+    const int height = 2160;
+    const int seconds = 3;
+    QGraphicsFrameRing ring;
+    if (!ring.create("/qgraphicsroi_bench", 4, width * height * 3 / 2)) {
+        out << "frame ring: cannot create shared memory\n";
+        return;
+    }
+    QGraphicsFrameSource source;
+    source.open("/qgraphicsroi_bench");
+    QElapsedTimer clock;
+    clock.start();
+    int shown = 0;
+    qint64 latency = 0;
+    quint64 last = 0;
+    int stale = 0;
+    QObject::connect(&source, &QGraphicsFrameSource::frameReady, [&](const QGraphicsImageData& frame) {
+        quint64 stamp[2];
+        memcpy(stamp, frame.constBits(), sizeof(stamp));
+        stale += stamp[0] <= last ? 1 : 0;
+        last = stamp[0];
+        latency += clock.nsecsElapsed() / 1000 - qint64(stamp[1]);
+        shown++;
+    });
+    volatile bool running = true;
+    quint64 written = 0;
+    std::thread producer([&]() {
+        for (quint64 number = 1; running; number++) {
+            int slot = ring.beginFrame();
+            if (slot < 0) {
+                std::this_thread::yield();
+                continue;
+            }
+            uchar* bits = ring.slotBits(slot);
+            memset(bits + 16, int(number), width * height * 3 / 2 - 16);
+            quint64 stamp[2] = { number, quint64(clock.nsecsElapsed() / 1000) };
+            memcpy(bits, stamp, sizeof(stamp));
+            ring.publish(slot, QGraphicsImageData::NV12, width, height, width);
+            written++;
+        }
+    });
+    QEventLoop loop;
+    QTimer::singleShot(seconds * 1000, &loop, &QEventLoop::quit);
+    loop.exec();
+    running = false;
+    producer.join();
+    source.close();
+    out << "frame ring 3840x2160 nv12: " << written / seconds << " written/s, " << shown / seconds
+        << " shown/s, latency " << (shown ? latency / shown : 0) << " us, stale " << stale << "\n";
+    out.flush();
+}
+#endif
+
+int main(int argc, char* argv[])
+{
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QApplication a(argc, argv);
+    QString filter = argc > 1 ? QString(argv[1]) : QString();
+
+    struct Benchmark
+    {
+        const char* name;
+        void (*run)();
+    };
+    const Benchmark benchmarks[] = {
+        { "pan_quality", bench_pan_quality },
+        { "move_damage", bench_move_damage },
+        { "drag_selection", bench_drag_selection },
+        { "group_move", bench_group_move },
+        { "ingest_burst", bench_ingest_burst },
+        { "frame_detections", bench_frame_detections },
+        { "overlap_dedupe", bench_overlap_dedupe },
+        { "boolean_ops", bench_boolean_ops },
+        { "polygon_validity", bench_polygon_validity },
+        { "polygon_metrics", bench_polygon_metrics },
+        { "lasso_stroke", bench_lasso_stroke },
+        { "mask_brush", bench_mask_brush },
+        { "rle_boolean", bench_rle_boolean },
+        { "magic_wand", bench_magic_wand },
+        { "live_wire", bench_live_wire },
+        { "superpixels", bench_superpixels },
+        { "background_window", bench_background_window },
+        { "frame_formats", bench_frame_formats },
+        { "roi_stream", bench_roi_stream },
+        { "roi_batch", bench_roi_batch },
+#ifdef Q_OS_UNIX
+        { "frame_ring", bench_frame_ring },
+#endif
+    };
+    for (const Benchmark& benchmark : benchmarks) {
+        if (QString(benchmark.name).contains(filter)) {
+            benchmark.run();
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,129 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QThread>
+#include <csignal>
+#include "QGraphicsFrameRing.h"
+#include "QGraphicsImageData.h"
+
+// Test producer of frames into a QGraphicsFrameRing, in place of a camera.
+// Frames are a moving gradient with a bright bar, numbered in their first
+// pixels, written at a fixed rate until interrupted.
+
+static volatile sig_atomic_t _interrupted = 0;
+
+static void _on_signal(int signal)
+{
+    Q_UNUSED(signal);
+    _interrupted = 1;
+}
+
+// Y plane, then U and V for 2 x 2 pixels, or 16 bit gray
+static void _draw_frame(uchar* bits, QGraphicsImageData::FORMAT format, int width, int height, int stride,
+                        quint64 number)
+{
+    int bar = int(number * 8 % width);
+    for (int y = 0; y < height; y++) {
+        if (format == QGraphicsImageData::GRAY16) {
+            quint16* row = reinterpret_cast<quint16*>(bits + qint64(y) * stride);
+            for (int x = 0; x < width; x++) {
+                row[x] = quint16(qAbs(x - bar) < 16 ? 65535 : (x + y + number) * 16 % 60000);
+            }
+        }
+        else {
+            uchar* row = bits + qint64(y) * stride;
+            for (int x = 0; x < width; x++) {
+                row[x] = uchar(qAbs(x - bar) < 16 ? 235 : 16 + (x + y + number) % 200);
+            }
+        }
+    }
+    if (format == QGraphicsImageData::NV12) {
+        for (int y = 0; y < (height + 1) / 2; y++) {
+            uchar* row = bits + qint64(height + y) * stride;
+            for (int x = 0; x < width / 2; x++) {
+                row[2 * x] = uchar(128 + (x * 2 * 100 / width) - 50);
+                row[2 * x + 1] = uchar(128 + (y * 2 * 100 / height) - 50);
+            }
+        }
+    }
+    // frame number in the first 8 bytes, for checks by the reader
+    for (int i = 0; i < 8; i++) {
+        bits[i] = uchar(number >> (8 * i));
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Writes test frames into a shared memory frame ring.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("name", "Name of the shared memory, as /camera.");
+    QCommandLineOption width_option("width", "Frame width.", "pixels", "1920");
+    QCommandLineOption height_option("height", "Frame height.", "pixels", "1080");
+    QCommandLineOption format_option("format", "nv12 or gray16.", "format", "nv12");
+    QCommandLineOption rate_option("rate", "Frames per second.", "fps", "30");
+    QCommandLineOption slots_option("slots", "Slots of the ring, at least 3.", "count", "4");
+    QCommandLineOption frames_option("frames", "Frames to write, 0 for no end.", "count", "0");
+    parser.addOption(width_option);
+    parser.addOption(height_option);
+    parser.addOption(format_option);
+    parser.addOption(rate_option);
+    parser.addOption(slots_option);
+    parser.addOption(frames_option);
+    parser.process(app);
+
+    QTextStream out(stdout);
+    QString name = parser.positionalArguments().value(0, "/qgraphicsroi_frames");
+    int width = qMax(2, parser.value(width_option).toInt()) & ~1;
+    int height = qMax(2, parser.value(height_option).toInt()) & ~1;
+    int rate = qMax(1, parser.value(rate_option).toInt());
+    quint64 frames = parser.value(frames_option).toULongLong();
+    QGraphicsImageData::FORMAT format = QGraphicsImageData::NV12;
+    int stride = (width + 63) & ~63;
+    int rows = height + height / 2;
+    if (parser.value(format_option) == "gray16") {
+        format = QGraphicsImageData::GRAY16;
+        stride = (width * 2 + 63) & ~63;
+        rows = height;
+    }
+
+    QGraphicsFrameRing ring;
+    if (!ring.create(name, parser.value(slots_option).toInt(), stride * rows)) {
+        out << "cannot create frame ring " << name << "\n";
+        return 1;
+    }
+    signal(SIGINT, _on_signal);
+    signal(SIGTERM, _on_signal);
+    out << "writing " << width << "x" << height << " " << parser.value(format_option) << " at " << rate
+        << " fps into " << name << "\n";
+    out.flush();
+
+    QElapsedTimer clock;
+    clock.start();
+    quint64 written = 0;
+    quint64 dropped = 0;
+    for (quint64 number = 1; !_interrupted && (frames == 0 || number <= frames); number++) {
+        int slot = ring.beginFrame();
+        if (slot < 0) {
+            dropped++; // all slots held by the reader
+        }
+        else {
+            _draw_frame(ring.slotBits(slot), format, width, height, stride, number);
+            ring.publish(slot, format, width, height, stride, quint64(clock.nsecsElapsed() / 1000));
+            written++;
+        }
+        qint64 next = qint64(number) * 1000000 / rate;
+        qint64 now = clock.nsecsElapsed() / 1000;
+        if (next > now) {
+            QThread::usleep(quint64(next - now));
+        }
+        if (number % (rate * 5) == 0) {
+            out << written << " frames written, " << dropped << " dropped\n";
+            out.flush();
+        }
+    }
+    out << written << " frames written, " << dropped << " dropped\n";
+    return 0;
+}
@@ -0,0 +1,80 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QImageReader>
+#include <QTextStream>
+#include <QDir>
+#include "QGraphicsROIBatch.h"
+
+// Renders masks, overlays and statistics of the ROI files of a directory of
+// images, without widgets, for batch jobs. ROIs of name.png are read from
+// name.json, as written by QGraphicsROIFile.
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Writes masks, overlays and statistics of ROI files of images.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("images", "Directory of images.");
+    QCommandLineOption rois_option("rois", "Directory of ROI files, the image directory if not set.", "dir");
+    QCommandLineOption output_option("output", "Directory of outputs.", "dir", "output");
+    QCommandLineOption masks_option("masks", "Write 8 bit masks, ROI number as value.");
+    QCommandLineOption overlays_option("overlays", "Write images with ROIs drawn over.");
+    QCommandLineOption statistics_option("statistics", "Write statistics.csv of ROIs.");
+    QCommandLineOption threads_option("threads", "Threads, 0 for the number of cores.", "count", "0");
+    QCommandLineOption in_flight_option("in-flight", "Images in memory at once, 0 for twice the threads.", "count",
+                                        "0");
+    QCommandLineOption opacity_option("opacity", "Opacity of ROIs in overlays.", "opacity", "0.4");
+    parser.addOption(rois_option);
+    parser.addOption(output_option);
+    parser.addOption(masks_option);
+    parser.addOption(overlays_option);
+    parser.addOption(statistics_option);
+    parser.addOption(threads_option);
+    parser.addOption(in_flight_option);
+    parser.addOption(opacity_option);
+    parser.process(app);
+
+    QTextStream out(stdout);
+    if (parser.positionalArguments().isEmpty()) {
+        parser.showHelp(1);
+    }
+    QDir dir(parser.positionalArguments().first());
+    QStringList filters;
+    foreach (const QByteArray& format, QImageReader::supportedImageFormats()) {
+        filters << "*." + QString::fromLatin1(format);
+    }
+    QStringList images;
+    foreach (const QString& name, dir.entryList(filters, QDir::Files, QDir::Name)) {
+        images << dir.filePath(name);
+    }
+    if (images.isEmpty()) {
+        out << "no images in " << dir.path() << "\n";
+        return 1;
+    }
+
+    int outputs = 0;
+    outputs |= parser.isSet(masks_option) ? QGraphicsROIBatch::MASK_OUTPUT : 0;
+    outputs |= parser.isSet(overlays_option) ? QGraphicsROIBatch::OVERLAY_OUTPUT : 0;
+    outputs |= parser.isSet(statistics_option) ? QGraphicsROIBatch::STATISTICS_OUTPUT : 0;
+    QGraphicsROIBatch batch;
+    batch.setOutputs(outputs ? outputs : int(QGraphicsROIBatch::MASK_OUTPUT));
+    batch.setOutputDir(parser.value(output_option));
+    batch.setRoiDir(parser.value(rois_option));
+    batch.setThreads(parser.value(threads_option).toInt());
+    batch.setMaxInFlight(parser.value(in_flight_option).toInt());
+    batch.setOverlayOpacity(parser.value(opacity_option).toDouble());
+
+    QElapsedTimer timer;
+    timer.start();
+    bool done = batch.run(images);
+    foreach (const QString& error, batch.errors()) {
+        out << error << "\n";
+    }
+    out << batch.processedCount() << " images in " << timer.elapsed() << " ms, " << batch.failedCount()
+        << " failed; decode " << batch.stageTime(QGraphicsROIBatch::DECODE_STAGE) << " ms, rasterize "
+        << batch.stageTime(QGraphicsROIBatch::RASTERIZE_STAGE) << " ms, encode "
+        << batch.stageTime(QGraphicsROIBatch::ENCODE_STAGE) << " ms over threads\n";
+    return done ? 0 : 2;
+}
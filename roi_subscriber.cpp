@@ -0,0 +1,124 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QLocalSocket>
+#include <QTextStream>
+#include <QThread>
+#include <QTimer>
+#include <QHash>
+#include "QGraphicsROIStream.h"
+
+// Reference subscriber of a QGraphicsROIPublisher. It keeps the current ROIs
+// from the events, prints each event when verbose, and counts per second the
+// batches, events and drops. A delay per batch stands for a slow consumer.
+
+static const char* _event_name(int type)
+{
+    switch (type) {
+    case QGraphicsROIStream::ADD_EVENT:
+        return "add";
+    case QGraphicsROIStream::UPDATE_EVENT:
+        return "update";
+    case QGraphicsROIStream::REMOVE_EVENT:
+        return "remove";
+    case QGraphicsROIStream::COMMIT_EVENT:
+        return "commit";
+    default:
+        return "unknown";
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Prints ROI changes streamed by a QGraphicsROI publisher.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("name", "Name of the local socket of the publisher.");
+    QCommandLineOption verbose_option("verbose", "Print every event.");
+    QCommandLineOption delay_option("delay", "Sleep after each batch, as a slow consumer.", "msec", "0");
+    parser.addOption(verbose_option);
+    parser.addOption(delay_option);
+    parser.process(app);
+
+    QTextStream out(stdout);
+    QString name = parser.positionalArguments().value(0, "qgraphicsroi");
+    bool verbose = parser.isSet(verbose_option);
+    int delay = parser.value(delay_option).toInt();
+
+    QLocalSocket socket;
+    QByteArray buffer;
+    QHash<qint64, QGraphicsROIStream::Event> rois;
+    qint64 batches = 0;
+    qint64 events = 0;
+    qint64 dropped = 0;
+    qint64 bytes = 0;
+
+    QObject::connect(&socket, &QLocalSocket::readyRead, [&]() {
+        QByteArray received = socket.readAll();
+        bytes += received.size();
+        buffer.append(received);
+        QGraphicsROIStream::Batch batch;
+        int used;
+        while ((used = QGraphicsROIStream::decode(buffer, batch)) > 0) {
+            buffer.remove(0, used);
+            batches++;
+            events += batch.events.size();
+            if (batch.dropped > 0) {
+                // events were lost, ROIs are as of the last batch received
+                dropped += batch.dropped;
+                out << "batch " << batch.number << ": " << batch.dropped << " batches dropped before\n";
+            }
+            foreach (const QGraphicsROIStream::Event& event, batch.events) {
+                if (event.type == QGraphicsROIStream::ADD_EVENT || event.type == QGraphicsROIStream::UPDATE_EVENT) {
+                    rois.insert(event.id, event);
+                }
+                else if (event.type == QGraphicsROIStream::REMOVE_EVENT) {
+                    rois.remove(event.id);
+                }
+                if (verbose) {
+                    // of pixels for a mask
+                    QRectF bound = event.shape.isNull() ? QRectF(event.mask.boundingRect())
+                                                        : event.shape.boundingRect();
+                    out << batch.number << " " << _event_name(event.type) << " " << event.id;
+                    if (event.type == QGraphicsROIStream::ADD_EVENT || event.type == QGraphicsROIStream::UPDATE_EVENT) {
+                        out << " bound " << bound.x() << " " << bound.y() << " " << bound.width() << " "
+                            << bound.height();
+                    }
+                    else if (event.type == QGraphicsROIStream::COMMIT_EVENT) {
+                        out << " " << rois.size() << " ROIs";
+                    }
+                    out << "\n";
+                }
+            }
+            if (delay > 0) {
+                QThread::msleep(quint32(delay));
+            }
+        }
+        if (used < 0) {
+            out << "not a ROI stream, disconnecting\n";
+            socket.abort();
+        }
+        out.flush();
+    });
+    QObject::connect(&socket, &QLocalSocket::disconnected, &app, &QCoreApplication::quit);
+
+    QTimer stats;
+    QObject::connect(&stats, &QTimer::timeout, [&]() {
+        out << batches << " batches, " << events << " events, " << bytes / 1024 << " KB, " << dropped
+            << " dropped, " << rois.size() << " ROIs\n";
+        out.flush();
+        batches = 0;
+        events = 0;
+        bytes = 0;
+    });
+
+    socket.connectToServer(name);
+    if (!socket.waitForConnected(3000)) {
+        out << "cannot connect to " << name << ": " << socket.errorString() << "\n";
+        return 1;
+    }
+    if (!verbose) {
+        stats.start(1000);
+    }
+    return app.exec();
+}